@@ -0,0 +1,224 @@
+/*
+ * arena.c
+ * File ID: e8fb3c8a-cb3b-11f1-9b5c-3930ed176716
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An arena hands out memory from large blocks, so many small strings with the 
+ * same lifetime cost only a few malloc() calls and are all released by one 
+ * call to arena_free(). The first block can be a buffer supplied by the 
+ * caller, for example on the stack, and new blocks are allocated from the 
+ * heap when it's full.
+ *
+ * All functions that take a `struct Arena *` use malloc() if it's NULL, so 
+ * the same code can store its strings in an arena or on the heap. Memory that 
+ * may come from either place is released with arena_discard().
+ */
+
+#include "suuid.h"
+
+/*
+ * arena_init() - Prepare the arena `a` for use. If `buf` isn't NULL, the 
+ * first `size` bytes are allocated from it before the heap is used. Returns 
+ * nothing.
+ */
+
+void arena_init(struct Arena *a, char *buf, const size_t size)
+{
+	assert(a);
+	assert(buf || !size);
+
+	a->block = NULL;
+	a->buf = a->first = buf;
+	a->size = a->first_size = size;
+	a->used = 0;
+}
+
+/*
+ * arena_alloc() - Return a pointer to `size` bytes from the arena `a`, 
+ * aligned to ARENA_ALIGN bytes. If there's no room in the current block, a 
+ * new block of at least ARENA_BLOCKSIZE bytes is allocated. If `a` is NULL, 
+ * malloc() is used. Returns NULL if the allocation failed.
+ */
+
+void *arena_alloc(struct Arena *a, const size_t size)
+{
+	struct Arenablock *b;
+	size_t pad = 0, bsize;
+	char *p;
+
+	if (!a) {
+		p = malloc(size);
+		if (!p)
+			return NULL; /* gncov */
+		trace_count(allocs, 1);
+		trace_count(alloc_bytes, size);
+		return p;
+	}
+
+	if (a->buf)
+		pad = (ARENA_ALIGN - (uintptr_t)(a->buf + a->used)
+		       % ARENA_ALIGN) % ARENA_ALIGN;
+	if (!a->buf || a->used + pad > a->size
+	    || size > a->size - a->used - pad) {
+		bsize = size + ARENA_ALIGN;
+		if (bsize < ARENA_BLOCKSIZE)
+			bsize = ARENA_BLOCKSIZE;
+		b = malloc(sizeof(struct Arenablock) + bsize);
+		if (!b)
+			return NULL; /* gncov */
+		trace_count(allocs, 1);
+		trace_count(alloc_bytes, sizeof(struct Arenablock) + bsize);
+		b->prev = a->block;
+		a->block = b;
+		a->buf = (char *)(b + 1);
+		a->size = bsize;
+		a->used = 0;
+		pad = (ARENA_ALIGN - (uintptr_t)a->buf % ARENA_ALIGN)
+		      % ARENA_ALIGN;
+	}
+	p = a->buf + a->used + pad;
+	a->used += pad + size;
+
+	return p;
+}
+
+/*
+ * arena_strndup() - Return a pointer to a copy of the first `len` bytes of 
+ * `s`, or the whole string if it's shorter, allocated from `a`. Returns NULL 
+ * if `s` is NULL or the allocation failed.
+ */
+
+char *arena_strndup(struct Arena *a, const char *s, const size_t len)
+{
+	size_t n = 0;
+	char *p;
+
+	if (!s)
+		return NULL;
+	while (n < len && s[n])
+		n++;
+	p = arena_alloc(a, n + 1);
+	if (!p)
+		return NULL; /* gncov */
+	memcpy(p, s, n);
+	p[n] = '\0';
+
+	return p;
+}
+
+/*
+ * arena_strdup() - Return a pointer to a copy of `s` allocated from `a`. 
+ * Returns NULL if `s` is NULL or the allocation failed.
+ */
+
+char *arena_strdup(struct Arena *a, const char *s)
+{
+	if (!s)
+		return NULL;
+
+	return arena_strndup(a, s, strlen(s));
+}
+
+/*
+ * arena_allocstr() - Return a pointer to a string allocated from `a`, 
+ * generated by providing printf()-like arguments. Returns NULL on error.
+ */
+
+char *arena_allocstr(struct Arena *a, const char *format, ...)
+{
+	va_list ap;
+	int needed;
+	size_t size;
+	char *p;
+
+	assert(format);
+
+	va_start(ap, format);
+	needed = vsnprintf(NULL, 0, format, ap);
+	va_end(ap);
+	if (needed < 0)
+		return NULL; /* gncov */
+
+	size = (size_t)needed + 1;
+	p = arena_alloc(a, size);
+	if (!p)
+		return NULL; /* gncov */
+	va_start(ap, format);
+	vsnprintf(p, size, format, ap);
+	va_end(ap);
+
+	return p;
+}
+
+/*
+ * arena_discard() - Free `p` if it was allocated with malloc() because `a` is 
+ * NULL. Memory from an arena is only released by arena_rewind() and 
+ * arena_free(). Returns nothing.
+ */
+
+void arena_discard(struct Arena *a, void *p)
+{
+	if (!a)
+		free(p);
+}
+
+/*
+ * arena_rewind() - Release everything allocated from `a` after `mark`, a copy 
+ * of the arena made earlier. Returns nothing.
+ */
+
+void arena_rewind(struct Arena *a, const struct Arena *mark)
+{
+	struct Arenablock *b;
+
+	assert(a);
+	assert(mark);
+
+	while (a->block != mark->block) {
+		assert(a->block);
+		b = a->block->prev;
+		free(a->block);
+		a->block = b;
+	}
+	a->buf = mark->buf;
+	a->size = mark->size;
+	a->used = mark->used;
+}
+
+/*
+ * arena_free() - Release all memory allocated from `a`. The arena can be used 
+ * again afterwards, starting with the buffer from arena_init(). Returns 
+ * nothing.
+ */
+
+void arena_free(struct Arena *a)
+{
+	struct Arenablock *b;
+
+	assert(a);
+
+	while (a->block) {
+		b = a->block->prev;
+		free(a->block);
+		a->block = b;
+	}
+	arena_init(a, a->first, a->first_size);
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
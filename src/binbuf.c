@@ -70,4 +70,35 @@ char *bb_allocstr(struct binbuf *dest, const char *format, ...)
 	return dest->buf;
 }
 
+/*
+ * bb_append() - Add `len` bytes from `src` to the end of `dest`, followed by 
+ * a terminating null byte. The buffer grows to at least twice its size when 
+ * it's full. Returns `dest->buf`, or NULL if allocation failed, `dest` is 
+ * unchanged then.
+ */
+
+char *bb_append(struct binbuf *dest, const char *src, const size_t len)
+{
+	assert(dest);
+	assert(src);
+
+	if (dest->len + len + 1 > dest->alloc) {
+		size_t size = dest->alloc ? dest->alloc * 2 : 256;
+		char *p;
+
+		while (size < dest->len + len + 1)
+			size *= 2;
+		p = realloc(dest->buf, size);
+		if (!p)
+			return NULL; /* gncov */
+		dest->buf = p;
+		dest->alloc = size;
+	}
+	memcpy(dest->buf + dest->len, src, len);
+	dest->len += len;
+	dest->buf[dest->len] = '\0';
+
+	return dest->buf;
+}
+
 /* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
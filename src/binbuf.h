@@ -30,6 +30,7 @@ struct binbuf {
 void binbuf_init(struct binbuf *sb);
 void binbuf_free(struct binbuf *sb);
 char *bb_allocstr(struct binbuf *dest, const char *format, ...);
+char *bb_append(struct binbuf *dest, const char *src, const size_t len);
 
 #endif /* ifndef _BINBUF_H */
 
@@ -0,0 +1,1119 @@
+/*
+ * binlog.c
+ * File ID: 0b8f5a36-ad92-11f0-8d0e-83850402c3ce
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The binary log consists of two files with the same prefix as the XML log 
+ * file:
+ *
+ * <host>.sbr - Record file. Starts with a BINLOG_HDR_SIZE bytes header 
+ * (magic, record size), followed by records of BINLOG_RECSIZE bytes:
+ *
+ *   0   16 bytes  Binary UUID
+ *   16  u64       UUID timestamp, 100 ns ticks since 1582-10-15
+ *   24  u64       Heap reference to host
+ *   32  u64       Heap reference to cwd
+ *   40  u64       Heap reference to user
+ *   48  u64       Heap reference to tty
+ *   56  u64       Heap reference to the tag list
+ *   64  u64       Heap reference to the sess list
+ *   72  u64       Heap reference to txt
+ *   80  u32       Flags, BINLOG_RAW or BINLOG_VERBATIM
+ *   84  u32       Reserved, always 0
+ *
+ * <host>.sbh - Append-only heap. Starts with an 8 byte magic, followed by 
+ * blobs with a u32 length and the data. A heap reference is the file offset 
+ * of the blob, 0 means "not defined". The tag list is an array of u64 
+ * references to the tag names, and the sess list is an array of u64 pairs 
+ * with references to the desc and UUID. Strings and lists are interned, so 
+ * the same value is stored only once. The txt is always appended.
+ *
+ * All integers are little-endian. A verbatim record has the whole XML line 
+ * in txt, it's used for lines that can't be recreated by xml_entry().
+ */
+
+#include "suuid.h"
+
+#define BINLOG_REC_MAGIC  "SUUIDBR1"
+#define BINLOG_HEAP_MAGIC  "SUUIDBH1"
+#define BINLOG_MAGIC_LEN  8
+
+/*
+ * Offsets of the values in a record.
+ */
+enum binlog_off {
+	BO_UUID = 0,
+	BO_TICK = 16,
+	BO_HOST = 24,
+	BO_CWD = 32,
+	BO_USER = 40,
+	BO_TTY = 48,
+	BO_TAGS = 56,
+	BO_SESS = 64,
+	BO_TXT = 72,
+	BO_FLAGS = 80
+};
+
+/*
+ * put_u32() - Store `val` as a little-endian 32-bit integer at `dest`. 
+ * Returns nothing.
+ */
+
+void put_u32(unsigned char *dest, const uint32_t val)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		dest[i] = (unsigned char)(val >> (8 * i));
+}
+
+/*
+ * put_u64() - Store `val` as a little-endian 64-bit integer at `dest`. 
+ * Returns nothing.
+ */
+
+void put_u64(unsigned char *dest, const uint64_t val)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		dest[i] = (unsigned char)(val >> (8 * i));
+}
+
+/*
+ * get_u32() - Return the little-endian 32-bit integer at `src`.
+ */
+
+uint32_t get_u32(const unsigned char *src)
+{
+	uint32_t retval = 0;
+	int i;
+
+	for (i = 3; i >= 0; i--)
+		retval = retval << 8 | src[i];
+
+	return retval;
+}
+
+/*
+ * get_u64() - Return the little-endian 64-bit integer at `src`.
+ */
+
+uint64_t get_u64(const unsigned char *src)
+{
+	uint64_t retval = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--)
+		retval = retval << 8 | src[i];
+
+	return retval;
+}
+
+/*
+ * blob_hash() - Return the FNV-1a hash of the `len` bytes at `data`.
+ */
+
+static uint64_t blob_hash(const void *data, const size_t len)
+{
+	const unsigned char *p = data;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/*
+ * intern_find() - Return pointer to the slot in the interning table of `bl` 
+ * where the blob with hash `h`, `len` bytes at `data`, is stored, or the empty 
+ * slot where it should be stored.
+ */
+
+static struct binlog_str *intern_find(struct Binlog *bl, const uint64_t h,
+                                      const void *data, const size_t len)
+{
+	size_t i;
+
+	assert(bl);
+	assert(bl->tabsize);
+
+	for (i = (size_t)h & (bl->tabsize - 1);
+	     bl->tab[i].data;
+	     i = (i + 1) & (bl->tabsize - 1)) {
+		struct binlog_str *e = &bl->tab[i];
+
+		if (e->hash == h && e->len == len
+		    && !memcmp(e->data, data, len))
+			break;
+	}
+
+	return &bl->tab[i];
+}
+
+/*
+ * intern_add() - Add the blob in `data` with length `len` and heap reference 
+ * `ref` to the interning table of `bl`. Returns 0 if ok, or 1 if malloc() 
+ * fails.
+ */
+
+static int intern_add(struct Binlog *bl, const void *data, const size_t len,
+                      const uint64_t ref)
+{
+	struct binlog_str *e;
+	uint64_t h;
+
+	assert(bl);
+	assert(data);
+
+	if (bl->tabcount * 2 >= bl->tabsize) {
+		struct binlog_str *old = bl->tab;
+		size_t i, oldsize = bl->tabsize;
+
+		bl->tabsize = oldsize ? oldsize * 2 : 64;
+		bl->tab = calloc(bl->tabsize, sizeof(struct binlog_str));
+		if (!bl->tab) {
+			failed("calloc()"); /* gncov */
+			bl->tab = old; /* gncov */
+			bl->tabsize = oldsize; /* gncov */
+			return 1; /* gncov */
+		}
+		for (i = 0; i < oldsize; i++) {
+			if (old[i].data) {
+				*intern_find(bl, old[i].hash, old[i].data,
+				             old[i].len) = old[i];
+			}
+		}
+		free(old);
+	}
+
+	h = blob_hash(data, len);
+	e = intern_find(bl, h, data, len);
+	if (e->data)
+		return 0;
+	e->data = malloc(len + 1);
+	if (!e->data) {
+		failed("malloc()"); /* gncov */
+		return 1; /* gncov */
+	}
+	memcpy(e->data, data, len);
+	e->hash = h;
+	e->len = len;
+	e->ref = ref;
+	bl->tabcount++;
+
+	return 0;
+}
+
+/*
+ * heap_append() - Append the `len` bytes at `data` to the heap file of `bl`. 
+ * Returns the heap reference, or 0 if error.
+ */
+
+static uint64_t heap_append(struct Binlog *bl, const void *data,
+                            const size_t len)
+{
+	unsigned char *buf;
+	uint64_t ref;
+	ssize_t res;
+
+	assert(bl);
+	assert(data || !len);
+
+	if (len > UINT32_MAX) {
+		myerror("Binary log: Value is too large"); /* gncov */
+		return 0; /* gncov */
+	}
+	buf = malloc(len + 4);
+	if (!buf) {
+		failed("malloc()"); /* gncov */
+		return 0; /* gncov */
+	}
+	put_u32(buf, (uint32_t)len);
+	if (len)
+		memcpy(buf + 4, data, len);
+	res = pwrite(bl->heapfd, buf, len + 4, (off_t)bl->heapsize);
+	free(buf);
+	if (res == -1 || (size_t)res != len + 4) {
+		myerror("Cannot write to binary log heap"); /* gncov */
+		return 0; /* gncov */
+	}
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, len + 4);
+	ref = bl->heapsize;
+	bl->heapsize += len + 4;
+
+	return ref;
+}
+
+/*
+ * heap_read() - Return pointer to an allocated buffer with the blob at heap 
+ * reference `ref` in the heap file of `bl`, and store the length in `len`. 
+ * The buffer is terminated with a null byte. Returns NULL if error.
+ */
+
+static char *heap_read(struct Binlog *bl, const uint64_t ref, size_t *len)
+{
+	unsigned char lenbuf[4];
+	char *retval;
+
+	assert(bl);
+	assert(len);
+
+	if (ref < BINLOG_MAGIC_LEN || ref + 4 > bl->heapsize
+	    || pread(bl->heapfd, lenbuf, 4, (off_t)ref) != 4)
+		return NULL;
+	*len = get_u32(lenbuf);
+	if (ref + 4 + *len > bl->heapsize)
+		return NULL;
+	retval = malloc(*len + 1);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	if (pread(bl->heapfd, retval, *len, (off_t)(ref + 4))
+	    != (ssize_t)*len) {
+		free(retval); /* gncov */
+		return NULL; /* gncov */
+	}
+	retval[*len] = '\0';
+
+	return retval;
+}
+
+/*
+ * intern() - Return the heap reference of the blob with length `len` at 
+ * `data`. If it isn't stored in the heap of `bl` already, append it. Returns 0 
+ * if error.
+ */
+
+static uint64_t intern(struct Binlog *bl, const void *data, const size_t len)
+{
+	struct binlog_str *e;
+	uint64_t ref;
+
+	assert(bl);
+	assert(data);
+
+	if (bl->tabsize) {
+		e = intern_find(bl, blob_hash(data, len), data, len);
+		if (e->data)
+			return e->ref;
+	}
+	ref = heap_append(bl, data, len);
+	if (!ref)
+		return 0; /* gncov */
+	if (intern_add(bl, data, len, ref))
+		return 0; /* gncov */
+
+	return ref;
+}
+
+/*
+ * intern_str() - Return the heap reference of the string `s` in `bl`, or 0 if 
+ * `s` is NULL. If an error occurs, `*err` is set to 1.
+ */
+
+static uint64_t intern_str(struct Binlog *bl, const char *s, int *err)
+{
+	uint64_t ref;
+
+	assert(bl);
+	assert(err);
+
+	if (!s)
+		return 0;
+	ref = intern(bl, s, strlen(s));
+	if (!ref)
+		*err = 1; /* gncov */
+
+	return ref;
+}
+
+/*
+ * seed_ref() - Read the blob at heap reference `ref` and add it to the 
+ * interning table. If `list` is true, the blob is an array of references, and 
+ * the blobs they point to are added too. Returns nothing, errors are ignored 
+ * because the table is only used to avoid duplicates.
+ */
+
+static void seed_ref(struct Binlog *bl, const uint64_t ref, const bool list)
+{
+	char *buf;
+	size_t len, i;
+
+	assert(bl);
+
+	if (!ref)
+		return;
+	buf = heap_read(bl, ref, &len);
+	if (!buf)
+		return;
+	intern_add(bl, buf, len, ref);
+	for (i = 0; list && i + 8 <= len; i += 8)
+		seed_ref(bl, get_u64((unsigned char *)buf + i), false);
+	free(buf);
+}
+
+/*
+ * check_magic() - Verify that file descriptor `fd` for `fname` starts with 
+ * `magic`. If the file is empty, write the magic and `extra` bytes at `rest`. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int check_magic(const int fd, const char *fname, const char *magic,
+                       const unsigned char *rest, const size_t extra)
+{
+	unsigned char buf[BINLOG_HDR_SIZE];
+	struct stat sb;
+
+	assert(fname);
+	assert(magic);
+	assert(BINLOG_MAGIC_LEN + extra <= BINLOG_HDR_SIZE);
+
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	if (!sb.st_size) {
+		memcpy(buf, magic, BINLOG_MAGIC_LEN);
+		if (extra)
+			memcpy(buf + BINLOG_MAGIC_LEN, rest, extra);
+		if (pwrite(fd, buf, BINLOG_MAGIC_LEN + extra, 0)
+		    != (ssize_t)(BINLOG_MAGIC_LEN + extra)) {
+			myerror("%s: Cannot write header", /* gncov */
+			        fname);
+			return 1; /* gncov */
+		}
+		return 0;
+	}
+	if (pread(fd, buf, BINLOG_MAGIC_LEN + extra, 0)
+	    != (ssize_t)(BINLOG_MAGIC_LEN + extra)
+	    || memcmp(buf, magic, BINLOG_MAGIC_LEN)
+	    || (extra && memcmp(buf + BINLOG_MAGIC_LEN, rest, extra))) {
+		myerror("%s: Not a binary suuid log file", fname);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * binlog_filename() - Return pointer to an allocated string with `prefix` 
+ * followed by `ext`, or NULL if error.
+ */
+
+static char *binlog_filename(const char *prefix, const char *ext)
+{
+	char *retval;
+
+	assert(prefix);
+	assert(ext);
+
+	retval = allocstr("%s%s", prefix, ext);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+	return retval;
+}
+
+/*
+ * binlog_init() - Initialise the `struct Binlog` in `bl`. Returns nothing.
+ */
+
+void binlog_init(struct Binlog *bl)
+{
+	assert(bl);
+
+	bl->recfd = bl->heapfd = -1;
+	bl->recsize = bl->heapsize = 0;
+	bl->tab = NULL;
+	bl->tabsize = bl->tabcount = 0;
+}
+
+/*
+ * binlog_open() - Open or create the binary log files with the file name 
+ * prefix `prefix` and lock the record file. A partially written record at the 
+ * end of the record file is removed. The interning table is seeded with the 
+ * values from the last record, so subsequent entries from the same 
+ * environment reuse the stored strings. Returns 0 if ok, or 1 if error.
+ */
+
+int binlog_open(struct Binlog *bl, const char *prefix, struct Lockstat *ls)
+{
+	char *recname = NULL, *heapname = NULL;
+	unsigned char recinfo[8];
+	struct stat sb;
+	int retval = 1;
+
+	assert(bl);
+	assert(prefix);
+	assert(*prefix);
+
+	binlog_init(bl);
+	recname = binlog_filename(prefix, BINLOG_REC_EXTENSION);
+	heapname = binlog_filename(prefix, BINLOG_HEAP_EXTENSION);
+	if (!recname || !heapname)
+		goto cleanup; /* gncov */
+
+	bl->recfd = open(recname, O_RDWR | O_CREAT, 0666);
+	if (bl->recfd == -1) {
+		myerror("%s: Could not open binary log file", recname);
+		goto cleanup;
+	}
+	if (lock_fd(bl->recfd, recname, ls))
+		goto cleanup; /* gncov */
+	bl->heapfd = open(heapname, O_RDWR | O_CREAT, 0666);
+	if (bl->heapfd == -1) {
+		myerror("%s: Could not open binary log file", heapname);
+		goto cleanup;
+	}
+
+	put_u32(recinfo, BINLOG_RECSIZE);
+	put_u32(recinfo + 4, 0);
+	if (check_magic(bl->recfd, recname, BINLOG_REC_MAGIC, recinfo, 8)
+	    || check_magic(bl->heapfd, heapname, BINLOG_HEAP_MAGIC, NULL, 0))
+		goto cleanup;
+
+	if (fstat(bl->recfd, &sb) == -1 || fstat(bl->heapfd, &sb) == -1) {
+		myerror("%s: Cannot stat file", prefix); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	bl->heapsize = (uint64_t)sb.st_size;
+	if (fstat(bl->recfd, &sb) == -1) {
+		myerror("%s: Cannot stat file", recname); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	bl->recsize = (uint64_t)sb.st_size;
+	if ((bl->recsize - BINLOG_HDR_SIZE) % BINLOG_RECSIZE) {
+		/*
+		 * The last record was only partially written, remove it. The 
+		 * heap data it refers to is never referenced and does no 
+		 * harm.
+		 */
+		bl->recsize -= (bl->recsize - BINLOG_HDR_SIZE)
+		               % BINLOG_RECSIZE;
+		if (ftruncate(bl->recfd, (off_t)bl->recsize) == -1) {
+			myerror("%s: Cannot truncate file", /* gncov */
+			        recname);
+			goto cleanup; /* gncov */
+		}
+	}
+
+	if (bl->recsize > BINLOG_HDR_SIZE) {
+		unsigned char rec[BINLOG_RECSIZE];
+
+		if (pread(bl->recfd, rec, BINLOG_RECSIZE,
+		          (off_t)(bl->recsize - BINLOG_RECSIZE))
+		    == BINLOG_RECSIZE) {
+			seed_ref(bl, get_u64(rec + BO_HOST), false);
+			seed_ref(bl, get_u64(rec + BO_CWD), false);
+			seed_ref(bl, get_u64(rec + BO_USER), false);
+			seed_ref(bl, get_u64(rec + BO_TTY), false);
+			seed_ref(bl, get_u64(rec + BO_TAGS), true);
+			seed_ref(bl, get_u64(rec + BO_SESS), true);
+		}
+	}
+	retval = 0;
+
+cleanup:
+	free(heapname);
+	free(recname);
+	if (retval)
+		binlog_close(bl);
+
+	return retval;
+}
+
+/*
+ * write_record() - Append the record in `rec` to the record file of `bl`. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int write_record(struct Binlog *bl, const unsigned char *rec)
+{
+	assert(bl);
+	assert(rec);
+
+	if (pwrite(bl->recfd, rec, BINLOG_RECSIZE, (off_t)bl->recsize)
+	    != BINLOG_RECSIZE) {
+		myerror("Cannot write to binary log file"); /* gncov */
+		return 1; /* gncov */
+	}
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, BINLOG_RECSIZE);
+	bl->recsize += BINLOG_RECSIZE;
+
+	return 0;
+}
+
+/*
+ * binlog_add() - Add the values in `entry` to the binary log `bl`. `raw` has 
+ * the same meaning as in xml_entry(). Returns 0 if ok, or 1 if error.
+ */
+
+int binlog_add(struct Binlog *bl, const struct Entry *entry, const bool raw)
+{
+	unsigned char rec[BINLOG_RECSIZE];
+	unsigned char *list = NULL;
+	unsigned int i, n;
+	int err = 0;
+
+	assert(bl);
+	assert(entry);
+	assert(raw == false || raw == true);
+
+	memset(rec, 0, BINLOG_RECSIZE);
+	if (uuid_to_bin(rec + BO_UUID, entry->uuid))
+		return 1; /* gncov */
+	put_u64(rec + BO_TICK, uuid_ticks(entry->uuid));
+	put_u64(rec + BO_HOST, intern_str(bl, entry->host, &err));
+	put_u64(rec + BO_CWD, intern_str(bl, entry->cwd, &err));
+	put_u64(rec + BO_USER, intern_str(bl, entry->user, &err));
+	put_u64(rec + BO_TTY, intern_str(bl, entry->tty, &err));
+
+	for (n = 0; entry->tag[n]; n++);
+	if (n) {
+		list = malloc(n * 8);
+		if (!list) {
+			failed("malloc()"); /* gncov */
+			return 1; /* gncov */
+		}
+		for (i = 0; i < n; i++) {
+			put_u64(list + i * 8,
+			        intern_str(bl, entry->tag[i], &err));
+		}
+		put_u64(rec + BO_TAGS, intern(bl, list, n * 8));
+		free(list);
+		list = NULL;
+	}
+
+	for (n = 0; entry->sess[n].uuid; n++);
+	if (n) {
+		list = malloc(n * 16);
+		if (!list) {
+			failed("malloc()"); /* gncov */
+			return 1; /* gncov */
+		}
+		for (i = 0; i < n; i++) {
+			put_u64(list + i * 16,
+			        intern_str(bl, entry->sess[i].desc, &err));
+			put_u64(list + i * 16 + 8,
+			        intern_str(bl, entry->sess[i].uuid, &err));
+		}
+		put_u64(rec + BO_SESS, intern(bl, list, n * 16));
+		free(list);
+	}
+
+	if (entry->txt) {
+		uint64_t ref = heap_append(bl, entry->txt, strlen(entry->txt));
+
+		if (!ref)
+			return 1; /* gncov */
+		put_u64(rec + BO_TXT, ref);
+	}
+	put_u32(rec + BO_FLAGS, raw ? BINLOG_RAW : 0);
+	if (err)
+		return 1; /* gncov */
+
+	return write_record(bl, rec);
+}
+
+/*
+ * binlog_add_verbatim() - Add the XML line `line` unchanged to the binary log 
+ * `bl`. If the line contains a UUID, it's stored in the record. Returns 0 if 
+ * ok, or 1 if error.
+ */
+
+int binlog_add_verbatim(struct Binlog *bl, const char *line)
+{
+	unsigned char rec[BINLOG_RECSIZE];
+	const char *u;
+	uint64_t ref;
+
+	assert(bl);
+	assert(line);
+
+	memset(rec, 0, BINLOG_RECSIZE);
+	u = scan_for_uuid(line);
+	if (u) {
+		char uuid[UUID_LENGTH + 1];
+
+		memcpy(uuid, u, UUID_LENGTH);
+		uuid[UUID_LENGTH] = '\0';
+		uuid_to_bin(rec + BO_UUID, uuid);
+		put_u64(rec + BO_TICK, uuid_ticks(uuid));
+	}
+	ref = heap_append(bl, line, strlen(line));
+	if (!ref)
+		return 1; /* gncov */
+	put_u64(rec + BO_TXT, ref);
+	put_u32(rec + BO_FLAGS, BINLOG_VERBATIM);
+
+	return write_record(bl, rec);
+}
+
+/*
+ * binlog_close() - Close the binary log `bl` and deallocate the interning 
+ * table. Returns 0 if ok, or 1 if error.
+ */
+
+int binlog_close(struct Binlog *bl)
+{
+	int retval = 0;
+	size_t i;
+
+	assert(bl);
+
+	if (bl->heapfd != -1 && close(bl->heapfd) == -1)
+		retval = 1; /* gncov */
+	if (bl->recfd != -1 && close(bl->recfd) == -1)
+		retval = 1; /* gncov */
+	for (i = 0; i < bl->tabsize; i++)
+		free(bl->tab[i].data);
+	free(bl->tab);
+	binlog_init(bl);
+
+	return retval;
+}
+
+/*
+ * map_file() - Map the file `fname` read-only into memory, store the address 
+ * in `*dest` and the size in `*size`. Returns 0 if ok, or 1 if error.
+ */
+
+static int map_file(const char *fname, unsigned char **dest,
+                    size_t *size)
+{
+	struct stat sb;
+	void *p;
+	int fd;
+
+	assert(fname);
+	assert(dest);
+	assert(size);
+
+	fd = open(fname, O_RDONLY);
+	if (fd == -1) {
+		myerror("%s: Could not open file", fname);
+		return 1;
+	}
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", fname); /* gncov */
+		close(fd); /* gncov */
+		return 1; /* gncov */
+	}
+	*size = (size_t)sb.st_size;
+	if (*size < BINLOG_MAGIC_LEN) {
+		myerror("%s: Not a binary suuid log file", fname);
+		close(fd);
+		return 1;
+	}
+	p = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		myerror("%s: Cannot map file into memory", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	*dest = p;
+
+	return 0;
+}
+
+/*
+ * binmap_open() - Map the binary log with record file `recname` into memory 
+ * for reading. The heap file name is found by replacing the extension of 
+ * `recname`. Returns 0 if ok, or 1 if error.
+ */
+
+int binmap_open(struct Binmap *map, const char *recname)
+{
+	char *heapname;
+	size_t len;
+	int retval = 1;
+
+	assert(map);
+	assert(recname);
+
+	map->rec = map->heap = NULL;
+	map->recsize = map->heapsize = map->count = 0;
+
+	len = strlen(recname);
+	if (len < strlen(BINLOG_REC_EXTENSION)
+	    || strcmp(recname + len - strlen(BINLOG_REC_EXTENSION),
+	              BINLOG_REC_EXTENSION)) {
+		myerror("%s: Binary log file name must end with \"%s\"",
+		        recname, BINLOG_REC_EXTENSION);
+		return 1;
+	}
+	len -= strlen(BINLOG_REC_EXTENSION);
+	heapname = allocstr("%.*s%s", (int)len, recname,
+	                    BINLOG_HEAP_EXTENSION);
+	if (!heapname) {
+		failed("allocstr()"); /* gncov */
+		return 1; /* gncov */
+	}
+
+	if (map_file(recname, &map->rec, &map->recsize)
+	    || map_file(heapname, &map->heap, &map->heapsize))
+		goto cleanup;
+	if (map->recsize < BINLOG_HDR_SIZE
+	    || memcmp(map->rec, BINLOG_REC_MAGIC, BINLOG_MAGIC_LEN)
+	    || get_u32(map->rec + BINLOG_MAGIC_LEN) != BINLOG_RECSIZE) {
+		myerror("%s: Not a binary suuid log file", recname);
+		goto cleanup;
+	}
+	if (memcmp(map->heap, BINLOG_HEAP_MAGIC, BINLOG_MAGIC_LEN)) {
+		myerror("%s: Not a binary suuid log file", heapname);
+		goto cleanup;
+	}
+	map->count = (map->recsize - BINLOG_HDR_SIZE) / BINLOG_RECSIZE;
+	retval = 0;
+
+cleanup:
+	free(heapname);
+	if (retval)
+		binmap_close(map);
+
+	return retval;
+}
+
+/*
+ * binmap_close() - Unmap the binary log in `map`. Returns nothing.
+ */
+
+void binmap_close(struct Binmap *map)
+{
+	assert(map);
+
+	if (map->rec)
+		munmap(map->rec, map->recsize);
+	if (map->heap)
+		munmap(map->heap, map->heapsize);
+	map->rec = map->heap = NULL;
+	map->recsize = map->heapsize = map->count = 0;
+}
+
+/*
+ * binmap_record() - Return pointer to record number `i` in `map`.
+ */
+
+const unsigned char *binmap_record(const struct Binmap *map, const size_t i)
+{
+	assert(map);
+	assert(i < map->count);
+
+	return map->rec + BINLOG_HDR_SIZE + i * BINLOG_RECSIZE;
+}
+
+/*
+ * binmap_ticks() - Return the UUID timestamp of record number `i` in `map`.
+ */
+
+uint64_t binmap_ticks(const struct Binmap *map, const size_t i)
+{
+	assert(map);
+
+	return get_u64(binmap_record(map, i) + BO_TICK);
+}
+
+/*
+ * heap_blob() - Return pointer to the data of the heap blob at `ref` in 
+ * `map` and store the length in `*len`. Returns NULL if the reference is 
+ * outside the heap.
+ */
+
+static const unsigned char *heap_blob(const struct Binmap *map,
+                                      const uint64_t ref, size_t *len)
+{
+	assert(map);
+	assert(len);
+
+	if (ref < BINLOG_MAGIC_LEN || ref + 4 > map->heapsize)
+		return NULL;
+	*len = get_u32(map->heap + ref);
+	if (ref + 4 + *len > map->heapsize)
+		return NULL;
+
+	return map->heap + ref + 4;
+}
+
+/*
+ * heap_str() - Return pointer to an allocated string with the heap string at 
+ * `ref` in `map`, or NULL if `ref` is 0. If the reference is invalid, `*err` 
+ * is set to 1.
+ */
+
+static char *heap_str(const struct Binmap *map, const uint64_t ref, int *err)
+{
+	const unsigned char *p;
+	size_t len;
+	char *retval;
+
+	assert(map);
+	assert(err);
+
+	if (!ref)
+		return NULL;
+	p = heap_blob(map, ref, &len);
+	if (!p || memchr(p, '\0', len)) {
+		*err = 1;
+		return NULL;
+	}
+	retval = malloc(len + 1);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
+		*err = 1; /* gncov */
+		return NULL; /* gncov */
+	}
+	memcpy(retval, p, len);
+	retval[len] = '\0';
+
+	return retval;
+}
+
+/*
+ * binmap_entry() - Read record number `i` in `map` into `entry`, which must 
+ * be initialised with init_xml_entry(). `raw` is set to true if the txt 
+ * contains unescaped XML. If the record contains a verbatim XML line, 
+ * `*verbatim` is set to an allocated copy of the line, otherwise it's set to 
+ * NULL. The allocated values must be freed with free_sess(), free_tags() and 
+ * free() also if the function fails. Returns 0 if ok, or 1 if the record is 
+ * corrupt.
+ */
+
+int binmap_entry(const struct Binmap *map, const size_t i,
+                 struct Entry *entry, bool *raw, char **verbatim)
+{
+	const unsigned char *rec, *p;
+	uint32_t flags;
+	size_t len, n;
+	int err = 0;
+
+	assert(map);
+	assert(entry);
+	assert(raw);
+	assert(verbatim);
+
+	rec = binmap_record(map, i);
+	flags = get_u32(rec + BO_FLAGS);
+	*raw = !!(flags & BINLOG_RAW);
+	*verbatim = NULL;
+	if (flags & BINLOG_VERBATIM) {
+		*verbatim = heap_str(map, get_u64(rec + BO_TXT), &err);
+		return err || !*verbatim;
+	}
+
+	bin_to_uuid(entry->uuid, rec + BO_UUID);
+	if (!valid_uuid(entry->uuid, true) || !uuid_date(entry->date,
+	                                                 entry->uuid))
+		return 1;
+	entry->host = heap_str(map, get_u64(rec + BO_HOST), &err);
+	entry->cwd = heap_str(map, get_u64(rec + BO_CWD), &err);
+	entry->user = heap_str(map, get_u64(rec + BO_USER), &err);
+	entry->tty = heap_str(map, get_u64(rec + BO_TTY), &err);
+	entry->txt = heap_str(map, get_u64(rec + BO_TXT), &err);
+	if (*raw && !entry->txt)
+		return 1;
+
+	if (get_u64(rec + BO_TAGS)) {
+		p = heap_blob(map, get_u64(rec + BO_TAGS), &len);
+		if (!p || len % 8)
+			return 1;
+		for (n = 0; n < len / 8; n++) {
+			char *tag = heap_str(map, get_u64(p + n * 8), &err);
+
+			if (!tag || append_tag(entry, tag))
+				return 1;
+		}
+	}
+
+	if (get_u64(rec + BO_SESS)) {
+		p = heap_blob(map, get_u64(rec + BO_SESS), &len);
+		if (!p || len % 16)
+			return 1;
+		for (n = 0; n < len / 16; n++) {
+			char *desc, *uuid;
+
+			desc = heap_str(map, get_u64(p + n * 16), &err);
+			uuid = heap_str(map, get_u64(p + n * 16 + 8), &err);
+			if (!uuid) {
+				free(desc);
+				return 1;
+			}
+			if (append_sess(entry, uuid, desc))
+				return 1; /* gncov */
+		}
+	}
+
+	return err;
+}
+
+/*
+ * binlog_to_xml() - Convert the binary log with record file `recname` to an 
+ * XML log file written to `fp`. Returns 0 if ok, or 1 if error.
+ */
+
+int binlog_to_xml(const char *recname, FILE *fp)
+{
+	struct Binmap map;
+	size_t i;
+	int retval = 0;
+
+	assert(recname);
+	assert(fp);
+
+	if (binmap_open(&map, recname))
+		return 1;
+
+	fputs(LOGFILE_HEADER, fp);
+	for (i = 0; i < map.count && !retval; i++) {
+		struct Entry entry;
+		char *ap = NULL, *verbatim = NULL;
+		bool raw;
+
+		init_xml_entry(&entry);
+		if (binmap_entry(&map, i, &entry, &raw, &verbatim)) {
+			myerror("%s: Record %zu is corrupt", recname, i + 1);
+			retval = 1;
+		} else if (verbatim) {
+			fprintf(fp, "%s\n", verbatim);
+		} else {
+			ap = xml_entry(&entry, raw);
+			if (ap)
+				fprintf(fp, "%s\n", ap);
+			else
+				retval = 1; /* gncov */
+		}
+		free(ap);
+		free(verbatim);
+		free_sess(&entry);
+		free_tags(&entry);
+		free(entry.txt);
+		free(entry.host);
+		free(entry.cwd);
+		free(entry.user);
+		free(entry.tty);
+	}
+	fputs(LOGFILE_TRAILER, fp);
+	if (fflush(fp) == EOF) {
+		myerror("Cannot write XML"); /* gncov */
+		retval = 1; /* gncov */
+	}
+	binmap_close(&map);
+
+	return retval;
+}
+
+/*
+ * fits_binlog() - Return true if the UUID and date in `entry` can be recreated 
+ * from the binary UUID, otherwise false.
+ */
+
+static bool fits_binlog(const struct Entry *entry)
+{
+	char date[DATE_LENGTH + 1];
+
+	assert(entry);
+
+	return valid_uuid(entry->uuid, true) && uuid_date(date, entry->uuid)
+	       && !strcmp(date, entry->date);
+}
+
+/*
+ * add_xml_line() - Used by xml_to_binlog(). Add the XML log line `line` to 
+ * the binary log `data`. If the line can't be recreated by xml_entry(), it's 
+ * stored verbatim. Returns 0 if ok, or 1 if error.
+ */
+
+static int add_xml_line(void *data, const char *line)
+{
+	struct Binlog *bl = data;
+	struct Entry entry;
+	bool raw;
+	int retval;
+
+	assert(bl);
+	assert(line);
+
+	init_xml_entry(&entry);
+	if (!parse_xml_line(line, &entry, &raw) && fits_binlog(&entry))
+		retval = binlog_add(bl, &entry, raw);
+	else
+		retval = binlog_add_verbatim(bl, line);
+	free_sess(&entry);
+	free_tags(&entry);
+	free(entry.txt);
+	free(entry.host);
+	free(entry.cwd);
+	free(entry.user);
+	free(entry.tty);
+
+	return retval;
+}
+
+/*
+ * xml_to_binlog() - Convert the XML log file `xmlname` to a binary log. The 
+ * binary log files get the same name as `xmlname` without the ".xml" 
+ * extension, and they must not exist already. The standard XML header and 
+ * the "</suuids>" at the end of the file are left out, all other lines are 
+ * stored. Returns 0 if ok, or 1 if error.
+ */
+
+int xml_to_binlog(const char *xmlname)
+{
+	struct Binlog bl;
+	struct Logmerge m;
+	char *prefix = NULL, *recname = NULL;
+	int retval = 1;
+
+	assert(xmlname);
+
+	binlog_init(&bl);
+	if (logmerge_open(&m, xmlname))
+		return 1;
+
+	prefix = log_filename(xmlname, "");
+	recname = prefix ? binlog_filename(prefix, BINLOG_REC_EXTENSION)
+	                 : NULL;
+	if (!recname)
+		goto cleanup; /* gncov */
+	if (file_exists(recname)) {
+		myerror("%s: File already exists", recname);
+		goto cleanup;
+	}
+	if (binlog_open(&bl, prefix, NULL))
+		goto cleanup; /* gncov */
+	retval = logmerge_each(&m, add_xml_line, &bl);
+
+cleanup:
+	if ((bl.recfd != -1 || bl.heapfd != -1) && binlog_close(&bl))
+		retval = 1; /* gncov */
+	free(recname);
+	free(prefix);
+	logmerge_close(&m);
+
+	return retval;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -0,0 +1,595 @@
+/*
+ * daemon.c
+ * File ID: 3f6b9c52-cb5e-11f1-9a41-02fc00000001
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With --daemon, suuid opens the log files once and serves UUIDs over the 
+ * Unix domain socket <logdir>/<host>.sock until it's terminated. A client 
+ * connects, sends one request per line and closes its end of the connection. 
+ * The request is a JSON object from json_request() with the number of UUIDs, 
+ * at most DAEMON_MAX_COUNT, and the tags, comment, cwd, user, tty and sess 
+ * values. For every request the daemon logs the UUIDs, writes the log files 
+ * and replies with one UUID per line, or with a line starting with "error: " 
+ * if something failed. The reply is sent for every batch of UUIDs after 
+ * they're written to the log files. The clients are served one at a time, 
+ * so every client has DAEMON_TIMEOUT seconds to send the request line and 
+ * for every write of the reply.
+ *
+ * Ordinary suuid processes use the daemon if the socket accepts the 
+ * connection, otherwise they write to the log files themselves. The daemon 
+ * only uses the "xml" and "append" log modes, where the log file isn't 
+ * locked between the writes, so both can be used at the same time.
+ *
+ * With --serve-stdio, the same requests are read from stdin and the replies 
+ * are written to stdout, so a script can keep one suuid process as a 
+ * co-process instead of starting a new one for every entry.
+ */
+
+#include "suuid.h"
+
+/*
+ * get_socket_name() - Return pointer to an allocated string with the name of 
+ * the daemon socket for the log files with the file name prefix `prefix`. 
+ * Returns NULL if error.
+ */
+
+char *get_socket_name(const char *prefix)
+{
+	char *retval;
+
+	assert(prefix);
+
+	retval = allocstr("%s%s", prefix, SOCKET_EXTENSION);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+	return retval;
+}
+
+/*
+ * socket_addr() - Store the address of the socket `sockname` in `addr`. 
+ * Returns 0 if ok, or 1 if the name is too long.
+ */
+
+static int socket_addr(struct sockaddr_un *addr, const char *sockname)
+{
+	assert(addr);
+	assert(sockname);
+
+	if (strlen(sockname) >= sizeof(addr->sun_path))
+		return 1;
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, sockname);
+
+	return 0;
+}
+
+/*
+ * daemon_connect() - Connect to the daemon listening on `sockname`. Returns 
+ * the file descriptor of the connection, or -1 if there's no daemon there.
+ */
+
+int daemon_connect(const char *sockname)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	assert(sockname);
+
+	if (socket_addr(&addr, sockname))
+		return -1;
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		errno = 0; /* gncov */
+		return -1; /* gncov */
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		errno = 0;
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * daemon_request() - Send a request for `count` UUIDs with the values in 
+ * `entry` to the daemon connected to `fd`, and add the UUIDs in the reply to 
+ * the output buffers in `out`. The number of UUIDs and the last UUID are 
+ * stored in `res`. `fd` is closed. Returns 0 if ok, or 1 if error.
+ */
+
+int daemon_request(const int fd, const struct Entry *entry,
+                   const struct Options *opts, const unsigned long count,
+                   struct Outbuf *out, struct uuid_result *res)
+{
+	char *req, *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp;
+	int retval = 0;
+
+	assert(fd != -1);
+	assert(entry);
+	assert(opts);
+	assert(out);
+	assert(res);
+
+	req = json_request(entry, opts->raw, count);
+	if (!req) {
+		close(fd); /* gncov */
+		return 1; /* gncov */
+	}
+	if (write_all(fd, req, strlen(req), -1) || write_all(fd, "\n", 1, -1)
+	    || shutdown(fd, SHUT_WR) == -1) {
+		myerror("Cannot send the request to the daemon"); /* gncov */
+		free(req); /* gncov */
+		close(fd); /* gncov */
+		return 1; /* gncov */
+	}
+	free(req);
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		failed("fdopen()"); /* gncov */
+		close(fd); /* gncov */
+		return 1; /* gncov */
+	}
+
+	while ((len = getline(&line, &size, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len != UUID_LENGTH || !valid_uuid(line, true)) {
+			myerror("Daemon: %s", !strncmp(line, "error: ", 7)
+			                      ? line + 7 : line);
+			retval = 1;
+			continue;
+		}
+		if (outbuf_add(&out[0], line) || outbuf_add(&out[1], line)
+		    || (outbuf_full(&out[0]) && outbuf_flush(&out[0]))
+		    || (outbuf_full(&out[1]) && outbuf_flush(&out[1]))) {
+			retval = 1;
+			break;
+		}
+		memcpy(res->lastuuid, line, UUID_LENGTH + 1);
+		res->count++;
+	}
+	free(line);
+	fclose(fp);
+	if (res->count < count) {
+		myerror("Generated only %lu of %lu UUIDs", res->count, count);
+		retval = 1;
+	}
+
+	return retval;
+}
+
+/*
+ * check_request() - Used by serve_request(). Check the values in the parsed 
+ * request `e` with the same rules as the command line: The comment, the 
+ * tags, cwd, user and tty must be valid UTF-8 without control characters, 
+ * and the sess values must be a UUID and a desc that parse_sessvar() would 
+ * accept. The comment is trimmed like process_comment_option() does. Returns 
+ * NULL if ok, or the error message.
+ */
+
+static const char *check_request(struct Entry *e)
+{
+	const struct Sess *sp;
+	size_t i;
+
+	assert(e);
+
+	if (e->txt) {
+		if (!valid_xml_chars(e->txt))
+			return "Comment contains illegal characters or is not"
+			       " valid UTF-8";
+		trim_str_front(e->txt);
+		trim_str_end(e->txt);
+	}
+	for (i = 0; e->tag[i]; i++) {
+		if (!valid_xml_chars(e->tag[i]))
+			return "Tag contains illegal characters";
+	}
+	if ((e->cwd && !valid_xml_chars(e->cwd))
+	    || (e->user && !valid_xml_chars(e->user))
+	    || (e->tty && !valid_xml_chars(e->tty)))
+		return "Invalid cwd, user or tty value";
+	for (sp = e->sess; sp->uuid; sp++) {
+		if (!valid_uuid(sp->uuid, true))
+			return "Invalid sess UUID";
+		if (sp->desc
+		    && (!*sp->desc || !is_valid_desc_string(sp->desc)))
+			return "Invalid sess desc";
+	}
+
+	return NULL;
+}
+
+/*
+ * send_reply() - Used by serve_request() and send_batch(). Send the `reply` 
+ * to `outfd` and empty it. Returns 0 if ok, or 1 if the client has 
+ * disconnected or doesn't read the reply.
+ */
+
+static int send_reply(const int outfd, struct binbuf *reply)
+{
+	assert(reply);
+
+	if (reply->len && write_all(outfd, reply->buf, reply->len, -1))
+		return 1;
+	reply->len = 0;
+
+	return 0;
+}
+
+/*
+ * send_batch() - Used by serve_request(). Write the entries generated so far 
+ * to the log files, print the UUIDs buffered in `out` to stderr, and then 
+ * send the UUIDs in `reply` to `outfd`. If the entries couldn't be written, 
+ * the UUIDs aren't sent, and `*err` is set to the error message. Returns 0 
+ * if ok, or 1 if the reply couldn't be sent.
+ */
+
+static int send_batch(struct Logs *logs, struct Outbuf *out, const int outfd,
+                      struct binbuf *reply, const char **err)
+{
+	assert(logs);
+	assert(out);
+	assert(reply);
+	assert(err);
+
+	if (flush_logfile(logs)) {
+		*err = "Cannot write the log file"; /* gncov */
+		reply->len = 0; /* gncov */
+		return 0; /* gncov */
+	}
+	if (outbuf_flush(&out[1]))
+		*err = "Cannot print UUID to stderr"; /* gncov */
+
+	return send_reply(outfd, reply);
+}
+
+/*
+ * serve_request() - Parse and check the request `line`, generate and log the 
+ * UUIDs with the host name from `entry` and the other values from the 
+ * request, and send the reply to `outfd`, using `reply` as buffer. If 
+ * `stdio` is true, the request comes from --serve-stdio. Then the cwd, user, 
+ * tty and sess values that are missing in the request are taken from 
+ * `entry`, and the UUIDs are also printed to stderr if "w" contains 'e' or 
+ * 'a'. The reply is sent for every LOG_BATCH_ENTRIES UUIDs, after the 
+ * entries are written to the log files, so a UUID is never sent before it's 
+ * logged. Returns 0 if ok, or 1 if the reply couldn't be sent.
+ */
+
+static int serve_request(struct Logs *logs, const struct Rc *rc,
+                         const struct Options *opts,
+                         const struct Entry *entry, const char *line,
+                         const bool stdio, struct binbuf *reply,
+                         const int outfd)
+{
+	struct Options o = *opts;
+	struct Outbuf out[2];
+	struct Entry e;
+	struct Request req;
+	unsigned long l;
+	const char *err = NULL, *w;
+	bool own_sess = true;
+	int retval = 0;
+
+	assert(logs);
+	assert(rc);
+	assert(opts);
+	assert(entry);
+	assert(line);
+	assert(reply);
+
+	init_xml_entry(&e);
+	outbuf_init(&out[0], -1, "stdout");
+	outbuf_init(&out[1], -1, "stderr");
+	if (parse_json_request(line, &e, &req)) {
+		err = "Invalid request";
+		goto cleanup;
+	}
+	if (req.count > DAEMON_MAX_COUNT) {
+		err = "Too many UUIDs in one request";
+		goto cleanup;
+	}
+	err = check_request(&e);
+	if (err)
+		goto cleanup;
+	free(e.host);
+	e.host = entry->host;
+	if (stdio) {
+		if (!e.cwd)
+			e.cwd = entry->cwd;
+		if (!e.user)
+			e.user = entry->user;
+		if (!e.tty)
+			e.tty = entry->tty;
+		if (!e.sess[0].uuid) {
+			e.sess = entry->sess;
+			own_sess = false;
+		}
+		w = req.whereto;
+		if (w && (strchr(w, 'a') || strchr(w, 'e')))
+			outbuf_init(&out[1], STDERR_FILENO, "stderr");
+	}
+	o.raw = req.raw;
+	o.uuid = NULL;
+
+	for (l = 0; l < req.count && !err; l++) {
+		if (!process_uuid(logs, rc, &o, &e, out))
+			err = "Cannot log the UUID";
+		else if (!bb_append(reply, e.uuid, UUID_LENGTH)
+		         || !bb_append(reply, "\n", 1))
+			err = "Out of memory"; /* gncov */
+		if ((err || !((l + 1) % LOG_BATCH_ENTRIES))
+		    && send_batch(logs, out, outfd, reply, &err)) {
+			retval = 1; /* gncov */
+			goto cleanup; /* gncov */
+		}
+	}
+	if (!err && send_batch(logs, out, outfd, reply, &err)) {
+		retval = 1; /* gncov */
+		goto cleanup; /* gncov */
+	}
+
+cleanup:
+	if (err) {
+		myerror("Request failed: %s", err);
+		if (!bb_append(reply, "error: ", 7)
+		    || !bb_append(reply, err, strlen(err))
+		    || !bb_append(reply, "\n", 1))
+			failed("bb_append()"); /* gncov */
+	}
+	if (!retval && send_reply(outfd, reply))
+		retval = 1;
+	outbuf_free(&out[1]);
+	outbuf_free(&out[0]);
+	if (e.host == entry->host)
+		e.host = NULL;
+	if (e.cwd == entry->cwd)
+		e.cwd = NULL;
+	if (e.user == entry->user)
+		e.user = NULL;
+	if (e.tty == entry->tty)
+		e.tty = NULL;
+	if (!own_sess)
+		e.sess = e.sess_buf;
+	free(req.whereto);
+	free(e.tty);
+	free(e.user);
+	free(e.cwd);
+	free(e.host);
+	free(e.txt);
+	free_sess(&e);
+	free_tags(&e);
+
+	return retval;
+}
+
+/*
+ * serve_client() - Read requests from `infd` until end of file, and write 
+ * the replies to `outfd`. `stdio` is passed on to serve_request(). `infd` is 
+ * closed. Returns the number of requests served.
+ */
+
+static unsigned long serve_client(const int infd, const int outfd,
+                                  struct Logs *logs, const struct Rc *rc,
+                                  const struct Options *opts,
+                                  const struct Entry *entry,
+                                  const bool stdio)
+{
+	struct binbuf reply;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	unsigned long retval = 0;
+	FILE *fp;
+
+	fp = fdopen(infd, "r");
+	if (!fp) {
+		failed("fdopen()"); /* gncov */
+		close(infd); /* gncov */
+		return 0; /* gncov */
+	}
+	binbuf_init(&reply);
+	for (;;) {
+		/*
+		 * A daemon client gets DAEMON_TIMEOUT seconds to send the 
+		 * whole request line, so a client that sends it slowly 
+		 * doesn't keep the others waiting.
+		 */
+		if (!stdio)
+			alarm(DAEMON_TIMEOUT);
+		len = getline(&line, &size, fp);
+		if (!stdio)
+			alarm(0);
+		if (len < 1)
+			break;
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		reply.len = 0;
+		retval++;
+		if (serve_request(logs, rc, opts, entry, line, stdio, &reply,
+		                  outfd)) {
+			msg(1, "Client disconnected" /* gncov */
+			       " before the reply");
+			break; /* gncov */
+		}
+		if (should_terminate)
+			break; /* gncov */
+	}
+	errno = 0;
+	binbuf_free(&reply);
+	free(line);
+	fclose(fp);
+
+	return retval;
+}
+
+/*
+ * alarm_handler() - Handler for SIGALRM. It does nothing, the signal is only 
+ * used to interrupt the read() in serve_client() when a client is too slow. 
+ * Returns nothing.
+ */
+
+static void alarm_handler(const int sig)
+{
+	(void)sig;
+}
+
+/*
+ * catch_signals() - Set up the signal handlers for run_daemon() and 
+ * serve_stdio(). Without SA_RESTART, accept() and read() are interrupted by 
+ * the termination signals so the loops see should_terminate, and by SIGALRM 
+ * when a client is too slow. A client that disconnects early mustn't stop 
+ * the program, so SIGPIPE is ignored. Returns nothing.
+ */
+
+static void catch_signals(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGHUP, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGQUIT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = alarm_handler;
+	sigaction(SIGALRM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+/*
+ * run_daemon() - Serve UUIDs for the log files in `logs` on the socket 
+ * `sockname` until a termination signal is received. `entry` contains the 
+ * host name to use in the entries. The socket is removed when the daemon 
+ * stops. Returns 0 if ok, or 1 if error.
+ */
+
+int run_daemon(struct Logs *logs, const struct Rc *rc,
+               const struct Options *opts, const struct Entry *entry,
+               const char *sockname)
+{
+	struct sockaddr_un addr;
+	struct timeval tv = { DAEMON_TIMEOUT, 0 };
+	unsigned long requests = 0;
+	mode_t mask;
+	int fd, result, retval = 1;
+
+	assert(logs);
+	assert(rc);
+	assert(opts);
+	assert(entry);
+	assert(sockname);
+
+	if (socket_addr(&addr, sockname)) {
+		myerror("%s: Socket name is too long", sockname);
+		return 1;
+	}
+	fd = daemon_connect(sockname);
+	if (fd != -1) {
+		close(fd);
+		myerror("%s: The daemon is already running", sockname);
+		return 1;
+	}
+	if (remove(sockname) == -1 && errno != ENOENT) {
+		myerror("%s: Cannot remove old socket", sockname); /* gncov */
+		return 1; /* gncov */
+	}
+	errno = 0;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		failed("socket()"); /* gncov */
+		return 1; /* gncov */
+	}
+	mask = umask(0077);
+	result = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (result == -1 || listen(fd, SOMAXCONN) == -1) {
+		myerror("%s: Cannot listen on socket", sockname);
+		close(fd);
+		return 1;
+	}
+
+	catch_signals();
+	msg(1, "Listening on %s", sockname);
+	while (!should_terminate) {
+		int cfd = accept(fd, NULL, NULL);
+
+		if (cfd == -1) {
+			if (errno == EINTR) {
+				errno = 0;
+				continue;
+			}
+			failed("accept()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		/*
+		 * The client gets DAEMON_TIMEOUT seconds for every read and 
+		 * write, so a stuck client that doesn't send the request or 
+		 * read the reply doesn't block the daemon.
+		 */
+		setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		requests += serve_client(cfd, cfd, logs, rc, opts, entry,
+		                         false);
+	}
+	retval = 0;
+
+cleanup:
+	close(fd);
+	if (remove(sockname) == -1)
+		myerror("%s: Cannot remove socket", sockname); /* gncov */
+	msg(1, "Served %lu request%s", requests, requests == 1 ? "" : "s");
+
+	return retval;
+}
+
+/*
+ * serve_stdio() - Read requests from stdin until end of file or a 
+ * termination signal, and write the replies to stdout. The requests and 
+ * replies have the same format as for the daemon, and the entries use the 
+ * environment in `entry` unless the request overrides it. Returns 0.
+ */
+
+int serve_stdio(struct Logs *logs, const struct Rc *rc,
+                const struct Options *opts, const struct Entry *entry)
+{
+	unsigned long requests;
+
+	assert(logs);
+	assert(rc);
+	assert(opts);
+	assert(entry);
+
+	catch_signals();
+	requests = serve_client(STDIN_FILENO, STDOUT_FILENO, logs, rc, opts,
+	                        entry, true);
+	msg(2, "Served %lu request%s", requests, requests == 1 ? "" : "s");
+
+	return 0;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
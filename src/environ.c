@@ -263,36 +263,228 @@ char *getpath(void)
 }
 
 /*
- * get_username() - Return pointer to string with login name, or NULL if error.
+ * The user name and tty are looked up only once per process, and the result 
+ * is cached in the file "suuid-env-UID-DEV" in $XDG_RUNTIME_DIR, where UID is 
+ * the user ID and DEV is the device number of the tty on stdin in 
+ * hexadecimal, or 0 if stdin isn't a character device. The file contains the 
+ * boot ID, the user name and the tty, one per line, and is ignored if the 
+ * boot ID has changed. This avoids getpwuid() and ttyname() in every process, 
+ * they can be slow with network user databases and many ttys. The host name 
+ * isn't cached, so $SUUID_HOSTNAME and the rc file are always used.
  */
 
-char *get_username(void)
+static struct {
+	bool loaded;
+	char *user;
+	char *tty;
+	char ubuf[ENVCACHE_LINE];
+	char tbuf[ENVCACHE_LINE];
+} envc;
+
+/*
+ * get_boot_id() - Read the boot ID of the running kernel into `buf`, which 
+ * has room for ENVCACHE_LINE bytes. Returns 0 if ok, or 1 if it's not 
+ * available.
+ */
+
+static int get_boot_id(char *buf)
 {
+	FILE *fp;
+	bool ok;
+
+	assert(buf);
+
+	fp = fopen(BOOT_ID_FILE, "r");
+	if (!fp) {
+		errno = 0; /* gncov */
+		return 1; /* gncov */
+	}
+	ok = fgets(buf, ENVCACHE_LINE, fp);
+	fclose(fp);
+	if (!ok)
+		return 1; /* gncov */
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return !*buf;
+}
+
+/*
+ * envcache_name() - Return a pointer to an allocated string with the name of 
+ * the environment cache file for the current user and the tty on stdin, or 
+ * NULL if $XDG_RUNTIME_DIR isn't defined or error.
+ */
+
+static char *envcache_name(void)
+{
+	const char *dir = getenv(ENV_RUNTIME_DIR);
+	unsigned long dev = 0;
+	struct stat sb;
 	char *retval;
-	struct passwd *pw;
 
-	pw = getpwuid(getuid());
-	if (!pw)
-		retval = NULL; /* gncov */
-	else
-		retval = pw->pw_name;
+	if (!dir || !*dir)
+		return NULL;
+	if (!fstat(STDIN_FILENO, &sb) && S_ISCHR(sb.st_mode))
+		dev = (unsigned long)sb.st_rdev;
+	errno = 0;
+	retval = allocstr("%s/" ENVCACHE_PREFIX "%lu-%lx",
+	                  dir, (unsigned long)getuid(), dev);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
 
 	return retval;
 }
 
 /*
- * get_tty() - Return pointer to string with name of current tty.
+ * read_envcache() - Read the user name and tty from the cache file `fname` 
+ * into `envc` if the file was written after the boot with ID `bootid`. 
+ * Returns 0 if ok, or 1 if the file is missing, stale or invalid.
  */
 
-char *get_tty(void)
+static int read_envcache(const char *fname, const char *bootid)
 {
-	char *retval = ttyname(STDIN_FILENO);
+	char *s, *user, *tty, *end;
+	int retval = 1;
+
+	assert(fname);
+	assert(bootid);
+
+	s = read_from_file(fname);
+	if (!s) {
+		errno = 0;
+		return 1;
+	}
+	user = strchr(s, '\n');
+	if (!user)
+		goto cleanup;
+	*user++ = '\0';
+	tty = strchr(user, '\n');
+	if (!tty || strcmp(s, bootid))
+		goto cleanup;
+	*tty++ = '\0';
+	end = strchr(tty, '\n');
+	if (!end || end[1])
+		goto cleanup;
+	*end = '\0';
+	if (strlen(user) >= ENVCACHE_LINE || strlen(tty) >= ENVCACHE_LINE
+	    || (*tty && strncmp(tty, "/dev/", 5)))
+		goto cleanup;
+
+	strcpy(envc.ubuf, user);
+	strcpy(envc.tbuf, tty);
+	envc.user = *envc.ubuf ? envc.ubuf : NULL;
+	envc.tty = *envc.tbuf ? envc.tbuf : NULL;
+	retval = 0;
 
+cleanup:
+	free(s);
+
+	return retval;
+}
+
+/*
+ * write_envcache() - Write the boot ID `bootid` and the user name and tty in 
+ * `envc` to the cache file `fname`. The file is written under a temporary 
+ * name and renamed, so other processes never see a partial file. Errors are 
+ * ignored, the cache is only an optimisation. Returns nothing.
+ */
+
+static void write_envcache(const char *fname, const char *bootid)
+{
+	char *s = NULL, *tmpname = NULL;
+	const char *user = no_null(envc.user), *tty = envc.tty ? envc.tty : "";
+	int fd = -1;
+
+	assert(fname);
+	assert(bootid);
+
+	if (!envc.user || strlen(envc.user) >= ENVCACHE_LINE
+	    || strlen(tty) >= ENVCACHE_LINE || strchr(user, '\n')
+	    || strchr(tty, '\n'))
+		return; /* gncov */
+	s = allocstr("%s\n%s\n%s\n", bootid, user, tty);
+	tmpname = allocstr("%s.%ld", fname, (long)getpid());
+	if (!s || !tmpname) {
+		failed("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	fd = open(tmpname, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		goto cleanup;
+	if (write_all(fd, s, strlen(s), -1) || close(fd)
+	    || rename(tmpname, fname)) {
+		fd = -1; /* gncov */
+		remove(tmpname); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	fd = -1;
+	msg(3, "Wrote the environment cache %s", fname);
+
+cleanup:
+	if (fd != -1) {
+		close(fd); /* gncov */
+		remove(tmpname); /* gncov */
+	}
+	errno = 0;
+	free(tmpname);
+	free(s);
+}
+
+/*
+ * load_env() - Look up the user name and tty and store them in `envc`, from 
+ * the cache file if it's valid. Only does anything the first time it's 
+ * called. Returns nothing.
+ */
+
+static void load_env(void)
+{
+	char bootid[ENVCACHE_LINE], *fname;
+	struct passwd *pw;
+	bool cacheable;
+
+	if (envc.loaded)
+		return;
+	envc.loaded = true;
+
+	fname = envcache_name();
+	cacheable = fname && !get_boot_id(bootid);
+	if (cacheable && !read_envcache(fname, bootid)) {
+		msg(3, "Using the environment cache %s", fname);
+		free(fname);
+		return;
+	}
+
+	pw = getpwuid(getuid());
+	envc.user = pw ? pw->pw_name : NULL;
+	envc.tty = ttyname(STDIN_FILENO);
 	if (errno == ENOTTY)
 		errno = 0; /* Happens when the program reads from stdin */
 	check_errno;
 
-	return retval;
+	if (cacheable)
+		write_envcache(fname, bootid);
+	free(fname);
+}
+
+/*
+ * get_username() - Return pointer to string with login name, or NULL if error.
+ */
+
+char *get_username(void)
+{
+	load_env();
+
+	return envc.user;
+}
+
+/*
+ * get_tty() - Return pointer to string with name of current tty.
+ */
+
+char *get_tty(void)
+{
+	load_env();
+
+	return envc.tty;
 }
 
 /* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -118,6 +118,7 @@ char *process_comment_option(const char *cmt)
 int fill_entry_struct(struct Entry *entry, const struct Rc *rc,
                       const struct Options *opts)
 {
+	struct timespec ts;
 	unsigned int i;
 
 	assert(entry);
@@ -132,18 +133,26 @@ int fill_entry_struct(struct Entry *entry, const struct Rc *rc,
 	 * once. Only has some effect if creating many UUIDs.
 	 */
 
+	trace_begin(&ts);
 	entry->host = get_hostname(rc);
+	trace_end(TRACE_HOSTNAME, &ts);
 	if (!entry->host)
 		return 1;
+	trace_begin(&ts);
 	entry->cwd = getpath();
+	trace_end(TRACE_CWD, &ts);
+	trace_begin(&ts);
 	entry->user = get_username();
+	trace_end(TRACE_USER, &ts);
+	trace_begin(&ts);
 	entry->tty = get_tty();
+	trace_end(TRACE_TTY, &ts);
 
 	/*
 	 * Store tags and comment in entry.
 	 */
 
-	for (i = 0; i < MAX_TAGS && opts->tag[i]; i++) {
+	for (i = 0; opts->tag && opts->tag[i]; i++) {
 		if (store_tag(entry, opts->tag[i]))
 			return 1;
 	}
@@ -158,31 +167,35 @@ int fill_entry_struct(struct Entry *entry, const struct Rc *rc,
 	 * Store session information from the environment variable.
 	 */
 
+	trace_begin(&ts);
 	if (get_sess_info(entry)) {
 		free(entry->txt);
 		return 1;
 	}
+	trace_end(TRACE_SESS, &ts);
 
 	return 0;
 }
 
 /*
  * process_uuid() - Generate one UUID and write it to the log file. If no 
- * errors, send it to stdout and/or stderr and return a pointer to the UUID. 
- * Otherwise return NULL.
+ * errors, add it to the output buffers for stdout and stderr in `out` and 
+ * return a pointer to the UUID. Otherwise return NULL.
  */
 
 char *process_uuid(struct Logs *logs,
                    const struct Rc *rc, const struct Options *opts,
-                   struct Entry *entry)
+                   struct Entry *entry, struct Outbuf *out)
 {
-	int result;
+	struct timespec ts;
 
 	assert(logs);
-	assert(logs->logfp);
 	assert(rc);
 	assert(opts);
 	assert(entry);
+	assert(out);
+
+	trace_begin(&ts);
 
 	/*
 	 * Generate the UUID or use an already generated UUID stored in 
@@ -218,43 +231,41 @@ char *process_uuid(struct Logs *logs,
 
 	if (!uuid_date(entry->date, entry->uuid))
 		return NULL; /* gncov */
+	trace_end(TRACE_GENERATE, &ts);
 
-	if (add_to_logfile(logs->logfp, entry, opts->raw))
+	if (add_to_logfile(logs, entry, opts->raw))
 		return NULL; /* gncov */
 
 	/*
-	 * Write the UUID to stdout and/or stderr, or not, depending on the 
-	 * -w/--whereto argument.
+	 * Buffer the UUID for stdout and/or stderr. The streams that aren't 
+	 * selected with -w/--whereto have no file descriptor and ignore it.
 	 */
 
-	if (!opts->whereto) {
-		result = puts(entry->uuid);
-		if (result == EOF) {
-			myerror("Cannot print UUID to stdout");
-			return NULL;
-		}
-	} else {
-		size_t len = strlen(entry->uuid) + 1;
+	if (outbuf_add(&out[0], entry->uuid)
+	    || outbuf_add(&out[1], entry->uuid))
+		return NULL;
 
-		if (strchr(opts->whereto, 'a') || strchr(opts->whereto, 'o')) {
-			result = fprintf(stdout, "%s\n", entry->uuid);
-			if (result < 0 || (size_t)result != len) {
-				myerror("Cannot print UUID to stdout");
-				return NULL;
-			}
+	return entry->uuid;
+}
 
-		}
-		if (strchr(opts->whereto, 'a') || strchr(opts->whereto, 'e')) {
-			result = fprintf(stderr, "%s\n", entry->uuid);
-			if (result < 0 || (size_t)result != len) {
-				myerror("Cannot print UUID to" /* gncov */
-				        " stderr");
-				return NULL; /* gncov */
-			}
-		}
-	}
+/*
+ * commit_output() - Used when an output buffer in `out` is full. Wait until 
+ * the writer thread has written the entries in its ring, write the XML batch 
+ * in `logs`, and then print the buffered UUIDs, so no UUID is printed before 
+ * its entry is in the log file. Returns 0 if ok, or 1 if error.
+ */
 
-	return entry->uuid;
+static int commit_output(struct Logs *logs, struct Outbuf *out)
+{
+	assert(logs);
+	assert(out);
+
+	if (writer_drain(&logs->writer) || flush_logfile(logs))
+		return 1; /* gncov */
+	if (outbuf_flush(&out[0]) || outbuf_flush(&out[1]))
+		return 1;
+
+	return 0;
 }
 
 /*
@@ -273,6 +284,247 @@ void sighandler(const int sig)
 	should_terminate = true;
 }
 
+/*
+ * use_daemon() - Return true if the `count` UUIDs can be requested from the 
+ * daemon, i.e., it's not the daemon itself, --no-daemon isn't used, `count` 
+ * isn't larger than the daemon accepts, and no options that change the UUIDs 
+ * or the log files are used. Otherwise return false.
+ */
+
+static bool use_daemon(const struct Options *opts, const unsigned long count)
+{
+	assert(opts);
+
+	return count <= DAEMON_MAX_COUNT
+	       && !opts->daemon && !opts->serve_stdio && !opts->no_daemon
+	       && !opts->stream && !opts->uuid && !opts->uuid_file
+	       && !opts->random_mac && !opts->binlog && !opts->jsonl
+	       && !opts->logmode && !opts->segment && !opts->shards
+	       && !opts->sync;
+}
+
+/*
+ * stream_entry() - Used by stream_uuids(). Store the tags and comment from 
+ * the tab-separated fields in `line` in `entry`. The last field is the 
+ * comment, and the fields before it are tags, added after the first `keep` 
+ * tags from the command line. If the comment is empty, `cmt` is used. The 
+ * strings from the previous line are released by rewinding entry->arena to 
+ * `mark`. Returns 0 if ok, or 1 if error.
+ */
+
+static int stream_entry(struct Entry *entry, const char *line,
+                        const size_t keep, const struct Arena *mark,
+                        char *cmt)
+{
+	char *field, *p;
+
+	assert(entry);
+	assert(entry->arena);
+	assert(line);
+	assert(mark);
+
+	drop_tags(entry, keep);
+	arena_rewind(entry->arena, mark);
+	entry->txt = cmt;
+
+	field = arena_strdup(entry->arena, line);
+	if (!field) {
+		failed("arena_strdup()"); /* gncov */
+		return 1; /* gncov */
+	}
+	while ((p = strchr(field, '\t'))) {
+		*p = '\0';
+		if (store_tag(entry, field))
+			return 1;
+		field = p + 1;
+	}
+	trim_str_front(field);
+	trim_str_end(field);
+	if (!*field)
+		return 0;
+	if (!valid_xml_chars(field)) {
+		myerror("Comment contains illegal characters or is not valid"
+		        " UTF-8");
+		return 1;
+	}
+	entry->txt = field;
+
+	return 0;
+}
+
+/*
+ * stream_uuids() - Read lines from stdin until end of file and log one entry 
+ * for every line, with the tags and comment from the line, see 
+ * stream_entry(). The UUID, a tab and the line are added to out[0], and the 
+ * UUID alone to out[1]. Lines that can't be logged are reported with their 
+ * line number and skipped. The number of UUIDs, the last UUID and the date 
+ * of the first entry are stored in `res` and `firstdate`. Returns 0 if all 
+ * lines were logged, or 1 if anything failed.
+ */
+
+static int stream_uuids(struct Logs *logs, const struct Rc *rc,
+                        const struct Options *opts, struct Entry *entry,
+                        struct Outbuf *out, struct uuid_result *res,
+                        char *firstdate)
+{
+	struct Outbuf none[2];
+	struct Arena mark;
+	char *line = NULL, *echo, *cmt = entry->txt;
+	size_t size = 0;
+	ssize_t len;
+	unsigned long linenum = 0;
+	size_t keep;
+	int retval = 0;
+
+	assert(logs);
+	assert(rc);
+	assert(opts);
+	assert(entry);
+	assert(out);
+	assert(res);
+	assert(firstdate);
+
+	keep = entry->tag_count;
+	mark = *entry->arena;
+	outbuf_init(&none[0], -1, "stdout");
+	outbuf_init(&none[1], -1, "stderr");
+	writer_start(logs);
+
+	while (!should_terminate
+	       && (len = getline(&line, &size, stdin)) > 0) {
+		linenum++;
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		if (stream_entry(entry, line, keep, &mark, cmt)) {
+			myerror("stdin, line %lu: Entry not logged", linenum);
+			retval = 1;
+			continue;
+		}
+		if (!process_uuid(logs, rc, opts, entry, none)) {
+			myerror("stdin, line %lu: Cannot log the UUID",
+			        linenum);
+			retval = 1;
+			break;
+		}
+		if (!res->count)
+			memcpy(firstdate, entry->date, DATE_LENGTH + 1);
+		res->count++;
+		memcpy(res->lastuuid, entry->uuid, UUID_LENGTH + 1);
+		echo = arena_allocstr(entry->arena, "%s\t%s", entry->uuid,
+		                      line);
+		if (!echo) {
+			failed("arena_allocstr()"); /* gncov */
+			retval = 1; /* gncov */
+			break; /* gncov */
+		}
+		if (outbuf_add(&out[0], echo)
+		    || outbuf_add(&out[1], entry->uuid)
+		    || ((outbuf_full(&out[0]) || outbuf_full(&out[1]))
+		        && commit_output(logs, out))) {
+			retval = 1;
+			break;
+		}
+	}
+	if (ferror(stdin)) {
+		myerror("Error when reading from stdin"); /* gncov */
+		retval = 1; /* gncov */
+	}
+
+	drop_tags(entry, keep);
+	arena_rewind(entry->arena, &mark);
+	entry->txt = cmt;
+	outbuf_free(&none[1]);
+	outbuf_free(&none[0]);
+	free(line);
+
+	return retval;
+}
+
+/*
+ * import_uuids() - Read existing UUIDs from the file `fname`, one per line, 
+ * or from stdin if `fname` is "-", and log them with the tags, comment and 
+ * other values in `entry`. Empty lines are ignored, and invalid UUIDs are 
+ * reported with their line number and skipped. The number of UUIDs, the last 
+ * UUID and the date of the first entry are stored in `res` and `firstdate`. 
+ * Returns 0 if all lines were logged, or 1 if anything failed.
+ */
+
+static int import_uuids(struct Logs *logs, const struct Rc *rc,
+                        const struct Options *opts, struct Entry *entry,
+                        struct Outbuf *out, struct uuid_result *res,
+                        char *firstdate, const char *fname)
+{
+	struct Options o = *opts;
+	char *line = NULL;
+	const char *name;
+	size_t size = 0;
+	ssize_t len;
+	unsigned long linenum = 0;
+	int retval = 0;
+	FILE *fp;
+
+	assert(logs);
+	assert(rc);
+	assert(opts);
+	assert(entry);
+	assert(out);
+	assert(res);
+	assert(firstdate);
+	assert(fname);
+
+	if (!strcmp(fname, "-")) {
+		fp = stdin;
+		name = "stdin";
+	} else {
+		fp = fopen(fname, "r");
+		name = fname;
+		if (!fp) {
+			myerror("%s: Could not open file", fname);
+			return 1;
+		}
+	}
+	writer_start(logs);
+
+	while (!should_terminate && (len = getline(&line, &size, fp)) > 0) {
+		linenum++;
+		trim_str_end(line);
+		trim_str_front(line);
+		if (!*line)
+			continue;
+		if (!valid_uuid(line, true)) {
+			myerror("%s, line %lu: Invalid UUID", name, linenum);
+			retval = 1;
+			continue;
+		}
+		o.uuid = line;
+		if (!process_uuid(logs, rc, &o, entry, out)) {
+			myerror("%s, line %lu: Cannot log the UUID", name,
+			        linenum);
+			retval = 1;
+			break;
+		}
+		if (!res->count)
+			memcpy(firstdate, entry->date, DATE_LENGTH + 1);
+		res->count++;
+		memcpy(res->lastuuid, entry->uuid, UUID_LENGTH + 1);
+		if ((outbuf_full(&out[0]) || outbuf_full(&out[1]))
+		    && commit_output(logs, out)) {
+			retval = 1;
+			break;
+		}
+	}
+	if (ferror(fp)) {
+		myerror("%s: Error when reading the file", name); /* gncov */
+		retval = 1; /* gncov */
+	}
+
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+
+	return retval;
+}
+
 /*
  * create_and_log_uuids() - Do everything in one place; Initialise the random 
  * number generator, read values from the rc file, environment and command 
@@ -287,48 +539,161 @@ struct uuid_result create_and_log_uuids(const struct Options *opts)
 {
 	struct uuid_result retval;
 	char *rcfile = NULL;
-	char *logfile = NULL;
-	unsigned long l, count;
+	char *prefix = NULL, *logfile = NULL, *jsonfile = NULL;
+	char *segdir = NULL, *segname = NULL, *sockname = NULL;
+	char firstdate[DATE_LENGTH + 1];
+	unsigned long l, count, shards;
 	struct Rc rc;
+	struct Arena arena;
 	struct Entry entry;
 	struct Logs logs;
+	struct Segment seg;
+	struct Outbuf out[2];
+	struct timespec ts;
+	const char *w = opts->whereto;
+	bool logged = true; /* The log file was closed without errors */
 
 	assert(opts);
 
+	trace_init(!!opts->trace_timing);
 	init_rc(&rc);
-	logs.logfp = NULL;
+	logs.logfp = logs.jsonfp = NULL;
+	logs.fd = logs.jsonfd = logs.mapfd = -1;
+	logs.map = NULL;
+	uring_init(&logs.ring);
+	binlog_init(&logs.bin);
+	logs.lock.locks = logs.lock.waits = 0;
+	logs.lock.wait_ns = logs.lock.max_ns = 0;
 	count = opts->count;
 	retval.count = 0UL;
 	memset(retval.lastuuid, 0, UUID_LENGTH + 1);
 	retval.success = true;
+	arena_init(&arena, NULL, 0);
 	init_xml_entry(&entry);
+	entry.arena = &arena;
+	outbuf_init(&out[0], !w || strchr(w, 'a') || strchr(w, 'o')
+	                     ? STDOUT_FILENO : -1, "stdout");
+	outbuf_init(&out[1], w && (strchr(w, 'a') || strchr(w, 'e'))
+	                     ? STDERR_FILENO : -1, "stderr");
 
 	/*
 	 * Get information about the environment; hostname, current directory, 
 	 * tty, location of rc file and log directory, etc.
 	 */
 
+	trace_begin(&ts);
 	if (init_randomness()) {
 		retval.success = false; /* gncov */
 		goto cleanup; /* gncov */
 	}
+	trace_end(TRACE_RANDOMNESS, &ts);
 
+	trace_begin(&ts);
 	rcfile = get_rcfilename(opts);
 	if (read_rcfile(rcfile, &rc)) {
 		retval.success = false;
 		goto cleanup;
 	}
+	trace_end(TRACE_RCFILE, &ts);
+
+	logs.mode = get_logmode(&rc, opts);
+	logs.sync = get_syncmode(&rc, opts);
+	logs.lock.timeout = opts->lock_timeout;
+	if (logs.mode == LOGMODE_ERROR || logs.sync == SYNC_ERROR
+	    || get_segment(&rc, opts, &seg)
+	    || get_shards(&rc, opts, &shards)) {
+		retval.success = false;
+		goto cleanup;
+	}
+	if (shards > 1 && seg.mode != SEGMENT_NONE) {
+		myerror("Sharded logs can't be segmented");
+		retval.success = false;
+		goto cleanup;
+	}
 
+	if ((opts->stream
+	     || (opts->uuid_file && !strcmp(opts->uuid_file, "-")))
+	    && opts->comment
+	    && (!strcmp(opts->comment, "-") || !strcmp(opts->comment, "--"))) {
+		myerror("The comment can't be read from stdin or an editor"
+		        " when stdin is used for the %s",
+		        opts->stream ? "entries" : "UUIDs");
+		retval.success = false;
+		goto cleanup;
+	}
+	if (opts->stream && opts->uuid_file) {
+		myerror("--stream can't be combined with --uuid");
+		retval.success = false;
+		goto cleanup;
+	}
+	trace_begin(&ts);
 	if (fill_entry_struct(&entry, &rc, opts)) {
 		retval.success = false;
 		goto cleanup;
 	}
+	trace_end(TRACE_ENTRY, &ts);
 
-	logfile = get_log_prefix(&rc, opts, LOGFILE_EXTENSION);
-	if (!logfile) {
+	prefix = get_log_prefix(&rc, opts, "");
+	if (!prefix) {
 		retval.success = false;
 		goto cleanup;
 	}
+	sockname = get_socket_name(prefix);
+	if (!sockname) {
+		retval.success = false; /* gncov */
+		goto cleanup; /* gncov */
+	}
+
+	/*
+	 * If the daemon is running, let it generate and log the UUIDs.
+	 */
+
+	if (use_daemon(opts, count)) {
+		int fd = daemon_connect(sockname);
+
+		if (fd != -1) {
+			msg(2, "Using the daemon at %s", sockname);
+			if (daemon_request(fd, &entry, opts, count, out,
+			                   &retval))
+				retval.success = false;
+			goto cleanup;
+		}
+	}
+	if (opts->daemon && (seg.mode != SEGMENT_NONE || opts->binlog
+	                     || (logs.mode != LOGMODE_XML
+	                         && logs.mode != LOGMODE_APPEND))) {
+		myerror("The daemon can't use --binlog, --segment or the"
+		        " \"mmap\" and \"uring\" log modes");
+		retval.success = false;
+		goto cleanup;
+	}
+	if (seg.mode != SEGMENT_NONE) {
+		segdir = prefix;
+		prefix = get_segment_prefix(segdir, &seg, &segname);
+		if (!prefix) {
+			retval.success = false;
+			goto cleanup;
+		}
+	}
+	if (shards > 1) {
+		char *p = get_shard_prefix(prefix, shards);
+
+		free(prefix);
+		prefix = p;
+		if (!prefix) {
+			retval.success = false; /* gncov */
+			goto cleanup; /* gncov */
+		}
+	}
+	logfile = arena_allocstr(&arena, "%s%s", prefix, LOGFILE_EXTENSION);
+	if (opts->jsonl)
+		jsonfile = arena_allocstr(&arena, "%s%s", prefix,
+		                          JSONL_EXTENSION);
+	if (!logfile || (opts->jsonl && !jsonfile)) {
+		failed("arena_allocstr()"); /* gncov */
+		retval.success = false; /* gncov */
+		goto cleanup; /* gncov */
+	}
 
 	signal(SIGHUP, sighandler);
 	signal(SIGINT, sighandler);
@@ -337,23 +702,52 @@ struct uuid_result create_and_log_uuids(const struct Options *opts)
 	signal(SIGTERM, sighandler);
 
 	/*
-	 * Open the log file. If it's missing, create it.
+	 * Open the log files. If they're missing, create them.
 	 */
 
-	logs.logfp = open_logfile(logfile);
-	if (!logs.logfp) {
+	trace_begin(&ts);
+	if (open_logfile(&logs, logfile, jsonfile,
+	                 opts->binlog ? prefix : NULL)) {
 		retval.success = false;
 		goto cleanup;
 	}
+	trace_end(TRACE_OPEN, &ts);
+	trace.open_lock_ns = logs.lock.wait_ns;
 
 	/*
 	 * Generate the UUIDs and write them to the log file.
 	 */
 
+	if (opts->daemon) {
+		if (run_daemon(&logs, &rc, opts, &entry, sockname))
+			retval.success = false;
+		goto cleanup;
+	}
+	if (opts->serve_stdio) {
+		if (serve_stdio(&logs, &rc, opts, &entry))
+			retval.success = false; /* gncov */
+		goto cleanup;
+	}
+	if (opts->stream) {
+		if (stream_uuids(&logs, &rc, opts, &entry, out, &retval,
+		                 firstdate))
+			retval.success = false;
+		goto cleanup;
+	}
+	if (opts->uuid_file) {
+		if (import_uuids(&logs, &rc, opts, &entry, out, &retval,
+		                 firstdate, opts->uuid_file))
+			retval.success = false;
+		goto cleanup;
+	}
 	if (opts->uuid)
 		count = 1UL;
+	if (count > 1)
+		writer_start(&logs);
 	for (l = 0UL; l < count; l++) {
-		if (!process_uuid(&logs, &rc, opts, &entry)) {
+		if (!process_uuid(&logs, &rc, opts, &entry, out)
+		    || ((outbuf_full(&out[0]) || outbuf_full(&out[1]))
+		        && commit_output(&logs, out))) {
 			retval.success = false;
 			/*
 			 * Check that the correct amount of UUIDs were created.
@@ -365,6 +759,8 @@ struct uuid_result create_and_log_uuids(const struct Options *opts)
 
 			goto cleanup;
 		}
+		if (!retval.count)
+			memcpy(firstdate, entry.date, DATE_LENGTH + 1);
 		retval.count++;
 		if (should_terminate)
 			break; /* gncov */
@@ -377,12 +773,38 @@ struct uuid_result create_and_log_uuids(const struct Options *opts)
 	 */
 
 cleanup: /* gncov */
-	if (logs.logfp && close_logfile(logs.logfp))
+	/*
+	 * The last entries may still be in the writer thread or the XML 
+	 * batch, so the buffered UUIDs are printed only after the log file 
+	 * has been closed successfully.
+	 */
+	trace_begin(&ts);
+	if ((logs.logfp || logs.fd != -1) && close_logfile(&logs)) {
 		retval.success = false; /* gncov */
+		logged = false; /* gncov */
+	}
+	trace_end(TRACE_CLOSE, &ts);
+	if (logged && outbuf_flush(&out[0]))
+		retval.success = false;
+	if (logged && outbuf_flush(&out[1]))
+		retval.success = false; /* gncov */
+	if (segname && retval.count
+	    && update_manifest(segdir, segname, firstdate, entry.date,
+	                       retval.count))
+		retval.success = false; /* gncov */
+	if (opts->trace_timing
+	    && trace_print(opts->trace_timing, &logs, retval.count))
+		retval.success = false;
 
-	free(logfile);
+	outbuf_free(&out[1]);
+	outbuf_free(&out[0]);
+	free(sockname);
+	free(segname);
+	free(segdir);
+	free(prefix);
 	free_sess(&entry);
 	free_tags(&entry);
+	arena_free(&arena);
 	free_rc(&rc);
 	free(entry.txt);
 	free(entry.cwd);
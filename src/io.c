@@ -43,6 +43,119 @@ bool file_exists(const char *s)
 	return true;
 }
 
+/*
+ * write_all() - Write `len` bytes from `buf` to the file descriptor `fd`, at 
+ * file offset `pos` with pwrite(), or with write() if `pos` is -1. Continue 
+ * after short writes. Returns 0 if ok, or 1 if error.
+ */
+
+int write_all(const int fd, const char *buf, size_t len, off_t pos)
+{
+	assert(fd != -1);
+	assert(buf);
+
+	while (len) {
+		ssize_t res = pos == -1 ? write(fd, buf, len)
+		                        : pwrite(fd, buf, len, pos);
+
+		if (res == -1 && errno == EINTR)
+			continue; /* gncov */
+		if (res < 1)
+			return 1;
+		buf += res;
+		len -= (size_t)res;
+		if (pos != -1)
+			pos += res;
+	}
+
+	return 0;
+}
+
+/*
+ * outbuf_init() - Initialise the output buffer `ob` for the file descriptor 
+ * `fd`, called `name` in error messages. If `fd` is -1, nothing is written. 
+ * Returns nothing.
+ */
+
+void outbuf_init(struct Outbuf *ob, const int fd, const char *name)
+{
+	assert(ob);
+	assert(name);
+
+	ob->fd = fd;
+	ob->name = name;
+	binbuf_init(&ob->buf);
+}
+
+/*
+ * outbuf_add() - Add the string `s` and a newline to `ob`. The buffer is 
+ * never written here, a UUID mustn't be printed before its entry is written 
+ * to the log file, so the caller decides when to use outbuf_flush(). Returns 
+ * 0 if ok, or 1 if error.
+ */
+
+int outbuf_add(struct Outbuf *ob, const char *s)
+{
+	assert(ob);
+	assert(s);
+
+	if (ob->fd == -1)
+		return 0;
+	if (!bb_append(&ob->buf, s, strlen(s))
+	    || !bb_append(&ob->buf, "\n", 1)) {
+		failed("bb_append()"); /* gncov */
+		return 1; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * outbuf_full() - Return true if `ob` has OUTPUT_BUFSIZE bytes or more 
+ * buffered and should be written with outbuf_flush(), otherwise false.
+ */
+
+bool outbuf_full(const struct Outbuf *ob)
+{
+	assert(ob);
+
+	return ob->fd != -1 && ob->buf.len >= OUTPUT_BUFSIZE;
+}
+
+/*
+ * outbuf_flush() - Write the contents of `ob` to its file descriptor and 
+ * empty the buffer, also if the write fails. Returns 0 if ok, or 1 if error.
+ */
+
+int outbuf_flush(struct Outbuf *ob)
+{
+	int retval = 0;
+
+	assert(ob);
+
+	if (ob->fd == -1 || !ob->buf.len)
+		return 0;
+	if (write_all(ob->fd, ob->buf.buf, ob->buf.len, -1)) {
+		myerror("Cannot print UUID to %s", ob->name);
+		retval = 1;
+	}
+	ob->buf.len = 0;
+
+	return retval;
+}
+
+/*
+ * outbuf_free() - Deallocate the buffer in `ob` without writing it. Returns 
+ * nothing.
+ */
+
+void outbuf_free(struct Outbuf *ob)
+{
+	assert(ob);
+
+	binbuf_free(&ob->buf);
+}
+
 /*
  * streams_init() - Initialize a `struct streams` struct. Returns nothing.
  */
@@ -382,7 +495,7 @@ int streams_exec(const struct Options *o, struct streams *dest, char *cmd[])
 	close(errfd[1]);
 
 	if (!dest) {
-		wait(&retval); /* gncov */
+		waitpid(pid, &retval, 0); /* gncov */
 		goto cleanup; /* gncov */
 	}
 
@@ -408,7 +521,7 @@ int streams_exec(const struct Options *o, struct streams *dest, char *cmd[])
 	msg(10, "%s():%d: dest->err.buf = \"%s\"",
 	        __func__, __LINE__, no_null(dest->err.buf));
 
-	wait(&dest->ret);
+	waitpid(pid, &dest->ret, 0);
 	dest->ret = dest->ret >> 8;
 	retval = dest->ret;
 
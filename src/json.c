@@ -0,0 +1,778 @@
+/*
+ * json.c
+ * File ID: 5f0c1a4e-ad7b-11f0-9b1f-83850402c3ce
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "suuid.h"
+
+/*
+ * The worst case when escaping a string for JSON is a string with only 
+ * control characters, every byte is then written as "\u00XX".
+ */
+#define JSON_GROWTH  6
+
+/*
+ * json_str() - Return pointer to an allocated string where `s` is escaped and 
+ * surrounded by quotes for use as a JSON string. Bytes above U+007F are copied 
+ * unchanged. Returns NULL if malloc() fails.
+ */
+
+char *json_str(const char *s)
+{
+	char *retval, *destp;
+	const unsigned char *p;
+
+	assert(s);
+
+	retval = malloc(strlen(s) * JSON_GROWTH + 3);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+
+	destp = retval;
+	*destp++ = '"';
+	for (p = (const unsigned char *)s; *p; p++) {
+		switch (*p) {
+		case '"':
+			strcpy(destp, "\\\"");
+			destp += 2;
+			break;
+		case '\\':
+			strcpy(destp, "\\\\");
+			destp += 2;
+			break;
+		case '\n':
+			strcpy(destp, "\\n");
+			destp += 2;
+			break;
+		case '\t':
+			strcpy(destp, "\\t");
+			destp += 2;
+			break;
+		default:
+			if (*p < ' ' || *p == 127) {
+				sprintf(destp, "\\u%04x", *p);
+				destp += 6;
+			} else {
+				*destp++ = (char)*p;
+			}
+			break;
+		}
+	}
+	*destp++ = '"';
+	*destp = '\0';
+
+	return retval;
+}
+
+/*
+ * json_member() - Return pointer to an allocated string with the JSON member 
+ * `,"name":"src"`. If `src` is NULL or empty, an empty string is returned, 
+ * same as allocate_elem() does for XML. Returns NULL on error.
+ */
+
+static char *json_member(const char *name, const char *src)
+{
+	char *ap, *retval;
+
+	assert(name);
+	assert(*name);
+
+	if (!src || !*src) {
+		retval = mystrdup("");
+		if (!retval)
+			failed("mystrdup()"); /* gncov */
+		return retval;
+	}
+
+	ap = json_str(src);
+	if (!ap)
+		return NULL; /* gncov */
+	retval = allocstr(",\"%s\":%s", name, ap);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+	free(ap);
+
+	return retval;
+}
+
+/*
+ * get_json_tags() - Return pointer to an allocated string with the JSON 
+ * member `,"tag":[...]` generated from the entry->tag[] array. If there are no 
+ * tags, an empty string is returned. If error, return NULL.
+ */
+
+static char *get_json_tags(const struct Entry *entry)
+{
+	char *p, *buf;
+	size_t i, size = 0;
+
+	assert(entry);
+
+	for (i = 0; (p = entry->tag[i]); i++)
+		size += strlen(p) * JSON_GROWTH + 3;
+
+	if (!size) {
+		buf = mystrdup("");
+		if (!buf)
+			failed("mystrdup()"); /* gncov */
+		return buf;
+	}
+
+	size += strlen(",\"tag\":[]") + 1;
+	buf = malloc(size);
+	if (!buf) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	strcpy(buf, ",\"tag\":[");
+
+	for (i = 0; (p = entry->tag[i]); i++) {
+		char *ap = json_str(p);
+
+		if (!ap) {
+			free(buf); /* gncov */
+			return NULL; /* gncov */
+		}
+		if (buf[strlen(buf) - 1] != '[')
+			strcat(buf, ",");
+		strcat(buf, ap);
+		free(ap);
+	}
+	strcat(buf, "]");
+
+	return buf;
+}
+
+/*
+ * get_json_sess() - Return pointer to an allocated string with the JSON member 
+ * `,"sess":[...]` generated from the entry->sess[] array. Every element is an 
+ * object with the "uuid" member and an optional "desc" member. If there are 
+ * no sess elements, an empty string is returned. If error, return NULL.
+ */
+
+static char *get_json_sess(const struct Entry *entry)
+{
+	unsigned int i;
+	size_t size = 0;
+	char *buf;
+
+	assert(entry);
+
+	for (i = 0; entry->sess[i].uuid; i++) {
+		size += strlen(entry->sess[i].uuid) * JSON_GROWTH + 16;
+		if (entry->sess[i].desc) {
+			size += strlen(entry->sess[i].desc) * JSON_GROWTH
+			        + 16;
+		}
+	}
+
+	if (!size) {
+		buf = mystrdup("");
+		if (!buf)
+			failed("mystrdup()"); /* gncov */
+		return buf;
+	}
+
+	size += strlen(",\"sess\":[]") + 1;
+	buf = malloc(size);
+	if (!buf) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	strcpy(buf, ",\"sess\":[");
+
+	for (i = 0; entry->sess[i].uuid; i++) {
+		char *u, *d = NULL;
+
+		u = json_str(entry->sess[i].uuid);
+		if (entry->sess[i].desc)
+			d = json_str(entry->sess[i].desc);
+		if (!u || (entry->sess[i].desc && !d)) {
+			free(d); /* gncov */
+			free(u); /* gncov */
+			free(buf); /* gncov */
+			return NULL; /* gncov */
+		}
+		if (i)
+			strcat(buf, ",");
+		strcat(buf, "{");
+		if (d) {
+			strcat(buf, "\"desc\":");
+			strcat(buf, d);
+			strcat(buf, ",");
+		}
+		strcat(buf, "\"uuid\":");
+		strcat(buf, u);
+		strcat(buf, "}");
+		free(d);
+		free(u);
+	}
+	strcat(buf, "]");
+
+	return buf;
+}
+
+/*
+ * json_object() - Return pointer to an allocated string with a JSON object 
+ * that starts with the members in `head`, followed by the tags, comment, 
+ * host, cwd, user, tty and sess values from `entry`. Used by json_entry() 
+ * and json_request(). Returns NULL if error.
+ */
+
+static char *json_object(const struct Entry *entry, const bool raw,
+                         const char *head)
+{
+	struct Entry e;
+	char *retval = NULL;
+	char *tag_json = NULL, *sess_json = NULL;
+
+	assert(entry);
+	assert(raw == false || raw == true);
+	assert(head);
+
+	init_xml_entry(&e);
+
+	tag_json = get_json_tags(entry);
+	sess_json = get_json_sess(entry);
+	if (raw && entry->txt) {
+		/*
+		 * Always store the raw text, also when it's empty, so the 
+		 * entry is converted back to the same XML.
+		 */
+		char *ap = json_str(entry->txt);
+
+		if (ap)
+			e.txt = allocstr(",\"txt\":%s,\"raw\":true", ap);
+		free(ap);
+	} else {
+		e.txt = json_member("txt", entry->txt);
+	}
+	e.host = json_member("host", entry->host);
+	e.cwd = json_member("cwd", entry->cwd);
+	e.user = json_member("user", entry->user);
+	e.tty = json_member("tty", entry->tty);
+	if (!tag_json || !sess_json || !e.txt || !e.host || !e.cwd
+	    || !e.user || !e.tty)
+		goto cleanup; /* gncov */
+
+	retval = allocstr("{%s%s%s%s%s%s%s%s}",
+	                  head, tag_json, e.txt, e.host, e.cwd, e.user, e.tty,
+	                  sess_json);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+cleanup:
+	free(e.tty);
+	free(e.user);
+	free(e.cwd);
+	free(e.host);
+	free(e.txt);
+	free(sess_json);
+	free(tag_json);
+
+	return retval;
+}
+
+/*
+ * json_entry() - Return pointer to an allocated string with the JSON object 
+ * created from the data in `entry`, or NULL if error. The object contains the 
+ * same values as the XML from xml_entry(), in the same order. If `raw` is 
+ * true, the "txt" member contains unescaped XML and `"raw":true` is added so 
+ * the entry can be converted back to XML.
+ */
+
+char *json_entry(const struct Entry *entry, const bool raw)
+{
+	char *head, *retval;
+
+	assert(entry);
+	assert(raw == false || raw == true);
+
+	if (!valid_uuid(entry->uuid, true))
+		return NULL; /* gncov */
+
+	if (is_valid_date(entry->date, true)) {
+		head = allocstr("\"t\":\"%s\",\"u\":\"%s\"",
+		                entry->date, entry->uuid);
+	} else {
+		head = allocstr("\"u\":\"%s\"", entry->uuid);
+	}
+	if (!head) {
+		failed("allocstr()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	retval = json_object(entry, raw, head);
+	free(head);
+
+	return retval;
+}
+
+/*
+ * json_request() - Return pointer to an allocated string with a request to 
+ * the daemon for `count` UUIDs with the values from `entry`. It has the same 
+ * format as json_entry(), but without "t" and "u", and with the number of 
+ * UUIDs in "n". Returns NULL if error.
+ */
+
+char *json_request(const struct Entry *entry, const bool raw,
+                   const unsigned long count)
+{
+	char *head, *retval;
+
+	assert(entry);
+	assert(raw == false || raw == true);
+
+	head = allocstr("\"n\":%lu", count);
+	if (!head) {
+		failed("allocstr()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	retval = json_object(entry, raw, head);
+	free(head);
+
+	return retval;
+}
+
+/*
+ * skip_ws() - Return pointer to the first character in `s` that isn't JSON 
+ * whitespace.
+ */
+
+static const char *skip_ws(const char *s)
+{
+	assert(s);
+
+	while (*s && strchr(" \t\n\r", *s))
+		s++;
+
+	return s;
+}
+
+/*
+ * hex4() - Convert the 4 hexadecimal digits at `s` to an integer and store it 
+ * in `dest`. Returns 0 if ok, or 1 if `s` doesn't start with 4 hex digits.
+ */
+
+static int hex4(const char *s, unsigned long *dest)
+{
+	int i;
+
+	assert(s);
+	assert(dest);
+
+	*dest = 0;
+	for (i = 0; i < 4; i++) {
+		const int c = tolower((unsigned char)s[i]);
+
+		if (!c || !isxdigit(c))
+			return 1;
+		*dest = *dest * 16
+		        + (unsigned long)(isdigit(c) ? c - '0' : c - 'a' + 10);
+	}
+
+	return 0;
+}
+
+/*
+ * put_utf8() - Write code point `cp` as UTF-8 to `dest`. Returns pointer to 
+ * the byte after the written sequence.
+ */
+
+static char *put_utf8(char *dest, const unsigned long cp)
+{
+	assert(dest);
+
+	if (cp < 0x80) {
+		*dest++ = (char)cp;
+	} else if (cp < 0x800) {
+		*dest++ = (char)(0xc0 | (cp >> 6));
+		*dest++ = (char)(0x80 | (cp & 0x3f));
+	} else if (cp < 0x10000) {
+		*dest++ = (char)(0xe0 | (cp >> 12));
+		*dest++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+		*dest++ = (char)(0x80 | (cp & 0x3f));
+	} else {
+		*dest++ = (char)(0xf0 | (cp >> 18));
+		*dest++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+		*dest++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+		*dest++ = (char)(0x80 | (cp & 0x3f));
+	}
+
+	return dest;
+}
+
+/*
+ * json_parse_str() - Parse the JSON string at `*s` and return pointer to an 
+ * allocated string with the unescaped value. On return, `*s` points to the 
+ * first character after the closing quote. Returns NULL if the string is 
+ * invalid or malloc() fails.
+ */
+
+char *json_parse_str(const char **s)
+{
+	const char *p;
+	char *retval, *destp;
+
+	assert(s);
+	assert(*s);
+
+	p = *s;
+	if (*p++ != '"')
+		return NULL;
+	retval = malloc(strlen(p) + 1);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	destp = retval;
+
+	while (*p != '"') {
+		unsigned long cp, lo;
+
+		if (!*p || (unsigned char)*p < ' ')
+			goto error;
+		if (*p != '\\') {
+			*destp++ = *p++;
+			continue;
+		}
+		p++;
+		switch (*p) {
+		case '"':
+		case '\\':
+		case '/':
+			*destp++ = *p++;
+			break;
+		case 'b':
+			*destp++ = '\b';
+			p++;
+			break;
+		case 'f':
+			*destp++ = '\f';
+			p++;
+			break;
+		case 'n':
+			*destp++ = '\n';
+			p++;
+			break;
+		case 'r':
+			*destp++ = '\r';
+			p++;
+			break;
+		case 't':
+			*destp++ = '\t';
+			p++;
+			break;
+		case 'u':
+			if (hex4(p + 1, &cp))
+				goto error;
+			p += 5;
+			if (cp >= 0xdc00 && cp <= 0xdfff)
+				goto error;
+			if (cp >= 0xd800 && cp <= 0xdbff) {
+				/*
+				 * High surrogate, must be followed by a low 
+				 * surrogate.
+				 */
+				if (p[0] != '\\' || p[1] != 'u'
+				    || hex4(p + 2, &lo)
+				    || lo < 0xdc00 || lo > 0xdfff)
+					goto error;
+				p += 6;
+				cp = 0x10000 + ((cp - 0xd800) << 10)
+				     + (lo - 0xdc00);
+			}
+			if (!cp)
+				goto error; /* Can't be stored in a C string */
+			destp = put_utf8(destp, cp);
+			break;
+		default:
+			goto error;
+		}
+	}
+	*destp = '\0';
+	*s = p + 1;
+
+	return retval;
+
+error:
+	free(retval);
+
+	return NULL;
+}
+
+/*
+ * json_parse_tags() - Parse the JSON array of strings at `*s` and store the 
+ * strings in entry->tag[] with store_tag(), so they're split at commas, 
+ * trimmed and checked like the -t/--tag values. Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+static int json_parse_tags(const char **s, struct Entry *entry)
+{
+	const char *p;
+
+	assert(s);
+	assert(*s);
+	assert(entry);
+
+	p = skip_ws(*s);
+	if (*p++ != '[')
+		return 1;
+	p = skip_ws(p);
+	if (*p == ']') {
+		*s = p + 1;
+		return 0;
+	}
+	do {
+		char *tag;
+		int result;
+
+		p = skip_ws(p);
+		tag = json_parse_str(&p);
+		if (!tag)
+			return 1;
+		result = store_tag(entry, tag);
+		free(tag);
+		if (result)
+			return 1;
+		p = skip_ws(p);
+	} while (*p++ == ',');
+	if (p[-1] != ']')
+		return 1;
+	*s = p;
+
+	return 0;
+}
+
+/*
+ * json_parse_sess() - Parse the JSON array of sess objects at `*s` and store 
+ * the values in entry->sess[]. Returns 0 if ok, or 1 if error.
+ */
+
+static int json_parse_sess(const char **s, struct Entry *entry)
+{
+	const char *p;
+	struct Sess sess;
+
+	assert(s);
+	assert(*s);
+	assert(entry);
+
+	p = skip_ws(*s);
+	if (*p++ != '[')
+		return 1;
+	p = skip_ws(p);
+	if (*p == ']') {
+		*s = p + 1;
+		return 0;
+	}
+	do {
+		init_sess_array(&sess, 1);
+		p = skip_ws(p);
+		if (*p++ != '{')
+			return 1;
+		do {
+			char *key, **dest;
+
+			p = skip_ws(p);
+			key = json_parse_str(&p);
+			if (!key)
+				goto error;
+			if (!strcmp(key, "uuid"))
+				dest = &sess.uuid;
+			else if (!strcmp(key, "desc"))
+				dest = &sess.desc;
+			else
+				dest = NULL;
+			free(key);
+			p = skip_ws(p);
+			if (!dest || *dest || *p++ != ':')
+				goto error;
+			p = skip_ws(p);
+			*dest = json_parse_str(&p);
+			if (!*dest)
+				goto error;
+			p = skip_ws(p);
+		} while (*p++ == ',');
+		if (p[-1] != '}' || !sess.uuid)
+			goto error;
+		if (append_sess(entry, sess.uuid, sess.desc))
+			return 1; /* gncov */
+		p = skip_ws(p);
+	} while (*p++ == ',');
+	if (p[-1] != ']')
+		return 1;
+	*s = p;
+
+	return 0;
+
+error:
+	free(sess.desc);
+	free(sess.uuid);
+
+	return 1;
+}
+
+/*
+ * parse_object() - Used by parse_json_entry() and parse_json_request(). 
+ * Parse the JSON object in `s` and store the values in `entry`. If `req` is 
+ * NULL, the object is an entry and must contain "u". Otherwise it's a 
+ * request, "n" and "w" are stored in `req`, and "t" and "u" aren't allowed. 
+ * Returns 0 if ok, or 1 if `s` isn't valid.
+ */
+
+static int parse_object(const char *s, struct Entry *entry, bool *raw,
+                        struct Request *req)
+{
+	const char *p;
+	bool has_uuid = false, has_count = false;
+
+	assert(s);
+	assert(entry);
+	assert(raw);
+
+	*raw = false;
+	if (req) {
+		req->count = 1;
+		req->whereto = NULL;
+	}
+	p = skip_ws(s);
+	if (*p++ != '{')
+		return 1;
+	do {
+		char *key, *val = NULL, **dest = NULL;
+		int result = 0;
+
+		p = skip_ws(p);
+		key = json_parse_str(&p);
+		if (!key)
+			return 1;
+		p = skip_ws(p);
+		if (*p++ != ':') {
+			free(key);
+			return 1;
+		}
+		p = skip_ws(p);
+
+		if (!strcmp(key, "tag")) {
+			result = entry->tag[0] || json_parse_tags(&p, entry);
+		} else if (!strcmp(key, "sess")) {
+			result = entry->sess[0].uuid
+			         || json_parse_sess(&p, entry);
+		} else if (!strcmp(key, "raw")) {
+			if (!strncmp(p, "true", 4)) {
+				*raw = true;
+				p += 4;
+			} else if (!strncmp(p, "false", 5)) {
+				p += 5;
+			} else {
+				result = 1;
+			}
+		} else if (req && !strcmp(key, "n")) {
+			char *endp;
+
+			result = has_count || !isdigit((unsigned char)*p);
+			if (!result) {
+				errno = 0;
+				req->count = strtoul(p, &endp, 10);
+				result = !!errno;
+				errno = 0;
+				p = endp;
+			}
+			has_count = true;
+		} else {
+			if (!strcmp(key, "txt"))
+				dest = &entry->txt;
+			else if (!strcmp(key, "host"))
+				dest = &entry->host;
+			else if (!strcmp(key, "cwd"))
+				dest = &entry->cwd;
+			else if (!strcmp(key, "user"))
+				dest = &entry->user;
+			else if (!strcmp(key, "tty"))
+				dest = &entry->tty;
+			else if (req && !strcmp(key, "w"))
+				dest = &req->whereto;
+			val = json_parse_str(&p);
+			if (!val) {
+				result = 1;
+			} else if (dest) {
+				result = !!*dest;
+				if (!result) {
+					*dest = val;
+					val = NULL;
+				}
+			} else if (!req && !strcmp(key, "u")) {
+				result = has_uuid || !valid_uuid(val, true);
+				if (!result)
+					memcpy(entry->uuid, val, UUID_LENGTH);
+				has_uuid = true;
+			} else if (!req && !strcmp(key, "t")) {
+				result = !is_valid_date(val, true);
+				if (!result)
+					memcpy(entry->date, val, DATE_LENGTH);
+			} else {
+				result = 1;
+			}
+		}
+		free(val);
+		free(key);
+		if (result)
+			return 1;
+		p = skip_ws(p);
+	} while (*p++ == ',');
+	if (p[-1] != '}' || *skip_ws(p) || (!req && !has_uuid))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * parse_json_entry() - Parse the JSON object in `s` created by json_entry() 
+ * and store the values in `entry`, which must be initialised with 
+ * init_xml_entry(). `raw` is set to true if the entry contains `"raw":true`. 
+ * The allocated values must be freed with free_sess(), free_tags() and free() 
+ * also if the function fails. Returns 0 if ok, or 1 if `s` isn't a valid 
+ * entry.
+ */
+
+int parse_json_entry(const char *s, struct Entry *entry, bool *raw)
+{
+	return parse_object(s, entry, raw, NULL);
+}
+
+/*
+ * parse_json_request() - Parse the request in `s` created by json_request() 
+ * and store the values in `entry` like parse_json_entry() does. The number of 
+ * UUIDs ("n", default 1), the raw flag and the -w/--whereto value ("w", can 
+ * be NULL) are stored in `req`, `req->whereto` is allocated and must be 
+ * freed also if the function fails. Returns 0 if ok, or 1 if `s` isn't a 
+ * valid request.
+ */
+
+int parse_json_request(const char *s, struct Entry *entry,
+                       struct Request *req)
+{
+	assert(req);
+
+	return parse_object(s, entry, &req->raw, req);
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
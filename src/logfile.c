@@ -52,81 +52,102 @@ bool valid_xml_chars(const char *s)
 }
 
 /*
- * suuid_xml() - Return pointer to allocated string where the data in the text 
- * argument is escaped for use in the XML file.
+ * xml_escape() - Write the data in `text` escaped for use in the XML file to 
+ * `dest`, which must have room for strlen(text) * MAX_GROWTH + 1 bytes. 
+ * Returns a pointer to the terminating null byte in `dest`.
  */
 
-char *suuid_xml(const char *text)
+static char *xml_escape(char *dest, const char *text)
 {
-	char *retval;
-	size_t size;
 	const char *p;
-	char *destp;
 
+	assert(dest);
 	assert(text);
 
-	size = strlen(text);
-	retval = malloc(size * MAX_GROWTH + 1);
-	if (!retval) {
-		failed("malloc()"); /* gncov */
-		return NULL; /* gncov */
-	}
+	trace_count(xml_escapes, 1);
+	trace_count(xml_escape_bytes, strlen(text));
 
-	destp = retval;
 	for (p = text; *p; p++) {
 		switch (*p) {
 		case '&':
-			strcpy(destp, "&amp;");
-			destp += 5;
+			memcpy(dest, "&amp;", 5);
+			dest += 5;
 			break;
 		case '<':
-			strcpy(destp, "&lt;");
-			destp += 4;
+			memcpy(dest, "&lt;", 4);
+			dest += 4;
 			break;
 		case '>':
-			strcpy(destp, "&gt;");
-			destp += 4;
+			memcpy(dest, "&gt;", 4);
+			dest += 4;
 			break;
 		case '\\':
-			strcpy(destp, "\\\\");
-			destp += 2;
+			memcpy(dest, "\\\\", 2);
+			dest += 2;
 			break;
 		case '\n':
-			strcpy(destp, "\\n");
-			destp += 2;
+			memcpy(dest, "\\n", 2);
+			dest += 2;
 			break;
 		case '\t':
-			strcpy(destp, "\\t");
-			destp += 2;
+			memcpy(dest, "\\t", 2);
+			dest += 2;
 			break;
 		default:
-			*destp++ = *p;
+			*dest++ = *p;
 			break;
 		}
 	}
-	*destp = '\0';
+	*dest = '\0';
+
+	return dest;
+}
+
+/*
+ * suuid_xml() - Return pointer to allocated string where the data in the text 
+ * argument is escaped for use in the XML file.
+ */
+
+char *suuid_xml(const char *text)
+{
+	char *retval;
+	size_t size;
+
+	assert(text);
+
+	size = strlen(text);
+	retval = malloc(size * MAX_GROWTH + 1);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
+		return NULL; /* gncov */
+	}
+	trace_count(allocs, 1);
+	trace_count(alloc_bytes, size * MAX_GROWTH + 1);
+	xml_escape(retval, text);
 
 	return retval;
 }
 
 /*
- * init_sess_array() - Initializes a `struct Sess` array. The array must 
- * contain `MAX_SESS` elements. Returns nothing.
+ * init_sess_array() - Initializes the `n` elements of the `struct Sess` array 
+ * `sess`. Returns nothing.
  */
 
-void init_sess_array(struct Sess *sess)
+void init_sess_array(struct Sess *sess, const size_t n)
 {
-	int i;
+	size_t i;
 
 	assert(sess);
 
-	for (i = 0; i < MAX_SESS; i++)
+	for (i = 0; i < n; i++)
 		sess[i].uuid = sess[i].desc = NULL;
 }
 
 /*
  * init_xml_entry() - Initialise Entry struct at memory position e with initial 
- * values.
+ * values. The tag and sess arrays start in the small buffers inside the 
+ * struct and are moved to the heap by append_tag() and append_sess() when 
+ * they're full, so the struct must not be copied.
  */
 
 void init_xml_entry(struct Entry *e)
@@ -143,30 +164,40 @@ void init_xml_entry(struct Entry *e)
 	e->user = NULL;
 	e->tty = NULL;
 
-	for (i = 0; i < MAX_TAGS; i++)
-		e->tag[i] = NULL;
-	init_sess_array(e->sess);
+	for (i = 0; i <= ENTRY_TAGS; i++)
+		e->tag_buf[i] = NULL;
+	e->tag = e->tag_buf;
+	e->tag_count = 0;
+	e->tag_size = ENTRY_TAGS + 1;
+	e->tag_set = NULL;
+	e->tag_set_size = 0;
+	init_sess_array(e->sess_buf, ENTRY_SESS + 1);
+	e->sess = e->sess_buf;
+	e->arena = NULL;
+	e->sess_count = 0;
+	e->sess_size = ENTRY_SESS + 1;
 }
 
 /*
- * allocate_elem() - Allocate space and write the XML element to it.
+ * allocate_elem() - Allocate space from `a` and write the XML element to it.
+ *   a: Arena to allocate from, or NULL to use malloc()
  *   elem: char * to name of XML element
  *   src: char * to data source
  * Returns char * to allocated area, or NULL if error.
  */
 
-char *allocate_elem(const char *elem, const char *src)
+char *allocate_elem(struct Arena *a, const char *elem, const char *src)
 {
-	char *retval, *ap;
-	size_t size = 0;
+	char *retval, *p;
+	size_t size = 0, len;
 
 	assert(elem);
 	assert(*elem);
 
-	if (!src) {
-		retval = mystrdup("");
+	if (!src || !*src) {
+		retval = arena_strdup(a, "");
 		if (!retval)
-			failed("mystrdup()"); /* gncov */
+			failed("arena_strdup()"); /* gncov */
 		return retval;
 	}
 
@@ -175,224 +206,150 @@ char *allocate_elem(const char *elem, const char *src)
 	        + strlen("<") + strlen(elem) + strlen("/> ")
 	        + 1;
 
-	retval = malloc(size + 1);
+	retval = arena_alloc(a, size);
 	if (!retval) {
-		failed("malloc()"); /* gncov */
+		failed("arena_alloc()"); /* gncov */
 		return NULL; /* gncov */
 	}
 
-	ap = suuid_xml(src);
-	if (!ap)
-		return NULL; /* gncov */
-
-	if (*ap)
-		snprintf(retval, size, "<%s>%s</%s> ", elem, ap, elem);
-	else
-		retval[0] = '\0';
-
-	free(ap);
+	len = (size_t)snprintf(retval, size, "<%s>", elem);
+	p = xml_escape(retval + len, src);
+	snprintf(p, size - (size_t)(p - retval), "</%s> ", elem);
 
 	return retval;
 }
 
 /*
- * alloc_attr() - Return pointer to allocated string with XML attribute. 
- * Returns NULL on error.
+ * alloc_attr() - Return a pointer to a string allocated from `a` with the XML 
+ * attribute `attr` with the value `data`, or NULL if error.
  */
 
-char *alloc_attr(const char *attr, const char *data)
+char *alloc_attr(struct Arena *a, const char *attr, const char *data)
 {
-	char *retval = NULL;
-	size_t size;
+	char *retval;
 
 	assert(attr);
 	assert(*attr);
 	assert(data);
 
-	size = strlen(" ") + strlen(attr) + strlen("=\"") + strlen(data)
-	       + strlen("\"") + 1;
-
-	retval = malloc(size + 1);
-	if (!retval) {
-		failed("malloc()"); /* gncov */
-		return NULL; /* gncov */
-	}
-
-	snprintf(retval, size, " %s=\"%s\"", attr, data);
+	retval = arena_allocstr(a, " %s=\"%s\"", attr, data);
+	if (!retval)
+		failed("arena_allocstr()"); /* gncov */
 
 	return retval;
 }
 
 /*
- * get_xml_tags() - Return pointer to an allocated XML string with <tag> 
- * elements generated from the entry->tag[] array. If error, return NULL.
+ * get_xml_tags() - Return pointer to an XML string allocated from `a` with 
+ * <tag> elements generated from the entry->tag[] array. If error, return 
+ * NULL.
  */
 
-char *get_xml_tags(const struct Entry *entry)
+char *get_xml_tags(struct Arena *a, const struct Entry *entry)
 {
-	char *p, *buf, *tmpbuf;
-	size_t size = 0, tmpsize = 0;
+	char *p, *buf, *dest;
+	size_t i, size = 0;
 
 	assert(entry);
 
 	/*
 	 * Loop through the tags and find the total size of the tags. Multiply 
 	 * the size to make up for any worst case scenario (only ampersands) 
-	 * and include space for the XML tags. Also find the length of the 
-	 * longest tag, this is used to allocate a temporary work buffer where 
-	 * each tag is converted to escaped XML before it's appended to the 
-	 * returned string.
+	 * and include space for the XML tags.
 	 */
 
-	rewind_tag();
-	do {
-		p = get_next_tag(entry);
-		if (p) {
-			size_t len = strlen(p);
-
-			size += len * MAX_GROWTH + 16;
-			if (len > tmpsize)
-				tmpsize = len;
-		}
-	} while (p);
+	for (i = 0; (p = entry->tag[i]); i++)
+		size += strlen(p) * MAX_GROWTH + 16;
 
 	if (!size) {
 		/*
 		 * No tags found, return empty string,
 		 */
-		buf = mystrdup("");
+		buf = arena_strdup(a, "");
 		if (!buf)
-			failed("mystrdup()"); /* gncov */
+			failed("arena_strdup()"); /* gncov */
 		return buf;
 	}
 
-	buf = malloc(size);
+	buf = arena_alloc(a, size);
 	if (!buf) {
-		failed("malloc()"); /* gncov */
-		return NULL; /* gncov */
-	}
-	buf[0] = '\0';
-
-	tmpsize = tmpsize * MAX_GROWTH + 16;
-	tmpbuf = malloc(tmpsize);
-	if (!tmpbuf) {
-		failed("malloc()"); /* gncov */
-		free(buf); /* gncov */
+		failed("arena_alloc()"); /* gncov */
 		return NULL; /* gncov */
 	}
 
 	/*
-	 * Loop through each tag, convert it to XML and write it to a temporary 
-	 * buffer which is appended to the final string.
+	 * Loop through each tag and escape it directly into the string.
 	 */
 
-	rewind_tag();
-	do {
-		p = get_next_tag(entry);
-
-		if (p) {
-			char *ap;
-
-			ap = suuid_xml(p);
-			if (!ap) {
-				free(tmpbuf); /* gncov */
-				free(buf); /* gncov */
-				return NULL; /* gncov */
-			}
-
-			snprintf(tmpbuf, tmpsize, "<tag>%s</tag> ", ap);
-			free(ap);
-			strncat(buf, tmpbuf, size - strlen(buf));
-		}
-	} while (p);
-
-	free(tmpbuf);
+	dest = buf;
+	*dest = '\0';
+	for (i = 0; (p = entry->tag[i]); i++) {
+		memcpy(dest, "<tag>", 5);
+		dest = xml_escape(dest + 5, p);
+		memcpy(dest, "</tag> ", 8);
+		dest += 7;
+	}
 
 	return buf;
 }
 
 /*
- * create_sess_xml() - Return pointer to allocated XML string generated from 
- * entry->sess, or NULL if error.
+ * create_sess_xml() - Return pointer to XML string allocated from `a` 
+ * generated from entry->sess, or NULL if error. If `a` is NULL, the string is 
+ * allocated with malloc().
  */
 
-char *create_sess_xml(const struct Entry *entry)
+char *create_sess_xml(struct Arena *a, const struct Entry *entry)
 {
-	unsigned int i;
-	size_t size = 0, tmpsize = 0;
-	char *buf, *tmpbuf;
+	const struct Sess *sp;
+	size_t size = 0, len = 0;
+	char *buf;
 
 	assert(entry);
 
 	/*
 	 * Loop through the sess array and find the total length of all sess 
-	 * elements. Also find the length of the longest element, it's used to 
-	 * allocate a temporary work buffer.
+	 * elements.
 	 */
 
-	i = 0;
-	while (entry->sess[i].uuid) {
-		size_t len;
-
-		len = strlen(entry->sess[i].uuid) + 32;
-		if (entry->sess[i].desc)
-			len += strlen(entry->sess[i].desc) + 32;
-		size += len;
-		if (len > tmpsize)
-			tmpsize = len;
-		i++;
+	for (sp = entry->sess; sp->uuid; sp++) {
+		size += strlen(sp->uuid) + 32;
+		if (sp->desc)
+			size += strlen(sp->desc) + 32;
 	}
 
 	if (!size) {
 		/*
 		 * No elements in the sess array, return empty string.
 		 */
-		buf = mystrdup("");
+		buf = arena_strdup(a, "");
 		if (!buf)
-			failed("mystrdup()"); /* gncov */
+			failed("arena_strdup()"); /* gncov */
 		return buf;
 	}
 
-	/*
-	 * Allocate space for the final string and a temporary work buffer.
-	 */
-
-	buf = malloc(size);
+	buf = arena_alloc(a, size);
 	if (!buf) {
-		failed("malloc()"); /* gncov */
-		return NULL; /* gncov */
-	}
-
-	tmpbuf = malloc(tmpsize);
-	if (!tmpbuf) {
-		failed("malloc()"); /* gncov */
-		free(buf); /* gncov */
+		failed("arena_alloc()"); /* gncov */
 		return NULL; /* gncov */
 	}
-
 	buf[0] = '\0';
-	i = 0;
 
 	/*
-	 * Loop through each element in the sess array, convert it to XML, 
-	 * write it to a temporary buffer and append it to the final string.
+	 * Loop through each element in the sess array, convert it to XML and 
+	 * write it to the end of the string.
 	 */
 
-	while (entry->sess[i].uuid) {
-		char *u, *d;
-
-		u = entry->sess[i].uuid;
-		d = entry->sess[i].desc;
-		if (d) {
-			snprintf(tmpbuf, tmpsize,
-			         "<sess desc=\"%s\">%s</sess> ", d, u);
+	for (sp = entry->sess; sp->uuid; sp++) {
+		if (sp->desc) {
+			len += (size_t)snprintf(buf + len, size - len,
+			                        "<sess desc=\"%s\">%s</sess> ",
+			                        sp->desc, sp->uuid);
 		} else {
-			snprintf(tmpbuf, tmpsize, "<sess>%s</sess> ", u);
+			len += (size_t)snprintf(buf + len, size - len,
+			                        "<sess>%s</sess> ", sp->uuid);
 		}
-		strncat(buf, tmpbuf, size - strlen(buf));
-		i++;
 	}
-	free(tmpbuf);
 
 	return buf;
 }
@@ -400,57 +357,52 @@ char *create_sess_xml(const struct Entry *entry)
 /*
  * xml_entry() - Return pointer to allocated string with one XML entry 
  * extracted from the entry struct, or NULL if error. If raw is true, insert 
- * the comment into the XML unmodified, no escaping is performed.
+ * the comment into the XML unmodified, no escaping is performed. The 
+ * elements are built in an arena that starts on the stack, so only the 
+ * returned string is allocated in most cases.
  */
 
 char *xml_entry(const struct Entry *entry, const bool raw)
 {
-	struct Entry e;
+	char abuf[XML_ARENA_SIZE];
+	struct Arena arena;
+	char *txt, *host, *cwd, *user, *tty;
 	char *uuidp;
-	char *datep = NULL;
-	char *retval;
-	char *tag_xml = NULL, *sess_xml = NULL;
+	const char *datep = "";
+	char *retval = NULL;
+	char *tag_xml, *sess_xml;
 	size_t size;
 
 	assert(entry);
 	assert(raw == false || raw == true);
 
-	init_xml_entry(&e);
-
 	if (!valid_uuid(entry->uuid, true))
 		return NULL; /* gncov */
 
+	arena_init(&arena, abuf, sizeof(abuf));
+
 	/*
 	 * Allocate space for the UUID and timestamp attributes.
 	 */
 
-	uuidp = alloc_attr("u", entry->uuid);
+	uuidp = alloc_attr(&arena, "u", entry->uuid);
 	if (!uuidp)
-		return NULL; /* gncov */
+		goto cleanup; /* gncov */
 
 	if (is_valid_date(entry->date, true)) {
-		datep = alloc_attr("t", entry->date);
-		if (!datep) {
-			free(uuidp); /* gncov */
-			return NULL; /* gncov */
-		}
+		datep = alloc_attr(&arena, "t", entry->date);
+		if (!datep)
+			goto cleanup; /* gncov */
 	}
 
 	/*
 	 * Allocate space for XML tags and sess elements.
 	 */
 
-	tag_xml = get_xml_tags(entry);
-	if (!tag_xml) {
-		retval = NULL; /* gncov */
-		goto cleanup; /* gncov */
-	}
-
-	sess_xml = create_sess_xml(entry);
-	if (!sess_xml) {
-		retval = NULL; /* gncov */
+	tag_xml = get_xml_tags(&arena, entry);
+	sess_xml = create_sess_xml(&arena, entry);
+	if (!tag_xml || !sess_xml)
 		goto cleanup; /* gncov */
-	}
 
 	if (raw) {
 		/*
@@ -461,43 +413,34 @@ char *xml_entry(const struct Entry *entry, const bool raw)
 		 * file won't validate. The XML doesn't need to have a single 
 		 * root, as it will be enclosed inside the <txt> element.
 		 */
-		size_t txt_size;
-		char *txt_space;
+		const char *txt_space = entry->txt[0] == '<' ? " " : "";
 
-		txt_size = strlen("<txt> ") + strlen(entry->txt)
-		           + strlen(" </txt> ") + 1;
-		e.txt = malloc(txt_size);
-		if (!e.txt) {
-			failed("malloc()"); /* gncov */
-			retval = NULL; /* gncov */
-			goto cleanup; /* gncov */
-		}
-		txt_space = entry->txt[0] == '<' ? " " : "";
-		snprintf(e.txt, txt_size, "<txt>%s%s%s</txt> ",
-		                          txt_space, entry->txt, txt_space);
+		txt = arena_allocstr(&arena, "<txt>%s%s%s</txt> ",
+		                     txt_space, entry->txt, txt_space);
 	} else {
 		/*
 		 * Write escaped XML to the buffer.
 		 */
-		e.txt = allocate_elem("txt", entry->txt);
+		txt = allocate_elem(&arena, "txt", entry->txt);
 	}
 
-	e.host = allocate_elem("host", entry->host);
-	e.cwd = allocate_elem("cwd", entry->cwd);
-	e.user = allocate_elem("user", entry->user);
-	e.tty = allocate_elem("tty", entry->tty);
+	host = allocate_elem(&arena, "host", entry->host);
+	cwd = allocate_elem(&arena, "cwd", entry->cwd);
+	user = allocate_elem(&arena, "user", entry->user);
+	tty = allocate_elem(&arena, "tty", entry->tty);
+	if (!txt || !host || !cwd || !user || !tty)
+		goto cleanup; /* gncov */
 
 	/*
 	 * Allocate space for the final XML string.
 	 */
 
-	size = DATE_LENGTH + UUID_LENGTH + strlen(tag_xml) + strlen(e.txt)
-	       + strlen(e.host) + strlen(e.cwd) + strlen(e.user)
-	       + strlen(e.tty) + strlen(sess_xml) + 128;
+	size = DATE_LENGTH + UUID_LENGTH + strlen(tag_xml) + strlen(txt)
+	       + strlen(host) + strlen(cwd) + strlen(user)
+	       + strlen(tty) + strlen(sess_xml) + 128;
 	retval = malloc(size);
 	if (!retval) {
 		failed("malloc()"); /* gncov */
-		retval = NULL; /* gncov */
 		goto cleanup; /* gncov */
 	}
 
@@ -515,288 +458,1979 @@ char *xml_entry(const struct Entry *entry, const bool raw)
 	                       "%s" /* tty */
 	                       "%s" /* sess */
 	                       "</suuid>",
-	                       (datep) ? datep : "",
-	                       (uuidp) ? uuidp : "",
-	                       tag_xml ? tag_xml : "",
-	                       (e.txt) ? e.txt : "",
-	                       (e.host) ? e.host : "",
-	                       (e.cwd) ? e.cwd : "",
-	                       (e.user) ? e.user : "",
-	                       (e.tty) ? e.tty : "", sess_xml);
+	                       datep, uuidp, tag_xml, txt, host, cwd, user,
+	                       tty, sess_xml);
 
 cleanup:
-	free(e.tty);
-	free(e.user);
-	free(e.cwd);
-	free(e.host);
-	free(e.txt);
-	free(sess_xml);
-	free(tag_xml);
-	free(datep);
-	free(uuidp);
+	arena_free(&arena);
 
 	return retval;
 }
 
 /*
- * lock_file() - Lock file associated with fp. If locking succeeds, return FILE 
- * pointer to the stream, otherwise return NULL.
+ * xml_unescape() - Return pointer to an allocated string with the first `len` 
+ * bytes of `s` where the escapes created by suuid_xml() are converted back. 
+ * Returns NULL if `s` contains an unknown escape or malloc() fails.
  */
 
-FILE *lock_file(FILE *fp, const char *fname)
+char *xml_unescape(const char *s, const size_t len)
 {
-	assert(fp);
-	assert(fname);
-	assert(*fname);
+	const char *p, *end = s + len;
+	char *retval, *destp;
 
-	if (flock(fileno(fp), LOCK_EX) == -1) {
-		myerror("Could not lock file \"%s\"", fname); /* gncov */
-		fclose(fp); /* gncov */
+	assert(s);
+
+	retval = malloc(len + 1);
+	if (!retval) {
+		failed("malloc()"); /* gncov */
 		return NULL; /* gncov */
 	}
 
-	return fp;
+	destp = retval;
+	for (p = s; p < end; p++) {
+		if (*p == '&') {
+			if (end - p >= 5 && !strncmp(p, "&amp;", 5)) {
+				*destp++ = '&';
+				p += 4;
+			} else if (end - p >= 4 && !strncmp(p, "&lt;", 4)) {
+				*destp++ = '<';
+				p += 3;
+			} else if (end - p >= 4 && !strncmp(p, "&gt;", 4)) {
+				*destp++ = '>';
+				p += 3;
+			} else {
+				goto error;
+			}
+		} else if (*p == '\\') {
+			if (p + 1 >= end)
+				goto error;
+			p++;
+			if (*p == '\\')
+				*destp++ = '\\';
+			else if (*p == 'n')
+				*destp++ = '\n';
+			else if (*p == 't')
+				*destp++ = '\t';
+			else
+				goto error;
+		} else if (*p == '<') {
+			goto error;
+		} else {
+			*destp++ = *p;
+		}
+	}
+	*destp = '\0';
+
+	return retval;
+
+error:
+	free(retval);
+
+	return NULL;
 }
 
 /*
- * write_xml_header() - Write the initial log file header to the log file 
- * stream.
- *
- * Return fp if success, NULL if FUBAR.
+ * get_xml_elem() - Used by parse_xml_line(). If `*s` starts with the element 
+ * "<`elem`>...</`elem`> ", return pointer to an allocated string with the 
+ * unescaped contents and move `*s` past the element. If `raw` is true, the 
+ * contents are copied unchanged. Returns NULL if the element isn't found or 
+ * the contents can't be unescaped.
  */
 
-FILE *write_xml_header(FILE *fp)
+static char *get_xml_elem(const char **s, const char *elem, const bool raw)
 {
-	const char *header = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-	                     "<!DOCTYPE suuids SYSTEM \"dtd/suuids.dtd\">\n"
-	                     "<suuids>\n";
+	char *start, *end, *retval;
+	const char *p;
 
-	assert(fp);
+	assert(s);
+	assert(*s);
+	assert(elem);
 
-	if (fputs(header, fp) == EOF) {
-		myerror("Cannot write header to the log file"); /* gncov */
-		return NULL; /* gncov */
+	start = allocstr("<%s>", elem);
+	end = allocstr("</%s> ", elem);
+	if (!start || !end) {
+		failed("allocstr()"); /* gncov */
+		retval = NULL; /* gncov */
+		goto cleanup; /* gncov */
 	}
+	retval = NULL;
+	if (strncmp(*s, start, strlen(start)))
+		goto cleanup;
+	p = *s + strlen(start);
+	if (!strstr(p, end))
+		goto cleanup;
+	if (raw) {
+		size_t len = (size_t)(strstr(p, end) - p);
 
-	return fp;
+		retval = malloc(len + 1);
+		if (!retval) {
+			failed("malloc()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		memcpy(retval, p, len);
+		retval[len] = '\0';
+	} else {
+		retval = xml_unescape(p, (size_t)(strstr(p, end) - p));
+	}
+	if (retval)
+		*s = strstr(p, end) + strlen(end);
+
+cleanup:
+	free(end);
+	free(start);
+
+	return retval;
 }
 
 /*
- * seek_to_eof() - Seek to end of fp, and display error message about fname if 
- * it can't seek.
- *
- * Return fp if ok, NULL if error.
+ * parse_xml_line() - Parse the log file line `line` created by xml_entry() and 
+ * store the values in `entry`, which must be initialised with 
+ * init_xml_entry(). `raw` is set to true if the <txt> element contains 
+ * unescaped XML. To make sure no information is lost, the entry is converted 
+ * back to XML and compared to `line`. The allocated values must be freed with 
+ * free_sess(), free_tags() and free() also if the function fails. Returns 0 
+ * if ok, or 1 if the line can't be recreated from `entry`.
  */
 
-FILE *seek_to_eof(FILE *fp, const char *fname)
+int parse_xml_line(const char *line, struct Entry *entry, bool *raw)
 {
-	assert(fp);
-	assert(fname);
+	const char *elems[] = { "host", "cwd", "user", "tty" };
+	char **dests[] = { &entry->host, &entry->cwd, &entry->user,
+	                   &entry->tty };
+	const char *p = line;
+	char *txt, *ap;
+	unsigned int i;
+	int retval = 1;
 
-	if (fseek(fp, 0L, SEEK_END) == -1) {
-		myerror("%s: Cannot seek to end of file", fname); /* gncov */
-		return NULL; /* gncov */
+	assert(line);
+	assert(entry);
+	assert(raw);
+
+	*raw = false;
+	if (strncmp(p, "<suuid t=\"", 10) || strlen(p) < 10 + DATE_LENGTH)
+		return 1;
+	p += 10;
+	memcpy(entry->date, p, DATE_LENGTH);
+	p += DATE_LENGTH;
+	if (strncmp(p, "\" u=\"", 5) || strlen(p) < 5 + UUID_LENGTH)
+		return 1;
+	p += 5;
+	memcpy(entry->uuid, p, UUID_LENGTH);
+	p += UUID_LENGTH;
+	if (strncmp(p, "\"> ", 3))
+		return 1;
+	p += 3;
+
+	while (!strncmp(p, "<tag>", 5)) {
+		char *tag = get_xml_elem(&p, "tag", false);
+
+		if (!tag || append_tag(entry, tag))
+			return 1;
 	}
 
-	return fp;
+	/*
+	 * Try to unescape the contents of <txt>. If it can't be unescaped, or 
+	 * it doesn't give the same XML when it's escaped again, it was stored 
+	 * with --raw.
+	 */
+	txt = get_xml_elem(&p, "txt", true);
+	if (txt) {
+		char *esc = xml_unescape(txt, strlen(txt));
+		char *chk = esc ? suuid_xml(esc) : NULL;
+
+		if (chk && !strcmp(chk, txt)) {
+			entry->txt = esc;
+			free(txt);
+		} else {
+			size_t len = strlen(txt);
+
+			free(esc);
+			*raw = true;
+			if (len > 2 && txt[0] == ' ' && txt[1] == '<'
+			    && txt[len - 1] == ' ') {
+				memmove(txt, txt + 1, len - 2);
+				txt[len - 2] = '\0';
+			}
+			entry->txt = txt;
+		}
+		free(chk);
+	}
+	for (i = 0; i < 4; i++) {
+		char elem[8];
+
+		snprintf(elem, sizeof(elem), "<%s>", elems[i]);
+		if (strncmp(p, elem, strlen(elem)))
+			continue;
+		*dests[i] = get_xml_elem(&p, elems[i], false);
+		if (!*dests[i])
+			return 1;
+	}
+
+	while (!strncmp(p, "<sess", 5)) {
+		const char *u;
+		char *uuid, *desc = NULL;
+
+		if (!strncmp(p, "<sess desc=\"", 12)) {
+			const char *e = strstr(p + 12, "\">");
+
+			if (!e)
+				return 1;
+			desc = strndup(p + 12, (size_t)(e - p - 12));
+			if (!desc) {
+				failed("strndup()"); /* gncov */
+				return 1; /* gncov */
+			}
+			u = e + 2;
+		} else if (!strncmp(p, "<sess>", 6)) {
+			u = p + 6;
+		} else {
+			return 1;
+		}
+		if (strlen(u) < UUID_LENGTH
+		    || strncmp(u + UUID_LENGTH, "</sess> ", 8)) {
+			free(desc);
+			return 1;
+		}
+		uuid = strndup(u, UUID_LENGTH);
+		if (!uuid) {
+			failed("strndup()"); /* gncov */
+			free(desc); /* gncov */
+			return 1; /* gncov */
+		}
+		if (append_sess(entry, uuid, desc))
+			return 1; /* gncov */
+		p = u + UUID_LENGTH + 8;
+	}
+	if (strcmp(p, "</suuid>"))
+		return 1;
+
+	ap = xml_entry(entry, *raw);
+	if (ap && !strcmp(ap, line))
+		retval = 0;
+	free(ap);
+
+	return retval;
 }
 
 /*
- * unknown_end_line() - The last line in the logfile isn't "</suuids>\n". 
- * Complain about it and set the file position to EOF.
- *
- * Returns with value from seek_to_eof().
+ * log_filename() - Return pointer to an allocated string with the log file 
+ * name `fname` where the LOGFILE_EXTENSION extension is replaced with `ext`. 
+ * If `fname` doesn't have that extension, `ext` is added. Returns NULL if 
+ * allocstr() fails.
  */
 
-FILE *unknown_end_line(FILE *fp, const char *fname)
+char *log_filename(const char *fname, const char *ext)
 {
-	assert(fp);
+	size_t len, extlen = strlen(LOGFILE_EXTENSION);
+	char *retval;
+
 	assert(fname);
+	assert(ext);
 
-	myerror("%s: Unknown end line, adding to end of file", fname);
+	len = strlen(fname);
+	if (len > extlen && !strcmp(fname + len - extlen, LOGFILE_EXTENSION))
+		len -= extlen;
+	retval = allocstr("%.*s%s", (int)len, fname, ext);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
 
-	return seek_to_eof(fp, fname);
+	return retval;
 }
 
 /*
- * check_last_log_line() - Check that the last line of the logfile is ok, it 
- * should be identical to "</suuids>\n".
- *
- * If it isn't, return with value from unknown_end_line(). If it was ok, seek 
- * to the correct position and return fp.
+ * logreader_init() - Prepare `r` for reading the XML log file from `fp` with 
+ * read_log_line(). Returns nothing.
  */
 
-FILE *check_last_log_line(FILE *fp, const char *fname)
+void logreader_init(struct Logreader *r, FILE *fp)
 {
-	long filepos;
-	char check_line[12];
-
+	assert(r);
 	assert(fp);
-	assert(fname);
 
-	if (fseek(fp, -10L, SEEK_END) == -1) {
-		myerror("%s: Could not seek in log file", fname); /* gncov */
-		return NULL; /* gncov */
-	}
-	filepos = ftell(fp);
-	if (filepos == -1L) {
-		myerror("%s: Cannot get file position of" /* gncov */
-		        " end line", fname);
-		return NULL; /* gncov */
+	r->fp = fp;
+	r->line = NULL;
+	r->size = 0;
+	r->lineno = 0;
+	r->trailer = false;
+	r->pending = false;
+}
+
+/*
+ * logreader_free() - Deallocate the line buffer in `r`. The stream isn't 
+ * closed. Returns nothing.
+ */
+
+void logreader_free(struct Logreader *r)
+{
+	assert(r);
+
+	free(r->line);
+	r->line = NULL;
+	r->size = 0;
+}
+
+/*
+ * read_log_line() - Read the next line without the newline from the XML log 
+ * file in `r` and store a pointer to it in `*dest`, or NULL at the end of the 
+ * file. The standard header at the start of the file and "</suuids>" on the 
+ * last line are skipped, all other lines are delivered. The line is valid 
+ * until the next call. Returns 0 if ok, or 1 if error.
+ */
+
+int read_log_line(struct Logreader *r, const char **dest)
+{
+	static const char *hdr[] = {
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>",
+		"<!DOCTYPE suuids SYSTEM \"dtd/suuids.dtd\">",
+		"<suuids>"
+	};
+	ssize_t res;
+
+	assert(r);
+	assert(dest);
+
+	*dest = NULL;
+	if (r->pending) {
+		r->pending = false;
+		if (strcmp(r->line, "</suuids>")) {
+			*dest = r->line;
+			return 0;
+		}
+		r->trailer = true;
 	}
-	if (!fgets(check_line, 10, fp)) {
-		myerror("Error when reading end line from log" /* gncov */
-		        " file \"%s\"", fname);
-		return NULL; /* gncov */
+	while ((res = getline(&r->line, &r->size, r->fp)) != -1) {
+		if (res && r->line[res - 1] == '\n')
+			r->line[res - 1] = '\0';
+		if (r->lineno < 3 && !strcmp(r->line, hdr[r->lineno])) {
+			r->lineno++;
+			continue;
+		}
+		r->lineno = 3;
+		if (r->trailer) {
+			/*
+			 * "</suuids>" wasn't the last line, keep it and 
+			 * deliver the current line on the next call.
+			 */
+			r->trailer = false;
+			r->pending = true;
+			*dest = "</suuids>";
+			return 0;
+		}
+		if (!strcmp(r->line, "</suuids>")) {
+			r->trailer = true;
+			continue;
+		}
+		*dest = r->line;
+		return 0;
 	}
-	if (strcmp(check_line, "</suuids>"))
-		return unknown_end_line(fp, fname);
-	if (fseek(fp, filepos, SEEK_SET) == -1) {
-		myerror("%s: Cannot seek to position %lu", /* gncov */
-		        fname, filepos);
-		return NULL; /* gncov */
+	if (ferror(r->fp)) {
+		myerror("Error when reading log file"); /* gncov */
+		return 1; /* gncov */
 	}
+	errno = 0;
 
-	return fp;
+	return 0;
 }
 
 /*
- * seek_to_entry_pos() - Check the size of the log file and call the 
- * appropriate function for setting the file position.
- *
- * Return NULL if error, otherwise return fp.
+ * for_each_log_line() - Read the XML log file from `fp` and call `func` with 
+ * `data` and every line delivered by read_log_line(). Returns 0 if ok, or 1 
+ * if `func` returns non-zero or anything else fails.
  */
 
-FILE *seek_to_entry_pos(FILE *fp, const char *fname)
+int for_each_log_line(FILE *fp, int (*func)(void *, const char *),
+                      void *data)
 {
-	long filepos;
+	struct Logreader r;
+	const char *line;
+	int retval = 1;
 
 	assert(fp);
-	assert(fname);
+	assert(func);
 
-	if (!seek_to_eof(fp, fname))
-		return NULL; /* gncov */
-	filepos = ftell(fp);
-	if (filepos == -1L) {
-		myerror("%s: Cannot get file position at EOF", /* gncov */
-		        fname);
-		return NULL; /* gncov */
-	}
-	if (filepos > 10L)
-		return check_last_log_line(fp, fname);
-	if (filepos == 0L)
-		return write_xml_header(fp);
+	logreader_init(&r, fp);
+	do {
+		if (read_log_line(&r, &line))
+			goto cleanup; /* gncov */
+		if (line && func(data, line))
+			goto cleanup;
+	} while (line);
+	retval = 0;
 
-	return unknown_end_line(fp, fname);
+cleanup:
+	logreader_free(&r);
+
+	return retval;
 }
 
 /*
- * open_logfile() - Open log file fname for read+write if it exists, or create 
- * it if it doesn't. Then lock it and give control to seek_to_entry_pos().
- *
- * Return FILE pointer to the opened stream, ready for writing. If anything 
- * fails, NULL is returned.
+ * line_ticks() - Return the timestamp of the UUID in the u attribute of the 
+ * log line `line`, or 0 if it doesn't have a v1 UUID.
  */
 
-FILE *open_logfile(const char *fname)
+utime_t line_ticks(const char *line)
 {
-	FILE *fp;
-
-	assert(fname);
-	assert(*fname);
+	const char *p;
 
-	/*
-	 * FIXME: Make the existence check/file creation atomic. See the log 
-	 * message for commit a0c635c3aba8 ("Get rid of create_logfile() and 
-	 * set_up_logfile(), move into open_logfile()", 2016-07-06) for more 
-	 * info. ... OK, because I feel generous today, here it is:
-	 *
-	 * Trying to get rid of a small race condition when the log file is 
-	 * created. In some situations it can create an extra header when two 
-	 * processes create the file at the same time. The creation isn't 
-	 * atomic, there's a small gap between the existence check and when 
-	 * it's opened and locked. It's hard to reproduce, and it's maybe a 
-	 * non-problem because it only happens when the file is created and 
-	 * lots of processes are hammering on it, that's an unlikely scenario. 
-	 * Nevertheless, I'll look into it because it's kind of annoying.
-	 */
+	assert(line);
 
-	if (access(fname, F_OK) != -1) {
-		/* File already exists */
-		fp = fopen(fname, "r+");
-		if (!fp) {
-			myerror("%s: Could not open file for read+write",
-			        fname);
-			return NULL;
-		}
-	} else {
-		/* File doesn't exist */
-		if (errno == ENOENT)
-			errno = 0; /* Set by access() */
-		check_errno;
-		fp = fopen(fname, "a");
-		if (!fp) {
-			myerror("%s: Could not create log file", fname);
-			return NULL;
-		}
-	}
-	if (!lock_file(fp, fname))
-		return NULL; /* gncov */
+	p = strstr(line, " u=\"");
+	if (!p || !valid_uuid(p + 4, false))
+		return 0;
 
-	return seek_to_entry_pos(fp, fname);
+	return uuid_ticks(p + 4);
 }
 
 /*
- * add_to_logfile() - Add the contents of *entry to the logfile stream. Returns 
- * 0 if ok or 1 if any errors.
+ * elapsed_ns() - Return the number of nanoseconds since `start`, measured with 
+ * CLOCK_MONOTONIC.
  */
 
-int add_to_logfile(FILE *fp, const struct Entry *entry, const bool raw)
+static long long elapsed_ns(const struct timespec *start)
 {
-	char *ap;
-	int retval = 0;
-
-	assert(fp);
-	assert(entry);
-	assert(raw == false || raw == true);
+	struct timespec now;
 
-	ap = xml_entry(entry, raw);
-	if (!ap)
-		return 1; /* gncov */
-	if (fputs(ap, fp) < 0)
-		retval = 1; /* gncov */
-	if (fputc('\n', fp) == EOF)
-		retval = 1; /* gncov */
-	if (retval) {
-		myerror("%s(): Cannot write to the log file", /* gncov */
-		        __func__);
-	}
+	assert(start);
 
-	free(ap);
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	return retval;
+	return (long long)(now.tv_sec - start->tv_sec) * 1000000000LL
+	       + (now.tv_nsec - start->tv_nsec);
 }
 
 /*
- * close_logfile() - Do the finishing changes on FILE stream fp, add end tag 
- * and close the stream. Return 0 if no errors, if any errors were detected, 
- * return 1.
+ * lock_backoff() - Used by lock_fd() when the lock on `fd` is busy and there 
+ * is a timeout. Retry flock() with LOCK_NB until it succeeds or `timeout` 
+ * milliseconds have passed since `start`. The wait between the attempts 
+ * starts at LOCK_BACKOFF_MIN microseconds and is doubled every time up to 
+ * LOCK_BACKOFF_MAX, and a random jitter of up to half the wait is subtracted 
+ * from it, so processes that wait for the same lock don't retry in lockstep. 
+ * The jitter comes from rand_r() with a seed from the pid and `start`, so it 
+ * doesn't touch the random() state the UUIDs are made from, and it's safe 
+ * to call from the writer thread. Returns 0 if the lock was taken, or -1 if 
+ * error or timeout, errno is EWOULDBLOCK after a timeout.
  */
 
-int close_logfile(FILE *fp)
+static int lock_backoff(const int fd, const struct timespec *start,
+                        const long timeout)
 {
-	int retval = 0;
+	long delay = LOCK_BACKOFF_MIN;
+	unsigned int seed;
+
+	assert(fd != -1);
+	assert(start);
+	assert(timeout >= 0);
+
+	seed = (unsigned int)getpid() ^ (unsigned int)start->tv_nsec;
+	for (;;) {
+		long long left = timeout * 1000LL - elapsed_ns(start) / 1000;
+		long usec = delay - rand_r(&seed) % (delay / 2 + 1);
+		struct timespec ts;
+
+		if (left <= 0) {
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+		if (usec > left)
+			usec = (long)left;
+		ts.tv_sec = usec / 1000000;
+		ts.tv_nsec = usec % 1000000 * 1000;
+		nanosleep(&ts, NULL);
+		if (!flock(fd, LOCK_EX | LOCK_NB))
+			return 0;
+		if (errno != EWOULDBLOCK && errno != EINTR)
+			return -1; /* gncov */
+		delay *= 2;
+		if (delay > LOCK_BACKOFF_MAX)
+			delay = LOCK_BACKOFF_MAX;
+	}
+}
 
-	assert(fp);
+/*
+ * lock_fd() - Get an exclusive lock on the file descriptor `fd` that belongs 
+ * to the file `fname`. If `ls` is NULL or `ls->timeout` is negative, wait 
+ * until the lock is available, otherwise give up after `ls->timeout` 
+ * milliseconds. If `ls` isn't NULL, the lock and the time spent waiting for 
+ * it are counted in `ls`. Returns 0 if ok, or 1 if error or timeout.
+ */
+
+int lock_fd(const int fd, const char *fname, struct Lockstat *ls)
+{
+	struct timespec start;
+	long long ns;
+	int res;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(*fname);
+
+	if (!flock(fd, LOCK_EX | LOCK_NB)) {
+		if (ls)
+			ls->locks++;
+		return 0;
+	}
+	if (errno != EWOULDBLOCK) {
+		myerror("Could not lock file \"%s\"", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	errno = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (ls && ls->timeout >= 0) {
+		res = lock_backoff(fd, &start, ls->timeout);
+	} else {
+		do {
+			res = flock(fd, LOCK_EX);
+		} while (res == -1 && errno == EINTR);
+	}
+	ns = elapsed_ns(&start);
+	if (ls) {
+		ls->waits++;
+		ls->wait_ns += ns;
+		if (ns > ls->max_ns)
+			ls->max_ns = ns;
+	}
+	if (res == -1) {
+		if (errno == EWOULDBLOCK) {
+			errno = 0;
+			myerror("%s: Timed out after %ld ms waiting for the"
+			        " lock", fname, ls->timeout);
+		} else {
+			myerror("Could not lock file \"%s\"", /* gncov */
+			        fname);
+		}
+		return 1;
+	}
+	if (ls)
+		ls->locks++;
+
+	return 0;
+}
+
+/*
+ * write_xml_header() - Write the initial log file header to the log file 
+ * stream.
+ *
+ * Return fp if success, NULL if FUBAR.
+ */
+
+FILE *write_xml_header(FILE *fp)
+{
+	assert(fp);
+
+	if (fputs(LOGFILE_HEADER, fp) == EOF) {
+		myerror("Cannot write header to the log file"); /* gncov */
+		return NULL; /* gncov */
+	}
+
+	return fp;
+}
+
+/*
+ * trim_null_bytes() - Truncate the log file `fd` with the name `fname` and 
+ * size `*size` at the first null byte, and store the new size in `*size`. 
+ * Null bytes are left by an mmap mode writer that didn't finish, and pages 
+ * can be written back out of order, so there may be text after a hole. The 
+ * valid part of the file ends at the first null byte, and the file is 
+ * scanned from the beginning to find it. This only happens when the file 
+ * ends with a null byte. Returns 0 if ok, or 1 if error.
+ */
+
+static int trim_null_bytes(const int fd, const char *fname, off_t *size)
+{
+	char buf[LOGFILE_TAIL_SIZE];
+	off_t end, pos;
+	const char *p = NULL;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(size);
+
+	end = *size;
+	for (pos = 0; pos < end; pos += (off_t)sizeof(buf)) {
+		size_t len = sizeof(buf);
+
+		if (end - pos < (off_t)len)
+			len = (size_t)(end - pos);
+		if (pread(fd, buf, len, pos) != (ssize_t)len) {
+			myerror("%s: Cannot read from file", /* gncov */
+			        fname);
+			return 1; /* gncov */
+		}
+		p = memchr(buf, '\0', len);
+		if (p)
+			break;
+	}
+	if (!p)
+		return 0; /* gncov */
+	pos += p - buf;
+
+	if (ftruncate(fd, pos) == -1) {
+		myerror("%s: Cannot truncate file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	myerror("%s: Removed %lld bytes from the first null byte to the end of"
+	        " the file", fname, (long long)(end - pos));
+	*size = pos;
+
+	return 0;
+}
+
+/*
+ * read_tail() - Read the last part of the log file `fd` with size `size` into 
+ * `buf`, which has room for LOGFILE_TAIL_SIZE bytes. Returns the number of 
+ * bytes read, or 0 if error.
+ */
+
+static size_t read_tail(const int fd, const char *fname, const off_t size,
+                        char *buf)
+{
+	size_t len;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(size > 0);
+	assert(buf);
+
+	len = size < LOGFILE_TAIL_SIZE ? (size_t)size : LOGFILE_TAIL_SIZE;
+	if (pread(fd, buf, len, size - (off_t)len) != (ssize_t)len) {
+		myerror("%s: Cannot read from file", fname); /* gncov */
+		return 0; /* gncov */
+	}
+
+	return len;
+}
+
+/*
+ * has_trailer() - Return true if the `len` bytes in `buf` end with the 
+ * "</suuids>" trailer, otherwise false.
+ */
+
+static bool has_trailer(const char *buf, const size_t len)
+{
+	const size_t tlen = strlen(LOGFILE_TRAILER);
+
+	assert(buf);
+
+	return len >= tlen && !memcmp(buf + len - tlen, LOGFILE_TRAILER, tlen);
+}
+
+/*
+ * is_append_log() - Return true if the log file with size `size`, where `buf` 
+ * contains the last `len` bytes, is used in append mode, i.e., it has only 
+ * the header or ends with a complete entry and no trailer. XML mode creates 
+ * the file with the trailer and always keeps it there, so the trailer is 
+ * only missing when append mode has removed it. Otherwise return false.
+ */
+
+static bool is_append_log(const char *buf, const size_t len, const off_t size)
+{
+	const char *end = "</suuid>\n";
+	const size_t elen = strlen(end);
+
+	assert(buf);
+
+	if ((size_t)size == strlen(LOGFILE_HEADER))
+		return !memcmp(buf, LOGFILE_HEADER, len);
+
+	return len >= elen && !memcmp(buf + len - elen, end, elen);
+}
+
+/*
+ * find_line_start() - Find the start of the last line in the log file `fd` 
+ * with the name `fname` and size `size`. `buf` contains the last `len` bytes 
+ * of the file and is reused when the line is longer than that. The offset of 
+ * the line is stored in `*start`, or 0 if the file has no newline, and the 
+ * first character of the line is stored in `*first`. Returns 0 if ok, or 1 
+ * if error.
+ */
+
+static int find_line_start(const int fd, const char *fname, const off_t size,
+                           char *buf, size_t len, off_t *start, char *first)
+{
+	off_t pos = size - (off_t)len;
+	size_t i;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(buf);
+	assert(len);
+	assert(start);
+	assert(first);
+
+	*first = buf[0];
+	for (;;) {
+		for (i = len; i && buf[i - 1] != '\n'; i--);
+		if (i) {
+			*start = pos + (off_t)i;
+			if (i < len)
+				*first = buf[i];
+			return 0;
+		}
+		if (!pos)
+			break;
+		*first = buf[0];
+		len = LOGFILE_TAIL_SIZE;
+		if (pos < (off_t)len)
+			len = (size_t)pos;
+		pos -= (off_t)len;
+		if (pread(fd, buf, len, pos) != (ssize_t)len) {
+			myerror("%s: Cannot read from file", /* gncov */
+			        fname);
+			return 1; /* gncov */
+		}
+	}
+	*start = 0;
+
+	return 0;
+}
+
+/*
+ * find_entry_pos() - Find the file position in the locked log file `fd` with 
+ * the name `fname` where the next entry is written, and store it in `*pos`. 
+ * `*pos` contains the file size when the function is called. Only the last 
+ * LOGFILE_TAIL_SIZE bytes are read, with a single pread() unless there are 
+ * null bytes from an unfinished mmap mode writer or the file ends with a 
+ * partial line. If the partial line starts with '<', it's an entry or 
+ * trailer that was torn by a writer that crashed, and it's removed, however 
+ * long it is. If the file is used in append mode, see is_append_log(), an 
+ * error is printed, since entries written by XML mode would be followed by 
+ * a trailer that the append mode writers don't know about. This isn't done 
+ * after null bytes are removed, then the entries are from the unfinished 
+ * mmap mode writer. If the last line is complete but isn't the trailer, a 
+ * warning is printed and the entries are added to the end of the file. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int find_entry_pos(const int fd, const char *fname, off_t *pos)
+{
+	char buf[LOGFILE_TAIL_SIZE];
+	off_t size, start;
+	size_t len;
+	char first;
+	bool trimmed = false;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(pos);
+
+	size = *pos;
+	if (!size)
+		return 0;
+	len = read_tail(fd, fname, size, buf);
+	if (!len)
+		return 1; /* gncov */
+	if (!buf[len - 1]) {
+		trimmed = true;
+		if (trim_null_bytes(fd, fname, &size))
+			return 1; /* gncov */
+		*pos = size;
+		if (!size)
+			return 0;
+		len = read_tail(fd, fname, size, buf);
+		if (!len)
+			return 1; /* gncov */
+	}
+
+	if (has_trailer(buf, len)) {
+		*pos = size - (off_t)strlen(LOGFILE_TRAILER);
+		return 0;
+	}
+	if (!trimmed && is_append_log(buf, len, size)) {
+		myerror("%s: No </suuids> at the end, the log file is used"
+		        " in append mode", fname);
+		return 1;
+	}
+	if ((size_t)size == strlen(LOGFILE_HEADER)
+	    && !memcmp(buf, LOGFILE_HEADER, len))
+		return 0; /* The mmap mode writer had no entries */
+	if (buf[len - 1] != '\n') {
+		if (find_line_start(fd, fname, size, buf, len, &start, &first))
+			return 1; /* gncov */
+		if (start && first == '<') {
+			if (ftruncate(fd, start) == -1) {
+				myerror("%s: Cannot truncate file", /* gncov */
+				        fname);
+				return 1; /* gncov */
+			}
+			myerror("%s: Removed %lld bytes of an incomplete entry"
+			        " from the end of the file", fname,
+			        (long long)(size - start));
+			*pos = start;
+			len = read_tail(fd, fname, start, buf);
+			if (!len)
+				return 1; /* gncov */
+			if (has_trailer(buf, len))
+				*pos -= (off_t)strlen(LOGFILE_TRAILER);
+			return 0;
+		}
+	}
+	myerror("%s: Unknown end line, adding to end of file", fname);
+	*pos = size;
+
+	return 0;
+}
+
+/*
+ * create_logfile() - Create the log file `fname` with the XML header, and 
+ * with the "</suuids>" trailer if `trailer` is true. The contents are written 
+ * to a temporary file in the same directory which is then hard linked into 
+ * place, so no other process can see the file without a header, also in 
+ * append mode where there is no lock to protect it. XML mode creates the 
+ * file with the trailer, so a file with only the header is always an append 
+ * mode log file. If another process created the file in the meantime, that's 
+ * ok. Returns 0 if ok, or 1 if error.
+ */
+
+static int create_logfile(const char *fname, const bool trailer)
+{
+	char *tmpname;
+	int fd, retval = 0;
+	const char *txt = trailer ? LOGFILE_HEADER LOGFILE_TRAILER
+	                          : LOGFILE_HEADER;
+	const size_t len = strlen(txt);
+	mode_t mask;
+
+	assert(fname);
+	assert(*fname);
+
+	tmpname = allocstr("%s.XXXXXX", fname);
+	if (!tmpname) {
+		failed("allocstr()"); /* gncov */
+		return 1; /* gncov */
+	}
+	fd = mkstemp(tmpname);
+	if (fd == -1) {
+		myerror("%s: Could not create log file", fname);
+		free(tmpname);
+		return 1;
+	}
+
+	/*
+	 * mkstemp() creates the file with mode 0600, use the same permissions 
+	 * as a log file created by open() with mode 0666.
+	 */
+	mask = umask(0);
+	umask(mask);
+	if (fchmod(fd, 0666 & ~mask) == -1
+	    || write(fd, txt, len) != (ssize_t)len) {
+		myerror("%s: Cannot write header to the log file", /* gncov */
+		        tmpname);
+		retval = 1; /* gncov */
+	}
+	if (close(fd) == -1)
+		retval = 1; /* gncov */
+	if (!retval && link(tmpname, fname) == -1) {
+		if (errno == EEXIST) {
+			errno = 0; /* Created by another process */
+		} else {
+			myerror("%s: Could not create log file", /* gncov */
+			        fname);
+			retval = 1; /* gncov */
+		}
+	}
+	if (remove(tmpname) == -1) {
+		myerror("Warning: Could not remove temporary" /* gncov */
+		        " file \"%s\"", tmpname);
+	}
+	free(tmpname);
+
+	return retval;
+}
+
+/*
+ * open_xml_logfile() - Open the log file `fname` for read+write, or create it 
+ * with the XML header if it doesn't exist. Then lock it with the timeout and 
+ * statistics in `ls`, recover the end of the file if a writer crashed and set 
+ * the file position to where the next entry is written.
+ *
+ * Return FILE pointer to the opened stream, ready for writing. If anything 
+ * fails, NULL is returned.
+ */
+
+FILE *open_xml_logfile(const char *fname, struct Lockstat *ls)
+{
+	struct stat sb;
+	off_t pos;
+	FILE *fp;
+	int fd;
+
+	assert(fname);
+	assert(*fname);
+
+	fd = open(fname, O_RDWR);
+	if (fd == -1 && errno == ENOENT) {
+		errno = 0;
+		if (create_logfile(fname, true))
+			return NULL;
+		fd = open(fname, O_RDWR);
+	}
+	if (fd == -1) {
+		myerror("%s: Could not open file for read+write", fname);
+		return NULL;
+	}
+	if (lock_fd(fd, fname, ls)) {
+		close(fd);
+		return NULL;
+	}
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", fname); /* gncov */
+		close(fd); /* gncov */
+		return NULL; /* gncov */
+	}
+	pos = sb.st_size;
+	if (find_entry_pos(fd, fname, &pos)) {
+		close(fd); /* gncov */
+		return NULL; /* gncov */
+	}
+	fp = fdopen(fd, "r+");
+	if (!fp) {
+		myerror("%s: Cannot open stream", fname); /* gncov */
+		close(fd); /* gncov */
+		return NULL; /* gncov */
+	}
+	if (fseeko(fp, pos, SEEK_SET) == -1) {
+		myerror("%s: Cannot seek to position %lld", /* gncov */
+		        fname, (long long)pos);
+		fclose(fp); /* gncov */
+		return NULL; /* gncov */
+	}
+	if (!pos && !write_xml_header(fp)) {
+		fclose(fp); /* gncov */
+		return NULL; /* gncov */
+	}
+
+	return fp;
+}
+
+/*
+ * check_trailer() - Store the size of the log file `fd` with the name `fname` 
+ * in `*size` and check if the file ends with the "</suuids>" trailer. Returns 
+ * 1 if it does, 0 if not, or -1 if error.
+ */
+
+static int check_trailer(const int fd, const char *fname, off_t *size)
+{
+	char buf[LOGFILE_TAIL_SIZE];
+	struct stat sb;
+	size_t len;
+
+	assert(fd != -1);
+	assert(fname);
+	assert(size);
+
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", fname); /* gncov */
+		return -1; /* gncov */
+	}
+	*size = sb.st_size;
+	if (!*size)
+		return 0;
+	len = read_tail(fd, fname, *size, buf);
+	if (!len)
+		return -1; /* gncov */
+
+	return has_trailer(buf, len);
+}
+
+/*
+ * remove_trailer() - Remove the "</suuids>" trailer from the end of the log 
+ * file `fd` with the name `fname`, left there by an XML mode writer, so 
+ * append mode doesn't add entries after it. After this, XML mode refuses to 
+ * write to the file, see find_entry_pos(), so the trailer can't come back 
+ * while append mode writers use it. The file is only locked, with the 
+ * timeout and statistics in `ls`, if the trailer is found, and it's checked 
+ * again under the lock since another writer may have moved it. Returns 0 if 
+ * ok, or 1 if error.
+ */
+
+static int remove_trailer(const int fd, const char *fname, struct Lockstat *ls)
+{
+	off_t size;
+	int res;
+
+	assert(fd != -1);
+	assert(fname);
+
+	res = check_trailer(fd, fname, &size);
+	if (res != 1)
+		return res == -1;
+	if (lock_fd(fd, fname, ls))
+		return 1;
+	res = check_trailer(fd, fname, &size);
+	if (res == 1
+	    && ftruncate(fd, size - (off_t)strlen(LOGFILE_TRAILER)) == -1) {
+		myerror("%s: Cannot truncate file", fname); /* gncov */
+		res = -1; /* gncov */
+	}
+	flock(fd, LOCK_UN);
+
+	return res == -1;
+}
+
+/*
+ * open_append_logfile() - Open log file `fname` in append mode, create it with 
+ * a header if it doesn't exist. The file is opened with O_APPEND and every 
+ * entry is added with a single write(). The closing "</suuids>" is never 
+ * written, and if the file ends with it, it's removed first under a short 
+ * lock with the timeout and statistics in `ls`. Otherwise the file is never 
+ * locked or seeked in. Returns the file descriptor, or -1 if anything failed.
+ */
+
+int open_append_logfile(const char *fname, struct Lockstat *ls)
+{
+	int fd;
+
+	assert(fname);
+	assert(*fname);
+
+	fd = open(fname, O_RDWR | O_APPEND);
+	if (fd == -1 && errno == ENOENT) {
+		errno = 0;
+		if (create_logfile(fname, false))
+			return -1;
+		fd = open(fname, O_RDWR | O_APPEND);
+	}
+	if (fd == -1) {
+		myerror("%s: Could not open file for appending", fname);
+		return -1;
+	}
+	if (remove_trailer(fd, fname, ls)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * parse_logmode() - Return the log mode with the name `s`, or LOGMODE_ERROR if 
+ * the name is unknown.
+ */
+
+enum logmode parse_logmode(const char *s)
+{
+	assert(s);
+
+	if (!strcmp(s, "xml"))
+		return LOGMODE_XML;
+	if (!strcmp(s, "append"))
+		return LOGMODE_APPEND;
+	if (!strcmp(s, "mmap"))
+		return LOGMODE_MMAP;
+	if (!strcmp(s, "uring"))
+		return LOGMODE_URING;
+
+	return LOGMODE_ERROR;
+}
+
+/*
+ * get_logmode() - Return the log mode to use. The value from --logmode is used 
+ * if it's defined, otherwise the "logmode" keyword from the rc file. If none 
+ * of them are defined, use LOGMODE_XML. Returns LOGMODE_ERROR if the name is 
+ * unknown.
+ */
+
+enum logmode get_logmode(const struct Rc *rc, const struct Options *opts)
+{
+	const char *p = "xml";
+	enum logmode retval;
+
+	assert(rc);
+	assert(opts);
+
+	if (opts->logmode)
+		p = opts->logmode;
+	else if (rc->logmode)
+		p = rc->logmode;
+
+	retval = parse_logmode(p);
+	if (retval == LOGMODE_ERROR)
+		myerror("\"%s\": Unknown log mode", p);
+
+	return retval;
+}
+
+/*
+ * parse_syncmode() - Return the sync mode with the name `s`, or SYNC_ERROR if 
+ * the name is unknown.
+ */
+
+enum syncmode parse_syncmode(const char *s)
+{
+	assert(s);
+
+	if (!strcmp(s, "none"))
+		return SYNC_NONE;
+	if (!strcmp(s, "close"))
+		return SYNC_CLOSE;
+	if (!strcmp(s, "batch"))
+		return SYNC_BATCH;
+
+	return SYNC_ERROR;
+}
+
+/*
+ * get_syncmode() - Return the sync mode to use. The value from --sync is used 
+ * if it's defined, otherwise the "sync" keyword from the rc file. If none of 
+ * them are defined, use SYNC_NONE. Returns SYNC_ERROR if the name is unknown.
+ */
+
+enum syncmode get_syncmode(const struct Rc *rc, const struct Options *opts)
+{
+	const char *p = "none";
+	enum syncmode retval;
+
+	assert(rc);
+	assert(opts);
+
+	if (opts->sync)
+		p = opts->sync;
+	else if (rc->sync)
+		p = rc->sync;
+
+	retval = parse_syncmode(p);
+	if (retval == SYNC_ERROR)
+		myerror("\"%s\": Unknown sync mode", p);
+
+	return retval;
+}
+
+/*
+ * write_xml_batch() - Used in XML mode. Lock the log file in `logs`, find the 
+ * position of the trailer again because other processes may have added 
+ * entries since the last batch, and write the batched entries followed by a 
+ * new trailer with one pwrite(). Batched JSON Lines entries are written while 
+ * the lock is held. The lock is released before the function returns, and 
+ * the batches are emptied also if something fails. Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+static int write_xml_batch(struct Logs *logs)
+{
+	const size_t hlen = strlen(LOGFILE_HEADER);
+	struct stat sb;
+	off_t pos;
+	int fd, retval = 1;
+
+	assert(logs);
+	assert(logs->logfp);
+
+	if (!logs->batched)
+		return 0;
+	fd = fileno(logs->logfp);
+	if (lock_fd(fd, logs->fname, &logs->lock))
+		goto cleanup;
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", logs->fname); /* gncov */
+		goto unlock; /* gncov */
+	}
+	pos = sb.st_size;
+	if (find_entry_pos(fd, logs->fname, &pos))
+		goto unlock; /* gncov */
+	if (!pos) {
+		if (write_all(fd, LOGFILE_HEADER, hlen, 0)) {
+			myerror("%s: Cannot write header to the" /* gncov */
+			        " log file", logs->fname);
+			goto unlock; /* gncov */
+		}
+		trace_count(log_writes, 1);
+		trace_count(log_bytes, hlen);
+		pos = (off_t)hlen;
+	}
+	if (!bb_append(&logs->batch, LOGFILE_TRAILER,
+	               strlen(LOGFILE_TRAILER))) {
+		failed("bb_append()"); /* gncov */
+		goto unlock; /* gncov */
+	}
+	if (write_all(fd, logs->batch.buf, logs->batch.len, pos)) {
+		myerror("%s: Cannot write to the log file", /* gncov */
+		        logs->fname);
+		goto unlock; /* gncov */
+	}
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, logs->batch.len);
+	if (logs->jsonbatch.len) {
+		if (lock_fd(logs->jsonfd, logs->jsonname, &logs->lock))
+			goto unlock; /* gncov */
+		if (write_all(logs->jsonfd, logs->jsonbatch.buf,
+		              logs->jsonbatch.len, -1)) {
+			myerror("%s: Cannot write to the log" /* gncov */
+			        " file", logs->jsonname);
+		} else {
+			trace_count(log_writes, 1);
+			trace_count(log_bytes, logs->jsonbatch.len);
+			retval = 0;
+		}
+		flock(logs->jsonfd, LOCK_UN);
+	} else {
+		retval = 0;
+	}
+
+unlock:
+	flock(fd, LOCK_UN);
+cleanup:
+	logs->batch.len = logs->jsonbatch.len = 0;
+	logs->batched = 0;
+
+	return retval;
+}
+
+/*
+ * batch_entry() - Used in XML mode. Add the XML entry `ap` and the JSON entry 
+ * `jp` (if it's not NULL) to the batches in `logs`, and write the batches 
+ * when they have LOG_BATCH_ENTRIES entries or at least LOG_BATCH_SIZE bytes. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int batch_entry(struct Logs *logs, const char *ap, const char *jp)
+{
+	assert(logs);
+	assert(ap);
+
+	if (!bb_append(&logs->batch, ap, strlen(ap))
+	    || !bb_append(&logs->batch, "\n", 1)
+	    || (jp && (!bb_append(&logs->jsonbatch, jp, strlen(jp))
+	               || !bb_append(&logs->jsonbatch, "\n", 1)))) {
+		failed("bb_append()"); /* gncov */
+		return 1; /* gncov */
+	}
+	if (++logs->batched >= LOG_BATCH_ENTRIES
+	    || logs->batch.len >= LOG_BATCH_SIZE)
+		return write_xml_batch(logs);
+
+	return 0;
+}
+
+/*
+ * sync_fd() - Used by sync_logs(). Write the file `fd` to disk with 
+ * fdatasync() if it's open. Returns 0 if ok or `fd` is -1, or 1 if error.
+ */
+
+static int sync_fd(const int fd)
+{
+	if (fd == -1)
+		return 0;
+
+	return fdatasync(fd) == -1;
+}
+
+/*
+ * sync_logs() - Write the batched entries and flush the streams in `logs`, 
+ * and write all open log files to disk with fdatasync(). Returns 0 if ok, or 
+ * 1 if error.
+ */
+
+static int sync_logs(struct Logs *logs)
+{
+	int retval = 0;
+
+	assert(logs);
+
+	if (logs->batched && write_xml_batch(logs))
+		retval = 1; /* gncov */
+	if (logs->logfp) {
+		if (fflush(logs->logfp) == EOF
+		    || sync_fd(fileno(logs->logfp)))
+			retval = 1; /* gncov */
+	}
+	if (logs->jsonfp) {
+		if (fflush(logs->jsonfp) == EOF
+		    || sync_fd(fileno(logs->jsonfp)))
+			retval = 1; /* gncov */
+	}
+	if (logs->map && msync(logs->map, logs->maplen, MS_SYNC) == -1)
+		retval = 1; /* gncov */
+	if (sync_fd(logs->mapfd))
+		retval = 1; /* gncov */
+	if (logs->ring.fd != -1) {
+		if (uring_fsync(&logs->ring))
+			retval = 1; /* gncov */
+	} else if (sync_fd(logs->ring.logfd)) {
+		retval = 1; /* gncov */
+	}
+	if (sync_fd(logs->fd))
+		retval = 1; /* gncov */
+	if (sync_fd(logs->jsonfd))
+		retval = 1; /* gncov */
+	if (sync_fd(logs->bin.recfd))
+		retval = 1; /* gncov */
+	if (sync_fd(logs->bin.heapfd))
+		retval = 1; /* gncov */
+	if (retval)
+		myerror("Cannot write the log files to disk"); /* gncov */
+	logs->unsynced = 0;
+	logs->syncs++;
+	clock_gettime(CLOCK_MONOTONIC, &logs->lastsync);
+
+	return retval;
+}
+
+/*
+ * batch_sync() - Used by add_to_logfile() in batch sync mode. Sync the log 
+ * files in `logs` if SYNC_BATCH_ENTRIES entries have been written or 
+ * SYNC_BATCH_MSEC milliseconds have passed since the last sync. Returns 0 if 
+ * ok, or 1 if error.
+ */
+
+static int batch_sync(struct Logs *logs)
+{
+	struct timespec now;
+	long long msec;
+
+	assert(logs);
+
+	if (++logs->unsynced >= SYNC_BATCH_ENTRIES)
+		return sync_logs(logs);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	msec = (long long)(now.tv_sec - logs->lastsync.tv_sec) * 1000
+	       + (now.tv_nsec - logs->lastsync.tv_nsec) / 1000000;
+	if (msec >= SYNC_BATCH_MSEC)
+		return sync_logs(logs); /* gncov */
+
+	return 0;
+}
+
+/*
+ * open_jsonl_logfile() - Open the JSON Lines log file `fname` in `logs` for 
+ * appending, create it if it doesn't exist. The file has no header or 
+ * trailer. In append mode and XML mode it's opened with O_APPEND and not 
+ * locked, in XML mode it's locked while a batch is written. In the other 
+ * modes it's locked like the XML log file. Returns 0 if ok, or 1 if error.
+ */
+
+int open_jsonl_logfile(struct Logs *logs, const char *fname)
+{
+	assert(logs);
+	assert(fname);
+	assert(*fname);
+
+	if (logs->mode == LOGMODE_APPEND || logs->mode == LOGMODE_XML) {
+		logs->jsonfd = open(fname, O_WRONLY | O_APPEND | O_CREAT,
+		                    0666);
+		if (logs->jsonfd == -1) {
+			myerror("%s: Could not open file for appending",
+			        fname);
+			return 1;
+		}
+		return 0;
+	}
+
+	logs->jsonfp = fopen(fname, "a");
+	if (!logs->jsonfp) {
+		myerror("%s: Could not open file for appending", fname);
+		return 1;
+	}
+	if (lock_fd(fileno(logs->jsonfp), fname, &logs->lock)) {
+		fclose(logs->jsonfp); /* gncov */
+		logs->jsonfp = NULL; /* gncov */
+		return 1; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * map_extent() - Used in mmap mode. Map the part of the log file in `logs` 
+ * that starts at the page with the next entry, with room for at least `need` 
+ * more bytes. The file is extended with posix_fallocate() in steps of 
+ * MMAP_EXTENT bytes, the new part is filled with null bytes. Returns 0 if ok, 
+ * or 1 if error.
+ */
+
+static int map_extent(struct Logs *logs, const size_t need)
+{
+	const off_t pagesize = (off_t)sysconf(_SC_PAGESIZE);
+	size_t len = MMAP_EXTENT;
+	void *p;
+	int res;
+
+	assert(logs);
+	assert(logs->mapfd != -1);
+
+	if (logs->map && munmap(logs->map, logs->maplen) == -1) {
+		myerror("Cannot unmap the log file"); /* gncov */
+		return 1; /* gncov */
+	}
+	logs->map = NULL;
+	logs->mapbase = logs->mappos - logs->mappos % pagesize;
+	while ((size_t)(logs->mappos - logs->mapbase) + need > len)
+		len += MMAP_EXTENT;
+
+	res = posix_fallocate(logs->mapfd, logs->mapbase, (off_t)len);
+	if (res) {
+		errno = res; /* gncov */
+		myerror("Cannot allocate space in the log file"); /* gncov */
+		return 1; /* gncov */
+	}
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, logs->mapfd,
+	         logs->mapbase);
+	if (p == MAP_FAILED) {
+		myerror("Cannot map the log file into memory"); /* gncov */
+		return 1; /* gncov */
+	}
+	logs->map = p;
+	logs->maplen = len;
+
+	return 0;
+}
+
+/*
+ * open_mmap_logfile() - Used in mmap mode after the XML log file `fname` is 
+ * opened, locked and positioned by open_xml_logfile(). Remove the 
+ * "</suuids>" trailer and map the end of the file. Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+static int open_mmap_logfile(struct Logs *logs, const char *fname)
+{
+	assert(logs);
+	assert(logs->logfp);
+	assert(fname);
+
+	if (fflush(logs->logfp) == EOF) {
+		myerror("%s: Cannot write to the log file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	logs->mappos = ftello(logs->logfp);
+	if (logs->mappos == -1) {
+		myerror("%s: Cannot get file position", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	/*
+	 * The mapping gets its own file descriptor, so the stream isn't 
+	 * affected by it. The lock on the stream protects both of them.
+	 */
+	logs->mapfd = dup(fileno(logs->logfp));
+	if (logs->mapfd == -1) {
+		myerror("%s: Cannot duplicate file descriptor", /* gncov */
+		        fname);
+		return 1; /* gncov */
+	}
+	if (ftruncate(logs->mapfd, logs->mappos) == -1) {
+		myerror("%s: Cannot truncate file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+
+	return map_extent(logs, 0);
+}
+
+/*
+ * mmap_entry() - Copy the log entry `s` followed by a newline into the mapped 
+ * log file in `logs`, and map a new extent first if there isn't room for it. 
+ * Returns 0 if ok or 1 if any errors.
+ */
+
+static int mmap_entry(struct Logs *logs, const char *s)
+{
+	size_t len, off;
+
+	assert(logs);
+	assert(logs->map);
+	assert(s);
+
+	len = strlen(s);
+	off = (size_t)(logs->mappos - logs->mapbase);
+	if (off + len + 1 > logs->maplen) {
+		if (map_extent(logs, len + 1))
+			return 1; /* gncov */
+		off = (size_t)(logs->mappos - logs->mapbase);
+	}
+	memcpy(logs->map + off, s, len);
+	logs->map[off + len] = '\n';
+	logs->mappos += (off_t)len + 1;
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, len + 1);
+
+	return 0;
+}
+
+/*
+ * finish_mmap_logfile() - Unmap the log file in `logs`, add the "</suuids>" 
+ * trailer after the last entry and truncate the file to its real length. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int finish_mmap_logfile(struct Logs *logs)
+{
+	const size_t len = strlen(LOGFILE_TRAILER);
+	int retval = 0;
+
+	assert(logs);
+	assert(logs->map);
+
+	if (munmap(logs->map, logs->maplen) == -1)
+		retval = 1; /* gncov */
+	logs->map = NULL;
+	if (pwrite(logs->mapfd, LOGFILE_TRAILER, len, logs->mappos)
+	    != (ssize_t)len
+	    || ftruncate(logs->mapfd, logs->mappos + (off_t)len) == -1)
+		retval = 1; /* gncov */
+
+	return retval;
+}
+
+/*
+ * open_uring_logfile() - Used in uring mode after the XML log file `fname` is 
+ * opened, locked and positioned by open_xml_logfile(). Set up io_uring for 
+ * writing the entries from the current position, and remove the "</suuids>" 
+ * trailer. If io_uring can't be used, change to LOGMODE_XML and leave the 
+ * file as it is. Returns 0 if ok, or 1 if error.
+ */
+
+static int open_uring_logfile(struct Logs *logs, const char *fname)
+{
+	off_t pos;
+	int fd;
+
+	assert(logs);
+	assert(logs->logfp);
+	assert(fname);
+
+	if (fflush(logs->logfp) == EOF) {
+		myerror("%s: Cannot write to the log file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	pos = ftello(logs->logfp);
+	if (pos == -1) {
+		myerror("%s: Cannot get file position", fname); /* gncov */
+		return 1; /* gncov */
+	}
+	/*
+	 * io_uring gets its own file descriptor, so the stream isn't affected 
+	 * by it. The lock on the stream protects both of them.
+	 */
+	fd = dup(fileno(logs->logfp));
+	if (fd == -1) {
+		myerror("%s: Cannot duplicate file descriptor", /* gncov */
+		        fname);
+		return 1; /* gncov */
+	}
+	if (uring_setup(&logs->ring, fd, pos)) {
+		close(fd);
+		msg(1, "io_uring isn't available, using write()");
+		logs->mode = LOGMODE_XML;
+		return 0;
+	}
+	if (ftruncate(fd, pos) == -1) {
+		myerror("%s: Cannot truncate file", fname); /* gncov */
+		return 1; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * uring_entry() - Add the log entry `s` followed by a newline to the io_uring 
+ * write buffers in `logs`. Returns 0 if ok or 1 if any errors.
+ */
+
+static int uring_entry(struct Logs *logs, const char *s)
+{
+	assert(logs);
+	assert(s);
+
+	if (uring_write(&logs->ring, s, strlen(s))
+	    || uring_write(&logs->ring, "\n", 1))
+		return 1; /* gncov */
+
+	return 0;
+}
+
+/*
+ * finish_uring_logfile() - Wait for all io_uring writes in `logs` to complete 
+ * and shut down io_uring. Add the "</suuids>" trailer after the last entry. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int finish_uring_logfile(struct Logs *logs)
+{
+	const size_t len = strlen(LOGFILE_TRAILER);
+	struct Uring *u = &logs->ring;
+	int retval = 0;
+
+	assert(logs);
+	assert(u->fd != -1);
+
+	if (uring_finish(u))
+		retval = 1; /* gncov */
+	msg(2, "Submitted %lu write%s with io_uring", u->writes,
+	       u->writes == 1 ? "" : "s");
+	uring_free(u);
+	if (pwrite(u->logfd, LOGFILE_TRAILER, len, u->pos) != (ssize_t)len)
+		retval = 1; /* gncov */
+
+	return retval;
+}
+
+/*
+ * unlock_xml_logfile() - Used in XML mode after the log file is opened and 
+ * positioned by open_xml_logfile(). Make sure the file ends with the trailer 
+ * and release the lock, the entries are written in locked batches by 
+ * write_xml_batch(). Returns 0 if ok, or 1 if error.
+ */
+
+static int unlock_xml_logfile(struct Logs *logs)
+{
+	assert(logs);
+	assert(logs->logfp);
+
+	if (fputs(LOGFILE_TRAILER, logs->logfp) == EOF
+	    || fflush(logs->logfp) == EOF) {
+		myerror("%s: Cannot write to the log file", /* gncov */
+		        logs->fname);
+		return 1; /* gncov */
+	}
+	flock(fileno(logs->logfp), LOCK_UN);
+
+	return 0;
+}
+
+/*
+ * open_logfile() - Open the log file `fname` using the log mode in 
+ * `logs->mode` and store the stream or file descriptor in `logs`. If 
+ * `jsonname` isn't NULL, also open the JSON Lines log file with that name. If 
+ * `binprefix` isn't NULL, open the binary log with that file name prefix. The 
+ * binary log is always locked, also in append mode. Returns 0 if the log 
+ * files are ready for writing, or 1 if anything failed.
+ */
+
+int open_logfile(struct Logs *logs, const char *fname, const char *jsonname,
+                 const char *binprefix)
+{
+	assert(logs);
+	assert(fname);
+	assert(*fname);
+
+	logs->fname = fname;
+	logs->jsonname = jsonname;
+	logs->logfp = NULL;
+	logs->jsonfp = NULL;
+	logs->fd = -1;
+	logs->jsonfd = -1;
+	logs->mapfd = -1;
+	logs->map = NULL;
+	uring_init(&logs->ring);
+	binbuf_init(&logs->batch);
+	binbuf_init(&logs->jsonbatch);
+	logs->batched = 0;
+	logs->lock.locks = logs->lock.waits = 0;
+	logs->lock.wait_ns = logs->lock.max_ns = 0;
+	logs->unsynced = logs->syncs = 0;
+	clock_gettime(CLOCK_MONOTONIC, &logs->lastsync);
+	binlog_init(&logs->bin);
+	logs->writer.running = false;
+
+	if (logs->mode == LOGMODE_APPEND) {
+		logs->fd = open_append_logfile(fname, &logs->lock);
+		if (logs->fd == -1)
+			return 1;
+	} else {
+		logs->logfp = open_xml_logfile(fname, &logs->lock);
+		if (!logs->logfp)
+			return 1;
+		if (logs->mode == LOGMODE_MMAP
+		    && open_mmap_logfile(logs, fname))
+			return 1; /* gncov */
+		if (logs->mode == LOGMODE_URING
+		    && open_uring_logfile(logs, fname))
+			return 1; /* gncov */
+		if (logs->mode == LOGMODE_XML && unlock_xml_logfile(logs))
+			return 1; /* gncov */
+	}
+
+	if (jsonname && open_jsonl_logfile(logs, jsonname))
+		return 1;
+	if (binprefix)
+		return binlog_open(&logs->bin, binprefix, &logs->lock);
+
+	return 0;
+}
+
+/*
+ * check_append_size() - Check that the log entry `s` is small enough to be 
+ * written with a single write() in append mode. Returns 0 if ok, or 1 if it's 
+ * too large.
+ */
+
+int check_append_size(const char *s)
+{
+	size_t len;
+
+	assert(s);
+
+	len = strlen(s);
+	if (len > APPEND_ATOMIC_MAX) {
+		myerror("Log entry is %zu bytes, append mode allows max %u"
+		        " bytes", len, APPEND_ATOMIC_MAX);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * append_entry() - Write the log entry `s` to the file descriptor `fd` with a 
+ * single write() call. The size of the entry can't exceed APPEND_ATOMIC_MAX, 
+ * otherwise the data could be mixed with entries from other processes. Returns 
+ * 0 if ok or 1 if any errors.
+ */
+
+int append_entry(const int fd, const char *s)
+{
+	size_t len;
+	ssize_t written;
+
+	assert(s);
+
+	if (check_append_size(s))
+		return 1;
+	len = strlen(s);
+	do {
+		written = write(fd, s, len);
+	} while (written == -1 && errno == EINTR);
+	if (written == -1 || (size_t)written != len) {
+		myerror("%s(): Cannot write to the log file", /* gncov */
+		        __func__);
+		return 1; /* gncov */
+	}
+	errno = 0;
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, len);
+
+	return 0;
+}
+
+/*
+ * write_entry() - Write the log entry `s` followed by a newline to the locked 
+ * stream `fp`. Returns 0 if ok or 1 if any errors.
+ */
+
+int write_entry(FILE *fp, const char *s)
+{
+	int retval = 0;
+
+	assert(fp);
+	assert(s);
+
+	if (fputs(s, fp) < 0)
+		retval = 1; /* gncov */
+	if (fputc('\n', fp) == EOF)
+		retval = 1; /* gncov */
+	if (retval) {
+		myerror("%s(): Cannot write to the log file", /* gncov */
+		        __func__);
+		return retval; /* gncov */
+	}
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, strlen(s) + 1);
+
+	return retval;
+}
+
+/*
+ * write_log_entry() - Write the XML entry `ap` to the log file in `logs`, and 
+ * the JSON entry `jp` to the JSON Lines log file if it isn't NULL. In append 
+ * mode, the size of both entries is checked before anything is written, so 
+ * the files don't get out of sync. In XML mode, the entries are batched and 
+ * written by write_xml_batch(). Called by the writer thread if it's running. 
+ * Returns 0 if ok or 1 if any errors.
+ */
 
-	if (fprintf(fp, "</suuids>\n") != 10)
+int write_log_entry(struct Logs *logs, const char *ap, const char *jp)
+{
+	int retval = 0;
+
+	assert(logs);
+	assert(ap);
+
+	if (logs->mode == LOGMODE_APPEND) {
+		char *line = allocstr("%s\n", ap);
+		char *jline = jp ? allocstr("%s\n", jp) : NULL;
+
+		if (!line || (jp && !jline)) {
+			failed("allocstr()"); /* gncov */
+			retval = 1; /* gncov */
+		} else if (check_append_size(line)
+		           || (jline && check_append_size(jline))) {
+			retval = 1;
+		} else {
+			retval = append_entry(logs->fd, line);
+			if (!retval && jline)
+				retval = append_entry(logs->jsonfd, jline);
+		}
+		free(jline);
+		free(line);
+	} else if (logs->mode == LOGMODE_XML) {
+		retval = batch_entry(logs, ap, jp);
+	} else {
+		assert(logs->logfp);
+		if (logs->mode == LOGMODE_MMAP)
+			retval = mmap_entry(logs, ap);
+		else
+			retval = uring_entry(logs, ap);
+		if (!retval && jp)
+			retval = write_entry(logs->jsonfp, jp);
+	}
+
+	if (!retval && logs->sync == SYNC_BATCH)
+		retval = batch_sync(logs);
+
+	return retval;
+}
+
+/*
+ * add_to_logfile() - Add the contents of *entry to the log file in `logs`, and 
+ * to the JSON Lines log file and binary log if they're open. If the writer 
+ * thread is running, the rendered text entries are handed over to it, 
+ * otherwise they're written with write_log_entry(). The binary log is always 
+ * written by the calling thread. Returns 0 if ok or 1 if any errors.
+ */
+
+int add_to_logfile(struct Logs *logs, const struct Entry *entry,
+                   const bool raw)
+{
+	char *ap, *jp = NULL;
+	struct timespec ts;
+	int retval = 0;
+
+	assert(logs);
+	assert(entry);
+	assert(raw == false || raw == true);
+
+	trace_begin(&ts);
+	ap = xml_entry(entry, raw);
+	if (!ap)
+		return 1; /* gncov */
+	if (logs->jsonfp || logs->jsonfd != -1) {
+		jp = json_entry(entry, raw);
+		if (!jp) {
+			free(ap); /* gncov */
+			return 1; /* gncov */
+		}
+	}
+	trace_end(TRACE_SERIALIZE, &ts);
+
+	if (logs->writer.running) {
+		retval = writer_push(&logs->writer, ap, jp);
+		ap = jp = NULL;
+	} else {
+		trace_begin(&ts);
+		retval = write_log_entry(logs, ap, jp);
+		trace_end(TRACE_WRITE, &ts);
+	}
+	if (!retval && logs->bin.recfd != -1) {
+		trace_begin(&ts);
+		retval = binlog_add(&logs->bin, entry, raw);
+		trace_end(TRACE_WRITE, &ts);
+	}
+	free(jp);
+	free(ap);
+
+	return retval;
+}
+
+/*
+ * flush_logfile() - Write the batched entries in `logs` to the log files 
+ * without closing them, so other processes can read them. Used by the daemon 
+ * after every batch, and before buffered UUIDs are printed. If the writer 
+ * thread is running, it must be drained with writer_drain() first. Returns 0 
+ * if ok, or 1 if error.
+ */
+
+int flush_logfile(struct Logs *logs)
+{
+	assert(logs);
+
+	if (logs->batched)
+		return write_xml_batch(logs);
+
+	return 0;
+}
+
+/*
+ * close_logfile() - Do the finishing changes on the log files in `logs`, 
+ * write the last batch or add end tag if it's an XML log file and close it. 
+ * Unless the sync mode is SYNC_NONE, the files are written to disk before 
+ * they're closed. Return 0 if no errors, if any errors were detected, return 
+ * 1.
+ */
+
+int close_logfile(struct Logs *logs)
+{
+	int retval = 0;
+	FILE *fp;
+
+	assert(logs);
+
+	if (writer_stop(&logs->writer))
+		retval = 1;
+	if (logs->map) {
+		if (finish_mmap_logfile(logs))
+			retval = 1; /* gncov */
+	} else if (logs->ring.fd != -1) {
+		if (finish_uring_logfile(logs))
+			retval = 1; /* gncov */
+	} else if (logs->mode == LOGMODE_XML && logs->logfp
+	           && write_xml_batch(logs)) {
+		retval = 1; /* gncov */
+	}
+	if (logs->sync != SYNC_NONE) {
+		if (sync_logs(logs))
+			retval = 1; /* gncov */
+		msg(2, "Synced the log files %lu time%s", logs->syncs,
+		       logs->syncs == 1 ? "" : "s");
+	}
+	if (logs->lock.waits) {
+		msg(1, "Waited for %lu of %lu locks, %lld.%03lld ms in total,"
+		       " max %lld.%03lld ms", logs->lock.waits,
+		       logs->lock.locks, logs->lock.wait_ns / 1000000,
+		       logs->lock.wait_ns / 1000 % 1000,
+		       logs->lock.max_ns / 1000000,
+		       logs->lock.max_ns / 1000 % 1000);
+	} else if (logs->lock.locks) {
+		msg(2, "Locked the log files %lu time%s without waiting",
+		       logs->lock.locks, logs->lock.locks == 1 ? "" : "s");
+	}
+	if (logs->bin.recfd != -1 && binlog_close(&logs->bin))
 		retval = 1; /* gncov */
+	if (logs->jsonfd != -1 && close(logs->jsonfd) == -1)
+		retval = 1; /* gncov */
+	logs->jsonfd = -1;
+	if (logs->jsonfp) {
+		if (fflush(logs->jsonfp) == EOF)
+			retval = 1; /* gncov */
+		flock(fileno(logs->jsonfp), LOCK_UN);
+		if (fclose(logs->jsonfp) == EOF)
+			retval = 1; /* gncov */
+		logs->jsonfp = NULL;
+	}
+
+	if (logs->mode == LOGMODE_APPEND) {
+		if (logs->fd != -1 && close(logs->fd) == -1)
+			retval = 1; /* gncov */
+		logs->fd = -1;
+		goto out;
+	}
+
+	if (logs->mapfd != -1 && close(logs->mapfd) == -1)
+		retval = 1; /* gncov */
+	logs->mapfd = -1;
+	if (logs->ring.logfd != -1 && close(logs->ring.logfd) == -1)
+		retval = 1; /* gncov */
+	logs->ring.logfd = -1;
+	fp = logs->logfp;
+	assert(fp);
 	if (fflush(fp) == EOF)
 		retval = 1; /* gncov */
 	flock(fileno(fp), LOCK_UN);
 	if (fclose(fp) == EOF)
 		retval = 1; /* gncov */
+	logs->logfp = NULL;
 
+out:
+	binbuf_free(&logs->batch);
+	binbuf_free(&logs->jsonbatch);
 	if (retval)
 		myerror("Error when closing log file"); /* gncov */
 
@@ -0,0 +1,222 @@
+/*
+ * lz.c
+ * File ID: f894460d-cb1c-11f1-81f7-83850402c3ce
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A small LZ77 codec, so compressed log segments don't need any extra 
+ * libraries. The compressed data is a sequence of tokens:
+ *
+ *   token     1 byte, literal length in the high 4 bits, match length minus
+ *             LZ_MINMATCH in the low 4 bits
+ *   [litext]  If the literal length is 15, more bytes follow and are added
+ *             to it until a byte is less than 255
+ *   literals  The literal bytes
+ *   offset    u16 little-endian, distance back to the match
+ *   [matext]  Extra match length bytes, same encoding as litext
+ *
+ * The last token has only literals, it ends where the input ends.
+ */
+
+#include "suuid.h"
+
+#define LZ_MINMATCH  4
+#define LZ_HASH_BITS  14
+#define LZ_MAX_OFFSET  65535
+
+/*
+ * lz_bound() - Return the maximum size of `len` bytes after compression.
+ */
+
+size_t lz_bound(const size_t len)
+{
+	return len + len / 255 + 16;
+}
+
+/*
+ * read32() - Return the 4 bytes at `p` as an unaligned 32-bit value.
+ */
+
+static uint32_t read32(const unsigned char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+
+	return v;
+}
+
+/*
+ * put_len() - Write the extra length bytes for the length `len`, which is at 
+ * least 15, to `dst`. Returns the number of bytes written.
+ */
+
+static size_t put_len(unsigned char *dst, size_t len)
+{
+	size_t n = 0;
+
+	for (len -= 15; len >= 255; len -= 255)
+		dst[n++] = 255;
+	dst[n++] = (unsigned char)len;
+
+	return n;
+}
+
+/*
+ * emit() - Write a token with `litlen` literals from `lit` to `dst`. If 
+ * `matchlen` isn't 0, add a match with that length at `offset` bytes back. 
+ * Returns the number of bytes written.
+ */
+
+static size_t emit(unsigned char *dst, const unsigned char *lit,
+                   const size_t litlen, const size_t offset,
+                   const size_t matchlen)
+{
+	size_t op = 1, ml = matchlen ? matchlen - LZ_MINMATCH : 0;
+
+	dst[0] = (unsigned char)((litlen < 15 ? litlen : 15) << 4
+	                         | (ml < 15 ? ml : 15));
+	if (litlen >= 15)
+		op += put_len(dst + op, litlen);
+	if (litlen)
+		memcpy(dst + op, lit, litlen);
+	op += litlen;
+	if (!matchlen)
+		return op;
+	dst[op++] = (unsigned char)(offset & 0xff);
+	dst[op++] = (unsigned char)(offset >> 8);
+	if (ml >= 15)
+		op += put_len(dst + op, ml);
+
+	return op;
+}
+
+/*
+ * lz_compress() - Compress `len` bytes at `src` into `dst`, which must have 
+ * room for lz_bound(len) bytes. Returns the size of the compressed data, or 0 
+ * if malloc() fails.
+ */
+
+size_t lz_compress(const unsigned char *src, const size_t len,
+                   unsigned char *dst)
+{
+	size_t *tab, ip = 0, anchor = 0, op = 0;
+
+	assert(src || !len);
+	assert(dst);
+
+	tab = calloc((size_t)1 << LZ_HASH_BITS, sizeof(size_t));
+	if (!tab) {
+		failed("calloc()"); /* gncov */
+		return 0; /* gncov */
+	}
+
+	while (ip + LZ_MINMATCH < len) {
+		uint32_t seq = read32(src + ip);
+		size_t h = (size_t)((seq * 2654435761U)
+		                    >> (32 - LZ_HASH_BITS));
+		size_t ref = tab[h];
+
+		tab[h] = ip + 1; /* 0 means empty */
+		if (ref && ip - (ref - 1) <= LZ_MAX_OFFSET
+		    && read32(src + ref - 1) == seq) {
+			size_t mpos = ref - 1, mlen = LZ_MINMATCH;
+
+			while (ip + mlen < len
+			       && src[mpos + mlen] == src[ip + mlen])
+				mlen++;
+			op += emit(dst + op, src + anchor, ip - anchor,
+			           ip - mpos, mlen);
+			ip += mlen;
+			anchor = ip;
+		} else {
+			ip++;
+		}
+	}
+	op += emit(dst + op, src + anchor, len - anchor, 0, 0);
+	free(tab);
+
+	return op;
+}
+
+/*
+ * get_len() - Read extra length bytes from `src` at position `*ip`, `len` is 
+ * the end of the input. Add them to `*dest`. Returns 0 if ok, or 1 if the 
+ * input ends.
+ */
+
+static int get_len(const unsigned char *src, const size_t len, size_t *ip,
+                   size_t *dest)
+{
+	unsigned char c;
+
+	do {
+		if (*ip >= len)
+			return 1;
+		c = src[(*ip)++];
+		*dest += c;
+	} while (c == 255);
+
+	return 0;
+}
+
+/*
+ * lz_decompress() - Decompress the `len` bytes at `src` into `dst`, which must 
+ * have room for `rawlen` bytes, the size of the uncompressed data. Returns 0 
+ * if ok, or 1 if the data is corrupt or truncated.
+ */
+
+int lz_decompress(const unsigned char *src, const size_t len,
+                  unsigned char *dst, const size_t rawlen)
+{
+	size_t ip = 0, op = 0;
+
+	assert(src || !len);
+	assert(dst || !rawlen);
+
+	while (ip < len) {
+		unsigned char token = src[ip++];
+		size_t litlen = token >> 4, mlen = token & 15, offset;
+
+		if (litlen == 15 && get_len(src, len, &ip, &litlen))
+			return 1;
+		if (litlen > len - ip || litlen > rawlen - op)
+			return 1;
+		memcpy(dst + op, src + ip, litlen);
+		ip += litlen;
+		op += litlen;
+		if (ip == len)
+			return op != rawlen;
+
+		if (len - ip < 2)
+			return 1;
+		offset = src[ip] | (size_t)src[ip + 1] << 8;
+		ip += 2;
+		if (mlen == 15 && get_len(src, len, &ip, &mlen))
+			return 1;
+		mlen += LZ_MINMATCH;
+		if (!offset || offset > op || mlen > rawlen - op)
+			return 1;
+		for (; mlen; mlen--, op++)
+			dst[op] = dst[op - offset];
+	}
+
+	return 1; /* The last token must have only literals */
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
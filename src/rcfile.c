@@ -29,7 +29,11 @@ void init_rc(struct Rc *rc)
 	assert(rc);
 
 	rc->hostname = NULL;
+	rc->logmode = NULL;
 	rc->macaddr = NULL;
+	rc->segment = NULL;
+	rc->shards = NULL;
+	rc->sync = NULL;
 }
 
 /*
@@ -41,7 +45,11 @@ void free_rc(struct Rc *rc)
 	assert(rc);
 
 	free(rc->hostname);
+	free(rc->logmode);
 	free(rc->macaddr);
+	free(rc->segment);
+	free(rc->shards);
+	free(rc->sync);
 	init_rc(rc);
 }
 
@@ -63,8 +71,16 @@ int create_rcfile(const char *file, struct Rc *rc)
 		return 1; /* gncov */
 	if (rc->hostname)
 		fprintf(fp, "hostname = %s\n", rc->hostname);
+	if (rc->logmode)
+		fprintf(fp, "logmode = %s\n", rc->logmode);
 	if (rc->macaddr)
 		fprintf(fp, "macaddr = %s\n", rc->macaddr);
+	if (rc->segment)
+		fprintf(fp, "segment = %s\n", rc->segment);
+	if (rc->shards)
+		fprintf(fp, "shards = %s\n", rc->shards);
+	if (rc->sync)
+		fprintf(fp, "sync = %s\n", rc->sync);
 	if (fclose(fp))
 		return 1; /* gncov */
 
@@ -167,6 +183,13 @@ int parse_rc_line(const char *line, struct Rc *rc)
 			return 1; /* gncov */
 		}
 	}
+	if (has_key(line, "logmode")) {
+		rc->logmode = mystrdup(has_key(line, "logmode"));
+		if (!rc->logmode) {
+			failed("mystrdup()"); /* gncov */
+			return 1; /* gncov */
+		}
+	}
 	if (has_key(line, "macaddr")) {
 		rc->macaddr = mystrdup(has_key(line, "macaddr"));
 		if (!rc->macaddr) {
@@ -175,6 +198,27 @@ int parse_rc_line(const char *line, struct Rc *rc)
 		}
 		string_to_lower(rc->macaddr);
 	}
+	if (has_key(line, "segment")) {
+		rc->segment = mystrdup(has_key(line, "segment"));
+		if (!rc->segment) {
+			failed("mystrdup()"); /* gncov */
+			return 1; /* gncov */
+		}
+	}
+	if (has_key(line, "shards")) {
+		rc->shards = mystrdup(has_key(line, "shards"));
+		if (!rc->shards) {
+			failed("mystrdup()"); /* gncov */
+			return 1; /* gncov */
+		}
+	}
+	if (has_key(line, "sync")) {
+		rc->sync = mystrdup(has_key(line, "sync"));
+		if (!rc->sync) {
+			failed("mystrdup()"); /* gncov */
+			return 1; /* gncov */
+		}
+	}
 
 	return 0;
 }
@@ -0,0 +1,416 @@
+/*
+ * seal.c
+ * File ID: f894ff1c-cb1c-11f1-b092-83850402c3ce
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A sealed log segment is a read-only, compressed copy of an XML log file. 
+ * The lines between the XML header and trailer are split into blocks of 
+ * SEAL_BLOCK_ENTRIES lines, and every block is compressed with lz.c. The 
+ * file starts with a SEAL_HDR_SIZE bytes header:
+ *
+ *   0   8 bytes  Magic
+ *   8   u32      Max number of lines per block
+ *   12  u32      Number of blocks
+ *   16  u64      File offset of the block index
+ *   24  u64      Total number of lines
+ *
+ * The compressed blocks follow, and the block index is at the end of the 
+ * file with SEAL_INDEX_SIZE bytes per block:
+ *
+ *   0   u64      Lowest UUID timestamp in the block
+ *   8   u64      Highest UUID timestamp in the block
+ *   16  u64      File offset of the compressed block
+ *   24  u32      Size of the compressed block
+ *   28  u32      Size of the uncompressed block
+ *
+ * The timestamps are 0 if no lines in the block have a v1 UUID. The index 
+ * makes it possible to find the blocks in a time range without 
+ * decompressing the rest. All integers are little-endian.
+ */
+
+#include "suuid.h"
+
+#define SEAL_MAGIC  "SUUIDSC1"
+#define SEAL_MAGIC_LEN  8
+
+struct Seal {
+	int fd;
+	const char *fname;
+	char *buf; /* Uncompressed lines in the current block */
+	size_t len;
+	size_t alloc;
+	size_t lines; /* Number of lines in the current block */
+	utime_t first;
+	utime_t last;
+	unsigned char *index;
+	size_t nblocks;
+	uint64_t offset; /* Where the next block is written */
+	uint64_t total;
+};
+
+/*
+ * write_at() - Write `len` bytes from `buf` to offset `offset` in the sealed 
+ * file. Returns 0 if ok, or 1 if error.
+ */
+
+static int write_at(struct Seal *s, const void *buf, const size_t len,
+                    const uint64_t offset)
+{
+	assert(s);
+	assert(buf);
+
+	if (pwrite(s->fd, buf, len, (off_t)offset) != (ssize_t)len) {
+		myerror("%s: Cannot write to sealed file", /* gncov */
+		        s->fname);
+		return 1; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * flush_block() - Compress the lines in the current block of `s` and write 
+ * it to the sealed file, and add the block to the index. Returns 0 if ok, or 
+ * 1 if error.
+ */
+
+static int flush_block(struct Seal *s)
+{
+	unsigned char *cbuf, *p;
+	size_t clen;
+	int retval = 1;
+
+	assert(s);
+
+	if (!s->lines)
+		return 0;
+
+	cbuf = malloc(lz_bound(s->len));
+	p = realloc(s->index, (s->nblocks + 1) * SEAL_INDEX_SIZE);
+	if (!cbuf || !p) {
+		failed("malloc()"); /* gncov */
+		free(cbuf); /* gncov */
+		return 1; /* gncov */
+	}
+	s->index = p;
+	clen = lz_compress((unsigned char *)s->buf, s->len, cbuf);
+	if (!clen)
+		goto cleanup; /* gncov */
+	if (clen > UINT32_MAX || s->len > UINT32_MAX) {
+		myerror("%s: Block is too large", s->fname); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (write_at(s, cbuf, clen, s->offset))
+		goto cleanup; /* gncov */
+
+	p = s->index + s->nblocks * SEAL_INDEX_SIZE;
+	put_u64(p, s->first);
+	put_u64(p + 8, s->last);
+	put_u64(p + 16, s->offset);
+	put_u32(p + 24, (uint32_t)clen);
+	put_u32(p + 28, (uint32_t)s->len);
+	s->nblocks++;
+	s->offset += clen;
+	s->len = s->lines = 0;
+	s->first = s->last = 0;
+	retval = 0;
+
+cleanup:
+	free(cbuf);
+
+	return retval;
+}
+
+/*
+ * seal_line() - Used by seal_logfile(). Add the log line `line` to the 
+ * current block of the sealed file `data`, and write the block when it's 
+ * full. Returns 0 if ok, or 1 if error.
+ */
+
+static int seal_line(void *data, const char *line)
+{
+	struct Seal *s = data;
+	size_t len;
+	utime_t ticks;
+
+	assert(s);
+	assert(line);
+
+	len = strlen(line);
+	if (s->len + len + 1 > s->alloc) {
+		size_t newsize = (s->len + len + 1) * 2;
+		char *p = realloc(s->buf, newsize);
+
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			return 1; /* gncov */
+		}
+		s->buf = p;
+		s->alloc = newsize;
+	}
+	memcpy(s->buf + s->len, line, len);
+	s->buf[s->len + len] = '\n';
+	s->len += len + 1;
+
+	ticks = line_ticks(line);
+	if (ticks) {
+		if (!s->first || ticks < s->first)
+			s->first = ticks;
+		if (ticks > s->last)
+			s->last = ticks;
+	}
+	s->total++;
+	if (++s->lines >= SEAL_BLOCK_ENTRIES)
+		return flush_block(s);
+
+	return 0;
+}
+
+/*
+ * seal_logfile() - Create a sealed copy of the XML log file `xmlname`. The 
+ * sealed file gets the same name as `xmlname` with the ".xml" extension 
+ * replaced by SEAL_EXTENSION, and it must not exist already. The XML file is 
+ * left untouched. Returns 0 if ok, or 1 if error.
+ */
+
+int seal_logfile(const char *xmlname)
+{
+	struct Seal s;
+	unsigned char hdr[SEAL_HDR_SIZE];
+	struct Logmerge m;
+	char *sealname;
+	int retval = 1;
+
+	assert(xmlname);
+
+	memset(&s, 0, sizeof(s));
+	s.fd = -1;
+	if (logmerge_open(&m, xmlname))
+		return 1;
+	sealname = log_filename(xmlname, SEAL_EXTENSION);
+	if (!sealname)
+		goto cleanup; /* gncov */
+	s.fname = sealname;
+	s.fd = open(sealname, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (s.fd == -1) {
+		if (errno == EEXIST) {
+			errno = 0;
+			myerror("%s: File already exists", sealname);
+		} else {
+			myerror("%s: Could not create file", /* gncov */
+			        sealname);
+		}
+		goto cleanup;
+	}
+
+	s.offset = SEAL_HDR_SIZE;
+	if (logmerge_each(&m, seal_line, &s) || flush_block(&s))
+		goto cleanup; /* gncov */
+	if (s.nblocks
+	    && write_at(&s, s.index, s.nblocks * SEAL_INDEX_SIZE, s.offset))
+		goto cleanup; /* gncov */
+
+	memcpy(hdr, SEAL_MAGIC, SEAL_MAGIC_LEN);
+	put_u32(hdr + 8, SEAL_BLOCK_ENTRIES);
+	put_u32(hdr + 12, (uint32_t)s.nblocks);
+	put_u64(hdr + 16, s.offset);
+	put_u64(hdr + 24, s.total);
+	if (write_at(&s, hdr, SEAL_HDR_SIZE, 0))
+		goto cleanup; /* gncov */
+	retval = 0;
+
+cleanup:
+	if (s.fd != -1) {
+		if (close(s.fd) == -1) {
+			myerror("%s: Error when closing file", /* gncov */
+			        sealname);
+			retval = 1; /* gncov */
+		}
+		if (retval)
+			unlink(sealname); /* gncov */
+	}
+	free(s.index);
+	free(s.buf);
+	free(sealname);
+	logmerge_close(&m);
+
+	return retval;
+}
+
+/*
+ * map_sealed() - Map the sealed file `fname` into memory and check the header 
+ * and the block index. Store the address in `*dest` and the size in `*size`. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int map_sealed(const char *fname, unsigned char **dest, size_t *size)
+{
+	struct stat sb;
+	unsigned char *p;
+	uint64_t ioff;
+	int fd;
+
+	assert(fname);
+	assert(dest);
+	assert(size);
+
+	fd = open(fname, O_RDONLY);
+	if (fd == -1) {
+		myerror("%s: Could not open file", fname);
+		return 1;
+	}
+	if (fstat(fd, &sb) == -1) {
+		myerror("%s: Cannot stat file", fname); /* gncov */
+		close(fd); /* gncov */
+		return 1; /* gncov */
+	}
+	*size = (size_t)sb.st_size;
+	if (*size < SEAL_HDR_SIZE) {
+		myerror("%s: Not a sealed suuid log file", fname);
+		close(fd);
+		return 1;
+	}
+	p = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		myerror("%s: Cannot map file into memory", fname); /* gncov */
+		return 1; /* gncov */
+	}
+
+	ioff = get_u64(p + 16);
+	if (memcmp(p, SEAL_MAGIC, SEAL_MAGIC_LEN) || ioff < SEAL_HDR_SIZE
+	    || ioff > *size
+	    || (*size - ioff) / SEAL_INDEX_SIZE < get_u32(p + 12)) {
+		myerror("%s: Not a sealed suuid log file", fname);
+		munmap(p, *size);
+		return 1;
+	}
+	*dest = p;
+
+	return 0;
+}
+
+/*
+ * print_block() - Write the uncompressed block in `buf` with size `len` to 
+ * `fp`. `buf` must have room for a terminating null byte. If `range` isn't 
+ * NULL, only the lines with a UUID timestamp inside `range` are written. 
+ * Returns nothing.
+ */
+
+static void print_block(char *buf, const size_t len, const char *range,
+                        FILE *fp)
+{
+	char *p = buf, *end = buf + len;
+
+	assert(buf);
+	assert(fp);
+
+	if (!range) {
+		fwrite(buf, 1, len, fp);
+		return;
+	}
+	*end = '\0';
+	while (p < end) {
+		char *nl = strchr(p, '\n');
+		char date[DATE_LENGTH + 1];
+		utime_t ticks;
+
+		if (nl)
+			*nl = '\0';
+		ticks = line_ticks(p);
+		if (ticks && ticks_date(date, ticks)
+		    && range_overlaps(range, date, date))
+			fprintf(fp, "%s\n", p);
+		if (!nl)
+			break;
+		p = nl + 1;
+	}
+}
+
+/*
+ * unseal_logfile() - Write the sealed log file `sealname` as an XML log file 
+ * to `fp`. If `range` isn't NULL, only the entries in that time range are 
+ * written, see range_overlaps() for the format. Blocks outside the range are 
+ * not decompressed. Returns 0 if ok, or 1 if error.
+ */
+
+int unseal_logfile(const char *sealname, const char *range, FILE *fp)
+{
+	unsigned char *map;
+	char *buf = NULL;
+	size_t size, nblocks, i, used = 0;
+	uint64_t ioff;
+	int retval = 1;
+
+	assert(sealname);
+	assert(fp);
+
+	if (map_sealed(sealname, &map, &size))
+		return 1;
+	nblocks = get_u32(map + 12);
+	ioff = get_u64(map + 16);
+
+	fputs(LOGFILE_HEADER, fp);
+	for (i = 0; i < nblocks; i++) {
+		const unsigned char *idx = map + ioff + i * SEAL_INDEX_SIZE;
+		uint64_t off = get_u64(idx + 16);
+		size_t clen = get_u32(idx + 24), rawlen = get_u32(idx + 28);
+		char first[DATE_LENGTH + 1], last[DATE_LENGTH + 1];
+		char *p;
+
+		if (range) {
+			if (!get_u64(idx) || !ticks_date(first, get_u64(idx))
+			    || !ticks_date(last, get_u64(idx + 8))
+			    || !range_overlaps(range, first, last))
+				continue;
+		}
+		if (off < SEAL_HDR_SIZE || off > ioff || clen > ioff - off) {
+			myerror("%s: Block %zu is corrupt", sealname, i + 1);
+			goto cleanup;
+		}
+		p = realloc(buf, rawlen + 1);
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		buf = p;
+		if (lz_decompress(map + off, clen, (unsigned char *)buf,
+		                  rawlen)) {
+			myerror("%s: Block %zu is corrupt", sealname, i + 1);
+			goto cleanup;
+		}
+		print_block(buf, rawlen, range, fp);
+		used++;
+	}
+	fputs(LOGFILE_TRAILER, fp);
+	msg(1, "%s: Decompressed %zu of %zu blocks", sealname, used, nblocks);
+	retval = 0;
+
+cleanup:
+	if (fflush(fp) == EOF) {
+		myerror("Cannot write XML"); /* gncov */
+		retval = 1; /* gncov */
+	}
+	free(buf);
+	munmap(map, size);
+
+	return retval;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -0,0 +1,508 @@
+/*
+ * segment.c
+ * File ID: 837c2f9d-cb1c-11f1-a796-83850402c3ce
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Segmented logs are stored in the directory <logdir>/<host>/ instead of in 
+ * <logdir>/<host>.xml. The segment names are "yyyy-mm" when a new segment is 
+ * started every month, or a 6-digit sequence number when a new segment is 
+ * started after the active one has reached a certain size. The directory also 
+ * contains the file "manifest", which has one line per segment:
+ *
+ *   <name> <first date> <last date> <number of entries>
+ *
+ * The manifest is updated when the log file is closed. The directory is 
+ * locked while it's updated, and it's replaced atomically with rename().
+ */
+
+#include "suuid.h"
+
+#define SEGMENT_SEQ_DIGITS  6
+
+/*
+ * parse_segment() - Parse the segment specification `s` and store the result 
+ * in `seg`. `s` is "none", "month", or a size in bytes with an optional 
+ * suffix "k", "M" or "G". Returns 0 if ok, or 1 if `s` is invalid.
+ */
+
+int parse_segment(const char *s, struct Segment *seg)
+{
+	unsigned long long size;
+	char *endp;
+
+	assert(s);
+	assert(seg);
+
+	seg->mode = SEGMENT_NONE;
+	seg->size = 0;
+	if (!strcmp(s, "none"))
+		return 0;
+	if (!strcmp(s, "month")) {
+		seg->mode = SEGMENT_MONTH;
+		return 0;
+	}
+
+	if (!isdigit((unsigned char)*s))
+		goto error;
+	errno = 0;
+	size = strtoull(s, &endp, 10);
+	if (errno || !size)
+		goto error;
+	if (!strcmp(endp, "k"))
+		size *= 1024ULL;
+	else if (!strcmp(endp, "M"))
+		size *= 1024ULL * 1024ULL;
+	else if (!strcmp(endp, "G"))
+		size *= 1024ULL * 1024ULL * 1024ULL;
+	else if (*endp)
+		goto error;
+	seg->mode = SEGMENT_SIZE;
+	seg->size = size;
+
+	return 0;
+
+error:
+	errno = 0;
+	myerror("\"%s\": Invalid segment value", s);
+
+	return 1;
+}
+
+/*
+ * get_segment() - Store the segment specification to use in `seg`. The value 
+ * from --segment is used if it's defined, otherwise the "segment" keyword from 
+ * the rc file. If none of them are defined, the log isn't segmented. Returns 0 
+ * if ok, or 1 if the value is invalid.
+ */
+
+int get_segment(const struct Rc *rc, const struct Options *opts,
+                struct Segment *seg)
+{
+	const char *p = "none";
+
+	assert(rc);
+	assert(opts);
+	assert(seg);
+
+	if (opts->segment)
+		p = opts->segment;
+	else if (rc->segment)
+		p = rc->segment;
+
+	return parse_segment(p, seg);
+}
+
+/*
+ * last_seq_segment() - Return the highest sequence number of the segments in 
+ * `dir`, or 0 if there are none.
+ */
+
+static unsigned long last_seq_segment(const char *dir)
+{
+	DIR *dp;
+	struct dirent *de;
+	unsigned long retval = 0;
+
+	assert(dir);
+
+	dp = opendir(dir);
+	if (!dp)
+		return 0; /* gncov */
+	while ((de = readdir(dp))) {
+		const char *n = de->d_name;
+		unsigned long l;
+
+		if (strspn(n, "0123456789") != SEGMENT_SEQ_DIGITS
+		    || strcmp(n + SEGMENT_SEQ_DIGITS, LOGFILE_EXTENSION))
+			continue;
+		l = strtoul(n, NULL, 10);
+		if (l > retval)
+			retval = l;
+	}
+	closedir(dp);
+
+	return retval;
+}
+
+/*
+ * segment_name() - Return pointer to an allocated string with the name of the 
+ * active segment in directory `dir`, or NULL if error.
+ */
+
+static char *segment_name(const char *dir, const struct Segment *seg)
+{
+	char *retval = NULL;
+
+	assert(dir);
+	assert(seg);
+
+	if (seg->mode == SEGMENT_MONTH) {
+		char buf[8];
+		time_t t = time(NULL);
+		struct tm *tm = gmtime(&t);
+
+		if (!tm || !strftime(buf, sizeof(buf), "%Y-%m", tm)) {
+			myerror("Cannot get current month"); /* gncov */
+			return NULL; /* gncov */
+		}
+		retval = mystrdup(buf);
+	} else {
+		unsigned long seq = last_seq_segment(dir);
+		char *fname;
+		struct stat sb;
+
+		if (!seq)
+			seq = 1;
+		fname = allocstr("%s/%0*lu%s", dir, SEGMENT_SEQ_DIGITS, seq,
+		                 LOGFILE_EXTENSION);
+		if (!fname) {
+			failed("allocstr()"); /* gncov */
+			return NULL; /* gncov */
+		}
+		if (!stat(fname, &sb) && (unsigned long long)sb.st_size
+		                         >= seg->size)
+			seq++;
+		errno = 0;
+		free(fname);
+		retval = allocstr("%0*lu", SEGMENT_SEQ_DIGITS, seq);
+	}
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+	return retval;
+}
+
+/*
+ * get_segment_prefix() - Return pointer to an allocated string with the file 
+ * name prefix of the active segment in directory `dir`, and store an 
+ * allocated copy of the segment name in `*segname`. The directory is created 
+ * if it doesn't exist. Returns NULL if error.
+ */
+
+char *get_segment_prefix(const char *dir, const struct Segment *seg,
+                         char **segname)
+{
+	char *retval;
+
+	assert(dir);
+	assert(seg);
+	assert(seg->mode != SEGMENT_NONE);
+	assert(segname);
+
+	if (mkdir(dir, 0777) == -1 && errno != EEXIST) {
+		myerror("%s: Cannot create segment directory", dir);
+		return NULL;
+	}
+	errno = 0;
+	*segname = segment_name(dir, seg);
+	if (!*segname)
+		return NULL; /* gncov */
+	retval = allocstr("%s/%s", dir, *segname);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+	return retval;
+}
+
+/*
+ * free_manifest() - Deallocate the `count` entries in `man`. Returns nothing.
+ */
+
+void free_manifest(struct Manifest *man, const size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		free(man[i].name);
+	free(man);
+}
+
+/*
+ * read_manifest() - Read the manifest file `fname` and store a pointer to an 
+ * allocated array with the entries in `*dest` and the number of entries in 
+ * `*count`. A missing manifest file has no entries. Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+int read_manifest(const char *fname, struct Manifest **dest, size_t *count)
+{
+	char *buf, *line, *save = NULL;
+	struct Manifest *man = NULL;
+	size_t n = 0;
+	unsigned long lineno = 0;
+
+	assert(fname);
+	assert(dest);
+	assert(count);
+
+	*dest = NULL;
+	*count = 0;
+	if (!file_exists(fname))
+		return 0;
+	buf = read_from_file(fname);
+	if (!buf)
+		return 1; /* gncov */
+
+	for (line = strtok_r(buf, "\n", &save); line;
+	     line = strtok_r(NULL, "\n", &save)) {
+		char *name, *first, *last, *num, *s2 = NULL;
+		struct Manifest *p;
+
+		lineno++;
+		name = strtok_r(line, " ", &s2);
+		first = strtok_r(NULL, " ", &s2);
+		last = strtok_r(NULL, " ", &s2);
+		num = strtok_r(NULL, " ", &s2);
+		if (!num || strtok_r(NULL, " ", &s2)
+		    || !is_valid_date(first, true)
+		    || !is_valid_date(last, true)
+		    || !*num || num[strspn(num, "0123456789")]) {
+			myerror("%s: Invalid manifest line %lu", fname,
+			        lineno);
+			goto error;
+		}
+		p = realloc(man, (n + 1) * sizeof(struct Manifest));
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			goto error; /* gncov */
+		}
+		man = p;
+		man[n].name = mystrdup(name);
+		if (!man[n].name) {
+			failed("mystrdup()"); /* gncov */
+			goto error; /* gncov */
+		}
+		memcpy(man[n].first, first, DATE_LENGTH + 1);
+		memcpy(man[n].last, last, DATE_LENGTH + 1);
+		man[n].count = strtoul(num, NULL, 10);
+		n++;
+	}
+	free(buf);
+	*dest = man;
+	*count = n;
+
+	return 0;
+
+error:
+	free(buf);
+	free_manifest(man, n);
+
+	return 1;
+}
+
+/*
+ * write_manifest() - Write the `count` entries in `man` to the manifest file 
+ * `fname`. The new manifest is written to a temporary file which is renamed 
+ * to `fname`. Returns 0 if ok, or 1 if error.
+ */
+
+static int write_manifest(const char *fname, const struct Manifest *man,
+                          const size_t count)
+{
+	char *tmpname;
+	FILE *fp;
+	size_t i;
+	int retval = 0;
+
+	assert(fname);
+	assert(man || !count);
+
+	tmpname = allocstr("%s.tmp", fname);
+	if (!tmpname) {
+		failed("allocstr()"); /* gncov */
+		return 1; /* gncov */
+	}
+	fp = fopen(tmpname, "w");
+	if (!fp) {
+		myerror("%s: Cannot create file", tmpname); /* gncov */
+		free(tmpname); /* gncov */
+		return 1; /* gncov */
+	}
+	for (i = 0; i < count; i++) {
+		fprintf(fp, "%s %s %s %lu\n", man[i].name, man[i].first,
+		        man[i].last, man[i].count);
+	}
+	if (fclose(fp) == EOF || rename(tmpname, fname) == -1) {
+		myerror("%s: Cannot write manifest", fname); /* gncov */
+		retval = 1; /* gncov */
+	}
+	free(tmpname);
+
+	return retval;
+}
+
+/*
+ * update_manifest() - Add `count` entries created between `first` and `last` 
+ * to segment `segname` in the manifest in directory `dir`. The directory is 
+ * locked while the manifest is updated. Returns 0 if ok, or 1 if error.
+ */
+
+int update_manifest(const char *dir, const char *segname, const char *first,
+                    const char *last, const unsigned long count)
+{
+	struct Manifest *man = NULL;
+	size_t n = 0, i;
+	char *fname;
+	int fd, retval = 1;
+
+	assert(dir);
+	assert(segname);
+	assert(first);
+	assert(last);
+
+	fname = allocstr("%s/%s", dir, SEGMENT_MANIFEST);
+	if (!fname) {
+		failed("allocstr()"); /* gncov */
+		return 1; /* gncov */
+	}
+	fd = open(dir, O_RDONLY);
+	if (fd == -1 || flock(fd, LOCK_EX) == -1) {
+		myerror("%s: Cannot lock segment directory", /* gncov */
+		        dir);
+		goto cleanup; /* gncov */
+	}
+	if (read_manifest(fname, &man, &n))
+		goto cleanup;
+
+	for (i = 0; i < n && strcmp(man[i].name, segname); i++);
+	if (i == n) {
+		struct Manifest *p;
+
+		p = realloc(man, (n + 1) * sizeof(struct Manifest));
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		man = p;
+		man[n].name = mystrdup(segname);
+		if (!man[n].name) {
+			failed("mystrdup()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		memcpy(man[n].first, first, DATE_LENGTH + 1);
+		memcpy(man[n].last, last, DATE_LENGTH + 1);
+		man[n].count = 0;
+		n++;
+	}
+	if (strcmp(first, man[i].first) < 0)
+		memcpy(man[i].first, first, DATE_LENGTH + 1);
+	if (strcmp(last, man[i].last) > 0)
+		memcpy(man[i].last, last, DATE_LENGTH + 1);
+	man[i].count += count;
+	retval = write_manifest(fname, man, n);
+
+cleanup:
+	if (fd != -1)
+		close(fd);
+	free_manifest(man, n);
+	free(fname);
+
+	return retval;
+}
+
+/*
+ * range_overlaps() - Return true if the time range `range` overlaps with the 
+ * time range from `first` to `last`. `range` is "FROM,TO" or a single date 
+ * which is used for both. The dates can be shortened, "2025-10" matches all 
+ * of October 2025, and an empty FROM or TO means no limit.
+ */
+
+bool range_overlaps(const char *range, const char *first, const char *last)
+{
+	const char *comma, *to;
+	size_t fromlen, tolen;
+
+	assert(range);
+	assert(first);
+	assert(last);
+
+	comma = strchr(range, ',');
+	fromlen = comma ? (size_t)(comma - range) : strlen(range);
+	to = comma ? comma + 1 : range;
+	tolen = comma ? strlen(to) : fromlen;
+
+	return strncmp(last, range, fromlen) >= 0
+	       && strncmp(first, to, tolen) <= 0;
+}
+
+/*
+ * list_segments() - Print the path of all segments in the segmented log that 
+ * have entries in the time range `range` to stdout, see range_overlaps() for 
+ * the format. Sealed segments are listed with the path to the sealed file. 
+ * Only the manifest is read, so segments outside the range are never 
+ * touched. Returns 0 if ok, or 1 if error.
+ */
+
+int list_segments(const struct Options *opts, const char *range)
+{
+	struct Rc rc;
+	struct Manifest *man = NULL;
+	char *rcfile = NULL, *dir = NULL, *fname = NULL;
+	size_t n = 0, i;
+	int retval = 1;
+
+	assert(opts);
+	assert(range);
+
+	init_rc(&rc);
+	rcfile = get_rcfilename(opts);
+	if (read_rcfile(rcfile, &rc))
+		goto cleanup;
+	dir = get_log_prefix(&rc, opts, "");
+	if (!dir)
+		goto cleanup; /* gncov */
+	fname = allocstr("%s/%s", dir, SEGMENT_MANIFEST);
+	if (!fname) {
+		failed("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (read_manifest(fname, &man, &n))
+		goto cleanup;
+
+	for (i = 0; i < n; i++) {
+		char *sealed;
+
+		if (!range_overlaps(range, man[i].first, man[i].last))
+			continue;
+		sealed = allocstr("%s/%s%s", dir, man[i].name,
+		                  SEAL_EXTENSION);
+		if (!sealed) {
+			failed("allocstr()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		if (file_exists(sealed))
+			printf("%s\n", sealed);
+		else
+			printf("%s/%s%s\n", dir, man[i].name,
+			       LOGFILE_EXTENSION);
+		free(sealed);
+	}
+	retval = 0;
+
+cleanup:
+	free_manifest(man, n);
+	free(fname);
+	free(dir);
+	free(rcfile);
+	free_rc(&rc);
+
+	return retval;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -241,6 +241,7 @@ enum rr_msgs {
 
 static char *execname;
 static char *logfile;
+static char *orig_runtime_dir; /* $XDG_RUNTIME_DIR before the tests */
 static const char *rcfile = TMPDIR "/" STD_RCFILE;
 static int failcount = 0;
 static int testnum = 0;
@@ -929,6 +930,72 @@ out:
 	return count;
 }
 
+/*
+ * json_value_ok() - Used by json_valid(). Skip the JSON value at `*s` if it's 
+ * a string, an integer or an object, and store the position after it in 
+ * `*s`. Only the subset of JSON used by --trace-timing is recognised, without 
+ * whitespace. Returns true if the value is valid, otherwise false.
+ */
+
+static bool json_value_ok(const char **s)
+{
+	const char *p;
+
+	assert(s);
+	assert(*s);
+
+	p = *s;
+	if (*p == '"') {
+		for (p++; *p && *p != '"'; p++) {
+			if (*p == '\\' && !*++p)
+				return false;
+		}
+		if (!*p)
+			return false;
+		*s = p + 1;
+		return true;
+	}
+	if (*p == '-' || isdigit((unsigned char)*p)) {
+		if (*p == '-')
+			p++;
+		if (!isdigit((unsigned char)*p))
+			return false;
+		while (isdigit((unsigned char)*p))
+			p++;
+		*s = p;
+		return true;
+	}
+	if (*p++ != '{')
+		return false;
+	if (*p == '}') {
+		*s = p + 1;
+		return true;
+	}
+	for (;;) {
+		if (*p != '"' || !json_value_ok(&p) || *p++ != ':'
+		    || !json_value_ok(&p))
+			return false;
+		if (*p == '}') {
+			*s = p + 1;
+			return true;
+		}
+		if (*p++ != ',')
+			return false;
+	}
+}
+
+/*
+ * json_valid() - Return true if `s` contains one JSON value, optionally 
+ * followed by a newline, see json_value_ok(). Otherwise return false.
+ */
+
+static bool json_valid(const char *s)
+{
+	assert(s);
+
+	return json_value_ok(&s) && (!*s || (*s == '\n' && !s[1]));
+}
+
 /*
  * uc_check_va() - Verifies that `output` contains `num_exp` number of UUIDs. 
  * `name` describes if it's stdout or stderr, and the value there can be "out" 
@@ -1065,6 +1132,41 @@ static char *hostname_logfile(const char *dir)
 	return hostname_log;
 }
 
+/*
+ * hname() - Returns the host name the tested program gets from the rc file, 
+ * HNAME, or "fake" with FAKE_HOST. Points to the static buffer in 
+ * get_hostname().
+ */
+
+static char *hname(void)
+{
+	struct Rc rc;
+
+	init_rc(&rc);
+	rc.hostname = HNAME;
+
+	return get_hostname(&rc);
+}
+
+/*
+ * hname_path() - Returns an allocated string with the path to the file in the 
+ * log directory that the tested program names after the host name from 
+ * hname(), followed by `suffix`. Returns NULL on error.
+ */
+
+static char *hname_path(const char *suffix)
+{
+	char *path;
+
+	assert(suffix);
+
+	path = allocstr("%s/%s/%s%s", TMPDIR, LOGDIR_NAME, hname(), suffix);
+	if (!path)
+		failed_ok("allocstr()"); /* gncov */
+
+	return path;
+}
+
 /*
  * delete_logfile_func() - Deletes the log file. For the `funcname` value, 
  * `__func__` should be used, and `__LINE__` for `linenum`. This is to avoid 
@@ -1175,7 +1277,7 @@ static char *generate_line_regexp(const struct Entry *entry,
 	if (!txt_str)
 		goto cleanup; /* gncov */
 
-	sess_elems = create_sess_xml(entry);
+	sess_elems = create_sess_xml(NULL, entry);
 
 	r_entry = allocstr("(<suuid"
 	                   " t=\"%s\""
@@ -1220,7 +1322,7 @@ static void diag_sess_array(const struct Sess *sess) /* gncov */
 
 	assert(sess); /* gncov */
 
-	for (i = 0; i < MAX_SESS; i++) { /* gncov */
+	for (i = 0; sess[i].uuid; i++) { /* gncov */
 		if (sess[i].desc) /* gncov */
 			diag("sess[%zu].desc: \"%s\"", /* gncov */
 			     i, sess[i].desc); /* gncov */
@@ -1366,6 +1468,37 @@ static int init_tempdir_func(const int linenum)
 	return 0;
 }
 
+/*
+ * delete_envcache() - Delete the environment cache files that the tested 
+ * programs create in TMPDIR, the runtime directory during the tests. Expects 
+ * `linenum` to be `__LINE__` from the caller. Returns nothing.
+ */
+
+static void delete_envcache(const int linenum)
+{
+	DIR *dp;
+	struct dirent *de;
+	char *p;
+
+	dp = opendir(TMPDIR);
+	if (!dp)
+		return; /* gncov */
+	while ((de = readdir(dp))) {
+		if (strncmp(de->d_name, ENVCACHE_PREFIX,
+		            strlen(ENVCACHE_PREFIX)))
+			continue;
+		p = allocstr("%s/%s", TMPDIR, de->d_name);
+		if (!p) {
+			failed_ok("allocstr()"); /* gncov */
+			break; /* gncov */
+		}
+		OK_SUCCESS_L(remove(p), linenum,
+		             "Delete the environment cache %s", p);
+		free(p);
+	}
+	closedir(dp);
+}
+
 /*
  * cleanup_tempdir() - Delete all known filesystem entries in the temporary 
  * work directory defined in TMPDIR. Expects `linenum` to be `__LINE__` or the 
@@ -1448,6 +1581,21 @@ static int init_testvars(void)
 	}
 	if (set_env("HOME", p))
 		goto cleanup; /* gncov */
+
+	/*
+	 * Keep the environment cache from the executable tests out of the 
+	 * real runtime directory. The original value is restored by 
+	 * restore_testvars().
+	 */
+	if (getenv(ENV_RUNTIME_DIR)) {
+		orig_runtime_dir = mystrdup(getenv(ENV_RUNTIME_DIR));
+		if (!orig_runtime_dir) {
+			failed_ok("mystrdup()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+	}
+	if (set_env(ENV_RUNTIME_DIR, p))
+		goto cleanup; /* gncov */
 	free(p);
 	p = NULL;
 
@@ -1457,6 +1605,8 @@ static int init_testvars(void)
 		goto cleanup; /* gncov */
 	if (unset_env(ENV_LOGDIR))
 		goto cleanup; /* gncov */
+	if (unset_env(ENV_NO_URING))
+		goto cleanup; /* gncov */
 	if (unset_env(ENV_SESS))
 		goto cleanup; /* gncov */
 
@@ -1477,6 +1627,24 @@ cleanup:
 	return retval;
 }
 
+/*
+ * restore_testvars() - Restore the environment variables changed by 
+ * init_testvars() that may be inherited by other programs, and free the 
+ * file-static variables. Returns nothing.
+ */
+
+static void restore_testvars(void)
+{
+	if (orig_runtime_dir)
+		set_env(ENV_RUNTIME_DIR, orig_runtime_dir);
+	else
+		unset_env(ENV_RUNTIME_DIR);
+	free(orig_runtime_dir);
+	orig_runtime_dir = NULL;
+	free(logfile); /* Allocated in init_testvars() */
+	logfile = NULL;
+}
+
 /*
  * test_diag_big() - Tests diag_output() with a string larger than BUFSIZ. 
  * Returns nothing.
@@ -1721,6 +1889,29 @@ static void test_count_uuids(void)
 #undef U
 }
 
+/*
+ * test_json_valid() - Tests the json_valid() function. Returns nothing.
+ */
+
+static void test_json_valid(void)
+{
+	diag("Test json_valid()");
+
+	OK_TRUE(json_valid("{}"), "Empty object");
+	OK_TRUE(json_valid("{\"a\":1,\"b\":{\"c\":-2,\"d\":\"e\\\"\"}}\n"),
+	        "Nested object with newline");
+	OK_TRUE(json_valid("\"str\""), "String");
+	OK_FALSE(json_valid(""), "Empty string");
+	OK_FALSE(json_valid("{"), "Unterminated object");
+	OK_FALSE(json_valid("{\"a\":1,}"), "Trailing comma");
+	OK_FALSE(json_valid("{\"a\":-}"), "Minus without digits");
+	OK_FALSE(json_valid("{a:1}"), "Key without quotes");
+	OK_FALSE(json_valid("{\"a\":\"b}"), "Unterminated string");
+	OK_FALSE(json_valid("{\"a\":\"b\\"), "Backslash at the end");
+	OK_FALSE(json_valid("{}{}"), "Two objects");
+	OK_FALSE(json_valid("{\"a\" 1}"), "Missing colon");
+}
+
                                /*** suuid.c ***/
 
 /*
@@ -1734,6 +1925,84 @@ static void test_std_strerror(void)
 	          "std_strerror(EACCES) is as expected");
 }
 
+                               /*** arena.c ***/
+
+/*
+ * test_arena() - Tests the arena_*() functions. Returns nothing.
+ */
+
+static void test_arena(void)
+{
+	char buf[64], *p, *q;
+	struct Arena a, mark;
+
+	diag("Test the arena functions");
+	arena_init(&a, buf, sizeof(buf));
+
+	p = arena_strdup(&a, "abc");
+	OK_STRCMP(p ? p : "", "abc", "arena_strdup() copies the string");
+	OK_TRUE(p >= buf && p < buf + sizeof(buf),
+	        "The string is stored in the buffer from arena_init()");
+	q = arena_strndup(&a, "defghi", 3);
+	OK_STRCMP(q ? q : "", "def", "arena_strndup() copies 3 bytes");
+	OK_TRUE(q > p && q < buf + sizeof(buf)
+	        && !((uintptr_t)q % ARENA_ALIGN),
+	        "The next string is aligned and stored after the first");
+	OK_NULL(arena_strdup(&a, NULL), "arena_strdup(NULL) returns NULL");
+
+	mark = a;
+	p = arena_alloc(&a, 100);
+	OK_TRUE(p && a.block && (p < buf || p >= buf + sizeof(buf)),
+	        "A heap block is used when the buffer is full");
+	q = arena_alloc(&a, ARENA_BLOCKSIZE * 2);
+	OK_TRUE(q && a.block && a.block->prev,
+	        "A large allocation gets its own block");
+	if (q)
+		memset(q, 'x', ARENA_BLOCKSIZE * 2);
+	arena_rewind(&a, &mark);
+	OK_TRUE(!a.block && a.buf == mark.buf && a.used == mark.used,
+	        "arena_rewind() releases the blocks after the mark");
+
+	p = arena_allocstr(&a, "%s-%d", "abc", 42);
+	OK_STRCMP(p ? p : "", "abc-42", "arena_allocstr()");
+	OK_NOTNULL(arena_alloc(&a, 1000), "Allocate 1000 bytes");
+	arena_free(&a);
+	OK_TRUE(!a.block && a.buf == buf && !a.used,
+	        "arena_free() resets the arena");
+
+	p = arena_strdup(NULL, "heap");
+	OK_STRCMP(p ? p : "", "heap",
+	          "arena_strdup() without arena uses malloc()");
+	arena_discard(NULL, p);
+}
+
+                              /*** binbuf.c ***/
+
+/*
+ * test_bb_append() - Tests the bb_append() function. Returns nothing.
+ */
+
+static void test_bb_append(void)
+{
+	struct binbuf b;
+	unsigned int i;
+
+	diag("Test bb_append()");
+	binbuf_init(&b);
+
+	OK_NOTNULL(bb_append(&b, "abc", 3), "bb_append() to empty binbuf");
+	OK_STRCMP(b.buf, "abc", "binbuf contains \"abc\"");
+	OK_NOTNULL(bb_append(&b, "de\0f", 4), "Append string with null byte");
+	OK_EQUAL(b.len, 7U, "binbuf length is 7");
+	OK_MEMCMP(b.buf, "abcde\0f", 8, "binbuf contains null byte");
+	for (i = 0; i < 1000 && bb_append(&b, "x", 1); i++);
+	OK_EQUAL(b.len, 1007U, "Append 1000 bytes, one at a time");
+	OK_TRUE(b.alloc > b.len && b.buf[b.len] == '\0',
+	        "binbuf is null-terminated after growing");
+	binbuf_free(&b);
+	OK_NULL(b.buf, "binbuf_free() resets the buffer");
+}
+
                                 /*** io.c ***/
 
 /*
@@ -1759,6 +2028,397 @@ static void test_read_from_file(void)
 	}
 }
 
+/*
+ * test_outbuf() - Tests the outbuf_*() functions with a pipe. Returns 
+ * nothing.
+ */
+
+static void test_outbuf(void)
+{
+	struct Outbuf ob;
+	int fds[2];
+	char buf[100];
+	ssize_t len;
+
+	diag("Test outbuf_*()");
+
+	outbuf_init(&ob, -1, "nowhere");
+	OK_SUCCESS(outbuf_add(&ob, "abc"), "outbuf_add() without fd");
+	OK_EQUAL(ob.buf.len, 0, "Nothing is buffered without fd");
+	OK_FALSE(outbuf_full(&ob), "outbuf_full() is false without fd");
+	OK_SUCCESS(outbuf_flush(&ob), "outbuf_flush() without fd");
+	outbuf_free(&ob);
+
+	if (pipe(fds)) {
+		failed_ok("pipe()"); /* gncov */
+		return; /* gncov */
+	}
+	outbuf_init(&ob, fds[1], "pipe");
+	OK_SUCCESS(outbuf_add(&ob, "abc"), "outbuf_add() \"abc\"");
+	OK_SUCCESS(outbuf_add(&ob, "de"), "outbuf_add() \"de\"");
+	OK_STRCMP(ob.buf.buf, "abc\nde\n", "The lines are in the buffer");
+	OK_FALSE(outbuf_full(&ob), "The buffer isn't full");
+	OK_SUCCESS(outbuf_flush(&ob), "outbuf_flush() to the pipe");
+	OK_EQUAL(ob.buf.len, 0, "The buffer is empty after outbuf_flush()");
+	len = read(fds[0], buf, sizeof(buf) - 1);
+	OK_EQUAL(len, 7, "7 bytes were written to the pipe");
+	if (len >= 0) {
+		buf[len] = '\0';
+		OK_STRCMP(buf, "abc\nde\n", "The pipe contains the lines");
+	}
+	while (!outbuf_full(&ob) && !outbuf_add(&ob, "0123456789"));
+	OK_TRUE(outbuf_full(&ob), "The buffer is full after OUTPUT_BUFSIZE"
+	                          " bytes");
+	OK_SUCCESS(fcntl(fds[0], F_SETFL, O_NONBLOCK),
+	           "Make the pipe non-blocking");
+	OK_EQUAL(read(fds[0], buf, 1), -1,
+	         "outbuf_add() doesn't write the full buffer");
+	errno = 0;
+	outbuf_free(&ob);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+                               /*** json.c ***/
+
+/*
+ * chk_js() - Used by test_json_str(). Verifies that `json_str(s)` returns 
+ * `exp`. Returns nothing.
+ */
+
+static void chk_js(const int linenum, const char *s, const char *exp)
+{
+	char *result;
+
+	assert(s);
+	assert(exp);
+
+	result = json_str(s);
+	if (!result) {
+		failed_ok("json_str()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_STRCMP_L(result, exp, linenum, "json_str(\"%s\")", s);
+	print_gotexp(result, exp);
+	free(result);
+}
+
+/*
+ * test_json_str() - Tests the json_str() function. Returns nothing.
+ */
+
+static void test_json_str(void)
+{
+	diag("Test json_str()");
+
+#define chk_js(s, exp)  chk_js(__LINE__, (s), (exp))
+	chk_js("", "\"\"");
+	chk_js("abc", "\"abc\"");
+	chk_js("a\"b\\c/d", "\"a\\\"b\\\\c/d\"");
+	chk_js("&<>", "\"&<>\"");
+	chk_js("a\nb\tc", "\"a\\nb\\tc\"");
+	chk_js("\x01\r\x1f\x7f", "\"\\u0001\\u000d\\u001f\\u007f\"");
+	chk_js("🤘 Øyvind", "\"🤘 Øyvind\"");
+#undef chk_js
+}
+
+/*
+ * chk_jrt() - Used by test_json_entry(). Converts `entry` to JSON with 
+ * json_entry(), parses it back with parse_json_entry() and verifies that the 
+ * result gives the same XML as the original entry. If `exp` isn't NULL, the 
+ * JSON must be identical to `exp`. Returns nothing.
+ */
+
+static void chk_jrt(const int linenum, const struct Entry *entry,
+                    const bool raw, const char *exp, const char *desc)
+{
+	struct Entry parsed;
+	char *json, *json2 = NULL, *xml = NULL, *xml2 = NULL;
+	bool raw2;
+
+	assert(entry);
+	assert(desc);
+	assert(*desc);
+
+	init_xml_entry(&parsed);
+	json = json_entry(entry, raw);
+	if (!json) {
+		failed_ok("json_entry()"); /* gncov */
+		return; /* gncov */
+	}
+	if (exp) {
+		OK_STRCMP_L(json, exp, linenum, "%s (JSON)", desc);
+		print_gotexp(json, exp);
+	}
+	OK_SUCCESS_L(parse_json_entry(json, &parsed, &raw2), linenum,
+	             "%s (parse)", desc);
+	OK_EQUAL_L(raw2, raw, linenum, "%s (raw flag)", desc);
+	xml = xml_entry(entry, raw);
+	xml2 = xml_entry(&parsed, raw2);
+	if (!xml || !xml2) {
+		failed_ok("xml_entry()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_STRCMP_L(xml2, xml, linenum, "%s (same XML)", desc);
+	print_gotexp(xml2, xml);
+	json2 = json_entry(&parsed, raw2);
+	if (!json2) {
+		failed_ok("json_entry()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_STRCMP_L(json2, json, linenum, "%s (same JSON)", desc);
+
+cleanup:
+	free(json2);
+	free(xml2);
+	free(xml);
+	free(json);
+	free_sess(&parsed);
+	free_tags(&parsed);
+	free(parsed.txt);
+	free(parsed.host);
+	free(parsed.cwd);
+	free(parsed.user);
+	free(parsed.tty);
+}
+
+/*
+ * chk_pje() - Used by test_json_entry(). Verifies that parse_json_entry() 
+ * refuses to parse `s`. Returns nothing.
+ */
+
+static void chk_pje(const int linenum, const char *s, const char *desc)
+{
+	struct Entry entry;
+	bool raw;
+
+	assert(s);
+	assert(desc);
+	assert(*desc);
+
+	init_xml_entry(&entry);
+	OK_FAILURE_L(parse_json_entry(s, &entry, &raw), linenum,
+	             "parse_json_entry(): %s", desc);
+	free_sess(&entry);
+	free_tags(&entry);
+	free(entry.txt);
+	free(entry.host);
+	free(entry.cwd);
+	free(entry.user);
+	free(entry.tty);
+}
+
+/*
+ * test_json_entry() - Tests json_entry() and parse_json_entry(). Returns 
+ * nothing.
+ */
+
+static void test_json_entry(void)
+{
+	struct Entry e;
+	struct Entry parsed;
+	bool raw;
+
+	diag("Test json_entry() and parse_json_entry()");
+
+#define chk_jrt(entry, raw, exp, desc)  chk_jrt(__LINE__, (entry), (raw), \
+                                                (exp), (desc))
+	init_xml_entry(&e);
+	strcpy(e.uuid, "5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce");
+	strcpy(e.date, "2025-10-18T12:34:56.7891234Z");
+	chk_jrt(&e, false,
+	        "{\"t\":\"2025-10-18T12:34:56.7891234Z\","
+	        "\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	        "Only UUID and date");
+
+	e.tag[0] = "tag1";
+	e.tag[1] = "tag & <2>";
+	e.txt = "Text with \"quotes\",\n\ttabs and \\ backslash";
+	e.host = "hname";
+	e.cwd = "/home/\"user\"/dir";
+	e.user = "user";
+	e.tty = "/dev/pts/7";
+	e.sess[0].uuid = "5175c9c8-5f82-11f0-a282-83850402c3ce";
+	e.sess[0].desc = "xterm";
+	e.sess[1].uuid = "cd2c846c-5f82-11f0-903a-83850402c3ce";
+	chk_jrt(&e, false,
+	        "{\"t\":\"2025-10-18T12:34:56.7891234Z\","
+	        "\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"tag\":[\"tag1\",\"tag & <2>\"],"
+	        "\"txt\":\"Text with \\\"quotes\\\",\\n\\ttabs and"
+	        " \\\\ backslash\","
+	        "\"host\":\"hname\","
+	        "\"cwd\":\"/home/\\\"user\\\"/dir\","
+	        "\"user\":\"user\","
+	        "\"tty\":\"/dev/pts/7\","
+	        "\"sess\":[{\"desc\":\"xterm\","
+	        "\"uuid\":\"5175c9c8-5f82-11f0-a282-83850402c3ce\"},"
+	        "{\"uuid\":\"cd2c846c-5f82-11f0-903a-83850402c3ce\"}]}",
+	        "All elements");
+
+	e.txt = "<a href=\"x\">b</a>";
+	chk_jrt(&e, true, NULL, "Raw XML in txt");
+	e.txt = "";
+	chk_jrt(&e, true, NULL, "Empty raw txt");
+	chk_jrt(&e, false, NULL, "Empty txt");
+	e.txt = "🤘 Øyvind, \x7f";
+	chk_jrt(&e, false, NULL, "UTF-8 and control character");
+	memset(e.date, 0, DATE_LENGTH + 1);
+	chk_jrt(&e, false, NULL, "Missing date");
+#undef chk_jrt
+
+	diag("parse_json_entry() with valid JSON that json_entry() doesn't"
+	     " produce");
+	init_xml_entry(&parsed);
+	OK_SUCCESS(parse_json_entry(" { \"u\" : "
+	                            "\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\" ,"
+	                            "\"txt\":\"\\u00d8\\ud83e\\udd18\\/"
+	                            "\\b\\f\\r\", \"tag\" : [ ] ,"
+	                            "\"sess\":[ ], \"raw\":false }\n",
+	                            &parsed, &raw),
+	           "parse_json_entry() with whitespace and escapes");
+	OK_STRCMP(parsed.uuid, "5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce",
+	          "UUID is parsed");
+	OK_STRCMP(parsed.txt ? parsed.txt : "", "Ø🤘/\b\f\r",
+	          "Escapes in txt are decoded");
+	OK_FALSE(raw, "raw is false");
+	free(parsed.txt);
+
+#define chk_pje(s, desc)  chk_pje(__LINE__, (s), (desc))
+	chk_pje("", "Empty string");
+	chk_pje("[]", "Array instead of object");
+	chk_pje("{}", "Empty object");
+	chk_pje("{\"t\":\"2025-10-18T12:34:56.7891234Z\"}", "Missing UUID");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3c\"}",
+	        "UUID is too short");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	        "Duplicated UUID");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"t\":\"2025-10-18 12:34:56.7891234Z\"}", "Invalid date");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"",
+	        "Missing end brace");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"} x",
+	        "Garbage after object");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"abc\":\"def\"}", "Unknown key");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"host\":\"a\",\"host\":\"b\"}", "Duplicated host");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"a\\x\"}", "Unknown escape");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"a\\u12g4\"}", "Invalid \\u escape");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"a\\u0000\"}", "\\u0000 in string");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"\\ud83e\"}", "Lone high surrogate");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"\\udd18\"}", "Lone low surrogate");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"a\tb\"}", "Unescaped control character");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"txt\":\"abc}", "Unterminated string");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"raw\":1}", "raw is not a boolean");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"tag\":[\"a\",1]}", "Number in tag array");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"tag\":\"a\"}", "tag is not an array");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"tag\":[\"a\"}", "Unterminated tag array");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"tag\":[\"a\"],\"tag\":[\"b\"]}", "Duplicated tag array");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[{\"desc\":\"a\"}]}", "sess without uuid");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[{\"uuid\":\"a\",\"x\":\"b\"}]}",
+	        "Unknown key in sess");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[{\"uuid\":\"a\",\"uuid\":\"b\"}]}",
+	        "Duplicated uuid in sess");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[\"a\"]}", "sess element is not an object");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[{\"uuid\":\"a\"}}", "Unterminated sess array");
+	chk_pje("{\"u\":\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\","
+	        "\"sess\":[{\"uuid\" \"a\"}]}", "Missing colon in sess");
+	chk_pje("{\"u\" \"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	        "Missing colon");
+	chk_pje("{u:\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	        "Unquoted key");
+#undef chk_pje
+}
+
+/*
+ * test_json_request() - Tests the json_request() and parse_json_request() 
+ * functions. Returns nothing.
+ */
+
+static void test_json_request(void)
+{
+	struct Entry e, parsed;
+	struct Request req;
+	bool raw;
+	char *s;
+
+	diag("Test json_request() and parse_json_request()");
+
+	init_xml_entry(&e);
+	e.tag[0] = "tag1";
+	e.txt = "<b>Raw</b>";
+	e.cwd = "/tmp";
+	e.sess[0].uuid = "5175c9c8-5f82-11f0-a282-83850402c3ce";
+	s = json_request(&e, true, 42);
+	if (!s) {
+		failed_ok("json_request()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_STRCMP(s, "{\"n\":42,\"tag\":[\"tag1\"],"
+	             "\"txt\":\"<b>Raw</b>\",\"raw\":true,\"cwd\":\"/tmp\","
+	             "\"sess\":[{\"uuid\":"
+	             "\"5175c9c8-5f82-11f0-a282-83850402c3ce\"}]}",
+	          "json_request() with count, tag, raw txt, cwd and sess");
+
+	init_xml_entry(&parsed);
+	OK_SUCCESS(parse_json_request(s, &parsed, &req),
+	           "parse_json_request() parses the request");
+	OK_EQUAL(req.count, 42, "The count is 42");
+	OK_TRUE(req.raw, "raw is true");
+	OK_NULL(req.whereto, "whereto is NULL");
+	OK_STRCMP(parsed.tag[0] ? parsed.tag[0] : "", "tag1", "Tag is parsed");
+	OK_STRCMP(parsed.cwd ? parsed.cwd : "", "/tmp", "cwd is parsed");
+	free(parsed.cwd);
+	free(parsed.txt);
+	free_sess(&parsed);
+	free_tags(&parsed);
+	free(s);
+
+	init_xml_entry(&parsed);
+	OK_SUCCESS(parse_json_request("{\"tag\":[\"a\"],\"w\":\"e\"}",
+	                              &parsed, &req),
+	           "parse_json_request() without \"n\"");
+	OK_EQUAL(req.count, 1, "The count is 1 by default");
+	OK_FALSE(req.raw, "raw is false by default");
+	OK_STRCMP(req.whereto ? req.whereto : "", "e", "whereto is parsed");
+	free(req.whereto);
+	free_tags(&parsed);
+	init_xml_entry(&parsed);
+	OK_FAILURE(parse_json_request("{\"n\":-1}", &parsed, &req),
+	           "parse_json_request() with negative \"n\"");
+	OK_FAILURE(parse_json_request("{\"n\":1,\"u\":"
+	                              "\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	                              &parsed, &req),
+	           "parse_json_request() with \"u\"");
+	OK_FAILURE(parse_json_entry("{\"n\":1,\"u\":"
+	                            "\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	                            &parsed, &raw),
+	           "parse_json_entry() with \"n\"");
+	OK_FAILURE(parse_json_entry("{\"w\":\"e\",\"u\":"
+	                            "\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"}",
+	                            &parsed, &raw),
+	           "parse_json_entry() with \"w\"");
+}
+
                               /*** logfile.c ***/
 
 /*
@@ -1767,12 +2427,11 @@ static void test_read_from_file(void)
  * Returns nothing.
  */
 
-static void chk_csx(const int linenum, const struct Sess *sess,
+static void chk_csx(const int linenum, struct Sess *sess,
                     const char *exp, const char *desc)
 {
 	struct Entry entry;
 	char *result;
-	int i;
 
 	assert(sess);
 	assert(exp);
@@ -1780,11 +2439,8 @@ static void chk_csx(const int linenum, const struct Sess *sess,
 	assert(*desc);
 
 	init_xml_entry(&entry);
-	for (i = 0; i < MAX_SESS; i++) {
-		entry.sess[i].uuid = sess[i].uuid;
-		entry.sess[i].desc = sess[i].desc;
-	}
-	OK_NOTNULL_L(result = create_sess_xml(&entry), linenum,
+	entry.sess = sess;
+	OK_NOTNULL_L(result = create_sess_xml(NULL, &entry), linenum,
 	             "Generate sess array, %s", desc);
 	if (!result) {
 		failed_ok("create_sess_xml()"); /* gncov */
@@ -1802,12 +2458,12 @@ static void chk_csx(const int linenum, const struct Sess *sess,
 
 static void test_create_sess_xml(void)
 {
-	struct Sess sess[MAX_SESS];
+	struct Sess sess[3];
 
 	diag("Test create_sess_xml()");
 
 #define chk_csx(sess, exp, desc)  chk_csx(__LINE__, (sess), (exp), (desc))
-	init_sess_array(sess);
+	init_sess_array(sess, 3);
 	chk_csx(sess, "", "No sess elements");
 
 	sess[0].uuid = "5175c9c8-5f82-11f0-a282-83850402c3ce";
@@ -1833,6 +2489,195 @@ static void test_create_sess_xml(void)
 #undef chk_csx
 }
 
+/*
+ * chk_pxl() - Used by test_parse_xml_line(). Verifies that parse_xml_line() 
+ * returns `exp_ret` when parsing `line`, and if it succeeds, that `raw` is set 
+ * to `exp_raw`. `desc` is a short test description. Returns nothing.
+ */
+
+static void chk_pxl(const int linenum, const char *line, const int exp_ret,
+                    const bool exp_raw, const char *desc)
+{
+	struct Entry entry;
+	bool raw = false;
+	int ret;
+
+	assert(line);
+	assert(desc);
+	assert(*desc);
+
+	init_xml_entry(&entry);
+	ret = parse_xml_line(line, &entry, &raw);
+	OK_EQUAL_L(ret, exp_ret, linenum, "%s (retval)", desc);
+	if (!ret)
+		OK_TRUE_L(raw == exp_raw, linenum, "%s (raw)", desc);
+	free_sess(&entry);
+	free_tags(&entry);
+	free(entry.txt);
+	free(entry.host);
+	free(entry.cwd);
+	free(entry.user);
+	free(entry.tty);
+}
+
+/*
+ * test_parse_xml_line() - Tests the parse_xml_line() function. Returns 
+ * nothing.
+ */
+
+static void test_parse_xml_line(void)
+{
+	struct Entry e, parsed;
+	char *ap;
+	bool raw;
+
+	diag("Test parse_xml_line()");
+
+#define chk_pxl(line, exp_ret, exp_raw, desc)  chk_pxl(__LINE__, (line), \
+                                                       (exp_ret), \
+                                                       (exp_raw), (desc))
+	init_xml_entry(&e);
+	strcpy(e.uuid, "5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce");
+	strcpy(e.date, "2025-10-18T12:34:56.7891234Z");
+	e.tag[0] = "tag1";
+	e.tag[1] = "tag & <2>";
+	e.txt = "Text with <xml>,\n\ttabs and \\ backslash";
+	e.host = "hname";
+	e.cwd = "/home/user/dir";
+	e.user = "user";
+	e.tty = "/dev/pts/7";
+	e.sess[0].uuid = "5175c9c8-5f82-11f0-a282-83850402c3ce";
+	e.sess[0].desc = "xterm";
+	e.sess[1].uuid = "cd2c846c-5f82-11f0-903a-83850402c3ce";
+	ap = xml_entry(&e, false);
+	if (!ap) {
+		failed_ok("xml_entry()"); /* gncov */
+		return; /* gncov */
+	}
+	chk_pxl(ap, 0, false, "All elements");
+	init_xml_entry(&parsed);
+	OK_SUCCESS(parse_xml_line(ap, &parsed, &raw), "Parse all elements");
+	OK_STRCMP(parsed.txt ? parsed.txt : "", e.txt, "txt is unescaped");
+	OK_STRCMP(parsed.tag[1] ? parsed.tag[1] : "", e.tag[1],
+	          "Tag is unescaped");
+	OK_STRCMP(parsed.sess[0].desc ? parsed.sess[0].desc : "", "xterm",
+	          "sess desc is parsed");
+	free_sess(&parsed);
+	free_tags(&parsed);
+	free(parsed.txt);
+	free(parsed.host);
+	free(parsed.cwd);
+	free(parsed.user);
+	free(parsed.tty);
+	free(ap);
+
+	e.txt = "<a href=\"x\">b</a>";
+	ap = xml_entry(&e, true);
+	if (ap)
+		chk_pxl(ap, 0, true, "Raw XML in txt");
+	free(ap);
+
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"> </suuid>",
+	        0, false, "Only UUID and date");
+	chk_pxl("", 1, false, "Empty string");
+	chk_pxl("<suuid t=\"2025\" u=\"x\"> odd </suuid>", 1, false,
+	        "Short date and UUID");
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\">  </suuid>",
+	        1, false, "Extra space");
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\">"
+	        " <user>u</user> <host>h</host> </suuid>",
+	        1, false, "Elements in wrong order");
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\">"
+	        " <tag>&quot;</tag> </suuid>",
+	        1, false, "Unknown entity in tag");
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"> <host>h</host> ",
+	        1, false, "Missing end tag");
+	chk_pxl("<suuid t=\"2025-10-18T12:34:56.7891234Z\""
+	        " u=\"5f1b9a6c-ad7b-11f0-8a4e-83850402c3ce\"> </suuid> ",
+	        1, false, "Space after end tag");
+#undef chk_pxl
+}
+
+                               /*** lz.c ***/
+
+/*
+ * chk_lz() - Used by test_lz(). Compresses `len` bytes at `src` with 
+ * lz_compress(), decompresses the result with lz_decompress() and verifies 
+ * that it's identical to `src`. Returns nothing.
+ */
+
+static void chk_lz(const int linenum, const char *src, const size_t len,
+                   const char *desc)
+{
+	unsigned char *cbuf, *dbuf;
+	size_t clen;
+
+	assert(src);
+	assert(desc);
+
+	cbuf = malloc(lz_bound(len));
+	dbuf = malloc(len + 1);
+	if (!cbuf || !dbuf) {
+		failed_ok("malloc()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	clen = lz_compress((const unsigned char *)src, len, cbuf);
+	OK_TRUE_L(clen && clen <= lz_bound(len), linenum,
+	          "%s: Compressed size is within the bound", desc);
+	OK_SUCCESS_L(lz_decompress(cbuf, clen, dbuf, len), linenum,
+	             "%s: Decompress", desc);
+	OK_MEMCMP_L(dbuf, src, len, linenum, "%s: Data is unchanged", desc);
+	if (clen > 1)
+		OK_FAILURE_L(lz_decompress(cbuf, clen - 1, dbuf, len),
+		             linenum, "%s: Truncated data is detected", desc);
+	OK_FAILURE_L(lz_decompress(cbuf, clen, dbuf, len + 1), linenum,
+	             "%s: Wrong size is detected", desc);
+
+cleanup:
+	free(dbuf);
+	free(cbuf);
+}
+
+/*
+ * test_lz() - Tests the lz_compress() and lz_decompress() functions. Returns 
+ * nothing.
+ */
+
+static void test_lz(void)
+{
+	char *rep;
+	size_t i;
+
+	diag("Test lz_compress() and lz_decompress()");
+
+#define chk_lz(src, len, desc)  chk_lz(__LINE__, (src), (len), (desc))
+	chk_lz("", 0, "Empty input");
+	chk_lz("abc", 3, "Short input");
+	chk_lz("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 47,
+	       "Overlapping match");
+	rep = malloc(100000);
+	if (!rep) {
+		failed_ok("malloc()"); /* gncov */
+		return; /* gncov */
+	}
+	for (i = 0; i < 100000; i++)
+		rep[i] = "<suuid t=\"2025\" u=\"x\"> </suuid>\n"[i % 32];
+	chk_lz(rep, 100000, "Long repeated input");
+	for (i = 0; i < 100000; i++)
+		rep[i] = (char)((i * 7919 + i / 3) % 251);
+	chk_lz(rep, 100000, "Input with few matches");
+#undef chk_lz
+	OK_FAILURE(lz_decompress((const unsigned char *)"\x10" "a\0\0", 4,
+	                         (unsigned char *)rep, 5),
+	           "lz_decompress() with offset 0");
+	free(rep);
+}
+
                               /*** rcfile.c ***/
 
 /*
@@ -1889,23 +2734,163 @@ static void test_has_key(void)
 #undef chk_hk
 }
 
-                              /*** sessvar.c ***/
+                              /*** segment.c ***/
 
 /*
- * chk_gsi() - Used by test_get_sess_info(). Verifies that the value `env` in 
- * the environment variable defined by ENV_SESS results in the XML in `exp`. 
- * Returns nothing.
+ * chk_ps() - Used by test_parse_segment(). Verifies that parse_segment() 
+ * parses `s` to mode `exp_mode` and size `exp_size`. Returns nothing.
  */
 
-static void chk_gsi(const int linenum, const char *env, const char *exp,
-                    const char *desc)
+static void chk_ps(const int linenum, const char *s,
+                   const enum segmode exp_mode,
+                   const unsigned long long exp_size)
 {
-	struct Entry entry;
-	char *chk_env, *result = NULL;
+	struct Segment seg;
 
-	assert(env);
-	assert(exp);
-	assert(desc);
+	assert(s);
+
+	OK_SUCCESS_L(parse_segment(s, &seg), linenum,
+	             "parse_segment(\"%s\")", s);
+	OK_EQUAL_L(seg.mode, exp_mode, linenum, "\"%s\" (mode)", s);
+	OK_TRUE_L(seg.size == exp_size, linenum, "\"%s\" (size)", s);
+}
+
+/*
+ * test_parse_segment() - Tests the parse_segment() function with valid 
+ * values. Returns nothing.
+ */
+
+static void test_parse_segment(void)
+{
+	diag("Test parse_segment()");
+
+#define chk_ps(s, exp_mode, exp_size)  chk_ps(__LINE__, (s), (exp_mode), \
+                                              (exp_size))
+	chk_ps("none", SEGMENT_NONE, 0);
+	chk_ps("month", SEGMENT_MONTH, 0);
+	chk_ps("1", SEGMENT_SIZE, 1);
+	chk_ps("100000", SEGMENT_SIZE, 100000);
+	chk_ps("64k", SEGMENT_SIZE, 65536);
+	chk_ps("10M", SEGMENT_SIZE, 10485760);
+	chk_ps("2G", SEGMENT_SIZE, 2147483648ULL);
+#undef chk_ps
+}
+
+/*
+ * chk_ro() - Used by test_range_overlaps(). Verifies that 
+ * range_overlaps(range, first, last) returns `exp`. Returns nothing.
+ */
+
+static void chk_ro(const int linenum, const char *range, const char *first,
+                   const char *last, const bool exp)
+{
+	assert(range);
+	assert(first);
+	assert(last);
+
+	OK_EQUAL_L(range_overlaps(range, first, last), exp, linenum,
+	           "range_overlaps(\"%s\", \"%s\", \"%s\")",
+	           range, first, last);
+}
+
+/*
+ * test_range_overlaps() - Tests the range_overlaps() function. Returns 
+ * nothing.
+ */
+
+static void test_range_overlaps(void)
+{
+	diag("Test range_overlaps()");
+
+#define chk_ro(range, first, last, exp)  chk_ro(__LINE__, (range), (first), \
+                                                (last), (exp))
+	chk_ro(",", "2025-01-01", "2025-12-31", true);
+	chk_ro("2025", "2025-01-01", "2025-12-31", true);
+	chk_ro("2024", "2025-01-01", "2025-12-31", false);
+	chk_ro("2026", "2025-01-01", "2025-12-31", false);
+	chk_ro("2025-06,", "2025-01-01", "2025-12-31", true);
+	chk_ro("2025-12-31,", "2025-01-01", "2025-12-31T10:00:00", true);
+	chk_ro("2026,", "2025-01-01", "2025-12-31", false);
+	chk_ro(",2025-01", "2025-01-31", "2025-12-31", true);
+	chk_ro(",2024-12-31", "2025-01-01", "2025-12-31", false);
+	chk_ro("2025-03,2025-04", "2025-01-01", "2025-02-28", false);
+	chk_ro("2025-02,2025-04", "2025-01-01", "2025-02-28", true);
+#undef chk_ro
+}
+
+                              /*** sessvar.c ***/
+
+/*
+ * test_is_legal_desc_char() - Tests that the table used by 
+ * is_legal_desc_char() contains the same characters as DESC_LEGAL. Returns 
+ * nothing.
+ */
+
+static void test_is_legal_desc_char(void)
+{
+	unsigned int c, errs = 0;
+
+	diag("Test is_legal_desc_char()");
+
+	for (c = 1; c < 256; c++) {
+		if (is_legal_desc_char((char)c)
+		    != (strchr(DESC_LEGAL, (int)c) != NULL))
+			errs++;
+	}
+	OK_EQUAL(errs, 0, "is_legal_desc_char() matches DESC_LEGAL");
+	OK_FALSE(is_legal_desc_char('\0'), "Null byte isn't legal in desc");
+}
+
+/*
+ * test_parse_sessvar() - Tests the parse_sessvar() function. Returns nothing.
+ */
+
+static void test_parse_sessvar(void)
+{
+	const char *s = "ab/c/da700fd8-43eb-11e2-889a-0016d364066c,"
+	                "x;ee5db39a-43f7-11e2-a975-0016d364066c"
+	                "def5f650dac-4404-11e2-8e0e-0016d364066c"
+	                "c9ffa9cb-708d-454b-b1f2-f18f609cb825";
+	struct Sesslink links[5];
+	size_t n;
+
+	diag("Test parse_sessvar()");
+
+	OK_EQUAL(parse_sessvar("", 0, NULL), 0, "parse_sessvar() with empty"
+	                                        " string");
+	n = parse_sessvar(s, strlen(s), links);
+	OK_EQUAL(n, 3, "3 UUIDs are found, the v4 UUID is ignored");
+	if (n != 3)
+		return; /* gncov */
+
+	OK_STRNCMP(s + links[0].uuid, "da700fd8-43eb-11e2-889a-0016d364066c",
+	           UUID_LENGTH, "The first UUID is found");
+	OK_TRUE(links[0].desc == 0 && links[0].desclen == 4,
+	        "The first desc is \"ab/c\", ending at the last slash");
+	OK_STRNCMP(s + links[1].uuid, "ee5db39a-43f7-11e2-a975-0016d364066c",
+	           UUID_LENGTH, "The second UUID is found");
+	OK_EQUAL(links[1].desclen, 0, "The semicolon removes the second desc");
+	OK_STRNCMP(s + links[2].uuid, "5f650dac-4404-11e2-8e0e-0016d364066c",
+	           UUID_LENGTH, "The third UUID is found");
+	OK_TRUE(links[2].desc == 80 && links[2].desclen == 3,
+	        "The third desc is \"def\", without slash");
+}
+
+/*
+ * chk_gsi() - Used by test_get_sess_info(). Verifies that the value `env` in 
+ * the environment variable defined by ENV_SESS results in the XML in `exp`. 
+ * Returns nothing.
+ */
+
+static void chk_gsi(const int linenum, const char *env, const char *exp,
+                    const char *desc)
+{
+	struct Entry entry;
+	char *chk_env, *result = NULL;
+
+	assert(env);
+	assert(exp);
+	assert(desc);
 	assert(*desc);
 
 	diag(desc);
@@ -1929,7 +2914,7 @@ static void chk_gsi(const int linenum, const char *env, const char *exp,
 		return; /* gncov */
 	}
 
-	OK_NOTNULL_L(result = create_sess_xml(&entry), linenum,
+	OK_NOTNULL_L(result = create_sess_xml(NULL, &entry), linenum,
 	                                      "Extract info from %s",
 	                                      ENV_SESS);
 	if (!result) {
@@ -2274,6 +3259,71 @@ static void test_string_to_lower(void)
 	print_gotexp(s1, "abcÅÆØ");
 }
 
+                                /*** tag.c ***/
+
+/*
+ * test_store_tag() - Tests the store_tag(), tag_exists() and drop_tags() 
+ * functions. Returns nothing.
+ */
+
+static void test_store_tag(void)
+{
+	struct Entry entry;
+	struct Arena arena;
+	char buf[32], *p;
+	unsigned int i;
+
+	diag("Test store_tag()");
+	init_xml_entry(&entry);
+
+	OK_SUCCESS(store_tag(&entry, " a , b,,a ,\tc\n, "),
+	           "store_tag() with spaces and empty tags");
+	OK_EQUAL(entry.tag_count, 3, "3 tags are stored");
+	OK_STRCMP(entry.tag[0], "a", "The first tag is \"a\"");
+	OK_STRCMP(entry.tag[1], "b", "The second tag is \"b\"");
+	OK_STRCMP(entry.tag[2], "c", "The third tag is \"c\"");
+	OK_NULL(entry.tag_set, "No hash set is used for a few tags");
+	OK_SUCCESS(store_tag(&entry, ""), "store_tag() with empty string");
+	OK_EQUAL(entry.tag_count, 3, "Still 3 tags");
+
+	for (i = 0; i < 200; i++) {
+		snprintf(buf, sizeof(buf), "t%u,t%u", i, i / 2);
+		if (store_tag(&entry, buf)) {
+			failed_ok("store_tag()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+	}
+	OK_EQUAL(entry.tag_count, 203, "203 tags are stored");
+	OK_NOTNULL(entry.tag_set, "The hash set is used");
+	OK_TRUE(entry.tag_set_size >= 2 * entry.tag_count,
+	        "The hash set is at most half full");
+	OK_STRCMP(entry.tag[202], "t199", "The tags are in insertion order");
+	OK_TRUE(tag_exists(&entry, "t150"), "tag_exists(\"t150\")");
+	OK_FALSE(tag_exists(&entry, "t200"), "tag_exists(\"t200\") is false");
+
+	drop_tags(&entry, 4);
+	OK_EQUAL(entry.tag_count, 4, "drop_tags() leaves 4 tags");
+	OK_FALSE(tag_exists(&entry, "t1"), "The dropped tag \"t1\" is gone");
+	OK_TRUE(tag_exists(&entry, "t0"), "\"t0\" is still there");
+	OK_SUCCESS(store_tag(&entry, "t1,b,t0"), "Add \"t1\" again");
+	OK_EQUAL(entry.tag_count, 5, "5 tags after the new store_tag()");
+	OK_STRCMP(entry.tag[4], "t1", "\"t1\" is the last tag");
+	OK_TRUE(tag_exists(&entry, "t1"), "\"t1\" exists");
+
+cleanup:
+	free_tags(&entry);
+	OK_NULL(entry.tag_set, "free_tags() frees the hash set");
+
+	arena_init(&arena, NULL, 0);
+	entry.arena = &arena;
+	OK_SUCCESS(store_tag(&entry, "x, y ,x"), "store_tag() with arena");
+	OK_EQUAL(entry.tag_count, 2, "2 tags from the arena");
+	p = entry.tag[1];
+	OK_STRCMP(p ? p : "", "y", "The second tag from the arena is \"y\"");
+	free_tags(&entry);
+	arena_free(&arena);
+}
+
                                /*** uuid.c ***/
 
 /*
@@ -2394,6 +3444,35 @@ static void test_uuid_date(void)
 #undef chk_ud
 }
 
+/*
+ * test_uuid_to_bin() - Tests uuid_to_bin(), bin_to_uuid() and uuid_ticks(). 
+ * Returns nothing.
+ */
+
+static void test_uuid_to_bin(void)
+{
+	unsigned char bin[UUID_BIN_LENGTH];
+	char buf[UUID_LENGTH + 1];
+	const char *uuid = "acdaf974-e78e-11e7-87d5-f74d993421b0";
+
+	diag("Test uuid_to_bin(), bin_to_uuid() and uuid_ticks()");
+
+	OK_SUCCESS(uuid_to_bin(bin, uuid), "uuid_to_bin() with valid UUID");
+	OK_TRUE(bin[0] == 0xac && bin[7] == 0xe7 && bin[15] == 0xb0,
+	        "Binary UUID is correct");
+	memset(buf, 0, UUID_LENGTH + 1);
+	OK_STRCMP(bin_to_uuid(buf, bin), uuid, "bin_to_uuid() converts back");
+	OK_FAILURE(uuid_to_bin(bin, "notvalid"), "uuid_to_bin() with invalid"
+	                                         " UUID");
+	OK_FAILURE(uuid_to_bin(bin, "ACDAF974-E78E-11E7-87D5-F74D993421B0"),
+	           "uuid_to_bin() with uppercase UUID");
+
+	OK_TRUE(uuid_ticks(uuid) == 0x1e7e78eacdaf974ULL,
+	        "uuid_ticks() returns the timestamp");
+	OK_TRUE(uuid_ticks("c9ffa9cb-708d-454b-b1f2-f18f609cb825") == 0,
+	        "uuid_ticks() returns 0 for a v4 UUID");
+}
+
 /******************************************************************************
                    Function tests, use a temporary directory
 ******************************************************************************/
@@ -2518,15 +3597,15 @@ cleanup:
                               /*** genuuid.c ***/
 
 /*
- * test_fill_entry_struct() - Tests the fill_entry_struct() function. Returns 
- * nothing.
+ * test_fill_entry_struct() - Tests the fill_entry_struct() function with more 
+ * sess elements than there's room for inside `struct Entry`. Returns nothing.
  */
 
 static void test_fill_entry_struct(void)
 {
-	size_t bufsize = 1 + (UUID_LENGTH + 1) * (MAX_SESS + 1) + 1,
-	       t, buf_len;
-	char *buf, *p, *bufchk, *desc = NULL, *exp_stderr = NULL;
+	const size_t count = 1001;
+	size_t bufsize = 1 + (UUID_LENGTH + 1) * count + 1, t, buf_len;
+	char *buf, *p, *bufchk, last[UUID_LENGTH + 1];
 	int res;
 	struct Entry entry;
 	struct Rc rc;
@@ -2534,6 +3613,7 @@ static void test_fill_entry_struct(void)
 
 	diag("Test fill_entry_struct()");
 
+	init_xml_entry(&entry);
 	buf = malloc(bufsize);
 	if (!buf) {
 		failed_ok("malloc()"); /* gncov */
@@ -2542,14 +3622,16 @@ static void test_fill_entry_struct(void)
 
 	p = buf;
 	*p++ = ',';
-	for (t = 0; t < MAX_SESS + 1; t++) {
+	for (t = 0; t < count; t++) {
 		generate_uuid(p);
 		p += UUID_LENGTH;
 		*p++ = ',';
 	}
 	*p = '\0';
+	memcpy(last, p - 1 - UUID_LENGTH, UUID_LENGTH);
+	last[UUID_LENGTH] = '\0';
 	OK_SUCCESS(res = setenv(ENV_SESS, buf, 1),
-	           "Init %s variable with MAX_SESS + 1 UUIDs", ENV_SESS);
+	           "Init %s variable with %zu UUIDs", ENV_SESS, count);
 	if (res) {
 		diag("Cannot set %s variable: %s", /* gncov */
 		     ENV_SESS, strerror(errno)); /* gncov */
@@ -2566,7 +3648,6 @@ static void test_fill_entry_struct(void)
 	         "Length of the %s variable is %zu bytes",
 	         ENV_SESS, bufsize - 1);
 
-	init_xml_entry(&entry);
 	init_rc(&rc);
 	rc.hostname = HNAME;
 
@@ -2578,23 +3659,24 @@ static void test_fill_entry_struct(void)
 	res = fill_entry_struct(&entry, &rc, &opt);
 	restore_output_files();
 
-	desc = allocstr("%s contains more than %u UUIDs", ENV_SESS, MAX_SESS);
-	if (!desc) {
-		failed_ok("allocstr()"); /* gncov */
-		goto cleanup; /* gncov */
-	}
-	OK_EQUAL(res, 1, "%s (retval)", desc);
-	exp_stderr = allocstr("%s: Maximum number of sess entries (%u)"
-	                      " exceeded\n", execname, MAX_SESS);
-	verify_output_files(desc, "", exp_stderr);
+	OK_SUCCESS(res, "fill_entry_struct() with %zu sess UUIDs", count);
+	verify_output_files("fill_entry_struct() with many sess UUIDs", "",
+	                    "");
+	OK_EQUAL(entry.sess_count, count, "All sess elements are stored");
+	OK_TRUE(entry.sess != entry.sess_buf,
+	        "The sess array is moved to the heap");
+	OK_STRCMP(entry.sess[count - 1].uuid ? entry.sess[count - 1].uuid
+	                                     : "",
+	          last, "The last sess element is correct");
+	OK_NULL(entry.sess[count].uuid, "The sess array ends with NULL");
 	unset_env(ENV_SESS);
 
 cleanup:
-	free(exp_stderr);
-	free(desc);
 	free(buf);
 	free(entry.cwd);
 	free_sess(&entry);
+	OK_TRUE(entry.sess == entry.sess_buf && !entry.sess[0].uuid,
+	        "free_sess() resets the sess array");
 	cleanup_tempdir(__LINE__);
 }
 
@@ -2839,6 +3921,80 @@ cleanup:
 	OK_SUCCESS(remove(file), "Delete %s", file);
 }
 
+                              /*** logfile.c ***/
+
+/*
+ * chk_unlocked() - Used by test_xml_batches(). Verifies that the log file 
+ * isn't locked by another open file description. Returns nothing.
+ */
+
+static void chk_unlocked(const int linenum, const char *desc)
+{
+	int fd;
+
+	assert(desc);
+
+	fd = open(logfile, O_RDONLY);
+	if (fd == -1) {
+		failed_ok("open()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_SUCCESS_L(flock(fd, LOCK_EX | LOCK_NB), linenum,
+	             "%s, log file isn't locked", desc);
+	close(fd);
+}
+
+/*
+ * test_xml_batches() - Tests that the log file is only locked while a batch 
+ * of entries is written in XML mode, and that entries from other processes 
+ * between the batches are kept. Returns nothing.
+ */
+
+static void test_xml_batches(void)
+{
+	struct Logs logs;
+	struct Entry entry, exp;
+	unsigned int i;
+
+	diag("Test the batches in XML mode");
+	if (init_tempdir())
+		return; /* gncov */
+
+	init_xml_entry(&entry);
+	strcpy(entry.date, "2026-10-18T12:00:00.0000000Z");
+	strcpy(entry.uuid, "a06f9b42-69d4-11f0-9d7b-83850402c3ce");
+	entry.host = hname();
+	entry.cwd = "/";
+	entry.user = "user";
+	init_xml_entry(&exp);
+	exp.host = entry.host;
+
+	logs.mode = LOGMODE_XML;
+	logs.sync = SYNC_NONE;
+	logs.lock.timeout = -1;
+	if (OK_SUCCESS(open_logfile(&logs, logfile, NULL, NULL),
+	               "open_logfile() in XML mode"))
+		goto cleanup; /* gncov */
+	chk_unlocked(__LINE__, "After open_logfile()");
+	verify_logfile(&exp, 0, "New log file has header and trailer");
+	for (i = 0; i <= LOG_BATCH_ENTRIES; i++) {
+		if (add_to_logfile(&logs, &entry, false))
+			break; /* gncov */
+	}
+	OK_EQUAL(i, LOG_BATCH_ENTRIES + 1, "Add %u entries",
+	         LOG_BATCH_ENTRIES + 1);
+	verify_logfile(&exp, LOG_BATCH_ENTRIES, "The first batch is written");
+	chk_unlocked(__LINE__, "After the first batch");
+	uc((chp{ execname, NULL }), 1, 0,
+	   "Another process adds an entry between the batches");
+	OK_SUCCESS(close_logfile(&logs), "close_logfile() in XML mode");
+	verify_logfile(&exp, LOG_BATCH_ENTRIES + 2,
+	               "The last batch is added after the other entry");
+
+cleanup:
+	cleanup_tempdir(__LINE__);
+}
+
                               /*** rcfile.c ***/
 
 /*
@@ -2896,7 +4052,11 @@ static void chk_rr(const int linenum, const char *contents, struct Rc *exp,
 	}
 
 	chk_rr_memb(linenum, got.hostname, exp->hostname, "hostname", desc);
+	chk_rr_memb(linenum, got.logmode, exp->logmode, "logmode", desc);
 	chk_rr_memb(linenum, got.macaddr, exp->macaddr, "macaddr", desc);
+	chk_rr_memb(linenum, got.segment, exp->segment, "segment", desc);
+	chk_rr_memb(linenum, got.shards, exp->shards, "shards", desc);
+	chk_rr_memb(linenum, got.sync, exp->sync, "sync", desc);
 
 	free_rc(&got);
 
@@ -2999,6 +4159,12 @@ static void test_read_rcfile(void)
 	       "macaddr with no value, but with trailing spaces");
 	chk_rr("macaddr: " MAC "\n", (sr{ .macaddr = NULL }),
 	       "macaddr with colon instead of equal sign");
+	chk_rr("logmode = append\n", (sr{ .logmode = "append" }),
+	       "logmode = append");
+	chk_rr("segment = month\n", (sr{ .segment = "month" }),
+	       "segment = month");
+	chk_rr("shards = 4\n", (sr{ .shards = "4" }), "shards = 4");
+	chk_rr("sync = batch\n", (sr{ .sync = "batch" }), "sync = batch");
 #undef chk_rr
 
 	diag("Invalid MAC address in the rc file");
@@ -3028,6 +4194,204 @@ static void test_read_rcfile(void)
 #undef sr
 }
 
+                               /*** seal.c ***/
+
+/*
+ * chk_unseal() - Used by test_seal_logfile(). Runs unseal_logfile() with 
+ * `sealfile` and `range` and verifies the return value and the output. 
+ * Returns nothing.
+ */
+
+static void chk_unseal(const int linenum, const char *sealfile,
+                       const char *range, const int exp_ret,
+                       const char *exp_stdout, const char *exp_stderr,
+                       const char *desc)
+{
+	int res;
+
+	assert(sealfile);
+	assert(exp_stdout);
+	assert(exp_stderr);
+	assert(desc);
+
+	if (init_output_files()) {
+		restore_output_files(); /* gncov */
+		failed_ok("init_output_files()"); /* gncov */
+		return; /* gncov */
+	}
+	res = unseal_logfile(sealfile, range, stdout);
+	restore_output_files();
+	OK_EQUAL_L(res, exp_ret, linenum, "%s (retval)", desc);
+	verify_output_files_func(linenum, desc, exp_stdout, exp_stderr);
+}
+
+/*
+ * test_seal_logfile() - Tests seal_logfile() and unseal_logfile() with a log 
+ * file that needs more than one block. Returns nothing.
+ */
+
+static void test_seal_logfile(void)
+{
+	char xmlfile[] = TMPDIR "/seal.xml";
+	char expfile[] = TMPDIR "/exp.xml";
+	char sealfile[] = TMPDIR "/seal" SEAL_EXTENSION;
+	const unsigned int count = SEAL_BLOCK_ENTRIES + 500,
+	                   start = SEAL_BLOCK_ENTRIES + 100;
+	char date[DATE_LENGTH + 1], *xml = NULL, *exp = NULL, *range = NULL;
+	char *exp_stderr = NULL;
+	unsigned char buf[SEAL_HDR_SIZE];
+	utime_t ticks = 138000000000000000ULL;
+	FILE *xfp, *efp;
+	unsigned int i;
+	int fd;
+
+	diag("Test seal_logfile() and unseal_logfile()");
+
+	xfp = fopen(xmlfile, "w");
+	efp = fopen(expfile, "w");
+	if (!xfp || !efp) {
+		failed_ok("fopen()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	fputs(LOGFILE_HEADER, xfp);
+	fputs(LOGFILE_HEADER, efp);
+	for (i = 0; i < count; i++, ticks += 10) {
+		char *line;
+
+		if (!ticks_date(date, ticks)) {
+			failed_ok("ticks_date()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		line = allocstr("<suuid t=\"%s\" u=\"%08llx-%04llx-1%03llx"
+		                "-8000-000000000000\"> <txt>Entry %u</txt>"
+		                " </suuid>\n",
+		                date, ticks & 0xffffffffULL,
+		                (ticks >> 32) & 0xffffULL, ticks >> 48, i);
+		if (!line) {
+			failed_ok("allocstr()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		fputs(line, xfp);
+		if (i >= start)
+			fputs(line, efp);
+		if (i == start)
+			range = allocstr("%s,", date);
+		free(line);
+	}
+	fputs(LOGFILE_TRAILER, xfp);
+	fputs(LOGFILE_TRAILER, efp);
+	OK_SUCCESS(fclose(xfp), "Close %s", xmlfile);
+	OK_SUCCESS(fclose(efp), "Close %s", expfile);
+	xfp = efp = NULL;
+	xml = read_from_file(xmlfile);
+	exp = read_from_file(expfile);
+	exp_stderr = allocstr("%s: %s: Block 1 is corrupt\n", execname,
+	                      sealfile);
+	if (!xml || !exp || !range || !exp_stderr) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+
+	OK_SUCCESS(seal_logfile(xmlfile), "seal_logfile()");
+	chk_unseal(__LINE__, sealfile, NULL, 0, xml, "",
+	           "unseal_logfile() recreates the log file");
+
+	diag("Only the blocks in the range are decompressed");
+	fd = open(sealfile, O_RDWR);
+	OK_TRUE(fd != -1 && pread(fd, buf, SEAL_HDR_SIZE, 0) == SEAL_HDR_SIZE,
+	        "Read header of %s", sealfile);
+	put_u32(buf, 1);
+	OK_TRUE(fd != -1 && pwrite(fd, buf, 4,
+	                           (off_t)get_u64(buf + 16) + 24) == 4,
+	        "Change the size of the first block");
+	if (fd != -1)
+		close(fd);
+	chk_unseal(__LINE__, sealfile, NULL, 1, LOGFILE_HEADER, exp_stderr,
+	           "unseal_logfile() with corrupt block");
+	chk_unseal(__LINE__, sealfile, range, 0, exp,  "",
+	           "unseal_logfile() with range skips the corrupt block");
+
+cleanup:
+	if (xfp)
+		fclose(xfp); /* gncov */
+	if (efp)
+		fclose(efp); /* gncov */
+	if (file_exists(sealfile))
+		OK_SUCCESS(remove(sealfile), "Delete %s", sealfile);
+	if (file_exists(expfile))
+		OK_SUCCESS(remove(expfile), "Delete %s", expfile);
+	if (file_exists(xmlfile))
+		OK_SUCCESS(remove(xmlfile), "Delete %s", xmlfile);
+	free(exp_stderr);
+	free(range);
+	free(exp);
+	free(xml);
+	cleanup_tempdir(__LINE__);
+}
+
+                               /*** writer.c ***/
+
+/*
+ * test_writer_thread() - Tests that the writer thread writes all entries, 
+ * also when the producer has to wait for a free slot in the ring. Returns 
+ * nothing.
+ */
+
+static void test_writer_thread(void)
+{
+	struct Logs logs;
+	struct Entry entry, exp;
+	unsigned int i, n = WRITER_RING_SLOTS * 3;
+
+	diag("Test the writer thread");
+	if (init_tempdir())
+		return; /* gncov */
+
+	init_xml_entry(&entry);
+	strcpy(entry.date, "2026-10-18T12:00:00.0000000Z");
+	strcpy(entry.uuid, "a06f9b42-69d4-11f0-9d7b-83850402c3ce");
+	entry.host = hname();
+	entry.cwd = "/";
+	entry.user = "user";
+	init_xml_entry(&exp);
+	exp.host = entry.host;
+
+	logs.mode = LOGMODE_XML;
+	logs.sync = SYNC_NONE;
+	logs.lock.timeout = -1;
+	if (OK_SUCCESS(open_logfile(&logs, logfile, NULL, NULL),
+	               "open_logfile() before starting the writer thread"))
+		goto cleanup; /* gncov */
+	writer_start(&logs);
+	OK_TRUE(logs.writer.running, "The writer thread is running");
+	for (i = 0; i < n; i++) {
+		if (add_to_logfile(&logs, &entry, false))
+			break; /* gncov */
+	}
+	OK_EQUAL(i, n, "Push %u entries to the writer thread", n);
+	OK_SUCCESS(writer_drain(&logs.writer), "writer_drain()");
+	OK_TRUE(logs.writer.running, "The writer thread is still running");
+	OK_EQUAL(logs.writer.written, (unsigned long)n,
+	         "The ring is empty after writer_drain()");
+	OK_SUCCESS(flush_logfile(&logs), "flush_logfile() after writer_drain()");
+	verify_logfile(&exp, n, "The entries are in the log file after"
+	               " writer_drain() and flush_logfile()");
+	if (add_to_logfile(&logs, &entry, false))
+		failed_ok("add_to_logfile()"); /* gncov */
+	n++;
+	OK_SUCCESS(close_logfile(&logs), "close_logfile() stops the writer");
+	OK_FALSE(logs.writer.running, "The writer thread is stopped");
+	OK_EQUAL(logs.writer.written, (unsigned long)n,
+	         "The writer thread wrote %u entries", n);
+	verify_logfile(&exp, n, "All entries from the writer thread are"
+	               " written");
+	OK_SUCCESS(writer_stop(&logs.writer),
+	           "writer_stop() when the thread isn't running");
+
+cleanup:
+	cleanup_tempdir(__LINE__);
+}
+
 /******************************************************************************
             Test the executable file, no temporary directory needed
 ******************************************************************************/
@@ -3354,6 +4718,85 @@ cleanup:
 	cleanup_tempdir(__LINE__);
 }
 
+/*
+ * test_environment_cache() - Tests that the user name and tty are cached in 
+ * $XDG_RUNTIME_DIR, and that the cache is ignored after a reboot. Returns 
+ * nothing.
+ */
+
+static void test_environment_cache(void)
+{
+	struct passwd *pw;
+	char *bootid = NULL, *cachefile = NULL, *exp = NULL, *s = NULL;
+
+	diag("Test the environment cache");
+
+	if (init_tempdir())
+		return; /* gncov */
+	bootid = read_from_file(BOOT_ID_FILE);
+	pw = getpwuid(getuid());
+	if (!bootid || !pw) {
+		diag("Can't get the boot ID or user name," /* gncov */
+		     " skipping tests");
+		goto cleanup; /* gncov */
+	}
+	bootid[strcspn(bootid, "\n")] = '\0';
+	cachefile = allocstr(TMPDIR "/" ENVCACHE_PREFIX "%lu-0",
+	                     (unsigned long)getuid());
+	exp = allocstr("%s\n%s\n\n", bootid, pw->pw_name);
+	if (!cachefile || !exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (cachefile && file_exists(cachefile))
+		OK_SUCCESS(remove(cachefile), "Delete the old %s", cachefile);
+
+	uc((chp{ execname, NULL }), 1, 0, "Create the environment cache");
+	s = read_from_file(cachefile);
+	OK_STRCMP(s ? s : "", exp, "The cache contains the boot ID, user"
+	                          " name and an empty tty");
+	free(s);
+
+	s = allocstr("%s\ncacheduser\n\n", bootid);
+	if (!s) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL(create_file(cachefile, s), "Change the user in the cache");
+	free(s);
+	uc((chp{ execname, "-t", "envcache", NULL }), 1, 0,
+	   "Use the environment cache");
+	s = read_from_file(logfile);
+	OK_NOTNULL(s ? strstr(s, "<tag>envcache</tag> <host>") : NULL,
+	           "The entry was logged");
+	OK_NOTNULL(s ? strstr(s, " <user>cacheduser</user> ") : NULL,
+	           "The user name is taken from the cache");
+	free(s);
+
+	OK_NOTNULL(create_file(cachefile, "00000000-0000-0000-0000-000000000000"
+	                                  "\ncacheduser\n\n"),
+	           "Change the boot ID in the cache");
+	uc((chp{ execname, NULL }), 1, 0, "Ignore the stale cache");
+	s = read_from_file(cachefile);
+	OK_STRCMP(s ? s : "", exp, "The stale cache is rewritten");
+	free(s);
+
+	OK_NOTNULL(create_file(cachefile, "Invalid cache file"),
+	           "Create invalid cache file");
+	uc((chp{ execname, NULL }), 1, 0, "Ignore the invalid cache");
+	s = read_from_file(cachefile);
+	OK_STRCMP(s ? s : "", exp, "The invalid cache is rewritten");
+	free(s);
+
+cleanup:
+	if (cachefile && file_exists(cachefile))
+		OK_SUCCESS(remove(cachefile), "Delete %s", cachefile);
+	free(exp);
+	free(cachefile);
+	free(bootid);
+	cleanup_tempdir(__LINE__);
+}
+
 /*
  * test_sess_elements() - Tests that the `<sess>` elements are generated 
  * properly in the XML file. Returns nothing.
@@ -3421,45 +4864,122 @@ static void test_sess_elements(void)
 }
 
 /*
- * test_truncated_logfile() - Contains tests for situations where the log file 
- * is truncated. Returns nothing.
+ * chk_torn_end() - Used by test_truncated_logfile(). Creates a log file with 
+ * 2 entries that ends with the partial line `torn` of length `len` instead of 
+ * the trailer, as if the writer crashed. Verifies that the partial line is 
+ * removed when the next entry is added. The log file isn't deleted 
+ * afterwards. Returns nothing.
  */
 
-static void test_truncated_logfile(void)
+static void chk_torn_end(const int linenum, const char *torn,
+                         const size_t len, const char *desc)
 {
 	struct Entry entry;
-	char *exp_stderr, *contents;
-	struct stat sb;
-
-	diag("Log file is truncated");
-	if (init_tempdir())
-		return; /* gncov */
-	init_xml_entry(&entry);
+	char *contents, *exp_stderr = NULL, *newcont = NULL, *p;
 
-	uc((chp{ execname, NULL }), 1, 0, "Create log file before truncate");
-	verify_logfile(&entry, 1, "Log file is ok before it's truncated");
+	assert(torn);
+	assert(desc);
 
-	if (stat(logfile, &sb)) {
-		failed_ok("stat()"); /* gncov */
+	init_xml_entry(&entry);
+	uc((chp{ execname, "-n", "2", "-w", "n", NULL }), 0, 0,
+	   "%s, create log file", desc);
+	contents = read_from_file(logfile);
+	if (!contents) {
+		failed_ok("read_from_file()"); /* gncov */
 		return; /* gncov */
 	}
-	OK_SUCCESS(truncate(logfile,
-	                    sb.st_size - (off_t)strlen("\n</suuids>")),
-	                    "Truncate log file");
-	exp_stderr = allocstr("%s: %s: Unknown end line, adding to end of"
-	                      " file\n", EXECSTR, logfile);
+	p = strstr(contents, LOGFILE_TRAILER);
+	if (!p) {
+		failed_ok("strstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	*p = '\0';
+	newcont = allocstr("%s%s", contents, torn);
+	if (!newcont) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL_L(create_file(logfile, newcont), linenum,
+	             "%s, write partial line", desc);
+	exp_stderr = allocstr("%s: %s: Removed %zu bytes of an incomplete"
+	                      " entry from the end of the file\n",
+	                      EXECSTR, logfile, len);
 	if (!exp_stderr) {
 		failed_ok("allocstr()"); /* gncov */
-		return; /* gncov */
+		goto cleanup; /* gncov */
 	}
-	tc((chp{ execname, NULL }),
-	   NULL,
+	tc((chp{ execname, "-w", "n", NULL }),
+	   "",
 	   exp_stderr,
 	   EXIT_SUCCESS,
-	   "Add to truncated log file");
+	   "%s, the partial line is removed", desc);
+	verify_logfile(&entry, 3, "%s, log file is valid", desc);
+
+cleanup:
+	free(newcont);
+	free(exp_stderr);
+	free(contents);
+}
+
+/*
+ * test_truncated_logfile() - Contains tests for situations where the log file 
+ * is truncated. Returns nothing.
+ */
+
+static void test_truncated_logfile(void)
+{
+	struct Entry entry;
+	char *exp_stderr, *contents, *torn = NULL;
+	struct stat sb;
+	size_t len;
+	FILE *fp;
+
+	diag("Log file is truncated");
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	uc((chp{ execname, NULL }), 1, 0, "Create log file before truncate");
+	verify_logfile(&entry, 1, "Log file is ok before it's truncated");
+
+	if (stat(logfile, &sb)) {
+		failed_ok("stat()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_SUCCESS(truncate(logfile,
+	                    sb.st_size - (off_t)strlen("\n</suuids>")),
+	                    "Truncate log file");
+	exp_stderr = allocstr("%s: %s: No </suuids> at the end, the log file"
+	                      " is used in append mode\n", EXECSTR, logfile);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		return; /* gncov */
+	}
+	tc((chp{ execname, NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_FAILURE,
+	   "Truncated log file looks like an append mode log file");
+	free(exp_stderr);
+	fp = fopen(logfile, "a");
+	if (!fp) {
+		failed_ok("fopen()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_TRUE(fputs(LOGFILE_TRAILER, fp) != EOF,
+	        "Add the trailer to the truncated log file");
+	fclose(fp);
+	uc((chp{ execname, NULL }), 1, 0, "Add to repaired log file");
 	verify_logfile(&entry, 2, "Log file is ok after truncation");
 	delete_logfile();
 
+	exp_stderr = allocstr("%s: %s: Unknown end line, adding to end of"
+	                      " file\n", EXECSTR, logfile);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		return; /* gncov */
+	}
+
 	OK_NOTNULL(create_file(logfile, NULL), "Create empty log file");
 	uc((chp{ execname, NULL }), 1, 0, "Add to empty log file");
 	verify_logfile(&entry, 1, "Log file header was generated");
@@ -3484,6 +5004,203 @@ static void test_truncated_logfile(void)
 	OK_STRNCMP(contents, "a<suuid t=\"", 11,
 	           "Start of log file is as expected");
 	free(contents);
+	delete_logfile();
+
+	chk_torn_end(__LINE__, "<suuid t=\"2026-10-18T", 21,
+	             "Log file ends with an incomplete entry");
+	delete_logfile();
+	chk_torn_end(__LINE__, "</suu", 5,
+	             "Log file ends with an incomplete trailer");
+	delete_logfile();
+
+	len = LOGFILE_TAIL_SIZE * 2 + 1;
+	torn = malloc(len + 1);
+	if (!torn) {
+		failed_ok("malloc()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	memset(torn, 'a', len);
+	memcpy(torn, "<suuid t=\"2026-10-18T", 21);
+	torn[len] = '\0';
+	chk_torn_end(__LINE__, torn, len,
+	             "Incomplete entry longer than LOGFILE_TAIL_SIZE");
+	delete_logfile();
+
+cleanup:
+	free(torn);
+	cleanup_tempdir(__LINE__);
+}
+
+/*
+ * test_concurrent_writers() - Start several processes at the same time that 
+ * write to a log file that doesn't exist yet, and check that the file gets 
+ * one header, one trailer and all the entries. Returns nothing.
+ */
+
+static void test_concurrent_writers(void)
+{
+	struct Entry entry;
+	pid_t pids[8];
+	unsigned int i, n = 0;
+	int status;
+
+	diag("Concurrent writers create the log file");
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	for (i = 0; i < sizeof(pids) / sizeof(pids[0]); i++) {
+		pids[i] = fork();
+		if (!pids[i]) {
+			int fd = open("/dev/null", O_WRONLY);
+
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			execl(execname, execname, "-n", "50", (char *)NULL);
+			_exit(EXIT_FAILURE); /* gncov */
+		}
+		if (pids[i] == -1) {
+			failed_ok("fork()"); /* gncov */
+			break; /* gncov */
+		}
+	}
+	for (n = 0; n < i; n++) {
+		OK_TRUE(waitpid(pids[n], &status, 0) == pids[n]
+		        && WIFEXITED(status)
+		        && WEXITSTATUS(status) == EXIT_SUCCESS,
+		        "Concurrent writer %u succeeded", n);
+	}
+	verify_logfile(&entry, 50 * i, "Log file after concurrent writers");
+
+	cleanup_tempdir(__LINE__);
+}
+
+                           /*** --binlog ***/
+
+/*
+ * chk_binlog() - Used by test_binlog_option(). Verifies that --bin-to-xml 
+ * converts the binary log with record file `recfile` to a file identical to 
+ * the XML log file. Returns nothing.
+ */
+
+static void chk_binlog(const int linenum, char *recfile, const char *desc)
+{
+	char *xml;
+
+	assert(recfile);
+	assert(desc);
+	assert(*desc);
+
+	xml = read_from_file(logfile);
+	if (!xml) {
+		failed_ok("read_from_file()"); /* gncov */
+		return; /* gncov */
+	}
+	tc_func(linenum, (chp{ execname, "--bin-to-xml", recfile, NULL }),
+	        xml, "", EXIT_SUCCESS, desc);
+	free(xml);
+}
+
+/*
+ * delete_binlog() - Used by test_binlog_option(). Deletes the binary log 
+ * files `recfile` and `heapfile`. Returns nothing.
+ */
+
+static void delete_binlog(const int linenum, const char *recfile,
+                          const char *heapfile)
+{
+	assert(recfile);
+	assert(heapfile);
+
+	OK_SUCCESS_L(remove(recfile), linenum, "Delete %s", recfile);
+	OK_SUCCESS_L(remove(heapfile), linenum, "Delete %s", heapfile);
+}
+
+/*
+ * test_binlog_option() - Tests the --binlog, --xml-to-bin and --bin-to-xml 
+ * options. Returns nothing.
+ */
+
+static void test_binlog_option(void)
+{
+	char *recfile = NULL, *heapfile = NULL, *xml = NULL, *odd = NULL;
+	size_t len;
+	int fd;
+
+	diag("Test --binlog");
+
+	if (init_tempdir())
+		return; /* gncov */
+	recfile = hname_path(BINLOG_REC_EXTENSION);
+	heapfile = hname_path(BINLOG_HEAP_EXTENSION);
+	if (!recfile || !heapfile)
+		goto cleanup; /* gncov */
+
+	uc((chp{ execname, NULL }), 1, 0, "Without --binlog");
+	OK_FALSE(file_exists(recfile), "Binary log isn't created");
+	delete_logfile();
+
+	uc((chp{ execname, "--binlog", "-t", "tag1", "-t", "tag & 2", "-c",
+	         "Comment with <xml>,\n\ttab and \\ backslash", NULL }),
+	   1, 0, "--binlog with tags and comment");
+	chk_binlog(__LINE__, recfile, "--binlog created 1 entry");
+	uc((chp{ execname, "--binlog", "-n", "3", "-t", "tag1", NULL }),
+	   3, 0, "--binlog -n 3");
+	chk_binlog(__LINE__, recfile, "--binlog -n 3 added 3 entries");
+	uc((chp{ execname, "--binlog", "--raw", "-c", "<a href=\"x\">b</a>",
+	         NULL }), 1, 0, "--binlog --raw");
+	chk_binlog(__LINE__, recfile, "--binlog --raw added 1 entry");
+
+	diag("Partially written record is removed");
+	fd = open(recfile, O_WRONLY | O_APPEND);
+	OK_TRUE(fd != -1 && write(fd, "garbage", 7) == 7
+	        && !close(fd), "Add partial record to %s", recfile);
+	uc((chp{ execname, "--binlog", NULL }), 1, 0,
+	   "--binlog after partial record");
+	chk_binlog(__LINE__, recfile, "Partial record is gone");
+	delete_binlog(__LINE__, recfile, heapfile);
+
+	diag("Convert the XML log file to a binary log");
+	xml = read_from_file(logfile);
+	if (!xml) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	len = strlen(xml) - strlen(LOGFILE_TRAILER);
+	odd = allocstr("%.*s<suuid t=\"2025\" u=\"x\">  odd  </suuid>\n%s",
+	               (int)len, xml, LOGFILE_TRAILER);
+	if (!odd || !create_file(logfile, odd)) {
+		failed_ok("create_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--xml-to-bin", logfile, NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--xml-to-bin");
+	chk_binlog(__LINE__, recfile, "--bin-to-xml recreates the XML log");
+	sc((chp{ execname, "--xml-to-bin", logfile, NULL }),
+	   "",
+	   BINLOG_REC_EXTENSION ": File already exists\n",
+	   EXIT_FAILURE,
+	   "--xml-to-bin doesn't overwrite existing binary log");
+	tc((chp{ execname, "--bin-to-xml", logfile, NULL }),
+	   "",
+	   NULL,
+	   EXIT_FAILURE,
+	   "--bin-to-xml with XML log file");
+	tc((chp{ execname, "--bin-to-xml", heapfile, NULL }),
+	   "",
+	   NULL,
+	   EXIT_FAILURE,
+	   "--bin-to-xml with heap file");
+	delete_binlog(__LINE__, recfile, heapfile);
+
+cleanup:
+	free(odd);
+	free(xml);
+	free(heapfile);
+	free(recfile);
 	cleanup_tempdir(__LINE__);
 }
 
@@ -4067,6 +5784,12 @@ static void test_count_option(void)
 
 	uc((chp{ execname, "--count", "20", NULL }), 20, 0, "--count 20");
 	verify_logfile(&entry, 30, "--count created 20 entries");
+	sc((chp{ execname, "-vvv", "-n", "3", NULL }),
+	   NULL,
+	   ": The writer thread wrote 3 entries, the ring was full 0 times\n",
+	   EXIT_SUCCESS,
+	   "-n 3 uses the writer thread");
+	verify_logfile(&entry, 33, "The writer thread wrote 3 entries");
 
 	tc((chp{ execname, "-n", "y", NULL }),
 	   "",
@@ -4085,403 +5808,1990 @@ static void test_count_option(void)
 	cleanup_tempdir(__LINE__);
 }
 
-                             /*** -l/--logdir ***/
+                             /*** --daemon ***/
 
 /*
- * test_logdir_option() - Tests the -l/--logdir option. Returns nothing.
+ * start_daemon() - Used by test_daemon_option(). Start `suuid --daemon` in 
+ * the background and wait until it accepts connections on `sockname`. 
+ * Returns the pid of the daemon, or -1 if it didn't start.
  */
 
-static void test_logdir_option(void)
+static pid_t start_daemon(const char *sockname)
 {
-	struct Entry entry;
-	int result;
-	char *bck_home = NULL;
-	struct Rc rc;
+	struct timespec ts = { 0, 10000000 };
+	unsigned int i;
+	pid_t pid;
 
-	diag("Test -l/--logdir");
+	assert(sockname);
 
-	if (init_tempdir())
-		return; /* gncov */
-	init_xml_entry(&entry);
+	pid = fork();
+	if (!pid) {
+		int fd = open("/dev/null", O_WRONLY);
 
-	OK_SUCCESS(result = rename(TMPDIR "/" LOGDIR_NAME,
-	                           TMPDIR "/" LOGDIR_NAME "2"),
-	           "rename %s/ to %s2/", LOGDIR_NAME, LOGDIR_NAME);
-	if (result) {
-		OK_ERROR("Cannot rename %s/ to %s2/" /* gncov */
-		         " directory, skipping tests: %s",
-		         LOGDIR_NAME, LOGDIR_NAME, strerror(errno));
-		errno = 0; /* gncov */
-		return; /* gncov */
+		if (fd == -1 || dup2(fd, STDERR_FILENO) == -1)
+			_exit(EXIT_FAILURE); /* gncov */
+		execl(execname, execname, "--daemon", NULL);
+		_exit(EXIT_FAILURE); /* gncov */
 	}
+	if (pid == -1)
+		return -1; /* gncov */
+	for (i = 0; i < 500; i++) {
+		int fd = daemon_connect(sockname);
 
-	entry.txt = "With -l/--logdir";
-	uc((chp{ execname, "-l", TMPDIR "/" LOGDIR_NAME "2",
-	         "-c", "With -l/--logdir", NULL }),
-	   1, 0, "\"-l %s/%s2\"", TMPDIR, LOGDIR_NAME);
+		if (fd != -1) {
+			close(fd);
+			return pid;
+		}
+		nanosleep(&ts, NULL);
+	}
+	kill(pid, SIGKILL); /* gncov */
+	waitpid(pid, NULL, 0); /* gncov */
 
-	uc((chp{ execname, "--logdir", TMPDIR "/" LOGDIR_NAME "2", "-c",
-	         "With -l/--logdir", NULL }), 1, 0,
-	        "\"--logdir %s/%s2\"", TMPDIR, LOGDIR_NAME);
+	return -1; /* gncov */
+}
 
-	OK_SUCCESS(result = rename(TMPDIR "/" LOGDIR_NAME "2",
-	                           TMPDIR "/" LOGDIR_NAME),
-	           "Rename %s2/ back to %s/", LOGDIR_NAME, LOGDIR_NAME);
-	if (result) {
-		OK_ERROR("Cannot rename %s2/ to %s/: %s", /* gncov */
-		         LOGDIR_NAME, LOGDIR_NAME, strerror(errno));
-		errno = 0; /* gncov */
-		return; /* gncov */
-	}
+/*
+ * chk_daemon_error() - Used by test_daemon_option(). Send the raw request 
+ * `req` to the daemon on `sockname` and verify that it's answered with the 
+ * error line for `err`. Returns nothing.
+ */
 
-	verify_logfile(&entry, 2,
-	               "Log file, \"-l %s/%s2\"", TMPDIR, LOGDIR_NAME);
-	delete_logfile();
+static void chk_daemon_error(const int linenum, const char *sockname,
+                             const char *req, const char *err,
+                             const char *desc)
+{
+	char *reply = NULL, *exp;
+	FILE *fp;
+	int fd;
 
-	tc((chp{ execname, "--logdir", "", NULL }),
-	   "",
-	   EXECSTR ": -l/--logdir argument cannot be empty\n"
-	   OPTION_ERROR_STR,
-	   EXIT_FAILURE,
-	   "Empty argument to --logdir");
+	assert(sockname);
+	assert(req);
+	assert(err);
+	assert(desc);
 
-	diag("No HOME envvar, but -l is used");
-	OK_NOTNULL(getenv("HOME"), "getenv(\"HOME\") doesn't return NULL");
-	bck_home = mystrdup(getenv("HOME"));
-	if (!bck_home) {
-		failed_ok("mystrdup()"); /* gncov */
+	exp = allocstr("error: %s\n", err);
+	if (!exp) {
+		failed_ok("allocstr()"); /* gncov */
+		return; /* gncov */
+	}
+	fd = daemon_connect(sockname);
+	if (OK_TRUE_L(fd != -1, linenum, "%s (connect)", desc))
+		goto cleanup; /* gncov */
+	if (write_all(fd, req, strlen(req), -1) || write_all(fd, "\n", 1, -1)
+	    || shutdown(fd, SHUT_WR) == -1) {
+		failed_ok("write_all()"); /* gncov */
+		close(fd); /* gncov */
 		goto cleanup; /* gncov */
 	}
-	unset_env("HOME");
-
-	tc((chp{ execname, "-l", TMPDIR "/" LOGDIR_NAME, NULL }),
-	   NULL,
-	   EXECSTR ": HOME environment variable not defined, cannot determine"
-	   " name of rcfile\n",
-	   EXIT_SUCCESS,
-	   "-l is used with undefined HOME");
-
-	if (OK_SUCCESS(setenv("HOME", bck_home, 1), "Restore HOME envvar")) {
-		failed_ok("setenv()"); /* gncov */
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		failed_ok("fdopen()"); /* gncov */
+		close(fd); /* gncov */
 		goto cleanup; /* gncov */
 	}
-	init_rc(&rc);
-	entry.host = get_hostname(&rc);
-	entry.txt = NULL;
-	if (!entry.host)
-		failed_ok("get_hostname()"); /* gncov */
-	else
-		verify_logfile(&entry, 1, "Log file after -l without HOME");
+	reply = read_from_fp(fp, NULL);
+	fclose(fp);
+	if (!reply) {
+		failed_ok("read_from_fp()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_STRCMP_L(reply, exp, linenum, "%s", desc);
 
 cleanup:
-	free(bck_home);
-	cleanup_tempdir(__LINE__);
+	free(reply);
+	free(exp);
 }
 
-                           /*** -m/--random-mac ***/
-
 /*
- * chk_unique_macs() - Check that all `num` newline-separated UUID strings in 
- * the string `s` have unique or identical MAC addresses.
- *
- * `mode`:
- * - CHECK_UNIQUE: Check that all MAC addresses are unique.
- * - CHECK_EQUAL: Check that all MAC addresses are identical.
- *
- * Returns:
- * - 0 if the condition is met
- * - 1 if the condition is not met
- * - -1 on error (`s` is NULL)
+ * test_daemon_option() - Tests the --daemon and --no-daemon options. Returns 
+ * nothing.
  */
 
-int chk_unique_macs(const char *s, unsigned int num, enum cum_mode mode)
+static void test_daemon_option(void)
 {
-	char macs[num][13];
-	unsigned int count = 0;
-	const char *line_start = s;
+	struct Entry entry;
+	char *sockname;
+	int status;
+	pid_t pid;
 
-	assert(s);
+	diag("Test --daemon");
 
-	if (!s)
-		return -1; /* gncov */
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+	sockname = hname_path(SOCKET_EXTENSION);
+	if (!sockname)
+		goto cleanup; /* gncov */
 
-	if (!num)
-		return 0; /* gncov */
+	pid = start_daemon(sockname);
+	OK_TRUE(pid != -1, "Start the daemon");
+	if (pid == -1)
+		goto cleanup; /* gncov */
 
-	while (*line_start && count < num) {
-		const char *line_end = strchr(line_start, '\n');
-		size_t line_len = line_end ? (size_t)(line_end - line_start)
-		                           : strlen(line_start);
+	sc((chp{ execname, "-vv", "-n", "3", "-t", "daemontag", "-c",
+	         "Via the daemon", NULL }),
+	   NULL,
+	   ": Using the daemon at /",
+	   EXIT_SUCCESS,
+	   "-vv says the daemon is used");
+	entry.tag[0] = "daemontag";
+	entry.txt = "Via the daemon";
+	verify_logfile(&entry, 3, "The daemon logged 3 entries");
+	uc((chp{ execname, "-n", "2", "-w", "a", "-t", "daemontag", "-c",
+	         "Via the daemon", NULL }), 2, 2,
+	   "-w a prints the UUIDs from the daemon");
+	uc((chp{ execname, "--no-daemon", "-t", "daemontag", "-c",
+	         "Via the daemon", NULL }), 1, 0,
+	   "--no-daemon writes to the log file while the daemon runs");
+	verify_logfile(&entry, 6, "The log file has entries from the daemon"
+	                          " and the client");
+
+	diag("The daemon checks the requests like the command line");
+	chk_daemon_error(__LINE__, sockname, "{\"tag\":[\"\xff\"]}",
+	                 "Invalid request", "Daemon, tag isn't UTF-8");
+	chk_daemon_error(__LINE__, sockname, "{\"tag\":[\"a\\u0001b\"]}",
+	                 "Tag contains illegal characters",
+	                 "Daemon, tag with control character");
+	chk_daemon_error(__LINE__, sockname, "{\"txt\":\"\\u0007\"}",
+	                 "Comment contains illegal characters or is not"
+	                 " valid UTF-8",
+	                 "Daemon, comment with control character");
+	chk_daemon_error(__LINE__, sockname, "{\"txt\":\"a\xc3\"}",
+	                 "Comment contains illegal characters or is not"
+	                 " valid UTF-8",
+	                 "Daemon, comment isn't UTF-8");
+	chk_daemon_error(__LINE__, sockname, "{\"cwd\":\"/\\u0001\"}",
+	                 "Invalid cwd, user or tty value",
+	                 "Daemon, cwd with control character");
+	chk_daemon_error(__LINE__, sockname,
+	                 "{\"sess\":[{\"uuid\":\"</sess>\"}]}",
+	                 "Invalid sess UUID", "Daemon, sess UUID isn't valid");
+	chk_daemon_error(__LINE__, sockname,
+	                 "{\"sess\":[{\"uuid\":"
+	                 "\"b0edfd88-9b08-11f0-a1d5-83850402c3ce\","
+	                 "\"desc\":\"a<b\"}]}",
+	                 "Invalid sess desc", "Daemon, sess desc with \"<\"");
+	chk_daemon_error(__LINE__, sockname,
+	                 "{\"sess\":[{\"uuid\":"
+	                 "\"b0edfd88-9b08-11f0-a1d5-83850402c3ce\","
+	                 "\"desc\":\"\"}]}",
+	                 "Invalid sess desc", "Daemon, empty sess desc");
+	chk_daemon_error(__LINE__, sockname, "{\"n\":10001}",
+	                 "Too many UUIDs in one request",
+	                 "Daemon, more than DAEMON_MAX_COUNT UUIDs");
+	verify_logfile(&entry, 6, "The rejected requests weren't logged");
+	uc((chp{ execname, "-n", "1500", "-t", "daemontag", "-c",
+	         "Via the daemon", NULL }), 1500, 0,
+	   "The daemon sends the reply in batches");
+	uc((chp{ execname, "-n", "10001", "-w", "n", "-t", "daemontag", "-c",
+	         "Via the daemon", NULL }), 0, 0,
+	   "More than DAEMON_MAX_COUNT UUIDs are logged without the daemon");
+	verify_logfile(&entry, 11507, "The large requests are logged");
+	sc((chp{ execname, "--daemon", NULL }),
+	   "",
+	   ": The daemon is already running\n",
+	   EXIT_FAILURE,
+	   "--daemon when the daemon is running");
+
+	OK_SUCCESS(kill(pid, SIGTERM), "Stop the daemon");
+	OK_EQUAL(waitpid(pid, &status, 0), pid, "Wait for the daemon");
+	OK_TRUE(WIFEXITED(status) && !WEXITSTATUS(status),
+	        "The daemon exited with value 0");
+	OK_FALSE(file_exists(sockname), "The socket is removed");
+
+	OK_NOTNULL(create_file(sockname, NULL), "Create stale %s", sockname);
+	uc((chp{ execname, "-t", "daemontag", "-c", "Via the daemon", NULL }),
+	   1, 0, "A stale socket is ignored");
+	verify_logfile(&entry, 11508,
+	               "The entry was logged without the daemon");
+	sc((chp{ execname, "--daemon", "--logmode", "mmap", NULL }),
+	   "",
+	   ": The daemon can't use --binlog, --segment or the \"mmap\" and"
+	   " \"uring\" log modes\n",
+	   EXIT_FAILURE,
+	   "--daemon with --logmode mmap");
+	if (file_exists(sockname))
+		OK_SUCCESS(remove(sockname), "Delete %s", sockname);
 
-		/* Extract last 12 characters as MAC string */
-		const char *mac_start = line_start + line_len - 12;
+cleanup:
+	free(sockname);
+	cleanup_tempdir(__LINE__);
+}
 
-		/* Copy MAC substring */
-		memcpy(macs[count], mac_start, 12);
-		macs[count][12] = '\0';
+                               /*** --jsonl ***/
 
-		if (mode == CHECK_UNIQUE) {
-			unsigned int i;
+/*
+ * chk_jsonl() - Used by test_jsonl_option(). Verifies that the JSON Lines log 
+ * file `jsonfile` contains `count` entries, and that every entry is converted 
+ * to an XML line that exists in the XML log file. Returns nothing.
+ */
 
-			/* Check for duplicates among previous MACs */
-			for (i = 0; i < count; i++) {
-				if (strcmp(macs[count], macs[i]) == 0) {
-					/* Duplicate found */
-					return 1; /* gncov */
-				}
-			}
-		} else {
-			/* Check if current MAC differs from first MAC */
-			if (count > 0 /* gncov */
-			    && strcmp(macs[count], macs[0]) != 0) { /* gncov */
-				/* Difference found */
-				return 1; /* gncov */
-			}
-		}
+static void chk_jsonl(const int linenum, const char *jsonfile,
+                      const unsigned int count, const char *desc)
+{
+	char *xml, *json, *jp, *save = NULL;
+	unsigned int num = 0, same = 0;
 
-		count++;
-		if (!line_end)
-			break; /* gncov */
-		line_start = line_end + 1;
+	assert(jsonfile);
+	assert(desc);
+	assert(*desc);
+
+	xml = read_from_file(logfile);
+	json = read_from_file(jsonfile);
+	if (!xml || !json) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
 	}
+	OK_EQUAL_L(count_substr(json, "\n"), count, linenum,
+	           "%s (number of lines)", desc);
+
+	for (jp = strtok_r(json, "\n", &save); jp;
+	     jp = strtok_r(NULL, "\n", &save)) {
+		struct Entry entry;
+		char *ap = NULL, *line = NULL;
+		bool raw;
+
+		init_xml_entry(&entry);
+		if (!parse_json_entry(jp, &entry, &raw))
+			ap = xml_entry(&entry, raw);
+		if (ap)
+			line = allocstr("\n%s\n", ap);
+		if (line && strstr(xml, line))
+			same++;
+		else
+			diag("%s(): Not found in XML: %s", /* gncov */
+			     __func__, jp);
+		free(line);
+		free(ap);
+		free_sess(&entry);
+		free_tags(&entry);
+		free(entry.txt);
+		free(entry.host);
+		free(entry.cwd);
+		free(entry.user);
+		free(entry.tty);
+		num++;
+	}
+	OK_EQUAL_L(same, num, linenum, "%s (same as XML)", desc);
 
-	return 0;
+cleanup:
+	free(json);
+	free(xml);
 }
 
 /*
- * test_unique_macs() - Verifies that -m/--random-mac creates unique MAC 
- * addresses. Returns nothing.
+ * test_jsonl_option() - Tests the --jsonl option. Returns nothing.
  */
 
-static void test_unique_macs(void)
+static void test_jsonl_option(void)
 {
-	struct streams ss;
-	struct Options opt = opt_struct();
-	unsigned int num = 100;
-	char *num_s;
+	struct Entry entry;
+	char *jsonfile;
 
-	num_s = allocstr("%u", num);
-	if (!num_s) {
-		failed_ok("allocstr()"); /* gncov */
+	diag("Test --jsonl");
+
+	if (init_tempdir())
 		return; /* gncov */
-	}
+	init_xml_entry(&entry);
+	jsonfile = hname_path(JSONL_EXTENSION);
+	if (!jsonfile)
+		goto cleanup; /* gncov */
 
-	streams_init(&ss);
-	streams_exec(&opt, &ss, chp{ execname, "-m", "-n", num_s, NULL });
+	uc((chp{ execname, NULL }), 1, 0, "Without --jsonl");
+	OK_FALSE(file_exists(jsonfile), "JSON Lines file isn't created");
 
-	if (opt.verbose >= 1) {
-		diag("ss.out.buf = \"%s\"", no_null(ss.out.buf)); /* gncov */
-		diag("ss.err.buf = \"%s\"", no_null(ss.err.buf)); /* gncov */
-		diag("ss.ret = \"%d\"", ss.ret); /* gncov */
+	uc((chp{ execname, "--jsonl", "-t", "tag1,tag & 2", "-c",
+	         "Comment with \"quotes\", <xml> and\nnewline", NULL }),
+	   1, 0, "--jsonl with tags and comment");
+	chk_jsonl(__LINE__, jsonfile, 1, "--jsonl created 1 JSON entry");
+
+	uc((chp{ execname, "--jsonl", "-n", "3", NULL }), 3, 0,
+	   "--jsonl -n 3");
+	chk_jsonl(__LINE__, jsonfile, 4, "--jsonl -n 3 added 3 JSON entries");
+
+	uc((chp{ execname, "--jsonl", "--raw", "-c", "<a href=\"x\">b</a>",
+	         NULL }), 1, 0, "--jsonl --raw");
+	chk_jsonl(__LINE__, jsonfile, 5, "--jsonl --raw added 1 JSON entry");
+
+	uc((chp{ execname, "--jsonl", "--logmode", "append", "-n", "2",
+	         NULL }), 2, 0, "--jsonl in append mode");
+	chk_jsonl(__LINE__, jsonfile, 7, "--jsonl in append mode added 2");
+	OK_SUCCESS(remove(jsonfile), "Delete JSON Lines file");
+	delete_logfile();
+
+	diag("JSON Lines file can't be opened");
+	OK_SUCCESS(mkdir(jsonfile, 0777), "Create directory with JSONL name");
+	sc((chp{ execname, "--jsonl", NULL }),
+	   "",
+	   JSONL_EXTENSION ": Could not open file for appending: Is a"
+	   " directory\n",
+	   EXIT_FAILURE,
+	   "--jsonl fails when the JSON Lines file can't be opened");
+	verify_logfile(&entry, 0, "XML log file is closed properly");
+	OK_SUCCESS(rmdir(jsonfile), "Delete directory with JSONL name");
+
+cleanup:
+	free(jsonfile);
+	cleanup_tempdir(__LINE__);
+}
+
+                           /*** --lock-timeout ***/
+
+/*
+ * hold_lock() - Used by test_lock_timeout_option(). Fork a child process that 
+ * locks the log file for `ms` milliseconds. Returns the pid of the child 
+ * when the lock is taken, or -1 if error.
+ */
+
+static pid_t hold_lock(const long ms)
+{
+	int pfd[2];
+	pid_t pid;
+	char c;
+
+	if (pipe(pfd) == -1)
+		return -1; /* gncov */
+	pid = fork();
+	if (!pid) {
+		int fd = open(logfile, O_RDONLY);
+		struct timespec ts = { ms / 1000, ms % 1000 * 1000000 };
+
+		close(pfd[0]);
+		if (fd == -1 || flock(fd, LOCK_EX) == -1)
+			_exit(EXIT_FAILURE); /* gncov */
+		if (write(pfd[1], "x", 1) != 1)
+			_exit(EXIT_FAILURE); /* gncov */
+		nanosleep(&ts, NULL);
+		_exit(EXIT_SUCCESS);
+	}
+	close(pfd[1]);
+	if (pid != -1 && read(pfd[0], &c, 1) != 1) {
+		waitpid(pid, NULL, 0); /* gncov */
+		pid = -1; /* gncov */
+	}
+	close(pfd[0]);
+
+	return pid;
+}
+
+/*
+ * test_lock_timeout_option() - Tests the --lock-timeout option and the lock 
+ * statistics. Returns nothing.
+ */
+
+static void test_lock_timeout_option(void)
+{
+	struct Entry entry;
+	int fd, status;
+	pid_t pid;
+
+	diag("Test --lock-timeout");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	sc((chp{ execname, "-vv", NULL }),
+	   NULL,
+	   ": Locked the log files 2 times without waiting\n",
+	   EXIT_SUCCESS,
+	   "Uncontended locks are counted");
+	uc((chp{ execname, "--lock-timeout", "0", NULL }), 1, 0,
+	   "--lock-timeout 0 without contention");
+	sc((chp{ execname, "--lock-timeout", "abc", NULL }),
+	   "",
+	   ": Error in --lock-timeout argument\n",
+	   EXIT_FAILURE,
+	   "--lock-timeout abc");
+	sc((chp{ execname, "--lock-timeout", "-1", NULL }),
+	   "",
+	   ": Error in --lock-timeout argument\n",
+	   EXIT_FAILURE,
+	   "--lock-timeout -1");
+
+	fd = open(logfile, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		failed_ok("open()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (!OK_SUCCESS(flock(fd, LOCK_EX), "Lock the log file")) {
+		sc((chp{ execname, "--lock-timeout", "50", NULL }),
+		   "",
+		   ": Timed out after 50 ms waiting for the lock\n",
+		   EXIT_FAILURE,
+		   "--lock-timeout 50 while the log file is locked");
+		flock(fd, LOCK_UN);
 	}
+	close(fd);
+	verify_logfile(&entry, 2, "Log file after lock timeout");
 
-	OK_SUCCESS(chk_unique_macs(ss.out.buf, num, CHECK_UNIQUE),
-	           "-m -n %u, all MAC addresses are unique", num);
+	pid = hold_lock(200);
+	if (pid == -1) {
+		failed_ok("hold_lock()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	sc((chp{ execname, "-v", "--lock-timeout", "5000", NULL }),
+	   NULL,
+	   ": Waited for 1 of 2 locks, ",
+	   EXIT_SUCCESS,
+	   "--lock-timeout 5000 waits for the lock");
+	OK_TRUE(waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+	        && WEXITSTATUS(status) == EXIT_SUCCESS,
+	        "Lock holder succeeded");
+	verify_logfile(&entry, 3, "Log file after waiting for the lock");
 
-	streams_free(&ss);
-	free(num_s);
+cleanup:
+	cleanup_tempdir(__LINE__);
 }
 
+                             /*** -l/--logdir ***/
+
 /*
- * test_random_mac_option() - Tests the -m/--random-mac option. Returns 
- * nothing.
+ * test_logdir_option() - Tests the -l/--logdir option. Returns nothing.
  */
 
-static void test_random_mac_option(void)
+static void test_logdir_option(void)
 {
 	struct Entry entry;
 	int result;
+	char *bck_home = NULL;
 	struct Rc rc;
-	char *s = NULL;
 
-	diag("Test -m/--random-mac");
+	diag("Test -l/--logdir");
 
 	if (init_tempdir())
 		return; /* gncov */
 	init_xml_entry(&entry);
 
-	init_rc(&rc);
-	rc.hostname = HNAME;
-	rc.macaddr = "897feb323faa";
+	OK_SUCCESS(result = rename(TMPDIR "/" LOGDIR_NAME,
+	                           TMPDIR "/" LOGDIR_NAME "2"),
+	           "rename %s/ to %s2/", LOGDIR_NAME, LOGDIR_NAME);
+	if (result) {
+		OK_ERROR("Cannot rename %s/ to %s2/" /* gncov */
+		         " directory, skipping tests: %s",
+		         LOGDIR_NAME, LOGDIR_NAME, strerror(errno));
+		errno = 0; /* gncov */
+		return; /* gncov */
+	}
 
-	OK_SUCCESS(result = create_rcfile(rcfile, &rc),
-	           "%s():%d: Create rcfile", __func__, __LINE__);
+	entry.txt = "With -l/--logdir";
+	uc((chp{ execname, "-l", TMPDIR "/" LOGDIR_NAME "2",
+	         "-c", "With -l/--logdir", NULL }),
+	   1, 0, "\"-l %s/%s2\"", TMPDIR, LOGDIR_NAME);
+
+	uc((chp{ execname, "--logdir", TMPDIR "/" LOGDIR_NAME "2", "-c",
+	         "With -l/--logdir", NULL }), 1, 0,
+	        "\"--logdir %s/%s2\"", TMPDIR, LOGDIR_NAME);
+
+	OK_SUCCESS(result = rename(TMPDIR "/" LOGDIR_NAME "2",
+	                           TMPDIR "/" LOGDIR_NAME),
+	           "Rename %s2/ back to %s/", LOGDIR_NAME, LOGDIR_NAME);
 	if (result) {
-		diag("%s(): Cannot create rcfile \"%s\", skipping" /* gncov */
-		     " tests: %s",
-		     __func__, rcfile, strerror(errno)); /* gncov */
+		OK_ERROR("Cannot rename %s2/ to %s/: %s", /* gncov */
+		         LOGDIR_NAME, LOGDIR_NAME, strerror(errno));
 		errno = 0; /* gncov */
 		return; /* gncov */
 	}
 
-	uc((chp{ execname, NULL }), 1, 0, "Use macaddr from the rc file");
-	s = read_from_file(logfile);
-	if (!s) {
-		failed_ok("read_from_file()"); /* gncov */
+	verify_logfile(&entry, 2,
+	               "Log file, \"-l %s/%s2\"", TMPDIR, LOGDIR_NAME);
+	delete_logfile();
+
+	tc((chp{ execname, "--logdir", "", NULL }),
+	   "",
+	   EXECSTR ": -l/--logdir argument cannot be empty\n"
+	   OPTION_ERROR_STR,
+	   EXIT_FAILURE,
+	   "Empty argument to --logdir");
+
+	diag("No HOME envvar, but -l is used");
+	OK_NOTNULL(getenv("HOME"), "getenv(\"HOME\") doesn't return NULL");
+	bck_home = mystrdup(getenv("HOME"));
+	if (!bck_home) {
+		failed_ok("mystrdup()"); /* gncov */
 		goto cleanup; /* gncov */
 	}
-	OK_NOTNULL(strstr(s, rc.macaddr), "rc.macaddr exists in the log file");
-	free(s);
-	s = NULL;
-	delete_logfile();
+	unset_env("HOME");
 
-	uc((chp{ execname, "-m", NULL }), 1, 0, "Use \"-m\"");
-	s = read_from_file(logfile);
-	if (!s) {
-		failed_ok("read_from_file()"); /* gncov */
+	tc((chp{ execname, "-l", TMPDIR "/" LOGDIR_NAME, NULL }),
+	   NULL,
+	   EXECSTR ": HOME environment variable not defined, cannot determine"
+	   " name of rcfile\n",
+	   EXIT_SUCCESS,
+	   "-l is used with undefined HOME");
+
+	if (OK_SUCCESS(setenv("HOME", bck_home, 1), "Restore HOME envvar")) {
+		failed_ok("setenv()"); /* gncov */
 		goto cleanup; /* gncov */
 	}
-	OK_NULL(strstr(s, rc.macaddr),
-	        "rc.macaddr doesn't exist in the log file after -m");
-	free(s);
-	s = NULL;
-	delete_logfile();
+	init_rc(&rc);
+	entry.host = get_hostname(&rc);
+	entry.txt = NULL;
+	if (!entry.host)
+		failed_ok("get_hostname()"); /* gncov */
+	else
+		verify_logfile(&entry, 1, "Log file after -l without HOME");
 
-	uc((chp{ execname, "--random-mac", NULL }), 1, 0,
-	   "Use \"--random-mac\"");
-	s = read_from_file(logfile);
-	if (!s) {
-		failed_ok("read_from_file()"); /* gncov */
+cleanup:
+	free(bck_home);
+	cleanup_tempdir(__LINE__);
+}
+
+                              /*** --logmode ***/
+
+/*
+ * chk_append_log() - Used by test_logmode_option(). Verifies that the log file 
+ * is an append mode log file with `count` entries, i.e., it starts with the 
+ * standard header and has no closing "</suuids>". Returns nothing.
+ */
+
+static void chk_append_log(const int linenum, const unsigned int count,
+                           const char *desc)
+{
+	char *contents;
+	size_t len;
+
+	assert(desc);
+	assert(*desc);
+
+	contents = read_from_file(logfile);
+	if (!contents) {
+		failed_ok("read_from_file(logfile)"); /* gncov */
+		return; /* gncov */
+	}
+	len = strlen(contents);
+	OK_STRNCMP_L(contents, LOGFILE_HEADER, strlen(LOGFILE_HEADER),
+	             linenum, "%s (header)", desc);
+	OK_EQUAL_L(count_substr(contents, "<suuid t="), count, linenum,
+	           "%s (number of entries)", desc);
+	OK_NULL_L(strstr(contents, "</suuids>"), linenum,
+	          "%s (no end tag)", desc);
+	if (count) {
+		OK_TRUE_L(len > 9
+		          && !strcmp(contents + len - 9, "</suuid>\n"),
+		          linenum, "%s (ends with an entry)", desc);
+	}
+	free(contents);
+}
+
+/*
+ * test_logmode_option() - Tests the --logmode option and the "logmode" keyword 
+ * in the rc file. Returns nothing.
+ */
+
+static void test_logmode_option(void)
+{
+	struct Entry entry;
+	struct Rc rc;
+	char *exp_stderr = NULL, *longcmt = NULL;
+	FILE *fp;
+
+	diag("Test --logmode");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	uc((chp{ execname, "--logmode", "append", NULL }), 1, 0,
+	   "--logmode append creates log file");
+	chk_append_log(__LINE__, 1, "Log file after --logmode append");
+	uc((chp{ execname, "--logmode", "append", "-n", "3", NULL }), 3, 0,
+	   "--logmode append -n 3");
+	chk_append_log(__LINE__, 4, "Log file after --logmode append -n 3");
+
+	diag("Use the default XML mode on an append mode log file");
+	exp_stderr = allocstr("%s: %s: No </suuids> at the end, the log file"
+	                      " is used in append mode\n", EXECSTR, logfile);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "-w", "n", NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_FAILURE,
+	   "XML mode refuses append mode log file");
+	chk_append_log(__LINE__, 4, "XML mode didn't change the log file");
+	delete_logfile();
+	uc((chp{ execname, "--logmode", "append", "-n", "0", NULL }), 0, 0,
+	   "--logmode append creates log file with only the header");
+	chk_append_log(__LINE__, 0, "Append mode log file without entries");
+	tc((chp{ execname, "-w", "n", NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_FAILURE,
+	   "XML mode refuses append mode log file with only the header");
+	delete_logfile();
+
+	diag("Use append mode on an XML mode log file");
+	uc((chp{ execname, NULL }), 1, 0, "Create XML mode log file");
+	verify_logfile(&entry, 1, "XML mode log file before append mode");
+	uc((chp{ execname, "--logmode", "append", "-n", "2", NULL }), 2, 0,
+	   "--logmode append on a log file with the trailer");
+	chk_append_log(__LINE__, 3, "The trailer is removed by append mode");
+	tc((chp{ execname, "-w", "n", NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_FAILURE,
+	   "XML mode after append mode on an XML mode log file");
+	chk_append_log(__LINE__, 3, "XML mode didn't add to the log file");
+	fp = fopen(logfile, "a");
+	if (!fp) {
+		failed_ok("fopen()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_TRUE(fputs(LOGFILE_TRAILER, fp) != EOF,
+	        "Add the trailer to the append mode log file");
+	fclose(fp);
+	uc((chp{ execname, "-w", "n", NULL }), 0, 0,
+	   "XML mode after the trailer is added");
+	verify_logfile(&entry, 4, "The log file is used in XML mode again");
+	delete_logfile();
+
+	diag("Entry is too large for append mode");
+	longcmt = malloc(APPEND_ATOMIC_MAX + 1);
+	if (!longcmt) {
+		failed_ok("malloc()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	memset(longcmt, 'a', APPEND_ATOMIC_MAX);
+	longcmt[APPEND_ATOMIC_MAX] = '\0';
+	sc((chp{ execname, "--logmode", "append", "-c", longcmt, NULL }),
+	   "",
+	   " bytes, append mode allows max 4096 bytes\n"
+	   EXECSTR ": Generated only 0 of 1 UUIDs\n",
+	   EXIT_FAILURE,
+	   "--logmode append with too large entry");
+	chk_append_log(__LINE__, 0, "Too large entry isn't added");
+	sc((chp{ execname, "--logmode", "append", "-n", "3", "-c", longcmt,
+	         NULL }),
+	   NULL,
+	   " bytes, append mode allows max 4096 bytes\n",
+	   EXIT_FAILURE,
+	   "--logmode append -n 3 with too large entries");
+	chk_append_log(__LINE__, 0, "Too large entries from the writer thread"
+	                            " aren't added");
+	delete_logfile();
+
+	diag("logmode in the rc file");
+	init_rc(&rc);
+	rc.hostname = HNAME;
+	rc.logmode = "append";
+	if (OK_SUCCESS(create_rcfile(rcfile, &rc),
+	               "Create rc file with logmode = append")) {
+		diag("%s():%d: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
+		goto cleanup; /* gncov */
+	}
+	uc((chp{ execname, NULL }), 1, 0, "logmode = append in rc file");
+	chk_append_log(__LINE__, 1, "Log file after logmode = append in rc");
+	delete_logfile();
+	tc((chp{ execname, "--logmode", "xml", "-w", "n", NULL }),
+	   "",
+	   NULL,
+	   EXIT_SUCCESS,
+	   "--logmode xml overrides logmode in rc file");
+	verify_logfile(&entry, 1, "--logmode xml creates XML log file");
+	delete_logfile();
+
+	rc.logmode = "nope";
+	if (OK_SUCCESS(create_rcfile(rcfile, &rc),
+	               "Create rc file with logmode = nope")) {
+		diag("%s():%d: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, NULL }),
+	   "",
+	   EXECSTR ": \"nope\": Unknown log mode\n",
+	   EXIT_FAILURE,
+	   "Unknown logmode in rc file");
+	tc((chp{ execname, "--logmode", "gurgle", NULL }),
+	   "",
+	   EXECSTR ": \"gurgle\": Unknown log mode\n",
+	   EXIT_FAILURE,
+	   "--logmode with unknown mode");
+	OK_FALSE(file_exists(logfile),
+	         "Log file doesn't exist after unknown log mode");
+
+cleanup:
+	free(longcmt);
+	free(exp_stderr);
+	cleanup_tempdir(__LINE__);
+}
+
+/*
+ * chk_file_size() - Used by test_mmap_logmode(). Verifies that the log file 
+ * has no null bytes after the text, i.e., that it was truncated to its real 
+ * length. Returns nothing.
+ */
+
+static void chk_file_size(const int linenum, const char *desc)
+{
+	struct stat sb;
+	char *contents;
+
+	assert(desc);
+
+	contents = read_from_file(logfile);
+	if (!contents || stat(logfile, &sb)) {
+		failed_ok("read_from_file()"); /* gncov */
+		free(contents); /* gncov */
+		return; /* gncov */
+	}
+	OK_TRUE_L(strlen(contents) == (size_t)sb.st_size, linenum,
+	          "%s, no null bytes", desc);
+	free(contents);
+}
+
+/*
+ * test_mmap_logmode() - Tests --logmode mmap, and that null bytes from an 
+ * interrupted mmap mode writer are removed. Returns nothing.
+ */
+
+static void test_mmap_logmode(void)
+{
+	struct Entry entry;
+	char *contents = NULL, *exp_stderr = NULL;
+	char zeros[5000];
+	const char *junk = "<suuid t=\"2026-10-18T12:00:00.0000000Z\">\n";
+	size_t len, torn;
+	int fd;
+
+	diag("Test --logmode mmap");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	uc((chp{ execname, "--logmode", "mmap", "-n", "3", NULL }), 3, 0,
+	   "--logmode mmap creates log file");
+	verify_logfile(&entry, 3, "Log file after --logmode mmap -n 3");
+	chk_file_size(__LINE__, "--logmode mmap -n 3");
+	uc((chp{ execname, "--logmode", "mmap", "-n", "7000", "-w", "n",
+	         NULL }), 0, 0, "--logmode mmap with more than one extent");
+	verify_logfile(&entry, 7003, "Log file after --logmode mmap -n 7000");
+	chk_file_size(__LINE__, "--logmode mmap -n 7000");
+	uc((chp{ execname, NULL }), 1, 0, "XML mode after mmap mode");
+	verify_logfile(&entry, 7004, "XML mode after mmap mode");
+	sc((chp{ execname, "-vv", "--logmode", "mmap", "--sync", "close",
+	         NULL }),
+	   NULL,
+	   ": Synced the log files 1 time\n",
+	   EXIT_SUCCESS,
+	   "--logmode mmap --sync close");
+	verify_logfile(&entry, 7005, "Log file after --logmode mmap --sync");
+	delete_logfile();
+
+	diag("Interrupted mmap mode writer");
+	uc((chp{ execname, "-n", "2", NULL }), 2, 0, "Create log file");
+	contents = read_from_file(logfile);
+	if (!contents) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	len = strlen(contents) - strlen(LOGFILE_TRAILER);
+	memset(zeros, 0, sizeof(zeros));
+	fd = open(logfile, O_WRONLY | O_TRUNC);
+	OK_TRUE(fd != -1 && write(fd, contents, len) == (ssize_t)len
+	        && write(fd, zeros, sizeof(zeros)) == (ssize_t)sizeof(zeros)
+	        && !close(fd), "Replace the trailer with null bytes");
+	exp_stderr = allocstr("%s: %s: Removed %zu bytes from the first null"
+	                      " byte to the end of the file\n"
+	                      "%s: %s: Unknown end line, adding to end of"
+	                      " file\n",
+	                      EXECSTR, logfile, sizeof(zeros),
+	                      EXECSTR, logfile);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--logmode", "mmap", "-w", "n", NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_SUCCESS,
+	   "Null bytes are removed");
+	verify_logfile(&entry, 3, "Log file is valid after null bytes");
+	chk_file_size(__LINE__, "After null bytes");
+
+	diag("Null bytes in the middle of the file");
+	for (torn = len - 1; torn && contents[torn - 1] != '\n'; torn--);
+	torn = len - 10 - torn;
+	fd = open(logfile, O_WRONLY | O_TRUNC);
+	OK_TRUE(fd != -1 && write(fd, contents, len - 10) == (ssize_t)len - 10
+	        && write(fd, zeros, 100) == 100
+	        && write(fd, junk, strlen(junk)) == (ssize_t)strlen(junk)
+	        && write(fd, zeros, sizeof(zeros)) == (ssize_t)sizeof(zeros)
+	        && !close(fd), "Torn entry, null bytes, text and null bytes");
+	free(exp_stderr);
+	exp_stderr = allocstr("%s: %s: Removed %zu bytes from the first null"
+	                      " byte to the end of the file\n"
+	                      "%s: %s: Removed %zu bytes of an incomplete entry"
+	                      " from the end of the file\n",
+	                      EXECSTR, logfile,
+	                      100 + strlen(junk) + sizeof(zeros),
+	                      EXECSTR, logfile, torn);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--logmode", "mmap", "-w", "n", NULL }),
+	   "",
+	   exp_stderr,
+	   EXIT_SUCCESS,
+	   "Text after the first null byte is removed");
+	verify_logfile(&entry, 2, "Log file is valid after a null byte hole");
+	chk_file_size(__LINE__, "After a null byte hole");
+
+cleanup:
+	free(exp_stderr);
+	free(contents);
+	cleanup_tempdir(__LINE__);
+}
+
+/*
+ * chk_last_entry() - Used by test_uring_logmode(). Verifies that the last 
+ * entry in the log file has the comment `txt` and is followed by the 
+ * "</suuids>" trailer. Returns nothing.
+ */
+
+static void chk_last_entry(const int linenum, const char *txt,
+                           const char *desc)
+{
+	char *contents, *exp;
+
+	assert(txt);
+	assert(desc);
+
+	contents = read_from_file(logfile);
+	exp = allocstr("<txt>%s</txt> <host>%s</host>", txt, hname());
+	if (!contents || !exp) {
+		failed_ok("read_from_file() or allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL_L(strstr(contents, exp), linenum, "%s, comment", desc);
+	OK_TRUE_L(strlen(contents) > 20
+	          && !strcmp(contents + strlen(contents) - 19,
+	                     "</suuid>\n</suuids>\n"),
+	          linenum, "%s, end of file", desc);
+
+cleanup:
+	free(exp);
+	free(contents);
+}
+
+/*
+ * uring_available() - Used by test_uring_logmode(). Returns true if io_uring 
+ * can be set up, otherwise false.
+ */
+
+static bool uring_available(void)
+{
+	struct Uring u;
+	bool retval;
+	int fd;
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd == -1) {
+		failed_ok("open()"); /* gncov */
+		return false; /* gncov */
+	}
+	retval = !uring_setup(&u, fd, 0);
+	uring_free(&u);
+	close(fd);
+
+	return retval;
+}
+
+/*
+ * test_uring_logmode() - Tests --logmode uring, both with io_uring and with 
+ * the write() fallback. Returns nothing.
+ */
+
+static void test_uring_logmode(void)
+{
+	struct Entry entry;
+	char *longcmt;
+	const size_t cmtsize = URING_BUFSIZE + 5000;
+
+	diag("Test --logmode uring");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+	longcmt = malloc(cmtsize + 1);
+	if (!longcmt) {
+		failed_ok("malloc()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	memset(longcmt, 'a', cmtsize);
+	longcmt[cmtsize] = '\0';
+
+	if (!uring_available()) {
+		diag("io_uring isn't available," /* gncov */
+		     " only testing the fallback"); /* gncov */
+		goto fallback; /* gncov */
+	}
+	uc((chp{ execname, "--logmode", "uring", "-n", "3", NULL }), 3, 0,
+	   "--logmode uring creates log file");
+	verify_logfile(&entry, 3, "Log file after --logmode uring -n 3");
+	chk_file_size(__LINE__, "--logmode uring -n 3");
+	sc((chp{ execname, "-vv", "--logmode", "uring", "-n", "7000",
+	         "-w", "n", NULL }),
+	   "",
+	   " writes with io_uring\n",
+	   EXIT_SUCCESS,
+	   "--logmode uring with more writes than buffers");
+	verify_logfile(&entry, 7003, "Log file after --logmode uring -n 7000");
+	chk_file_size(__LINE__, "--logmode uring -n 7000");
+	sc((chp{ execname, "-vv", "--logmode", "uring", "-n", "2500",
+	         "--sync", "batch", "-w", "n", NULL }),
+	   "",
+	   ": Synced the log files ",
+	   EXIT_SUCCESS,
+	   "--logmode uring --sync batch");
+	verify_logfile(&entry, 9503, "Log file after --logmode uring --sync");
+	uc((chp{ execname, NULL }), 1, 0, "XML mode after uring mode");
+	verify_logfile(&entry, 9504, "XML mode after uring mode");
+	chk_file_size(__LINE__, "XML mode after uring mode");
+	sc((chp{ execname, "-vv", "--logmode", "uring", "-c", longcmt, NULL }),
+	   NULL,
+	   ": Submitted 2 writes with io_uring\n",
+	   EXIT_SUCCESS,
+	   "--logmode uring with entry larger than the buffer");
+	chk_last_entry(__LINE__, longcmt, "Large entry in uring mode");
+	chk_file_size(__LINE__, "Large entry in uring mode");
+	delete_logfile();
+
+fallback:
+	diag("uring mode without io_uring");
+	if (set_env(ENV_NO_URING, "1"))
+		goto cleanup; /* gncov */
+	tc((chp{ execname, "-v", "--logmode", "uring", "-n", "2", "-w", "n",
+	         NULL }),
+	   "",
+	   EXECSTR ": io_uring isn't available, using write()\n",
+	   EXIT_SUCCESS,
+	   "--logmode uring falls back to write()");
+	verify_logfile(&entry, 2, "Log file after write() fallback");
+	uc((chp{ execname, "--logmode", "uring", "--sync", "batch",
+	         "-c", longcmt, NULL }), 1, 0,
+	   "Fallback with --sync batch and large entry");
+	chk_last_entry(__LINE__, longcmt, "Large entry after fallback");
+	unset_env(ENV_NO_URING);
+
+cleanup:
+	free(longcmt);
+	cleanup_tempdir(__LINE__);
+}
+
+                           /*** -m/--random-mac ***/
+
+/*
+ * chk_unique_macs() - Check that all `num` newline-separated UUID strings in 
+ * the string `s` have unique or identical MAC addresses.
+ *
+ * `mode`:
+ * - CHECK_UNIQUE: Check that all MAC addresses are unique.
+ * - CHECK_EQUAL: Check that all MAC addresses are identical.
+ *
+ * Returns:
+ * - 0 if the condition is met
+ * - 1 if the condition is not met
+ * - -1 on error (`s` is NULL)
+ */
+
+int chk_unique_macs(const char *s, unsigned int num, enum cum_mode mode)
+{
+	char macs[num][13];
+	unsigned int count = 0;
+	const char *line_start = s;
+
+	assert(s);
+
+	if (!s)
+		return -1; /* gncov */
+
+	if (!num)
+		return 0; /* gncov */
+
+	while (*line_start && count < num) {
+		const char *line_end = strchr(line_start, '\n');
+		size_t line_len = line_end ? (size_t)(line_end - line_start)
+		                           : strlen(line_start);
+
+		/* Extract last 12 characters as MAC string */
+		const char *mac_start = line_start + line_len - 12;
+
+		/* Copy MAC substring */
+		memcpy(macs[count], mac_start, 12);
+		macs[count][12] = '\0';
+
+		if (mode == CHECK_UNIQUE) {
+			unsigned int i;
+
+			/* Check for duplicates among previous MACs */
+			for (i = 0; i < count; i++) {
+				if (strcmp(macs[count], macs[i]) == 0) {
+					/* Duplicate found */
+					return 1; /* gncov */
+				}
+			}
+		} else {
+			/* Check if current MAC differs from first MAC */
+			if (count > 0 /* gncov */
+			    && strcmp(macs[count], macs[0]) != 0) { /* gncov */
+				/* Difference found */
+				return 1; /* gncov */
+			}
+		}
+
+		count++;
+		if (!line_end)
+			break; /* gncov */
+		line_start = line_end + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * test_unique_macs() - Verifies that -m/--random-mac creates unique MAC 
+ * addresses. Returns nothing.
+ */
+
+static void test_unique_macs(void)
+{
+	struct streams ss;
+	struct Options opt = opt_struct();
+	unsigned int num = 100;
+	char *num_s;
+
+	num_s = allocstr("%u", num);
+	if (!num_s) {
+		failed_ok("allocstr()"); /* gncov */
+		return; /* gncov */
+	}
+
+	streams_init(&ss);
+	streams_exec(&opt, &ss, chp{ execname, "-m", "-n", num_s, NULL });
+
+	if (opt.verbose >= 1) {
+		diag("ss.out.buf = \"%s\"", no_null(ss.out.buf)); /* gncov */
+		diag("ss.err.buf = \"%s\"", no_null(ss.err.buf)); /* gncov */
+		diag("ss.ret = \"%d\"", ss.ret); /* gncov */
+	}
+
+	OK_SUCCESS(chk_unique_macs(ss.out.buf, num, CHECK_UNIQUE),
+	           "-m -n %u, all MAC addresses are unique", num);
+
+	streams_free(&ss);
+	free(num_s);
+}
+
+/*
+ * test_random_mac_option() - Tests the -m/--random-mac option. Returns 
+ * nothing.
+ */
+
+static void test_random_mac_option(void)
+{
+	struct Entry entry;
+	int result;
+	struct Rc rc;
+	char *s = NULL;
+
+	diag("Test -m/--random-mac");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	init_rc(&rc);
+	rc.hostname = HNAME;
+	rc.macaddr = "897feb323faa";
+
+	OK_SUCCESS(result = create_rcfile(rcfile, &rc),
+	           "%s():%d: Create rcfile", __func__, __LINE__);
+	if (result) {
+		diag("%s(): Cannot create rcfile \"%s\", skipping" /* gncov */
+		     " tests: %s",
+		     __func__, rcfile, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
+		return; /* gncov */
+	}
+
+	uc((chp{ execname, NULL }), 1, 0, "Use macaddr from the rc file");
+	s = read_from_file(logfile);
+	if (!s) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL(strstr(s, rc.macaddr), "rc.macaddr exists in the log file");
+	free(s);
+	s = NULL;
+	delete_logfile();
+
+	uc((chp{ execname, "-m", NULL }), 1, 0, "Use \"-m\"");
+	s = read_from_file(logfile);
+	if (!s) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NULL(strstr(s, rc.macaddr),
+	        "rc.macaddr doesn't exist in the log file after -m");
+	free(s);
+	s = NULL;
+	delete_logfile();
+
+	uc((chp{ execname, "--random-mac", NULL }), 1, 0,
+	   "Use \"--random-mac\"");
+	s = read_from_file(logfile);
+	if (!s) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NULL(strstr(s, rc.macaddr),
+	        "rc.macaddr doesn't exist in the log file after --random-mac");
+	free(s);
+	s = NULL;
+
+	test_unique_macs();
+
+cleanup:
+	free(s);
+	cleanup_tempdir(__LINE__);
+}
+
+                                /*** --raw ***/
+
+/*
+ * test_raw_option() - Tests the --raw option. Returns nothing.
+ */
+
+static void test_raw_option(void)
+{
+	struct Entry entry;
+
+	diag("Test --raw");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	entry.txt = "Raw data";
+	uc((chp{ execname, "--raw", "-c", "Raw data", NULL }), 1, 0,
+	   "--raw -c \"Raw data\"");
+	verify_logfile(&entry, 1, "--raw with plain text has no surrounding"
+	                          " spaces");
+	delete_logfile();
+
+	entry.txt = " <dingle><dangle>bær</dangle></dingle> ";
+	uc((chp{ execname, "--raw", "-c",
+	         "<dingle><dangle>bær</dangle></dingle>", NULL }),
+	   1, 0, "--raw -c \"<dingle><dangle>bær</dangle></dingle>\"");
+	verify_logfile(&entry, 1, "XML with --raw gets surrounding spaces");
+	delete_logfile();
+
+	entry.txt = "abc<raw>Raw data</raw>def";
+	uc((chp{ execname, "--raw", "-c", "abc<raw>Raw data</raw>def", NULL }),
+	   1, 0, "--raw -c \"abc<raw>Raw data</raw>def\"");
+	verify_logfile(&entry, 1, "--raw: XML with surrounding plain text gets"
+	                          " no surrounding spaces");
+	delete_logfile();
+
+	cleanup_tempdir(__LINE__);
+}
+
+                              /*** --rcfile ***/
+
+/*
+ * test_rcfile_option() - Tests the --rcfile option. Returns nothing.
+ */
+
+static void test_rcfile_option(void)
+{
+	struct Entry entry;
+	struct Rc rc;
+	char *rc2 = TMPDIR "/rc2", *s = NULL;
+
+	diag("Test --rcfile");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	init_rc(&rc);
+	rc.hostname = HNAME;
+	rc.macaddr = "ed604660c349";
+
+	if (OK_SUCCESS(create_rcfile(rc2, &rc),
+	               "Create rc file \"%s\"", rc2)) {
+	        diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
+	             __func__, __LINE__, rc2, strerror(errno)); /* gncov */
+	        errno = 0; /* gncov */
+	        goto cleanup; /* gncov */
+	}
+
+	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0, "--rcfile %s", rc2);
+	s = read_from_file(logfile);
+	if (!s) {
+		failed_ok("read_from_file(logfile)"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL(strstr(s, rc.macaddr),
+	           "The correct MAC address is in the log file");
+
+	if (set_env(ENV_HOSTNAME, HNAME))
+		goto cleanup; /* gncov */
+	uc((chp{ execname, "--rcfile", TMPDIR "/nosuchrc", NULL }), 1, 0,
+	   "--rcfile %s/nosuchrc", TMPDIR);
+	if (unset_env(ENV_HOSTNAME))
+		goto cleanup; /* gncov */
+	verify_logfile(&entry, 2,
+	               "Log file after missing rc file has 2 entries");
+
+	rc.macaddr = "";
+	if (OK_SUCCESS(create_rcfile(rc2, &rc),
+	               "Create rc file \"%s\" with empty MAC address", rc2)) {
+		diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, rc2, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
+		goto cleanup; /* gncov */
+	}
+	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0,
+	   "--rcfile %s with empty MAC address", rc2);
+	verify_logfile(&entry, 3,
+	               "Log file after empty MAC address in the rc file");
+
+	if (OK_NOTNULL(create_file(rc2, "hostname = " HNAME "\nmacaddr =\n"),
+	               "Create rc file \"%s\" with empty MAC address and no"
+	               " terminating space character after \"=\"", rc2)) {
+		diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, rc2, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
+		goto cleanup; /* gncov */
+	}
+	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0,
+	   "--rcfile %s with empty MAC address and no terminating space", rc2);
+	verify_logfile(&entry, 4, "Log file after empty MAC address and no"
+	                          " space in the rc file");
+	delete_logfile();
+
+	if (set_env(ENV_HOSTNAME, HNAME))
+		goto cleanup; /* gncov */
+	uc((chp{ execname, "--rcfile", "", NULL }), 1, 0,
+	   "Empty argument to --rcfile");
+	verify_logfile(&entry, 1, "Log file after empty argument to --rcfile");
+
+cleanup:
+	unset_env(ENV_HOSTNAME);
+	free(s);
+	if (file_exists(rc2))
+		OK_SUCCESS(remove(rc2), "Delete rc file %s", rc2);
+	cleanup_tempdir(__LINE__);
+}
+
+                              /*** --seal ***/
+
+/*
+ * test_seal_option() - Tests the --seal, --unseal and --range options. Sealed 
+ * files with more than one block are tested by test_seal_logfile(). Returns 
+ * nothing.
+ */
+
+static void test_seal_option(void)
+{
+	char *xmlfile = NULL, *sealfile = NULL, *xml = NULL,
+	     *exp_stderr = NULL;
+
+	diag("Test --seal");
+
+	if (init_tempdir())
+		return; /* gncov */
+	xmlfile = hname_path(LOGFILE_EXTENSION);
+	sealfile = hname_path(SEAL_EXTENSION);
+	if (!xmlfile || !sealfile)
+		goto cleanup; /* gncov */
+
+	uc((chp{ execname, "-n", "5", "-t", "tag1", "-c", "Comment", NULL }),
+	   5, 0, "Create log file with 5 entries");
+	tc((chp{ execname, "--seal", xmlfile, NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--seal");
+	OK_TRUE(file_exists(sealfile), "%s exists", sealfile);
+	OK_TRUE(file_exists(xmlfile), "The XML file is kept");
+	xml = read_from_file(xmlfile);
+	if (!xml) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--unseal", sealfile, NULL }),
+	   xml,
+	   "",
+	   EXIT_SUCCESS,
+	   "--unseal recreates the XML file");
+	sc((chp{ execname, "--seal", xmlfile, NULL }),
+	   "",
+	   SEAL_EXTENSION ": File already exists\n",
+	   EXIT_FAILURE,
+	   "--seal doesn't overwrite existing file");
+	sc((chp{ execname, "--unseal", xmlfile, NULL }),
+	   "",
+	   ": Not a sealed suuid log file\n",
+	   EXIT_FAILURE,
+	   "--unseal with XML file");
+
+	diag("--unseal with --range");
+	exp_stderr = allocstr("%s: %s: Decompressed 1 of 1 blocks\n",
+	                      EXECSTR, sealfile);
+	if (!exp_stderr) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "-v", "--unseal", sealfile, "--range", ",",
+	         NULL }),
+	   xml,
+	   exp_stderr,
+	   EXIT_SUCCESS,
+	   "--range without limits prints everything");
+	tc((chp{ execname, "--unseal", sealfile, "--range", "1999", NULL }),
+	   LOGFILE_HEADER LOGFILE_TRAILER,
+	   "",
+	   EXIT_SUCCESS,
+	   "--range with no entries");
+
+cleanup:
+	if (sealfile && file_exists(sealfile))
+		OK_SUCCESS(remove(sealfile), "Delete %s", sealfile);
+	free(exp_stderr);
+	free(xml);
+	free(sealfile);
+	free(xmlfile);
+	cleanup_tempdir(__LINE__);
+}
+
+                           /*** --serve-stdio ***/
+
+/*
+ * test_serve_stdio_option() - Tests the --serve-stdio option. Returns 
+ * nothing.
+ */
+
+static void test_serve_stdio_option(void)
+{
+	struct Options o = opt_struct();
+	struct streams ss;
+	char *before = NULL, *after = NULL;
+	struct Entry entry;
+
+	diag("Test --serve-stdio");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+
+	streams_init(&ss);
+	bb_allocstr(&ss.in, "{\"tag\":[\"stdiotag\"],\"txt\":\"Via stdio\"}\n"
+	                    "{\"n\":2,\"tag\":[\"stdiotag\"],"
+	                    "\"txt\":\"Via stdio\",\"w\":\"e\"}\n"
+	                    "not json\n");
+	streams_exec(&o, &ss, chp{ execname, "--serve-stdio", NULL });
+	if (!ss.out.buf || !ss.err.buf) {
+		failed_ok("ss.out.buf or ss.err.buf is NULL," /* gncov */
+		          " streams_exec()");
+		goto cleanup; /* gncov */
+	}
+	OK_EQUAL(count_uuids(ss.out.buf, "\n"), 3, "3 UUIDs on stdout");
+	OK_NOTNULL(strstr(ss.out.buf, "\nerror: Invalid request\n"),
+	           "The invalid request is answered with an error line");
+	OK_EQUAL(count_uuids(ss.err.buf, "\n"), 2,
+	         "\"w\":\"e\" prints 2 UUIDs to stderr");
+	OK_NOTNULL(strstr(ss.err.buf, ": Request failed: Invalid request\n"),
+	           "The error is also printed to stderr");
+	OK_EQUAL(ss.ret, EXIT_SUCCESS, "--serve-stdio exits with value 0");
+	entry.tag[0] = "stdiotag";
+	entry.txt = "Via stdio";
+	verify_logfile(&entry, 3, "--serve-stdio logged 3 entries");
+	streams_free(&ss);
+
+	diag("--serve-stdio rejects bad tag, txt and sess values");
+	before = read_from_file(logfile);
+	if (!before) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	bb_allocstr(&ss.in, "{\"tag\":[\"a\\u0001b\"]}\n"
+	                    "{\"txt\":\"a\\u0007b\"}\n"
+	                    "{\"sess\":[{\"uuid\":\"nope\"}]}\n");
+	streams_exec(&o, &ss, chp{ execname, "--serve-stdio", NULL });
+	if (!ss.out.buf) {
+		failed_ok("ss.out.buf is NULL, streams_exec()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_STRCMP(ss.out.buf, "error: Tag contains illegal characters\n"
+	                      "error: Comment contains illegal characters or"
+	                      " is not valid UTF-8\n"
+	                      "error: Invalid sess UUID\n",
+	          "--serve-stdio answers the bad requests with error lines");
+	OK_EQUAL(ss.ret, EXIT_SUCCESS,
+	         "--serve-stdio with bad requests exits with value 0");
+	after = read_from_file(logfile);
+	OK_NOTNULL(after, "Read the log file after the bad requests");
+	if (after)
+		OK_STRCMP(after, before, "The log file is unchanged");
+
+cleanup:
+	free(after);
+	free(before);
+	streams_free(&ss);
+	cleanup_tempdir(__LINE__);
+}
+
+                             /*** --segment ***/
+
+/*
+ * chk_manifest() - Used by test_segment_option(). Verifies that the manifest 
+ * file `fname` has `lines` lines and that segment `name` has `count` entries. 
+ * Returns nothing.
+ */
+
+static void chk_manifest(const int linenum, const char *fname,
+                         const size_t lines, const char *name,
+                         const unsigned long count)
+{
+	struct Manifest *man = NULL;
+	size_t n = 0, i;
+
+	assert(fname);
+	assert(name);
+
+	if (OK_SUCCESS_L(read_manifest(fname, &man, &n), linenum,
+	                 "Read manifest")) {
+		failed_ok("read_manifest()"); /* gncov */
+		return; /* gncov */
+	}
+	OK_EQUAL_L(n, lines, linenum, "Manifest has %zu lines", lines);
+	for (i = 0; i < n && strcmp(man[i].name, name); i++);
+	if (!OK_TRUE_L(i < n, linenum, "Segment %s is in the manifest",
+	               name)) {
+		OK_EQUAL_L(man[i].count, count, linenum,
+		           "Segment %s has %lu entries", name, count);
+		OK_TRUE_L(strcmp(man[i].first, man[i].last) <= 0, linenum,
+		          "Segment %s, first date isn't after the last",
+		          name);
+	}
+	free_manifest(man, n);
+}
+
+/*
+ * segfile_exists() - Used by test_segment_option(). Returns true if the file 
+ * `name` exists in the segment directory `dir`, otherwise false.
+ */
+
+static bool segfile_exists(const char *dir, const char *name)
+{
+	char *p;
+	bool retval;
+
+	assert(dir);
+	assert(name);
+
+	p = allocstr("%s/%s", dir, name);
+	if (!p) {
+		failed_ok("allocstr()"); /* gncov */
+		return false; /* gncov */
+	}
+	retval = file_exists(p);
+	free(p);
+
+	return retval;
+}
+
+/*
+ * test_segment_option() - Tests the --segment and --list-segments options. 
+ * Returns nothing.
+ */
+
+static void test_segment_option(void)
+{
+	const char *files[] = { "000001.xml", "000001.sxc", "000002.xml",
+	                        "000002.jsonl", "000002.sbr", "000002.sbh",
+	                        NULL, NULL };
+	char *dir = NULL, *manifest = NULL, *exp = NULL, *fname = NULL;
+	char month[8];
+	time_t t;
+	unsigned int i;
+
+	diag("Test --segment");
+
+	if (init_tempdir())
+		return; /* gncov */
+	dir = allocstr("%.*s", (int)(strlen(logfile)
+	                             - strlen(LOGFILE_EXTENSION)), logfile);
+	manifest = allocstr("%s/%s", dir, SEGMENT_MANIFEST);
+	if (!dir || !manifest) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+
+	uc((chp{ execname, "--segment", "1", NULL }), 1, 0,
+	   "--segment 1 creates the first segment");
+	OK_TRUE(segfile_exists(dir, "000001.xml"), "000001.xml exists");
+	OK_FALSE(file_exists(logfile), "Log file isn't created");
+	chk_manifest(__LINE__, manifest, 1, "000001", 1);
+	uc((chp{ execname, "--segment", "1", "-n", "2", NULL }), 2, 0,
+	   "--segment 1 -n 2 starts a new segment");
+	chk_manifest(__LINE__, manifest, 2, "000002", 2);
+	uc((chp{ execname, "--segment", "1k", "--jsonl", "--binlog", NULL }),
+	   1, 0, "--segment 1k --jsonl --binlog uses the active segment");
+	chk_manifest(__LINE__, manifest, 2, "000002", 3);
+	OK_TRUE(segfile_exists(dir, "000002.jsonl"), "JSON Lines file is segmented");
+	OK_TRUE(segfile_exists(dir, "000002.sbr"), "Binary log is segmented");
+
+	diag("--list-segments");
+	exp = allocstr("%s/000001.xml\n%s/000002.xml\n", dir, dir);
+	if (!exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--list-segments", ",", NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--list-segments without limits");
+	tc((chp{ execname, "--list-segments", "2000,", NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--list-segments with FROM");
+	tc((chp{ execname, "--list-segments", "1999", NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--list-segments with old year");
+	tc((chp{ execname, "--list-segments", ",1999-12-31", NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--list-segments with TO");
+	free(exp);
+	exp = allocstr("%s/000001.xml", dir);
+	if (!exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--seal", exp, NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--seal the first segment");
+	free(exp);
+	exp = allocstr("%s/000001.sxc\n%s/000002.xml\n", dir, dir);
+	if (!exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--list-segments", ",", NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--list-segments lists the sealed segment");
+
+	diag("--segment month");
+	t = time(NULL);
+	strftime(month, sizeof(month), "%Y-%m", gmtime(&t));
+	uc((chp{ execname, "--segment", "month", NULL }), 1, 0,
+	   "--segment month");
+	chk_manifest(__LINE__, manifest, 3, month, 1);
+	fname = allocstr("%s.xml", month);
+	files[6] = fname;
+
+	diag("Invalid values");
+	tc((chp{ execname, "--segment", "abc", NULL }),
+	   "",
+	   EXECSTR ": \"abc\": Invalid segment value\n",
+	   EXIT_FAILURE,
+	   "--segment with invalid value");
+	tc((chp{ execname, "--segment", "10X", NULL }),
+	   "",
+	   EXECSTR ": \"10X\": Invalid segment value\n",
+	   EXIT_FAILURE,
+	   "--segment with invalid suffix");
+	OK_NOTNULL(create_file(manifest, "000001 x\n"),
+	           "Create invalid manifest");
+	sc((chp{ execname, "--list-segments", ",", NULL }),
+	   "",
+	   SEGMENT_MANIFEST ": Invalid manifest line 1\n",
+	   EXIT_FAILURE,
+	   "--list-segments with invalid manifest");
+
+cleanup:
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		char *p;
+
+		if (!files[i])
+			continue;
+		p = allocstr("%s/%s", dir, files[i]);
+		if (p && file_exists(p))
+			OK_SUCCESS(remove(p), "Delete %s", p);
+		free(p);
+	}
+	if (manifest && file_exists(manifest))
+		OK_SUCCESS(remove(manifest), "Delete manifest");
+	if (dir && file_exists(dir))
+		OK_SUCCESS(rmdir(dir), "Delete segment directory");
+	free(fname);
+	free(exp);
+	free(manifest);
+	free(dir);
+	cleanup_tempdir(__LINE__);
+}
+
+                              /*** --shards ***/
+
+/*
+ * chk_shard_count() - Used by test_shards_option(). Verifies that the shards 
+ * in `shardfile` contain `count` entries in total and that the unsharded log 
+ * file doesn't exist. `shardfile` is a copy of the file name of shard 0, and 
+ * the shards are deleted afterwards. Returns nothing.
+ */
+
+static void chk_shard_count(const int linenum, char *shardfile,
+                            const size_t count, const char *desc)
+{
+	char *p = strrchr(shardfile, '.') - 1;
+	size_t n = 0;
+
+	assert(desc);
+	assert(*desc);
+
+	OK_FALSE_L(file_exists(logfile), linenum, "%s, no %s", desc, logfile);
+	for (*p = '0'; *p <= '1'; (*p)++) {
+		char *xml;
+
+		if (!file_exists(shardfile))
+			continue;
+		xml = read_from_file(shardfile);
+		if (!xml) {
+			failed_ok("read_from_file()"); /* gncov */
+			continue; /* gncov */
+		}
+		n += count_substr(xml, "<suuid ");
+		free(xml);
+		OK_SUCCESS_L(remove(shardfile), linenum, "%s, delete %s", desc,
+		             shardfile);
+	}
+	*p = '0';
+	OK_EQUAL_L(n, count, linenum, "%s, %zu entries in the shards", desc,
+	           count);
+}
+
+/*
+ * test_shards_option() - Tests the --shards and --merge-shards options and 
+ * the "shards" keyword in the rc file. Returns nothing.
+ */
+
+static void test_shards_option(void)
+{
+	const char *l[] = {
+		"<suuid t=\"2026-10-18T19:07:29.4008240Z\""
+		" u=\"2a0017b0-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>",
+		"<suuid t=\"2026-10-18T19:07:29.4008241Z\""
+		" u=\"2a0017b1-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>",
+		"<suuid t=\"2026-10-18T19:07:29.4008242Z\""
+		" u=\"2a0017b2-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>",
+		"<suuid t=\"2026-10-18T19:07:29.4008243Z\""
+		" u=\"2a0017b3-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>",
+		"<suuid t=\"2026-10-18T19:07:29.4008244Z\""
+		" u=\"2a0017b4-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>",
+		"<!-- No UUID -->",
+		"<suuid t=\"2026-10-18T19:07:29.4008245Z\""
+		" u=\"2a0017b5-cb27-11f1-8a3d-51bb7ba40671\"> </suuid>"
+	};
+	char *xmlfile = NULL, *shard0 = NULL, *shard1 = NULL, *sealfile = NULL,
+	     *main_xml = NULL, *s0 = NULL, *s1 = NULL, *exp = NULL;
+	struct Rc rc;
+
+	diag("Test --shards and --merge-shards");
+
+	if (init_tempdir())
+		return; /* gncov */
+	xmlfile = hname_path(LOGFILE_EXTENSION);
+	shard0 = hname_path(".0" LOGFILE_EXTENSION);
+	shard1 = hname_path(".1" LOGFILE_EXTENSION);
+	sealfile = hname_path(SEAL_EXTENSION);
+	if (!xmlfile || !shard0 || !shard1 || !sealfile)
+		goto cleanup; /* gncov */
+
+	main_xml = allocstr(LOGFILE_HEADER "%s\n%s\n" LOGFILE_TRAILER,
+	                    l[0], l[3]);
+	s0 = allocstr(LOGFILE_HEADER "%s\n%s\n%s\n" LOGFILE_TRAILER,
+	              l[1], l[4], l[5]);
+	s1 = allocstr(LOGFILE_HEADER "%s\n%s\n" LOGFILE_TRAILER, l[2], l[6]);
+	exp = allocstr(LOGFILE_HEADER "%s\n%s\n%s\n%s\n%s\n%s\n%s\n"
+	               LOGFILE_TRAILER, l[0], l[1], l[2], l[3], l[4], l[5],
+	               l[6]);
+	if (!main_xml || !s0 || !s1 || !exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (OK_NOTNULL(create_file(xmlfile, main_xml), "Create %s", xmlfile)
+	    || OK_NOTNULL(create_file(shard0, s0), "Create %s", shard0)
+	    || OK_NOTNULL(create_file(shard1, s1), "Create %s", shard1))
+		goto cleanup; /* gncov */
+
+	tc((chp{ execname, "--merge-shards", xmlfile, NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--merge-shards sorts by the UUID timestamps");
+	sc((chp{ execname, "-vv", "--merge-shards", xmlfile, NULL }),
+	   exp,
+	   ": Reading 2 shards of " TMPDIR,
+	   EXIT_SUCCESS,
+	   "--merge-shards -vv");
+	tc((chp{ execname, "--seal", xmlfile, NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--seal merges the shards");
+	tc((chp{ execname, "--unseal", sealfile, NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--unseal after sealing the shards");
+	OK_SUCCESS(remove(sealfile), "Delete %s", sealfile);
+
+	OK_SUCCESS(remove(xmlfile), "Delete %s", xmlfile);
+	free(exp);
+	exp = allocstr(LOGFILE_HEADER "%s\n%s\n%s\n%s\n%s\n" LOGFILE_TRAILER,
+	               l[1], l[2], l[4], l[5], l[6]);
+	if (!exp) {
+		failed_ok("allocstr()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	tc((chp{ execname, "--merge-shards", xmlfile, NULL }),
+	   exp,
+	   "",
+	   EXIT_SUCCESS,
+	   "--merge-shards without the unsharded file");
+	OK_SUCCESS(remove(shard0), "Delete %s", shard0);
+	OK_SUCCESS(remove(shard1), "Delete %s", shard1);
+	sc((chp{ execname, "--merge-shards", xmlfile, NULL }),
+	   "",
+	   LOGFILE_EXTENSION ": Could not open file for read: No such"
+	   " file or directory\n",
+	   EXIT_FAILURE,
+	   "--merge-shards with no log files");
+
+	uc((chp{ execname, "--shards", "2", "-n", "5", NULL }), 5, 0,
+	   "--shards 2 -n 5");
+	chk_shard_count(__LINE__, shard0, 5, "--shards 2");
+	uc((chp{ execname, "--shards", "1", NULL }), 1, 0, "--shards 1");
+	OK_TRUE(file_exists(xmlfile), "--shards 1 uses the unsharded file");
+	sc((chp{ execname, "--shards", "0", NULL }),
+	   "",
+	   ": \"0\": Invalid number of shards, must be 1-1024\n",
+	   EXIT_FAILURE,
+	   "--shards 0");
+	sc((chp{ execname, "--shards", "1025", NULL }),
+	   "",
+	   ": \"1025\": Invalid number of shards, must be 1-1024\n",
+	   EXIT_FAILURE,
+	   "--shards 1025");
+	sc((chp{ execname, "--shards", "2x", NULL }),
+	   "",
+	   ": \"2x\": Invalid number of shards, must be 1-1024\n",
+	   EXIT_FAILURE,
+	   "--shards 2x");
+	sc((chp{ execname, "--shards", "2", "--segment", "month", NULL }),
+	   "",
+	   ": Sharded logs can't be segmented\n",
+	   EXIT_FAILURE,
+	   "--shards with --segment");
+	OK_SUCCESS(remove(xmlfile), "Delete %s", xmlfile);
+
+	diag("shards in the rc file");
+	init_rc(&rc);
+	rc.hostname = HNAME;
+	rc.shards = "2";
+	if (OK_SUCCESS(create_rcfile(rcfile, &rc),
+	               "Create rc file with shards = 2")) {
+		diag("%s():%d: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, strerror(errno)); /* gncov */
+		errno = 0; /* gncov */
 		goto cleanup; /* gncov */
 	}
-	OK_NULL(strstr(s, rc.macaddr),
-	        "rc.macaddr doesn't exist in the log file after --random-mac");
-	free(s);
-	s = NULL;
-
-	test_unique_macs();
+	uc((chp{ execname, "-n", "3", NULL }), 3, 0, "shards = 2 in rc file");
+	chk_shard_count(__LINE__, shard0, 3, "shards = 2");
 
 cleanup:
-	free(s);
+	free(exp);
+	free(s1);
+	free(s0);
+	free(main_xml);
+	free(sealfile);
+	free(shard1);
+	free(shard0);
+	free(xmlfile);
 	cleanup_tempdir(__LINE__);
 }
 
-                                /*** --raw ***/
+                              /*** --stream ***/
 
 /*
- * test_raw_option() - Tests the --raw option. Returns nothing.
+ * test_stream_option() - Tests the --stream option. Returns nothing.
  */
 
-static void test_raw_option(void)
+static void test_stream_option(void)
 {
-	struct Entry entry;
+	struct Options o = opt_struct();
+	struct streams ss;
+	char *xml = NULL, *p;
+	unsigned int lines = 0;
 
-	diag("Test --raw");
+	diag("Test --stream");
 
 	if (init_tempdir())
 		return; /* gncov */
-	init_xml_entry(&entry);
 
-	entry.txt = "Raw data";
-	uc((chp{ execname, "--raw", "-c", "Raw data", NULL }), 1, 0,
-	   "--raw -c \"Raw data\"");
-	verify_logfile(&entry, 1, "--raw with plain text has no surrounding"
-	                          " spaces");
-	delete_logfile();
-
-	entry.txt = " <dingle><dangle>bær</dangle></dingle> ";
-	uc((chp{ execname, "--raw", "-c",
-	         "<dingle><dangle>bær</dangle></dingle>", NULL }),
-	   1, 0, "--raw -c \"<dingle><dangle>bær</dangle></dingle>\"");
-	verify_logfile(&entry, 1, "XML with --raw gets surrounding spaces");
-	delete_logfile();
-
-	entry.txt = "abc<raw>Raw data</raw>def";
-	uc((chp{ execname, "--raw", "-c", "abc<raw>Raw data</raw>def", NULL }),
-	   1, 0, "--raw -c \"abc<raw>Raw data</raw>def\"");
-	verify_logfile(&entry, 1, "--raw: XML with surrounding plain text gets"
-	                          " no surrounding spaces");
-	delete_logfile();
+	streams_init(&ss);
+	bb_allocstr(&ss.in, "First line\n"
+	                    "tag1,tag2\tSecond line\n"
+	                    "tag3\ttag4\t\n"
+	                    "\xff\tInvalid tag\n"
+	                    "Last line");
+	streams_exec(&o, &ss, chp{ execname, "--stream", "-t", "base", "-c",
+	                           "Default", NULL });
+	if (!ss.out.buf || !ss.err.buf) {
+		failed_ok("ss.out.buf or ss.err.buf is NULL," /* gncov */
+		          " streams_exec()");
+		goto cleanup; /* gncov */
+	}
+	for (p = ss.out.buf; *p; p = strchr(p, '\n') + 1) {
+		if (!strchr(p, '\n'))
+			break; /* gncov */
+		if (valid_uuid(p, false) && p[UUID_LENGTH] == '\t')
+			lines++;
+	}
+	OK_EQUAL(lines, 4, "4 lines with UUID and tab on stdout");
+	OK_NOTNULL(strstr(ss.out.buf, "\ttag1,tag2\tSecond line\n"),
+	           "The input line is printed after the UUID");
+	OK_NOTNULL(strstr(ss.out.buf, "\tLast line\n"),
+	           "The last line doesn't need a newline");
+	OK_NOTNULL(strstr(ss.err.buf, ": stdin, line 4: Entry not logged\n"),
+	           "The invalid line is reported with its line number");
+	OK_EQUAL(ss.ret, EXIT_FAILURE, "--stream exits with value 1");
+
+	xml = read_from_file(logfile);
+	if (!xml) {
+		failed_ok("read_from_file()"); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	OK_NOTNULL(strstr(xml, "> <tag>base</tag> <txt>First line</txt> "),
+	           "A line without tabs is the comment");
+	OK_NOTNULL(strstr(xml, "> <tag>base</tag> <tag>tag1</tag>"
+	                       " <tag>tag2</tag> <txt>Second line</txt> "),
+	           "The fields before the last one are tags");
+	OK_NOTNULL(strstr(xml, "> <tag>base</tag> <tag>tag3</tag>"
+	                       " <tag>tag4</tag> <txt>Default</txt> "),
+	           "-c is used when the comment is empty");
+	OK_NULL(strstr(xml, "Invalid tag"), "The invalid line isn't logged");
+
+	sc((chp{ execname, "--stream", "-c", "-", NULL }),
+	   "",
+	   ": The comment can't be read from stdin or an editor when stdin"
+	   " is used for the entries\n",
+	   EXIT_FAILURE,
+	   "--stream with -c -");
 
+cleanup:
+	free(xml);
+	streams_free(&ss);
 	cleanup_tempdir(__LINE__);
 }
 
-                              /*** --rcfile ***/
+                              /*** --sync ***/
 
 /*
- * test_rcfile_option() - Tests the --rcfile option. Returns nothing.
+ * test_sync_option() - Tests the --sync option and the "sync" keyword in the 
+ * rc file. Returns nothing.
  */
 
-static void test_rcfile_option(void)
+static void test_sync_option(void)
 {
 	struct Entry entry;
 	struct Rc rc;
-	char *rc2 = TMPDIR "/rc2", *s = NULL;
 
-	diag("Test --rcfile");
+	diag("Test --sync");
 
 	if (init_tempdir())
 		return; /* gncov */
 	init_xml_entry(&entry);
 
+	uc((chp{ execname, "--sync", "none", NULL }), 1, 0, "--sync none");
+	sc((chp{ execname, "-vv", "--sync", "close", NULL }),
+	   NULL,
+	   ": Synced the log files 1 time\n",
+	   EXIT_SUCCESS,
+	   "--sync close syncs once");
+	sc((chp{ execname, "-vv", "--sync", "batch", "-n", "1500", "-w",
+	         "n", NULL }),
+	   "",
+	   ": Synced the log files ",
+	   EXIT_SUCCESS,
+	   "--sync batch -n 1500");
+	verify_logfile(&entry, 1502, "Log file after --sync");
+	uc((chp{ execname, "--sync", "batch", "--logmode", "append", NULL }),
+	   1, 0, "--sync batch --logmode append");
+	delete_logfile();
+	tc((chp{ execname, "--sync", "often", NULL }),
+	   "",
+	   EXECSTR ": \"often\": Unknown sync mode\n",
+	   EXIT_FAILURE,
+	   "--sync with unknown mode");
+
+	diag("sync in the rc file");
 	init_rc(&rc);
 	rc.hostname = HNAME;
-	rc.macaddr = "ed604660c349";
-
-	if (OK_SUCCESS(create_rcfile(rc2, &rc),
-	               "Create rc file \"%s\"", rc2)) {
-	        diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
-	             __func__, __LINE__, rc2, strerror(errno)); /* gncov */
-	        errno = 0; /* gncov */
-	        goto cleanup; /* gncov */
-	}
-
-	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0, "--rcfile %s", rc2);
-	s = read_from_file(logfile);
-	if (!s) {
-		failed_ok("read_from_file(logfile)"); /* gncov */
-		goto cleanup; /* gncov */
-	}
-	OK_NOTNULL(strstr(s, rc.macaddr),
-	           "The correct MAC address is in the log file");
-
-	if (set_env(ENV_HOSTNAME, HNAME))
-		goto cleanup; /* gncov */
-	uc((chp{ execname, "--rcfile", TMPDIR "/nosuchrc", NULL }), 1, 0,
-	   "--rcfile %s/nosuchrc", TMPDIR);
-	if (unset_env(ENV_HOSTNAME))
-		goto cleanup; /* gncov */
-	verify_logfile(&entry, 2,
-	               "Log file after missing rc file has 2 entries");
-
-	rc.macaddr = "";
-	if (OK_SUCCESS(create_rcfile(rc2, &rc),
-	               "Create rc file \"%s\" with empty MAC address", rc2)) {
-		diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
-		     __func__, __LINE__, rc2, strerror(errno)); /* gncov */
+	rc.sync = "close";
+	if (OK_SUCCESS(create_rcfile(rcfile, &rc),
+	               "Create rc file with sync = close")) {
+		diag("%s():%d: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, strerror(errno)); /* gncov */
 		errno = 0; /* gncov */
 		goto cleanup; /* gncov */
 	}
-	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0,
-	   "--rcfile %s with empty MAC address", rc2);
-	verify_logfile(&entry, 3,
-	               "Log file after empty MAC address in the rc file");
-
-	if (OK_NOTNULL(create_file(rc2, "hostname = " HNAME "\nmacaddr =\n"),
-	               "Create rc file \"%s\" with empty MAC address and no"
-	               " terminating space character after \"=\"", rc2)) {
-		diag("%s():%d: %s: Cannot create rc file: %s", /* gncov */
-		     __func__, __LINE__, rc2, strerror(errno)); /* gncov */
+	sc((chp{ execname, "-vv", NULL }),
+	   NULL,
+	   ": Synced the log files 1 time\n",
+	   EXIT_SUCCESS,
+	   "sync = close in rc file");
+	rc.sync = "nope";
+	if (OK_SUCCESS(create_rcfile(rcfile, &rc),
+	               "Create rc file with sync = nope")) {
+		diag("%s():%d: Cannot create rc file: %s", /* gncov */
+		     __func__, __LINE__, strerror(errno)); /* gncov */
 		errno = 0; /* gncov */
 		goto cleanup; /* gncov */
 	}
-	uc((chp{ execname, "--rcfile", rc2, NULL }), 1, 0,
-	   "--rcfile %s with empty MAC address and no terminating space", rc2);
-	verify_logfile(&entry, 4, "Log file after empty MAC address and no"
-	                          " space in the rc file");
-	delete_logfile();
-
-	if (set_env(ENV_HOSTNAME, HNAME))
-		goto cleanup; /* gncov */
-	uc((chp{ execname, "--rcfile", "", NULL }), 1, 0,
-	   "Empty argument to --rcfile");
-	verify_logfile(&entry, 1, "Log file after empty argument to --rcfile");
+	tc((chp{ execname, NULL }),
+	   "",
+	   EXECSTR ": \"nope\": Unknown sync mode\n",
+	   EXIT_FAILURE,
+	   "Unknown sync mode in rc file");
+	tc((chp{ execname, "--sync", "none", "-w", "n", NULL }),
+	   "",
+	   "",
+	   EXIT_SUCCESS,
+	   "--sync overrides sync in rc file");
 
 cleanup:
-	unset_env(ENV_HOSTNAME);
-	free(s);
-	if (file_exists(rc2))
-		OK_SUCCESS(remove(rc2), "Delete rc file %s", rc2);
 	cleanup_tempdir(__LINE__);
 }
 
@@ -4604,19 +7914,19 @@ static void test_tag_option(void)
 }
 
 /*
- * test_too_many_tags() - Tests the -t/--tag option with too many tags. Returns 
- * nothing.
+ * test_many_tags() - Tests the -t/--tag option with more tags than there's 
+ * room for inside `struct Entry`. Returns nothing.
  */
 
-static void test_too_many_tags(void)
+static void test_many_tags(void)
 {
 	struct Entry entry;
 	unsigned int i;
-	size_t tag_count = MAX_TAGS + 1,
+	size_t tag_count = 1001,
 	       arrsize = 2 * tag_count + 2;
-	char *arr[arrsize], *s = NULL;
+	char *arr[arrsize], *s;
 
-	diag("Too many -t/--tag options");
+	diag("Many -t/--tag options");
 
 	if (init_tempdir())
 		return; /* gncov */
@@ -4638,85 +7948,283 @@ static void test_too_many_tags(void)
 			failed_ok("allocstr()"); /* gncov */
 			goto cleanup; /* gncov */
 		}
-	}
 
-	s = allocstr("%s: Maximum number of tags (%u) exceeded\n%s",
-	             EXECSTR, MAX_TAGS, OPTION_ERROR_STR);
-	if (!s) {
-		failed_ok("allocstr()"); /* gncov */
-		goto cleanup; /* gncov */
+		s = mystrdup(arr[i * 2 + 2]);
+		if (!s || append_tag(&entry, s)) {
+			failed_ok("append_tag()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
 	}
+	OK_EQUAL(entry.tag_count, tag_count, "append_tag() stored all tags");
+	OK_TRUE(entry.tag != entry.tag_buf,
+	        "The tag array is moved to the heap");
+	OK_NULL(entry.tag[tag_count], "The tag array ends with NULL");
 
-	tc(arr, "", s, EXIT_FAILURE, "Too many tags");
-	OK_FALSE(file_exists(logfile),
-	         "Log file doesn't exist after too many tags");
+	uc(arr, 1, 0, "%zu tags", tag_count);
+	verify_logfile(&entry, 1, "Log file contains %zu tags", tag_count);
 
 cleanup:
-	free(s);
+	free_tags(&entry);
+	OK_TRUE(entry.tag == entry.tag_buf && !entry.tag[0],
+	        "free_tags() resets the tag array");
 	for (i = 0; i < arrsize; i++)
 		free(arr[i]);
 	cleanup_tempdir(__LINE__);
 }
 
 /*
- * test_too_many_comma_tags() - Tests what happens when too many 
- * comma-separated tags (more than MAX_TAGS) are used with --tag. Returns 
- * nothing.
+ * test_many_comma_tags() - Tests --tag with more comma-separated tags than 
+ * there's room for inside `struct Entry`. Returns nothing.
  */
 
-static void test_too_many_comma_tags(void)
+static void test_many_comma_tags(void)
 {
 	struct Entry entry;
-	size_t digits = 1, n = MAX_TAGS + 1, bufsize;
-	char *buf, *p, *exp_stderr = NULL;
+	size_t n = 1001, bufsize, len = 0;
+	char *buf, *p;
 	unsigned int i;
 
-	diag("Too many comma-separated tags");
+	diag("Many comma-separated tags");
 
 	if (init_tempdir())
 		return; /* gncov */
 	init_xml_entry(&entry);
 
-	while (n >= 10) {
-		digits++;
-		n /= 10;
-	}
-	bufsize = MAX_TAGS * (strlen("t") + digits + strlen(",")) + 1;
-	if (bufsize < MAX_TAGS) {
-		OK_ERROR("Buffer size overflow for MAX_TAGS=%u", /* gncov */
-		         MAX_TAGS);
-		return; /* gncov */
-	}
-
+	bufsize = n * (strlen("t") + 4 + strlen(",")) + 1;
 	buf = malloc(bufsize);
 	if (!buf) {
 		failed_ok("malloc()"); /* gncov */
 		return; /* gncov */
 	}
-	*buf = '\0';
 
-	p = buf;
-	for (i = 1; i <= MAX_TAGS + 1; i++) {
-		p = allocstr("t%u,", i);
-		if (!p) {
-			failed_ok("allocstr()"); /* gncov */
+	for (i = 1; i <= n; i++) {
+		len += (size_t)snprintf(buf + len, bufsize - len, "t%u,", i);
+		p = allocstr("t%u", i);
+		if (!p || append_tag(&entry, p)) {
+			failed_ok("append_tag()"); /* gncov */
 			goto cleanup; /* gncov */
 		}
-		strcat(buf, p);
-		free(p);
 	}
 
-	exp_stderr = allocstr("%s: Maximum number of tags (%u) exceeded\n",
-	                      execname, MAX_TAGS);
-	tc((chp{ execname, "--tag", buf, NULL }),
+	uc((chp{ execname, "--tag", buf, NULL }), 1, 0,
+	   "%zu comma-separated tags", n);
+	verify_logfile(&entry, 1, "Log file contains %zu comma-separated tags",
+	               n);
+
+cleanup:
+	free_tags(&entry);
+	free(buf);
+	cleanup_tempdir(__LINE__);
+}
+
+                           /*** --trace-timing ***/
+
+/*
+ * chk_trace() - Used by test_trace_timing_option(). Verifies that `s` is a 
+ * valid JSON object from --trace-timing with `count` UUIDs and all the 
+ * phases. Returns nothing.
+ */
+
+static void chk_trace(const int linenum, const char *s,
+                      const unsigned long count, const char *desc)
+{
+	const char *keys[] = {
+		"\"init_randomness\":{\"ns\":", "\"read_rcfile\":{\"ns\":",
+		"\"fill_entry_struct\":{\"ns\":", "\"hostname\":{\"ns\":",
+		"\"cwd\":{\"ns\":", "\"user\":{\"ns\":", "\"tty\":{\"ns\":",
+		"\"sess\":{\"ns\":", "\"open_logfile\":{\"ns\":",
+		"\"generate\":{\"ns\":", "\"serialize\":{\"ns\":",
+		"\"write\":{\"ns\":", "\"close_logfile\":{\"ns\":",
+		"\"open_logfile\":{\"lock_wait_ns\":", "\"locks\":{\"count\":",
+		"\"counters\":{\"allocs\":", "\"xml_escapes\":",
+		"\"log_writes\":", "\"clock_reads\":", "\"clock_spins\":",
+	};
+	char *exp;
+	size_t i;
+
+	assert(desc);
+
+	OK_TRUE_L(s && json_valid(s), linenum, "%s, valid JSON", desc);
+	if (!s)
+		return; /* gncov */
+	OK_TRUE_L(!strncmp(s, "{\"total_ns\":", 12), linenum,
+	          "%s, starts with total_ns", desc);
+	exp = allocstr(",\"count\":%lu,", count);
+	OK_NOTNULL_L(exp ? strstr(s, exp) : NULL, linenum, "%s, count is %lu",
+	             desc, count);
+	free(exp);
+	for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+		OK_NOTNULL_L(strstr(s, keys[i]), linenum, "%s, contains %s",
+		             desc, keys[i]);
+	}
+}
+
+/*
+ * trace_value() - Used by test_trace_timing_option(). Return the integer 
+ * value of the member `name` in the JSON object `s` from --trace-timing, or 
+ * 0 if it's not found.
+ */
+
+static unsigned long long trace_value(const char *s, const char *name)
+{
+	char *key;
+	const char *p;
+
+	assert(name);
+
+	if (!s)
+		return 0; /* gncov */
+	key = allocstr("\"%s\":", name);
+	if (!key) {
+		failed_ok("allocstr()"); /* gncov */
+		return 0; /* gncov */
+	}
+	p = strstr(s, key);
+	if (p)
+		p += strlen(key);
+	free(key);
+
+	return p ? strtoull(p, NULL, 10) : 0;
+}
+
+/*
+ * test_trace_timing_option() - Tests the --trace-timing option. Returns 
+ * nothing.
+ */
+
+static void test_trace_timing_option(void)
+{
+	char tracefile[] = TMPDIR "/trace.json";
+	struct Options o = opt_struct();
+	struct streams ss;
+	char *s = NULL;
+
+	diag("Test --trace-timing");
+
+	if (init_tempdir())
+		return; /* gncov */
+
+	streams_init(&ss);
+	streams_exec(&o, &ss, chp{ execname, "-n", "5", "--trace-timing", "-",
+	                           NULL });
+	if (!ss.out.buf || !ss.err.buf) {
+		failed_ok("ss.out.buf or ss.err.buf is NULL," /* gncov */
+		          " streams_exec()");
+		goto cleanup; /* gncov */
+	}
+	OK_EQUAL(count_uuids(ss.out.buf, "\n"), 5, "5 UUIDs on stdout");
+	chk_trace(__LINE__, ss.err.buf, 5, "--trace-timing -");
+	OK_EQUAL(ss.ret, EXIT_SUCCESS, "--trace-timing - (retval)");
+
+	uc((chp{ execname, "-n", "1000", "--trace-timing", tracefile, NULL }),
+	   1000, 0, "--trace-timing with file");
+	s = read_from_file(tracefile);
+	chk_trace(__LINE__, s, 1000, "--trace-timing with file");
+	OK_EQUAL(trace_value(s, "clock_reads") - trace_value(s, "clock_spins"),
+	         1000, "The clock was read once for every UUID, apart from"
+	               " spins");
+	OK_TRUE(trace_value(s, "xml_escapes") >= 1000,
+	        "The entries were escaped");
+	OK_TRUE(trace_value(s, "log_bytes") > 1000, "Bytes were written to the"
+	                                            " log file");
+	OK_NOTNULL(s ? strstr(s, "\"calls\":1000}") : NULL,
+	           "A phase was timed 1000 times");
+
+	sc((chp{ execname, "--trace-timing", TMPDIR "/nonexisting/file",
+	         NULL }),
+	   NULL,
+	   "/nonexisting/file: Could not open file",
+	   EXIT_FAILURE,
+	   "--trace-timing with file in nonexisting directory");
+
+cleanup:
+	free(s);
+	streams_free(&ss);
+	if (file_exists(tracefile))
+		OK_SUCCESS(remove(tracefile), "Delete %s", tracefile);
+	cleanup_tempdir(__LINE__);
+}
+
+                               /*** --uuid ***/
+
+/*
+ * test_uuid_option() - Tests the --uuid option with a UUID, a file and 
+ * stdin. Returns nothing.
+ */
+
+static void test_uuid_option(void)
+{
+	char uuidfile[] = TMPDIR "/uuids.txt";
+	struct Options o = opt_struct();
+	struct streams ss;
+	struct Entry entry;
+
+	diag("Test --uuid");
+
+	if (init_tempdir())
+		return; /* gncov */
+	init_xml_entry(&entry);
+	entry.tag[0] = "import";
+
+	tc((chp{ execname, "--uuid", "0a1d9f8e-cb33-11f1-8000-02fc00000001",
+	         "-t", "import", NULL }),
+	   "0a1d9f8e-cb33-11f1-8000-02fc00000001\n",
+	   "",
+	   EXIT_SUCCESS,
+	   "--uuid with a UUID");
+	verify_logfile(&entry, 1, "--uuid logged 1 entry");
+
+	OK_NOTNULL(create_file(uuidfile,
+	                       "0a1d9f8e-cb33-11f1-8000-02fc00000002\n"
+	                       "\n"
+	                       "  0a1d9f8e-cb33-11f1-8000-02fc00000003  \n"
+	                       "17dc339e-9e43-4032-bf8d-449db7b2547b\n"
+	                       "Not a UUID\n"
+	                       "0a1d9f8e-cb33-11f1-8000-02fc00000004"),
+	           "Create %s", uuidfile);
+	tc((chp{ execname, "--uuid", uuidfile, "-t", "import", NULL }),
+	   "0a1d9f8e-cb33-11f1-8000-02fc00000002\n"
+	   "0a1d9f8e-cb33-11f1-8000-02fc00000003\n"
+	   "0a1d9f8e-cb33-11f1-8000-02fc00000004\n",
+	   EXECSTR ": " TMPDIR "/uuids.txt, line 4: Invalid UUID\n"
+	   EXECSTR ": " TMPDIR "/uuids.txt, line 5: Invalid UUID\n",
+	   EXIT_FAILURE,
+	   "--uuid with a file, invalid lines are reported");
+	verify_logfile(&entry, 4, "The valid UUIDs in the file are logged");
+
+	streams_init(&ss);
+	bb_allocstr(&ss.in, "0a1d9f8e-cb33-11f1-8000-02fc00000005\n"
+	                    "0a1d9f8e-cb33-11f1-8000-02fc00000006\n");
+	streams_exec(&o, &ss, chp{ execname, "--uuid", "-", "-t", "import",
+	                           "-w", "e", NULL });
+	if (!ss.out.buf || !ss.err.buf) {
+		failed_ok("ss.out.buf or ss.err.buf is NULL," /* gncov */
+		          " streams_exec()");
+		goto cleanup; /* gncov */
+	}
+	OK_STRCMP(ss.out.buf, "", "--uuid - (stdout)");
+	OK_STRCMP(ss.err.buf, "0a1d9f8e-cb33-11f1-8000-02fc00000005\n"
+	                      "0a1d9f8e-cb33-11f1-8000-02fc00000006\n",
+	          "--uuid - (stderr)");
+	OK_EQUAL(ss.ret, EXIT_SUCCESS, "--uuid - (retval)");
+	verify_logfile(&entry, 6, "The UUIDs from stdin are logged");
+
+	sc((chp{ execname, "--uuid", TMPDIR "/nonexisting", NULL }),
 	   "",
-	   exp_stderr,
+	   "/nonexisting: Could not open file",
 	   EXIT_FAILURE,
-	   "Too many comma-separated tags");
+	   "--uuid with nonexisting file");
+	sc((chp{ execname, "--uuid", "-", "-c", "-", NULL }),
+	   "",
+	   ": The comment can't be read from stdin or an editor when stdin"
+	   " is used for the UUIDs\n",
+	   EXIT_FAILURE,
+	   "--uuid - with -c -");
 
 cleanup:
-	free(exp_stderr);
-	free(buf);
+	streams_free(&ss);
+	if (file_exists(uuidfile))
+		OK_SUCCESS(remove(uuidfile), "Delete %s", uuidfile);
 	cleanup_tempdir(__LINE__);
 }
 
@@ -4743,8 +8251,9 @@ static void test_whereto_option(void)
 	uc((chp{ execname, "-w", "n", NULL }), 0, 0, "\"-w n\" prints nothing");
 	uc((chp{ execname, "-w", "y", NULL }), 0, 0, "\"-w y\" prints nothing");
 	uc((chp{ execname, "-w", "", NULL }), 0, 0, "\"-w\" with empty argument prints nothing");
+	uc((chp{ execname, "-n", "1000", "-w", "a", NULL }), 1000, 1000, "\"-n 1000 -w a\" prints all UUIDs through the buffers");
 
-	verify_logfile(&entry, 7, "Log file contains the correct number of"
+	verify_logfile(&entry, 1007, "Log file contains the correct number of"
 	                          " entries after -w/--whereto");
 	cleanup_tempdir(__LINE__);
 }
@@ -4775,7 +8284,7 @@ static void test_sigpipe_signal(const int linenum, const char *args)
 	init_xml_entry(&entry);
 	s = allocstr("#!/bin/sh\n"
 	             "\n"
-	             "%s -n 1000 -vvvv %s | true\n", execname, args);
+	             "%s -n 10000 -vvvv %s | true\n", execname, args);
 	if (!s) {
 		failed_ok("allocstr()"); /* gncov */
 		return; /* gncov */
@@ -4793,20 +8302,25 @@ static void test_sigpipe_signal(const int linenum, const char *args)
 	pattern = allocstr(
 	          "^"
 	          "%s: main\\(\\): Using verbose level 4\n"
+	          "(%s: Using the environment cache [^\n]+\n)?"
 	          "%s: Termination signal \\(Broken pipe\\) received, aborting"
 #ifdef __NetBSD__
 	          ": No such file or directory" /* FIXME */
 #endif
 	          "\n"
 	          "%s: Cannot print UUID to stdout: Broken pipe\n"
-	          "%s: Generated only [0-9]+ of 1000 UUIDs\n"
+	          "%s: Generated only [0-9]+ of 10000 UUIDs\n"
+	          "%s: The writer thread wrote [0-9]+ entries, the ring was"
+	          " full [0-9]+ times?\n"
+	          "%s: Locked the log files [0-9]+ times? without waiting\n"
 	          "%s: Returning from main\\(\\) with value 1\n"
 #ifdef __FreeBSD__
 	          /* FIXME: Happens in FreeBSD 14.2 */
 	          "(%s: Termination signal \\(Broken pipe\\) received, aborting\n)?"
 #endif
 	          "$",
-	          execname, execname, execname, execname, execname
+	          execname, execname, execname, execname, execname, execname,
+	          execname, execname
 #ifdef __FreeBSD__
 	          , execname
 #endif
@@ -5028,9 +8542,19 @@ static void functests_with_tempdir(void)
 	test_file_exists();
 	test_create_file();
 
+	/* logfile.c */
+	test_xml_batches();
+
 	/* rcfile.c */
 	test_read_rcfile();
 
+	/* seal.c */
+	test_seal_logfile();
+
+	/* writer.c */
+	test_writer_thread();
+
+	delete_envcache(__LINE__);
 	result = rmdir(TMPDIR);
 	OK_SUCCESS(result, "rmdir " TMPDIR " after function tests");
 	if (result) {
@@ -5061,26 +8585,44 @@ static void tests_with_tempdir(void)
 	}
 
 	test_without_options();
+	test_environment_cache();
 	test_sess_elements();
 	test_truncated_logfile();
+	test_concurrent_writers();
+	test_binlog_option();
 	test_comment_option();
 	read_long_text_from_stdin();
 	test_external_editor();
 	test_unreadable_editor_file();
 	test_nonexisting_editor();
 	test_count_option();
+	test_daemon_option();
+	test_jsonl_option();
+	test_lock_timeout_option();
 	test_logdir_option();
+	test_logmode_option();
+	test_mmap_logmode();
+	test_uring_logmode();
 	test_random_mac_option();
 	test_raw_option();
 	test_rcfile_option();
+	test_seal_option();
+	test_serve_stdio_option();
+	test_segment_option();
+	test_shards_option();
+	test_stream_option();
+	test_sync_option();
 	test_tag_option();
-	test_too_many_tags();
-	test_too_many_comma_tags();
+	test_many_tags();
+	test_many_comma_tags();
+	test_trace_timing_option();
+	test_uuid_option();
 	test_whereto_option();
 	test_sigpipe_signal(__LINE__, "");
 	test_sigpipe_signal(__LINE__, "-w o");
 	test_invalid_rcfile_data();
 
+	delete_envcache(__LINE__);
 	OK_SUCCESS(rmdir(TMPDIR), "Delete temporary directory %s", TMPDIR);
 }
 
@@ -5102,22 +8644,45 @@ static void test_functions(const struct Options *o)
 	test_gotexp_output();
 	test_valgrind_lines();
 	test_count_uuids();
+	test_json_valid();
 
 	diag("Test various routines");
 
 	/* suuid.c */
 	test_std_strerror();
 
+	/* arena.c */
+	test_arena();
+
+	/* binbuf.c */
+	test_bb_append();
+
 	/* io.c */
 	test_read_from_file();
+	test_outbuf();
+
+	/* json.c */
+	test_json_str();
+	test_json_entry();
+	test_json_request();
 
 	/* logfile.c */
 	test_create_sess_xml();
+	test_parse_xml_line();
+
+	/* lz.c */
+	test_lz();
 
 	/* rcfile.c */
 	test_has_key();
 
+	/* segment.c */
+	test_parse_segment();
+	test_range_overlaps();
+
 	/* sessvar.c */
+	test_is_legal_desc_char();
+	test_parse_sessvar();
 	test_get_sess_info();
 
 	/* strings.c */
@@ -5127,10 +8692,14 @@ static void test_functions(const struct Options *o)
 	test_str_replace();
 	test_string_to_lower();
 
+	/* tag.c */
+	test_store_tag();
+
 	/* uuid.c */
 	test_valid_uuid();
 	test_is_valid_date();
 	test_uuid_date();
+	test_uuid_to_bin();
 
 	functests_with_tempdir();
 }
@@ -5176,6 +8745,7 @@ int opt_selftest(char *main_execname, const struct Options *o)
 		return EXIT_FAILURE; /* gncov */
 	test_functions(o);
 	test_executable(o);
+	restore_testvars();
 
 	printf("1..%d\n", testnum);
 	if (failcount) {
@@ -5184,7 +8754,6 @@ int opt_selftest(char *main_execname, const struct Options *o)
 		     testnum);
 	}
 
-	free(logfile); /* Allocated in init_testvars() */
 	return failcount ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
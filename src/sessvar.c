@@ -20,7 +20,29 @@
 
 #include "suuid.h"
 
-static unsigned int sessind = 0;
+/*
+ * The characters from DESC_LEGAL, indexed by unsigned char. It's constant so 
+ * it can be used from several threads without any initialisation.
+ */
+
+static const bool desc_legal[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x00 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x10 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, /* 0x20 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, /* 0x30 */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x40 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, /* 0x50 */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x60 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, /* 0x70 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x80 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x90 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xa0 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xb0 */
+	0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xc0 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xd0 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xe0 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, /* 0xf0 */
+};
 
 /*
  * is_legal_desc_char() - Return true if the character c is a valid char for 
@@ -29,10 +51,9 @@ static unsigned int sessind = 0;
 
 bool is_legal_desc_char(const char c)
 {
-	return strchr(DESC_LEGAL, c) ? true : false;
+	return desc_legal[(unsigned char)c];
 }
 
-#ifdef UNUSED
 /*
  * is_valid_desc_string() - Return true if the string s is a valid desc name, 
  * return false if not.
@@ -55,7 +76,6 @@ bool is_valid_desc_string(const char *s)
 
 	return true;
 }
-#endif
 
 #ifdef UNUSED
 /*
@@ -91,9 +111,8 @@ char *get_desc_from_command(const char *cmd)
 #endif
 
 /*
- * fill_sess() - Fill the first available dest->sess element with uuid and desc 
- * and increase the local counter. Return 0 if everything is ok, 1 if something 
- * failed.
+ * fill_sess() - Add a sess element with uuid and desc to the end of the 
+ * dest->sess array. Return 0 if everything is ok, 1 if something failed.
  */
 
 int fill_sess(struct Entry *dest, const char *uuid,
@@ -104,13 +123,7 @@ int fill_sess(struct Entry *dest, const char *uuid,
 	assert(dest);
 	assert(valid_uuid(uuid, false));
 
-	if (sessind >= MAX_SESS) {
-		myerror("Maximum number of sess entries (%d) exceeded",
-		        MAX_SESS);
-		return 1;
-	}
-
-	auuid = strndup(uuid, UUID_LENGTH);
+	auuid = arena_strndup(dest->arena, uuid, UUID_LENGTH);
 	if (!auuid) {
 		myerror("%s(): Memory allcation error," /* gncov */
 		        " could not duplicate UUID", __func__);
@@ -118,19 +131,67 @@ int fill_sess(struct Entry *dest, const char *uuid,
 	}
 
 	if (desc && desclen) {
-		adesc = strndup(desc, desclen);
+		adesc = arena_strndup(dest->arena, desc, desclen);
 		if (!adesc) {
 			myerror("%s(): Memory allocation error," /* gncov */
 			        " could not duplicate desc", __func__);
-			free(auuid); /* gncov */
+			arena_discard(dest->arena, auuid); /* gncov */
 			return 1; /* gncov */
 		}
-		dest->sess[sessind].desc = adesc;
 	}
-	dest->sess[sessind].uuid = auuid;
-	sessind++;
 
-	return 0;
+	return append_sess(dest, auuid, adesc);
+}
+
+/*
+ * parse_sessvar() - Scan the session variable `s`, a null-terminated string 
+ * of length `len`, once and store the position of every UUID in `dest`, 
+ * together with the position and length of the desc in front of it. A desc 
+ * ends at the last slash or at the start of the UUID, and is discarded if an 
+ * illegal character is found before the UUID. `dest` must have room for 
+ * `len / UUID_LENGTH` elements. Returns the number of elements stored.
+ */
+
+size_t parse_sessvar(const char *s, const size_t len, struct Sesslink *dest)
+{
+	const char *p, *end, *desc_found = NULL, *desc_end = NULL;
+	unsigned char c;
+	size_t n = 0;
+
+	assert(s);
+	assert(dest || len < UUID_LENGTH);
+
+	end = s + len;
+	for (p = s; p < end; p++) {
+		c = (unsigned char)*p;
+		if (end - p >= UUID_LENGTH && valid_uuid(p, false)) {
+			if (!desc_found) {
+				desc_found = desc_end = p;
+			} else if (!desc_end) {
+				/*
+				 * There was no slash between desc and uuid, so 
+				 * desc_end hasn't been set.
+				 */
+				desc_end = p;
+			}
+			dest[n].uuid = (size_t)(p - s);
+			dest[n].desc = (size_t)(desc_found - s);
+			dest[n].desclen = (size_t)(desc_end - desc_found);
+			n++;
+			p += UUID_LENGTH - 1;
+			desc_found = desc_end = NULL;
+		} else if (desc_legal[c]) {
+			if (!desc_found)
+				desc_found = p;
+		} else if (c == '/') {
+			if (desc_found)
+				desc_end = p;
+		} else {
+			desc_found = desc_end = NULL;
+		}
+	}
+
+	return n;
 }
 
 /*
@@ -140,83 +201,112 @@ int fill_sess(struct Entry *dest, const char *uuid,
 
 int get_sess_info(struct Entry *entry)
 {
-	char *s, *p, *desc_found = NULL, *desc_end = NULL;
+	const char *env;
+	struct Sesslink *links;
+	size_t len, n, i;
+	int retval = 0;
 
 	assert(entry);
 
-	if (!getenv(ENV_SESS))
+	env = getenv(ENV_SESS);
+	if (!env)
 		return 0;
-
-	s = mystrdup(getenv(ENV_SESS));
-	if (!s) {
-		failed("mystrdup()"); /* gncov */
-		return 1; /* gncov */
-	}
-
-	if (!scan_for_uuid(s)) {
+	len = strlen(env);
+	if (len < UUID_LENGTH) {
 		/*
-		 * The environment variable exists, but contains no valid 
-		 * UUIDs. Not much to do about that, so just return gracefully.
+		 * The environment variable exists, but is too short to 
+		 * contain a UUID. Not much to do about that, so just return 
+		 * gracefully.
 		 */
-		free(s);
 		return 0;
 	}
 
-	p = s;
-	while (*p) {
-		if (valid_uuid(p, false)) {
-			size_t desclen = 0;
+	links = arena_alloc(entry->arena,
+	                    len / UUID_LENGTH * sizeof(struct Sesslink));
+	if (!links) {
+		failed("arena_alloc()"); /* gncov */
+		return 1; /* gncov */
+	}
+	n = parse_sessvar(env, len, links);
+	for (i = 0; i < n; i++) {
+		if (fill_sess(entry, env + links[i].uuid, env + links[i].desc,
+		              links[i].desclen)) {
+			retval = 1; /* gncov */
+			break; /* gncov */
+		}
+	}
+	arena_discard(entry->arena, links);
 
-			if (desc_found && !desc_end) {
-				/*
-				 * There was no slash between desc and uuid, so 
-				 * desc_end hasn't been set.
-				 */
-				desc_end = p;
-			}
+	return retval;
+}
 
-			if (desc_end > desc_found)
-				desclen = (size_t)(desc_end - desc_found);
+/*
+ * append_sess() - Add the strings `uuid` and `desc` (can be NULL), allocated 
+ * from entry->arena, as a new element at the end of the entry->sess array. 
+ * The elements are stored in entry->sess_buf until it's full, then the array 
+ * is moved to the heap and doubled in size when needed. The strings are 
+ * discarded if the array can't be extended. Returns 0 if ok, or 1 if error.
+ */
 
-			if (fill_sess(entry, p, desc_found, desclen)) {
-				free(s);
-				return 1;
-			}
+int append_sess(struct Entry *entry, char *uuid, char *desc)
+{
+	struct Sess *p;
+	size_t size;
 
-			p += UUID_LENGTH - 1;
-			desc_found = desc_end = NULL;
-		} else if (is_legal_desc_char(*p)) {
-			if (!desc_found && p >= s)
-				desc_found = p;
-		} else if (*p == '/') {
-			if (desc_found)
-				desc_end = p;
+	assert(entry);
+	assert(uuid);
+
+	if (entry->sess_count + 1 >= entry->sess_size) {
+		size = entry->sess_size * 2;
+		if (entry->sess == entry->sess_buf) {
+			p = malloc(size * sizeof(struct Sess));
+			if (p)
+				memcpy(p, entry->sess_buf,
+				       entry->sess_size * sizeof(struct Sess));
 		} else {
-			desc_found = desc_end = NULL;
+			p = realloc(entry->sess, size * sizeof(struct Sess));
 		}
-		p++;
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			arena_discard(entry->arena, desc); /* gncov */
+			arena_discard(entry->arena, uuid); /* gncov */
+			return 1; /* gncov */
+		}
+		trace_count(allocs, 1);
+		trace_count(alloc_bytes, size * sizeof(struct Sess));
+		entry->sess = p;
+		entry->sess_size = size;
 	}
-	free(s);
+	entry->sess[entry->sess_count].uuid = uuid;
+	entry->sess[entry->sess_count].desc = desc;
+	entry->sess_count++;
+	init_sess_array(&entry->sess[entry->sess_count], 1);
 
 	return 0;
 }
 
 /*
  * free_sess() - Deallocate all sess entries in the entry->sess[].{desc,uuid} 
- * arrays and reset `sessind`.
+ * arrays unless they belong to entry->arena, and the array itself if it was 
+ * moved to the heap. The entry can be used for new sess elements afterwards.
  */
 
 void free_sess(struct Entry *entry)
 {
-	unsigned int i;
+	size_t i;
 
 	assert(entry);
 
-	for (i = 0; i < MAX_SESS && entry->sess[i].uuid; i++) {
-		free(entry->sess[i].uuid);
-		free(entry->sess[i].desc);
+	for (i = 0; entry->sess[i].uuid; i++) {
+		arena_discard(entry->arena, entry->sess[i].uuid);
+		arena_discard(entry->arena, entry->sess[i].desc);
 	}
-	sessind = 0;
+	if (entry->sess != entry->sess_buf)
+		free(entry->sess);
+	entry->sess = entry->sess_buf;
+	init_sess_array(entry->sess_buf, 1);
+	entry->sess_count = 0;
+	entry->sess_size = ENTRY_SESS + 1;
 }
 
 #ifdef UNUSED
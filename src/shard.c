@@ -0,0 +1,403 @@
+/*
+ * shard.c
+ * File ID: 5a3c7f10-cb20-11f1-950c-02fc00000001
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A sharded log is split into the files <host>.<k>.xml, where k is the 
+ * process ID modulo the number of shards. Every shard is an ordinary XML log 
+ * file with its own lock, so processes writing to different shards don't 
+ * wait for each other. The entries are merged back into one stream sorted by 
+ * the timestamp in the UUIDs when the log is read, together with the entries 
+ * in <host>.xml from before the log was sharded.
+ */
+
+#include "suuid.h"
+
+#define SHARD_DIGITS_MAX  9 /* Max number of digits in a shard number */
+
+/*
+ * get_shards() - Store the number of shards to use in `*dest`. The value from 
+ * --shards is used if it's defined, otherwise the "shards" keyword from the 
+ * rc file. If none of them are defined, the log isn't sharded and the value 
+ * is 1. Returns 0 if ok, or 1 if the value is invalid.
+ */
+
+int get_shards(const struct Rc *rc, const struct Options *opts,
+               unsigned long *dest)
+{
+	const char *p = NULL;
+	unsigned long val;
+	char *endp;
+
+	assert(rc);
+	assert(opts);
+	assert(dest);
+
+	*dest = 1;
+	if (opts->shards)
+		p = opts->shards;
+	else if (rc->shards)
+		p = rc->shards;
+	if (!p)
+		return 0;
+
+	if (!isdigit((unsigned char)*p))
+		goto error;
+	errno = 0;
+	val = strtoul(p, &endp, 10);
+	if (errno || *endp || !val || val > SHARDS_MAX)
+		goto error;
+	*dest = val;
+
+	return 0;
+
+error:
+	errno = 0;
+	myerror("\"%s\": Invalid number of shards, must be 1-%lu", p,
+	        SHARDS_MAX);
+
+	return 1;
+}
+
+/*
+ * get_shard_prefix() - Return pointer to an allocated string with the file 
+ * name prefix of the shard this process writes to, `prefix` followed by a 
+ * period and the process ID modulo `shards`. Returns NULL if error.
+ */
+
+char *get_shard_prefix(const char *prefix, const unsigned long shards)
+{
+	char *retval;
+
+	assert(prefix);
+	assert(shards > 1);
+
+	retval = allocstr("%s.%lu", prefix, (unsigned long)getpid() % shards);
+	if (!retval)
+		failed("allocstr()"); /* gncov */
+
+	return retval;
+}
+
+/*
+ * cmp_shard() - Comparison function for qsort(), sorts shard numbers in 
+ * ascending order.
+ */
+
+static int cmp_shard(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a,
+	              y = *(const unsigned long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * find_shards() - Find the shards <base>.<k>.xml of the log with file name 
+ * prefix `base` and store an allocated, sorted array with the shard numbers 
+ * in `*dest` and the number of shards in `*count`. Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+static int find_shards(const char *base, unsigned long **dest, size_t *count)
+{
+	const char *name, *p;
+	char *dir;
+	size_t len, alloc = 0;
+	DIR *dp;
+	struct dirent *de;
+	int retval = 1;
+
+	assert(base);
+	assert(dest);
+	assert(count);
+
+	*dest = NULL;
+	*count = 0;
+	p = strrchr(base, '/');
+	if (p) {
+		name = p + 1;
+		dir = p == base ? mystrdup("/")
+		                : allocstr("%.*s", (int)(p - base), base);
+	} else {
+		name = base;
+		dir = mystrdup(".");
+	}
+	if (!dir) {
+		failed("allocstr()"); /* gncov */
+		return 1; /* gncov */
+	}
+	len = strlen(name);
+
+	dp = opendir(dir);
+	if (!dp) {
+		errno = 0;
+		free(dir);
+		return 0;
+	}
+	while ((de = readdir(dp))) {
+		const char *n = de->d_name;
+		size_t digits;
+
+		if (strncmp(n, name, len) || n[len] != '.')
+			continue;
+		n += len + 1;
+		digits = strspn(n, "0123456789");
+		if (!digits || digits > SHARD_DIGITS_MAX
+		    || strcmp(n + digits, LOGFILE_EXTENSION))
+			continue;
+		if (*count == alloc) {
+			unsigned long *np;
+
+			alloc = alloc ? alloc * 2 : 16;
+			np = realloc(*dest, alloc * sizeof(*np));
+			if (!np) {
+				failed("realloc()"); /* gncov */
+				goto cleanup; /* gncov */
+			}
+			*dest = np;
+		}
+		(*dest)[(*count)++] = strtoul(n, NULL, 10);
+	}
+	if (*count)
+		qsort(*dest, *count, sizeof(**dest), cmp_shard);
+	retval = 0;
+
+cleanup:
+	closedir(dp);
+	free(dir);
+	if (retval) {
+		free(*dest); /* gncov */
+		*dest = NULL; /* gncov */
+		*count = 0; /* gncov */
+	}
+
+	return retval;
+}
+
+/*
+ * next_line() - Read the next line of the shard `f` and update the 
+ * timestamp. Lines without a v1 UUID keep the timestamp of the line before 
+ * them, so they stay in place relative to their neighbours. Returns 0 if ok, 
+ * or 1 if error.
+ */
+
+static int next_line(struct Shardfile *f)
+{
+	utime_t ticks;
+
+	assert(f);
+
+	if (read_log_line(&f->r, &f->line))
+		return 1; /* gncov */
+	if (f->line) {
+		ticks = line_ticks(f->line);
+		if (ticks)
+			f->ticks = ticks;
+	}
+
+	return 0;
+}
+
+/*
+ * add_shardfile() - Used by logmerge_open(). Open the log file `fname` and 
+ * add it to `m`. `fname` is taken over by `m`. If the file doesn't exist and 
+ * `optional` is true, `fname` is deallocated and nothing is added. Returns 0 
+ * if ok, or 1 if error.
+ */
+
+static int add_shardfile(struct Logmerge *m, char *fname, const bool optional)
+{
+	struct Shardfile *f;
+	FILE *fp;
+
+	assert(m);
+	assert(fname);
+
+	fp = fopen(fname, "r");
+	if (!fp) {
+		if (optional && errno == ENOENT) {
+			errno = 0;
+			free(fname);
+			return 0;
+		}
+		myerror("%s: Could not open file for read", fname);
+		free(fname);
+		return 1;
+	}
+	f = &m->files[m->count++];
+	f->fname = fname;
+	logreader_init(&f->r, fp);
+	f->line = NULL;
+	f->ticks = 0;
+
+	return next_line(f);
+}
+
+/*
+ * logmerge_open() - Open the XML log file `xmlname` and all its shards for 
+ * reading with logmerge_each(). `xmlname` may be missing if there are 
+ * shards. Returns 0 if ok, or 1 if error.
+ */
+
+int logmerge_open(struct Logmerge *m, const char *xmlname)
+{
+	unsigned long *shards = NULL;
+	size_t n = 0, i;
+	char *base, *fname;
+	int retval = 1;
+
+	assert(m);
+	assert(xmlname);
+
+	m->files = NULL;
+	m->count = 0;
+	base = log_filename(xmlname, "");
+	if (!base)
+		return 1; /* gncov */
+	if (find_shards(base, &shards, &n))
+		goto cleanup; /* gncov */
+	m->files = malloc((n + 1) * sizeof(*m->files));
+	fname = mystrdup(xmlname);
+	if (!m->files || !fname) {
+		failed("malloc()"); /* gncov */
+		free(fname); /* gncov */
+		goto cleanup; /* gncov */
+	}
+	if (add_shardfile(m, fname, n > 0))
+		goto cleanup;
+	for (i = 0; i < n; i++) {
+		fname = allocstr("%s.%lu%s", base, shards[i],
+		                 LOGFILE_EXTENSION);
+		if (!fname) {
+			failed("allocstr()"); /* gncov */
+			goto cleanup; /* gncov */
+		}
+		if (add_shardfile(m, fname, false))
+			goto cleanup; /* gncov */
+	}
+	msg(2, "Reading %zu shard%s of %s", n, n == 1 ? "" : "s", xmlname);
+	retval = 0;
+
+cleanup:
+	if (retval)
+		logmerge_close(m);
+	free(shards);
+	free(base);
+
+	return retval;
+}
+
+/*
+ * logmerge_each() - Call `func` with `data` and every line from the files in 
+ * `m`, in the order of the timestamps in the UUIDs. Lines with the same 
+ * timestamp are delivered in the order of the files. Returns 0 if ok, or 1 
+ * if `func` returns non-zero or anything else fails.
+ */
+
+int logmerge_each(struct Logmerge *m, int (*func)(void *, const char *),
+                  void *data)
+{
+	assert(m);
+	assert(func);
+
+	for (;;) {
+		struct Shardfile *best = NULL;
+		size_t i;
+
+		for (i = 0; i < m->count; i++) {
+			struct Shardfile *f = &m->files[i];
+
+			if (f->line && (!best || f->ticks < best->ticks))
+				best = f;
+		}
+		if (!best)
+			break;
+		if (func(data, best->line) || next_line(best))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * logmerge_close() - Close the files in `m` and deallocate it. Returns 
+ * nothing.
+ */
+
+void logmerge_close(struct Logmerge *m)
+{
+	size_t i;
+
+	assert(m);
+
+	for (i = 0; i < m->count; i++) {
+		logreader_free(&m->files[i].r);
+		fclose(m->files[i].r.fp);
+		free(m->files[i].fname);
+	}
+	free(m->files);
+	m->files = NULL;
+	m->count = 0;
+}
+
+/*
+ * print_line() - Used by merge_shards(). Write the log line `line` to the 
+ * stream `data`. Returns 0.
+ */
+
+static int print_line(void *data, const char *line)
+{
+	assert(data);
+	assert(line);
+
+	fprintf(data, "%s\n", line);
+
+	return 0;
+}
+
+/*
+ * merge_shards() - Merge the XML log file `xmlname` and its shards into one 
+ * XML log file sorted by the UUID timestamps and write it to `fp`. Returns 0 
+ * if ok, or 1 if error.
+ */
+
+int merge_shards(const char *xmlname, FILE *fp)
+{
+	struct Logmerge m;
+	int retval;
+
+	assert(xmlname);
+	assert(fp);
+
+	if (logmerge_open(&m, xmlname))
+		return 1;
+	fputs(LOGFILE_HEADER, fp);
+	retval = logmerge_each(&m, print_line, fp);
+	fputs(LOGFILE_TRAILER, fp);
+	if (fflush(fp) == EOF) {
+		myerror("Cannot write XML"); /* gncov */
+		retval = 1; /* gncov */
+	}
+	logmerge_close(&m);
+
+	return retval;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
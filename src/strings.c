@@ -37,6 +37,8 @@ char *mystrdup(const char *s)
 	p = malloc(size + 1);
 	if (!p)
 		return NULL; /* gncov */
+	trace_count(allocs, 1);
+	trace_count(alloc_bytes, size + 1);
 	memcpy(p, s, size);
 	p[size] = '\0';
 
@@ -70,6 +72,8 @@ char *allocstr_va(const char *format, va_list ap)
 	p = malloc(size);
 	if (!p)
 		return NULL; /* gncov */
+	trace_count(allocs, 1);
+	trace_count(alloc_bytes, size);
 
 	needed = vsnprintf(p, size, format, ap);
 	if (needed < 0) {
@@ -257,23 +257,90 @@ static int usage(const struct Options *o, const int retval)
 	       "    the value from EDITOR is used. If none of these variables"
 	       " are \n"
 	       "    defined, the program aborts.\n", ENV_EDITOR, ENV_EDITOR);
+	printf("  --bin-to-xml FILE\n"
+	       "    Convert the binary log with record file FILE (\"%s\") to"
+	       " XML and \n"
+	       "    write it to stdout.\n", BINLOG_REC_EXTENSION);
+	printf("  --binlog\n"
+	       "    Also store the entries in a compact binary log, the files"
+	       " \"%s\" \n"
+	       "    and \"%s\" next to the log file. The binary log is"
+	       " always locked.\n",
+	       BINLOG_REC_EXTENSION, BINLOG_HEAP_EXTENSION);
 	printf("  -n x, --count x\n"
 	       "    Print and store x UUIDs.\n");
+	printf("  --daemon\n"
+	       "    Keep the log files open and serve UUIDs on the socket"
+	       " \"HOST%s\" in \n"
+	       "    the log directory until terminated. Other suuid"
+	       " processes use the \n"
+	       "    daemon when the socket exists, unless they use options"
+	       " that change \n"
+	       "    the UUIDs or the log files. Only works with the \"xml\""
+	       " and \"append\" \n"
+	       "    log modes.\n", SOCKET_EXTENSION);
 	printf("  -h, --help\n"
 	       "    Show this help.\n");
+	printf("  --jsonl\n"
+	       "    Also store the entries as JSON Lines in a file with the"
+	       " same name as \n"
+	       "    the log file, but with the \"%s\" extension.\n",
+	       JSONL_EXTENSION);
 	printf("  --license\n"
 	       "    Print the software license.\n");
+	printf("  --list-segments x\n"
+	       "    Print the path of the log segments with entries in the"
+	       " time range \n"
+	       "    x, \"FROM,TO\". The dates can be shortened, and an empty"
+	       " value means \n"
+	       "    no limit. A single date is used as both FROM and TO.\n");
+	printf("  --lock-timeout x\n"
+	       "    Wait at most x milliseconds for a lock on the log files,"
+	       " then exit \n"
+	       "    with an error. Default is to wait as long as"
+	       " necessary.\n");
 	printf("  -l x, --logdir x\n"
 	       "    Store log files in directory x.\n"
 	       "    If the %s environment variable is defined,"
 	       " that value is \n"
 	       "    used. Otherwise the value \"$HOME/%s\" is used.\n"
 	       "    Current default: %s\n", ENV_LOGDIR, LOGDIR_NAME, logdir);
+	printf("  --logmode x\n"
+	       "    Use log mode x, can be \"xml\", \"append\", \"mmap\" or"
+	       " \"uring\". \"xml\" \n"
+	       "    locks the log file and keeps the closing </suuids> at the"
+	       " end of it. \n"
+	       "    \"append\" writes every entry with a single unlocked"
+	       " write() and leaves \n"
+	       "    out </suuids>, so many processes can add to the file at"
+	       " the same time. \n"
+	       "    Entries can't be larger than %u bytes in append mode."
+	       " \"mmap\" is \n"
+	       "    like \"xml\", but copies the entries into a memory"
+	       " mapped part of \n"
+	       "    the file, for large -n values. \"uring\" is like"
+	       " \"xml\", but writes \n"
+	       "    the entries asynchronously with io_uring, or with"
+	       " write() if io_uring \n"
+	       "    isn't available. Default: \"xml\"\n",
+	       APPEND_ATOMIC_MAX);
+	printf("  --merge-shards FILE\n"
+	       "    Merge the XML log file FILE and its shards (see"
+	       " --shards) into one \n"
+	       "    XML log sorted by the UUID timestamps and write it to"
+	       " stdout.\n");
+	printf("  --no-daemon\n"
+	       "    Don't use the daemon, write to the log files"
+	       " directly.\n");
 	printf("  -q, --quiet\n"
 	       "    Be more quiet. Can be repeated to increase silence.\n");
 	printf("  -m, --random-mac\n"
 	       "    Don't use the hardware MAC address, generate a random"
 	       " address field.\n");
+	printf("  --range x\n"
+	       "    Used with --unseal, only print the entries in the time"
+	       " range x, \n"
+	       "    \"FROM,TO\". Uses the same format as --list-segments.\n");
 	printf("  --raw\n"
 	       "    Don't convert the <txt> element to XML. When using this"
 	       " option, it \n"
@@ -283,6 +350,24 @@ static int usage(const struct Options *o, const int retval)
 	printf("  --rcfile X\n"
 	       "    Use file X instead of '%s/%s'.\n",
 	       getenv("HOME"), STD_RCFILE);
+	printf("  --seal FILE\n"
+	       "    Create a compressed, read-only copy of the XML log file"
+	       " FILE with \n"
+	       "    the same name, but with the extension \"%s\". FILE is"
+	       " not \n"
+	       "    modified and can be deleted afterwards.\n",
+	       SEAL_EXTENSION);
+	printf("  --segment x\n"
+	       "    Store the log in segments in the directory"
+	       " \"LOGDIR/HOST/\". x is \n"
+	       "    \"month\" to start a new segment every month, or a size"
+	       " with an \n"
+	       "    optional k, M or G suffix to start a new segment when the"
+	       " active one \n"
+	       "    reaches that size. The file \"%s\" lists the time range"
+	       " and \n"
+	       "    number of entries for each segment. Default: \"none\"\n",
+	       SEGMENT_MANIFEST);
 	printf("  --selftest [arg]\n"
 	       "    Run the built-in test suite. If specified, the argument"
 	       " can contain \n"
@@ -293,13 +378,67 @@ static int usage(const struct Options *o, const int retval)
 	       "    should be separated by commas. If no argument is"
 	       " specified, default \n"
 	       "    is \"all\".\n");
+	printf("  --serve-stdio\n"
+	       "    Read one request per line from stdin and write the"
+	       " UUIDs to stdout, \n"
+	       "    one per line, until end of file. A request is a JSON"
+	       " object with the \n"
+	       "    optional members \"n\" (number of UUIDs), \"tag\""
+	       " (array), \"txt\", \n"
+	       "    \"raw\" (boolean) and \"w\" (like -w, 'e' or 'a'"
+	       " also prints the \n"
+	       "    UUIDs to stderr). Errors are reported as a line"
+	       " starting with \n"
+	       "    \"error: \".\n");
+	printf("  --shards x\n"
+	       "    Split the log into x files, \"HOST.0%s\" to"
+	       " \"HOST.<x-1>%s\", with \n"
+	       "    their own locks. Every process writes to the shard"
+	       " given by its \n"
+	       "    process ID modulo x. --merge-shards, --seal and"
+	       " --xml-to-bin read \n"
+	       "    all shards. Can't be combined with --segment."
+	       " Default: 1\n",
+	       LOGFILE_EXTENSION, LOGFILE_EXTENSION);
+	printf("  --stream\n"
+	       "    Log one entry for every line read from stdin and"
+	       " print the UUID, a \n"
+	       "    tab and the line to stdout. The last tab-separated"
+	       " field of the line \n"
+	       "    is used as comment, and the fields before it as"
+	       " tags, in addition to \n"
+	       "    the -t/--tag options. -c/--comment is used for"
+	       " lines with an empty \n"
+	       "    comment.\n");
+	printf("  --sync x\n"
+	       "    Write the log files to disk with fdatasync(), x can be"
+	       " \"none\", \n"
+	       "    \"close\" to sync when the log files are closed, or"
+	       " \"batch\" to also \n"
+	       "    sync every %u entries or %u milliseconds. Default:"
+	       " \"none\"\n",
+	       SYNC_BATCH_ENTRIES, SYNC_BATCH_MSEC);
 	printf("  -t x, --tag x\n"
 	       "    Use x as tag (category).\n");
+	printf("  --trace-timing x\n"
+	       "    Measure the time spent in every phase and write it"
+	       " as a JSON object to \n"
+	       "    the file x when done, or to stderr if x is \"-\".\n");
 	printf("  --valgrind [arg]\n"
 	       "    Run the built-in test suite with Valgrind memory checking."
 	       " Accepts \n"
 	       "    the same optional argument as --selftest, with the same"
 	       " defaults.\n");
+	printf("  --unseal FILE\n"
+	       "    Print the sealed log file FILE as an XML log file to"
+	       " stdout.\n");
+	printf("  --uuid x\n"
+	       "    Log the existing version 1 UUID x instead of"
+	       " generating a new one. If \n"
+	       "    x isn't a UUID, it's a file with one UUID per line to"
+	       " import, or \"-\" \n"
+	       "    to read them from stdin. Invalid lines are reported"
+	       " and skipped.\n");
 	printf("  -v, --verbose\n"
 	       "    Increase level of verbosity. Can be repeated.\n");
 	printf("  --version\n"
@@ -319,6 +458,13 @@ static int usage(const struct Options *o, const int retval)
 	       "      n\n"
 	       "        Don't output anything.\n"
 	       "    Default: \"o\"\n");
+	printf("  --xml-to-bin FILE\n"
+	       "    Convert the XML log file FILE to a binary log with the"
+	       " same name, \n"
+	       "    but with the extensions \"%s\" and \"%s\". The"
+	       " binary log \n"
+	       "    must not exist already.\n",
+	       BINLOG_REC_EXTENSION, BINLOG_HEAP_EXTENSION);
 	printf("\n");
 	printf("If the %s environment variable is defined by"
 	       " sess(1) or another \n"
@@ -339,6 +485,34 @@ static int usage(const struct Options *o, const int retval)
 	return retval;
 }
 
+/*
+ * add_opt_tag() - Add `tag` to the end of the NULL-terminated dest->tag 
+ * array, which is allocated when the first -t/--tag option is found. Returns 
+ * 0 if ok, or 1 if the array couldn't be extended.
+ */
+
+static int add_opt_tag(struct Options *dest, char *tag)
+{
+	char **p;
+	size_t n = 0;
+
+	assert(dest);
+	assert(tag);
+
+	while (dest->tag && dest->tag[n])
+		n++;
+	p = realloc(dest->tag, (n + 2) * sizeof(char *));
+	if (!p) {
+		failed("realloc()"); /* gncov */
+		return 1; /* gncov */
+	}
+	p[n] = tag;
+	p[n + 1] = NULL;
+	dest->tag = p;
+
+	return 0;
+}
+
 /*
  * choose_opt_action() - Decide what to do when option `c` is found. Store 
  * changes in `dest`. Read definitions for long options from `opts`.
@@ -348,25 +522,71 @@ static int usage(const struct Options *o, const int retval)
 static int choose_opt_action(struct Options *dest,
                              const int c, const struct option *opts)
 {
-	static unsigned int tag_count = 0;
-
 	assert(dest);
 	assert(opts);
 
 	switch (c) {
 	case 0:
-		if (!strcmp(opts->name, "license")) {
+		if (!strcmp(opts->name, "bin-to-xml")) {
+			dest->bin_to_xml = optarg;
+		} else if (!strcmp(opts->name, "binlog")) {
+			dest->binlog = true;
+		} else if (!strcmp(opts->name, "daemon")) {
+			dest->daemon = true;
+		} else if (!strcmp(opts->name, "jsonl")) {
+			dest->jsonl = true;
+		} else if (!strcmp(opts->name, "license")) {
 			dest->license = true;
+		} else if (!strcmp(opts->name, "list-segments")) {
+			dest->list_segments = optarg;
+		} else if (!strcmp(opts->name, "lock-timeout")) {
+			if (!*optarg || sscanf(optarg, "%ld",
+			                       &dest->lock_timeout) != 1
+			    || dest->lock_timeout < 0) {
+				myerror("Error in --lock-timeout argument");
+				return 1;
+			}
+		} else if (!strcmp(opts->name, "logmode")) {
+			dest->logmode = optarg;
+		} else if (!strcmp(opts->name, "merge-shards")) {
+			dest->merge_shards = optarg;
+		} else if (!strcmp(opts->name, "no-daemon")) {
+			dest->no_daemon = true;
+		} else if (!strcmp(opts->name, "range")) {
+			dest->range = optarg;
 		} else if (!strcmp(opts->name, "raw")) {
 			dest->raw = true;
 		} else if (!strcmp(opts->name, "rcfile")) {
 			dest->rcfile = optarg;
+		} else if (!strcmp(opts->name, "seal")) {
+			dest->seal = optarg;
+		} else if (!strcmp(opts->name, "segment")) {
+			dest->segment = optarg;
 		} else if (!strcmp(opts->name, "selftest")) {
 			dest->selftest = true;
+		} else if (!strcmp(opts->name, "serve-stdio")) {
+			dest->serve_stdio = true;
+		} else if (!strcmp(opts->name, "shards")) {
+			dest->shards = optarg;
+		} else if (!strcmp(opts->name, "stream")) {
+			dest->stream = true;
+		} else if (!strcmp(opts->name, "sync")) {
+			dest->sync = optarg;
+		} else if (!strcmp(opts->name, "trace-timing")) {
+			dest->trace_timing = optarg;
+		} else if (!strcmp(opts->name, "unseal")) {
+			dest->unseal = optarg;
+		} else if (!strcmp(opts->name, "uuid")) {
+			if (valid_uuid(optarg, true))
+				dest->uuid = optarg;
+			else
+				dest->uuid_file = optarg;
 		} else if (!strcmp(opts->name, "valgrind")) {
 			dest->valgrind = dest->selftest = true;
 		} else if (!strcmp(opts->name, "version")) {
 			dest->version = true;
+		} else if (!strcmp(opts->name, "xml-to-bin")) {
+			dest->xml_to_bin = optarg;
 		}
 		break;
 	case 'c':
@@ -395,12 +615,8 @@ static int choose_opt_action(struct Options *dest,
 		dest->verbose--;
 		break;
 	case 't':
-		if (tag_count >= MAX_TAGS) {
-			fprintf(stderr, "%s: Maximum number of tags (%d)"
-			                " exceeded\n", progname, MAX_TAGS);
-			return 1;
-		}
-		dest->tag[tag_count++] = optarg;
+		if (add_opt_tag(dest, optarg))
+			return 1; /* gncov */
 		break;
 	case 'v':
 		dest->verbose++;
@@ -425,28 +641,45 @@ static int choose_opt_action(struct Options *dest,
 
 void init_opt(struct Options *dest)
 {
-	unsigned int i;
-
 	assert(dest);
 
+	dest->binlog = false;
+	dest->bin_to_xml = NULL;
 	dest->comment = NULL;
 	dest->count = 1;
+	dest->daemon = false;
 	dest->help = false;
+	dest->jsonl = false;
 	dest->license = false;
+	dest->list_segments = NULL;
+	dest->lock_timeout = -1;
 	dest->logdir = NULL;
+	dest->logmode = NULL;
+	dest->merge_shards = NULL;
+	dest->no_daemon = false;
 	dest->random_mac = false;
+	dest->range = NULL;
 	dest->raw = false;
 	dest->rcfile = NULL;
+	dest->seal = NULL;
+	dest->segment = NULL;
 	dest->selftest = false;
+	dest->serve_stdio = false;
+	dest->shards = NULL;
+	dest->stream = false;
+	dest->sync = NULL;
 	dest->testexec = false;
 	dest->testfunc = false;
+	dest->trace_timing = NULL;
+	dest->unseal = NULL;
 	dest->uuid = NULL;
+	dest->uuid_file = NULL;
 	dest->valgrind = false;
 	dest->verbose = 0;
 	dest->version = false;
 	dest->whereto = NULL;
-	for (i = 0; i < MAX_TAGS; i++)
-		dest->tag[i] = NULL;
+	dest->xml_to_bin = NULL;
+	dest->tag = NULL;
 }
 
 /*
@@ -480,21 +713,41 @@ static int parse_options(struct Options *dest,
 		int c;
 		int option_index = 0;
 		static const struct option long_options[] = {
+			{"bin-to-xml", required_argument, NULL, 0},
+			{"binlog", no_argument, NULL, 0},
 			{"comment", required_argument, NULL, 'c'},
 			{"count", required_argument, NULL, 'n'},
+			{"daemon", no_argument, NULL, 0},
 			{"help", no_argument, NULL, 'h'},
+			{"jsonl", no_argument, NULL, 0},
 			{"license", no_argument, NULL, 0},
+			{"list-segments", required_argument, NULL, 0},
+			{"lock-timeout", required_argument, NULL, 0},
 			{"logdir", required_argument, NULL, 'l'},
+			{"logmode", required_argument, NULL, 0},
+			{"merge-shards", required_argument, NULL, 0},
+			{"no-daemon", no_argument, NULL, 0},
 			{"quiet", no_argument, NULL, 'q'},
 			{"random-mac", no_argument, NULL, 'm'},
+			{"range", required_argument, NULL, 0},
 			{"raw", no_argument, NULL, 0},
 			{"rcfile", required_argument, NULL, 0},
+			{"seal", required_argument, NULL, 0},
+			{"segment", required_argument, NULL, 0},
 			{"selftest", no_argument, NULL, 0},
+			{"serve-stdio", no_argument, NULL, 0},
+			{"shards", required_argument, NULL, 0},
+			{"stream", no_argument, NULL, 0},
+			{"sync", required_argument, NULL, 0},
 			{"tag", required_argument, NULL, 't'},
+			{"trace-timing", required_argument, NULL, 0},
+			{"unseal", required_argument, NULL, 0},
+			{"uuid", required_argument, NULL, 0},
 			{"valgrind", no_argument, NULL, 0},
 			{"verbose", no_argument, NULL, 'v'},
 			{"version", no_argument, NULL, 0},
 			{"whereto", required_argument, NULL, 'w'},
+			{"xml-to-bin", required_argument, NULL, 0},
 			{0, 0, 0, 0}
 		};
 
@@ -584,6 +837,23 @@ int main(int argc, char *argv[])
 		return print_version(&opt);
 	if (opt.license)
 		return print_license();
+	if (opt.xml_to_bin)
+		return xml_to_binlog(opt.xml_to_bin) ? EXIT_FAILURE
+		                                     : EXIT_SUCCESS;
+	if (opt.bin_to_xml)
+		return binlog_to_xml(opt.bin_to_xml, stdout) ? EXIT_FAILURE
+		                                             : EXIT_SUCCESS;
+	if (opt.seal)
+		return seal_logfile(opt.seal) ? EXIT_FAILURE : EXIT_SUCCESS;
+	if (opt.unseal)
+		return unseal_logfile(opt.unseal, opt.range, stdout)
+		       ? EXIT_FAILURE : EXIT_SUCCESS;
+	if (opt.merge_shards)
+		return merge_shards(opt.merge_shards, stdout) ? EXIT_FAILURE
+		                                               : EXIT_SUCCESS;
+	if (opt.list_segments)
+		return list_segments(&opt, opt.list_segments) ? EXIT_FAILURE
+		                                               : EXIT_SUCCESS;
 
 	result = create_and_log_uuids(&opt);
 	if (!result.success)
@@ -29,27 +29,41 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <regex.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    define HAVE_IO_URING  1
+#    include <linux/io_uring.h>
+#    include <sys/syscall.h>
+#  endif
+#endif
+
 #include "binbuf.h"
 #include "uuid.h"
 
@@ -72,6 +86,10 @@
 #endif
 
 #define failed(a)  myerror("%s():%d: %s failed", __func__, __LINE__, (a))
+#define trace_count(field, n)  do { \
+	if (trace.enabled) \
+		__atomic_add_fetch(&trace.field, (n), __ATOMIC_RELAXED); \
+} while (0)
 #define no_null(a)  ((a) ? (a) : "(null)")
 
 #define ENV_EDITOR  "SUUID_EDITOR" /* Name of editor to use with "-c --" */
@@ -79,15 +97,61 @@
 #define ENV_LOGDIR  "SUUID_LOGDIR" /* Optional environment variable with path 
                                     * to log directory
                                     */
+#define ENV_NO_URING  "SUUID_NO_URING" /* Don't use io_uring if defined */
+#define ENV_RUNTIME_DIR  "XDG_RUNTIME_DIR" /* Environment cache directory */
 #define ENV_SESS  "SESS_UUID" /* Name of environment variable where the session 
                                * information is stored
                                */
 #define LOGDIR_NAME  "uuids"
 #define LOGFILE_EXTENSION  ".xml"
+#define JSONL_EXTENSION  ".jsonl"
+#define BINLOG_REC_EXTENSION  ".sbr" /* Binary log, fixed-width records */
+#define BINLOG_HEAP_EXTENSION  ".sbh" /* Binary log, string heap */
+#define SEAL_EXTENSION  ".sxc" /* Sealed log segment */
+#define SOCKET_EXTENSION  ".sock" /* Socket of the daemon, see --daemon */
+#define SEAL_BLOCK_ENTRIES  1024 /* Max number of entries per sealed block */
+#define SEAL_HDR_SIZE  32 /* Size of the sealed file header */
+#define SEAL_INDEX_SIZE  32 /* Size of a block index entry in sealed files */
+#define BINLOG_HDR_SIZE  16 /* Size of the record file header */
+#define BINLOG_RECSIZE  88 /* Size of a binary log record */
+#define BINLOG_RAW  0x01 /* Record flag, txt is stored with --raw */
+#define BINLOG_VERBATIM  0x02 /* Record flag, txt contains the whole XML line 
+                               */
+#define LOGFILE_HEADER  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" \
+                        "<!DOCTYPE suuids SYSTEM \"dtd/suuids.dtd\">\n" \
+                        "<suuids>\n"
+#define LOGFILE_TRAILER  "</suuids>\n"
+#define APPEND_ATOMIC_MAX  4096U /* Max size of an entry in append mode, 
+                                 * larger writes may be interleaved with 
+                                 * entries from other processes
+                                 */
+#define ARENA_ALIGN  16U /* Alignment of the memory from arena_alloc() */
+#define ARENA_BLOCKSIZE  16384U /* Min size of the heap blocks in an arena */
+#define BOOT_ID_FILE  "/proc/sys/kernel/random/boot_id"
+#define DAEMON_MAX_COUNT  10000UL /* Max UUIDs in one daemon request */
+#define DAEMON_TIMEOUT  5 /* Seconds the daemon waits for a client request */
+#define ENTRY_SESS  4 /* Sess elements in struct Entry before using the heap */
+#define ENTRY_TAGS  8 /* Tags in struct Entry before using the heap */
+#define ENVCACHE_LINE  256 /* Max length of a line in the environment cache */
+#define ENVCACHE_PREFIX  "suuid-env-" /* Environment cache file name */
+#define LOCK_BACKOFF_MAX  64000L /* Max microseconds between lock attempts */
+#define LOCK_BACKOFF_MIN  500L /* First wait in microseconds for a lock */
+#define LOGFILE_TAIL_SIZE  4096 /* Bytes read from the end of the log file */
+#define LOG_BATCH_ENTRIES  1000U /* Max entries per locked write in XML mode */
+#define LOG_BATCH_SIZE  262144U /* Max bytes per locked write in XML mode */
 #define MAX_HOSTNAME_LENGTH  100
-#define MAX_SESS  1000 /* Maximum number of sess elements per entry */
-#define MAX_TAGS  1000 /* Maximum number of tags */
+#define MMAP_EXTENT  1048576U /* The log file grows this much in mmap mode */
+#define OUTPUT_BUFSIZE  65536U /* Bytes of UUIDs buffered for stdout/stderr */
+#define SEGMENT_MANIFEST  "manifest" /* Name of the segment manifest file */
+#define SHARDS_MAX  1024UL /* Max number of log file shards */
 #define STD_RCFILE  ".suuidrc"
+#define SYNC_BATCH_ENTRIES  1000U /* Max entries between batch syncs */
+#define SYNC_BATCH_MSEC  1000U /* Max milliseconds between batch syncs */
+#define TAG_SET_MIN  32U /* Initial number of slots in the tag hash set */
+#define URING_BUFFERS  8U /* Max number of writes in flight in uring mode */
+#define URING_BUFSIZE  65536U /* Size of every write buffer in uring mode */
+#define WRITER_RING_SLOTS  4096U /* Entries in the writer thread ring */
+#define XML_ARENA_SIZE  4096U /* Stack buffer used by xml_entry() */
 
 #define LEGAL_UTF8_CHARS  "\x80\x81\x82\x83\x84\x85\x86\x87" \
                           "\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f" \
@@ -112,9 +176,76 @@
                     "abcdefghijklmnopqrstuvwxyz" \
                     LEGAL_UTF8_CHARS /* Legal chars in sess descriptions */
 
+enum logmode {
+	LOGMODE_ERROR = -1,
+	LOGMODE_XML = 0, /* Locked, with </suuids> trailer */
+	LOGMODE_APPEND, /* Unlocked O_APPEND writes, trailer is implied */
+	LOGMODE_MMAP, /* Locked, entries are copied into a mapped extent */
+	LOGMODE_URING /* Locked, entries are written with io_uring */
+};
+
+enum syncmode {
+	SYNC_ERROR = -1,
+	SYNC_NONE = 0, /* Leave it to the OS */
+	SYNC_CLOSE, /* fdatasync() before the log files are closed */
+	SYNC_BATCH /* Also sync in batches during long runs */
+};
+
+enum segmode {
+	SEGMENT_NONE = 0, /* One log file per host */
+	SEGMENT_MONTH, /* New segment every month */
+	SEGMENT_SIZE /* New segment when the active one reaches a size */
+};
+
+enum tracephase {
+	TRACE_RANDOMNESS = 0, /* init_randomness() */
+	TRACE_RCFILE, /* read_rcfile() */
+	TRACE_ENTRY, /* fill_entry_struct(), the next 5 phases are in it */
+	TRACE_HOSTNAME,
+	TRACE_CWD,
+	TRACE_USER,
+	TRACE_TTY,
+	TRACE_SESS,
+	TRACE_OPEN, /* open_logfile() */
+	TRACE_GENERATE, /* Generate the UUIDs */
+	TRACE_SERIALIZE, /* Create the XML and JSON entries */
+	TRACE_WRITE, /* Write the entries, also in the writer thread */
+	TRACE_CLOSE, /* close_logfile() */
+	TRACE_PHASES /* Number of phases */
+};
+
+struct Segment {
+	enum segmode mode;
+	unsigned long long size;
+};
+
+struct Manifest {
+	char *name;
+	char first[DATE_LENGTH + 1];
+	char last[DATE_LENGTH + 1];
+	unsigned long count;
+};
+
 struct Rc {
 	char *hostname;
+	char *logmode;
 	char *macaddr;
+	char *segment;
+	char *shards;
+	char *sync;
+};
+
+struct Arenablock {
+	struct Arenablock *prev;
+};
+
+struct Arena {
+	struct Arenablock *block; /* Newest heap block, or NULL */
+	char *buf; /* The block in use */
+	size_t size; /* Size of buf */
+	size_t used; /* Bytes of buf in use */
+	char *first; /* Buffer from arena_init(), used after arena_free() */
+	size_t first_size;
 };
 
 struct Sess {
@@ -122,41 +253,226 @@ struct Sess {
 	char *desc;
 };
 
+struct Sesslink {
+	size_t uuid; /* Offset of the UUID in the session variable */
+	size_t desc; /* Offset of the desc */
+	size_t desclen; /* Length of the desc, 0 if there is none */
+};
+
 struct Entry {
 	char date[DATE_LENGTH + 1];
 	char uuid[UUID_LENGTH + 1];
-	char *tag[MAX_TAGS];
+	char **tag; /* NULL-terminated, points to tag_buf or to the heap */
 	char *txt;
 	char *host;
 	char *cwd;
 	char *user;
 	char *tty;
-	struct Sess sess[MAX_SESS];
+	struct Sess *sess; /* Ends with a NULL uuid, sess_buf or the heap */
+	struct Arena *arena; /* Owns the tag and sess strings if not NULL */
+	size_t tag_count; /* Number of tags added with append_tag() */
+	size_t tag_size; /* Number of elements in tag, including the NULL */
+	size_t *tag_set; /* Open addressing, tag index + 1 in every slot */
+	size_t tag_set_size; /* Number of slots in tag_set, a power of 2 */
+	size_t sess_count; /* Number of elements added with append_sess() */
+	size_t sess_size; /* Number of elements in sess, including the last */
+	char *tag_buf[ENTRY_TAGS + 1];
+	struct Sess sess_buf[ENTRY_SESS + 1];
+};
+
+struct binlog_str {
+	uint64_t hash;
+	uint64_t ref;
+	size_t len;
+	char *data;
+};
+
+struct Binlog {
+	int recfd;
+	int heapfd;
+	uint64_t recsize;
+	uint64_t heapsize;
+	struct binlog_str *tab; /* Interned strings and lists */
+	size_t tabsize;
+	size_t tabcount;
+};
+
+struct Binmap {
+	unsigned char *rec;
+	size_t recsize;
+	unsigned char *heap;
+	size_t heapsize;
+	size_t count;
+};
+
+struct Lockstat {
+	long timeout; /* Max milliseconds to wait for a lock, -1 = no limit */
+	unsigned long locks; /* Number of locks taken */
+	unsigned long waits; /* Number of locks that weren't free at once */
+	long long wait_ns; /* Total time spent waiting */
+	long long max_ns; /* Longest wait */
+};
+
+struct Logreader {
+	FILE *fp;
+	char *line;
+	size_t size;
+	size_t lineno; /* Number of header lines read */
+	bool trailer; /* "</suuids>" is read, but not delivered yet */
+	bool pending; /* `line` is read, but not delivered yet */
+};
+
+struct Shardfile {
+	char *fname;
+	struct Logreader r;
+	const char *line; /* Next line, NULL at the end of the file */
+	utime_t ticks; /* Timestamp of `line` or the last line before it */
+};
+
+struct Logmerge {
+	struct Shardfile *files;
+	size_t count;
+};
+
+struct Uring {
+	int fd; /* io_uring file descriptor, -1 if it's not set up */
+	int logfd; /* Log file descriptor used for the writes */
+	off_t pos; /* File offset of the next write */
+	unsigned entries;
+	unsigned inflight; /* Submitted requests that aren't completed */
+	void *sqring;
+	size_t sqsize;
+	void *cqring; /* NULL if it's in the same mapping as sqring */
+	size_t cqsize;
+	void *sqes;
+	size_t sqessize;
+	unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+	unsigned *cqhead, *cqtail, *cqmask;
+	void *cqes;
+	char *buf[URING_BUFFERS];
+	size_t len[URING_BUFFERS];
+	off_t off[URING_BUFFERS]; /* File offset of every submitted buffer */
+	bool busy[URING_BUFFERS]; /* The buffer is in flight */
+	unsigned cur; /* The buffer that's being filled */
+	unsigned long writes; /* Number of submitted writes */
+};
+
+struct Writerslot {
+	char *ap; /* XML entry */
+	char *jp; /* JSON entry or NULL */
+};
+
+struct Trace {
+	bool enabled; /* --trace-timing is used */
+	struct timespec start;
+	long long ns[TRACE_PHASES]; /* Time spent in every phase */
+	unsigned long calls[TRACE_PHASES]; /* Number of times it was timed */
+	long long open_lock_ns; /* Time waiting for locks in open_logfile() */
+	/* Counters, also reported by --trace-timing */
+	unsigned long long allocs; /* mystrdup(), allocstr(), arenas, ... */
+	unsigned long long alloc_bytes;
+	unsigned long long xml_escapes; /* Calls to suuid_xml() */
+	unsigned long long xml_escape_bytes; /* Bytes escaped by suuid_xml() */
+	unsigned long long log_writes; /* Writes to the log files */
+	unsigned long long log_bytes;
+	unsigned long long clock_reads; /* In get_current_time() */
+	unsigned long long clock_spins; /* Clock reads with the same time */
+};
+
+struct Writer {
+	bool running; /* The writer thread is started */
+	pthread_t thread;
+	struct Writerslot *slots;
+	unsigned head; /* Next slot to fill, only changed by the producer */
+	unsigned tail; /* Next slot to write, only changed by the consumer */
+	pthread_mutex_t mutex; /* Only used when a thread has to sleep */
+	pthread_cond_t notempty;
+	pthread_cond_t notfull;
+	int pwaiting; /* The producer sleeps on `notfull` */
+	int cwaiting; /* The consumer sleeps on `notempty` */
+	int done; /* The producer has stopped */
+	int error; /* The writer thread failed to write an entry */
+	unsigned long written; /* Number of entries written by the thread */
+	unsigned long waits; /* Number of times the producer found it full */
 };
 
 struct Logs {
+	const char *fname;
+	const char *jsonname;
 	FILE *logfp;
+	FILE *jsonfp;
+	int fd;
+	int jsonfd;
+	struct Binlog bin;
+	int mapfd; /* Log file descriptor used for the mapping in mmap mode */
+	char *map;
+	off_t mapbase; /* File offset of the mapping */
+	size_t maplen;
+	off_t mappos; /* File offset of the next entry */
+	struct Uring ring;
+	struct binbuf batch; /* Entries that are written at the next lock */
+	struct binbuf jsonbatch;
+	unsigned long batched; /* Number of entries in the batch */
+	struct Lockstat lock;
+	enum logmode mode;
+	enum syncmode sync;
+	unsigned long unsynced; /* Entries written since the last sync */
+	unsigned long syncs; /* Number of syncs done */
+	struct timespec lastsync;
+	struct Writer writer;
 };
 
 struct Options {
 	/* sort -d -k2 */
+	bool binlog;
+	char *bin_to_xml;
 	char *comment;
+	bool daemon;
 	bool help;
+	bool jsonl;
 	bool license;
+	char *list_segments;
+	long lock_timeout;
 	char *logdir;
+	char *logmode;
 	unsigned long count;
+	char *merge_shards;
+	bool no_daemon;
 	bool random_mac;
+	char *range;
 	bool raw;
 	char *rcfile;
+	char *seal;
+	char *segment;
 	bool selftest;
-	char *tag[MAX_TAGS];
+	bool serve_stdio;
+	char *shards;
+	bool stream;
+	char *sync;
+	char **tag; /* NULL-terminated, or NULL if no -t/--tag options */
 	bool testexec;
 	bool testfunc;
+	char *trace_timing;
+	char *unseal;
 	char *uuid;
+	char *uuid_file;
 	bool valgrind;
 	int verbose;
 	bool version;
 	char *whereto;
+	char *xml_to_bin;
+};
+
+struct Request {
+	unsigned long count; /* Number of UUIDs */
+	bool raw;
+	char *whereto; /* Like -w/--whereto, can be NULL */
+};
+
+struct Outbuf {
+	int fd; /* -1 if the stream isn't used */
+	const char *name; /* Used in error messages */
+	struct binbuf buf;
 };
 
 struct streams {
@@ -184,6 +500,47 @@ int myerror(const char *format, ...);
 void init_opt(struct Options *dest);
 void set_opt_valgrind(bool b);
 
+/* arena.c */
+void arena_init(struct Arena *a, char *buf, const size_t size);
+void *arena_alloc(struct Arena *a, const size_t size);
+char *arena_strndup(struct Arena *a, const char *s, const size_t len);
+char *arena_strdup(struct Arena *a, const char *s);
+char *arena_allocstr(struct Arena *a, const char *format, ...);
+void arena_discard(struct Arena *a, void *p);
+void arena_rewind(struct Arena *a, const struct Arena *mark);
+void arena_free(struct Arena *a);
+
+/* binlog.c */
+void put_u32(unsigned char *dest, const uint32_t val);
+void put_u64(unsigned char *dest, const uint64_t val);
+uint32_t get_u32(const unsigned char *src);
+uint64_t get_u64(const unsigned char *src);
+void binlog_init(struct Binlog *bl);
+int binlog_open(struct Binlog *bl, const char *prefix, struct Lockstat *ls);
+int binlog_add(struct Binlog *bl, const struct Entry *entry, const bool raw);
+int binlog_add_verbatim(struct Binlog *bl, const char *line);
+int binlog_close(struct Binlog *bl);
+int binmap_open(struct Binmap *map, const char *recname);
+void binmap_close(struct Binmap *map);
+const unsigned char *binmap_record(const struct Binmap *map, const size_t i);
+uint64_t binmap_ticks(const struct Binmap *map, const size_t i);
+int binmap_entry(const struct Binmap *map, const size_t i,
+                 struct Entry *entry, bool *raw, char **verbatim);
+int binlog_to_xml(const char *recname, FILE *fp);
+int xml_to_binlog(const char *xmlname);
+
+/* daemon.c */
+char *get_socket_name(const char *prefix);
+int daemon_connect(const char *sockname);
+int daemon_request(const int fd, const struct Entry *entry,
+                   const struct Options *opts, const unsigned long count,
+                   struct Outbuf *out, struct uuid_result *res);
+int run_daemon(struct Logs *logs, const struct Rc *rc,
+               const struct Options *opts, const struct Entry *entry,
+               const char *sockname);
+int serve_stdio(struct Logs *logs, const struct Rc *rc,
+                const struct Options *opts, const struct Entry *entry);
+
 /* environ.c */
 char *get_editor(void);
 bool valid_hostname(const char *s);
@@ -196,12 +553,23 @@ char *get_username(void);
 char *get_tty(void);
 
 /* genuuid.c */
+extern bool should_terminate;
+char *process_uuid(struct Logs *logs,
+                   const struct Rc *rc, const struct Options *opts,
+                   struct Entry *entry, struct Outbuf *out);
+void sighandler(const int sig);
 int fill_entry_struct(struct Entry *entry, const struct Rc *rc,
                       const struct Options *opts);
 struct uuid_result create_and_log_uuids(const struct Options *opt);
 
 /* io.c */
 bool file_exists(const char *s);
+int write_all(const int fd, const char *buf, size_t len, off_t pos);
+void outbuf_init(struct Outbuf *ob, const int fd, const char *name);
+int outbuf_add(struct Outbuf *ob, const char *s);
+bool outbuf_full(const struct Outbuf *ob);
+int outbuf_flush(struct Outbuf *ob);
+void outbuf_free(struct Outbuf *ob);
 void streams_init(struct streams *dest);
 void streams_free(struct streams *dest);
 char *read_from_fp(FILE *fp, struct binbuf *dest);
@@ -210,14 +578,50 @@ char *read_from_file(const char *fname);
 char *read_from_editor(const char *editor);
 int streams_exec(const struct Options *o, struct streams *dest, char *cmd[]);
 
+/* json.c */
+char *json_str(const char *s);
+char *json_entry(const struct Entry *entry, const bool raw);
+char *json_request(const struct Entry *entry, const bool raw,
+                   const unsigned long count);
+char *json_parse_str(const char **s);
+int parse_json_entry(const char *s, struct Entry *entry, bool *raw);
+int parse_json_request(const char *s, struct Entry *entry,
+                       struct Request *req);
+
 /* logfile.c */
 bool valid_xml_chars(const char *s);
-void init_sess_array(struct Sess *sess);
+void init_sess_array(struct Sess *sess, const size_t n);
 void init_xml_entry(struct Entry *e);
-char *create_sess_xml(const struct Entry *entry);
-FILE *open_logfile(const char *fname);
-int add_to_logfile(FILE *fp, const struct Entry *entry, const bool raw);
-int close_logfile(FILE *fp);
+char *create_sess_xml(struct Arena *a, const struct Entry *entry);
+char *xml_entry(const struct Entry *entry, const bool raw);
+enum logmode parse_logmode(const char *s);
+enum logmode get_logmode(const struct Rc *rc, const struct Options *opts);
+enum syncmode parse_syncmode(const char *s);
+enum syncmode get_syncmode(const struct Rc *rc, const struct Options *opts);
+char *xml_unescape(const char *s, const size_t len);
+int parse_xml_line(const char *line, struct Entry *entry, bool *raw);
+char *log_filename(const char *fname, const char *ext);
+int lock_fd(const int fd, const char *fname, struct Lockstat *ls);
+void logreader_init(struct Logreader *r, FILE *fp);
+void logreader_free(struct Logreader *r);
+int read_log_line(struct Logreader *r, const char **dest);
+int for_each_log_line(FILE *fp, int (*func)(void *, const char *),
+                      void *data);
+utime_t line_ticks(const char *line);
+int open_logfile(struct Logs *logs, const char *fname, const char *jsonname,
+                 const char *binprefix);
+int write_log_entry(struct Logs *logs, const char *ap, const char *jp);
+int add_to_logfile(struct Logs *logs, const struct Entry *entry,
+                   const bool raw);
+int flush_logfile(struct Logs *logs);
+int close_logfile(struct Logs *logs);
+
+/* lz.c */
+size_t lz_bound(const size_t len);
+size_t lz_compress(const unsigned char *src, const size_t len,
+                   unsigned char *dst);
+int lz_decompress(const unsigned char *src, const size_t len,
+                  unsigned char *dst, const size_t rawlen);
 
 /* rcfile.c */
 void init_rc(struct Rc *rc);
@@ -227,15 +631,46 @@ char *get_rcfilename(const struct Options *opt);
 char *has_key(const char *line, const char *keyword);
 int read_rcfile(const char *rcfile, struct Rc *rc);
 
+/* seal.c */
+int seal_logfile(const char *xmlname);
+int unseal_logfile(const char *sealname, const char *range, FILE *fp);
+
+/* segment.c */
+int parse_segment(const char *s, struct Segment *seg);
+int get_segment(const struct Rc *rc, const struct Options *opts,
+                struct Segment *seg);
+char *get_segment_prefix(const char *dir, const struct Segment *seg,
+                         char **segname);
+void free_manifest(struct Manifest *man, const size_t count);
+int read_manifest(const char *fname, struct Manifest **dest, size_t *count);
+int update_manifest(const char *dir, const char *segname, const char *first,
+                    const char *last, const unsigned long count);
+bool range_overlaps(const char *range, const char *first, const char *last);
+int list_segments(const struct Options *opts, const char *range);
+
 /* selftest.c */
 int opt_selftest(char *execname, const struct Options *o);
 
 /* sessvar.c */
+bool is_legal_desc_char(const char c);
+bool is_valid_desc_string(const char *s);
+size_t parse_sessvar(const char *s, const size_t len, struct Sesslink *dest);
 int get_sess_info(struct Entry *entry);
+int append_sess(struct Entry *entry, char *uuid, char *desc);
 void free_sess(struct Entry *entry);
 int run_session(const struct Options *orig_opt,
                 const int argc, char * const argv[]);
 
+/* shard.c */
+int get_shards(const struct Rc *rc, const struct Options *opts,
+               unsigned long *dest);
+char *get_shard_prefix(const char *prefix, const unsigned long shards);
+int logmerge_open(struct Logmerge *m, const char *xmlname);
+int logmerge_each(struct Logmerge *m, int (*func)(void *, const char *),
+                  void *data);
+void logmerge_close(struct Logmerge *m);
+int merge_shards(const char *xmlname, FILE *fp);
+
 /* strings.c */
 char *mystrdup(const char *s);
 char *allocstr_va(const char *format, va_list ap);
@@ -250,12 +685,36 @@ char *trim_str_front(char *dest);
 char *trim_str_end(char *dest);
 const char *utf8_check(const char *text);
 
+/* uring.c */
+void uring_init(struct Uring *u);
+int uring_setup(struct Uring *u, const int logfd, const off_t pos);
+int uring_write(struct Uring *u, const char *s, size_t len);
+int uring_fsync(struct Uring *u);
+int uring_finish(struct Uring *u);
+void uring_free(struct Uring *u);
+
 /* tag.c */
-void rewind_tag(void);
-char *get_next_tag(const struct Entry *entry);
+bool tag_exists(const struct Entry *entry, const char *tag);
+int append_tag(struct Entry *entry, char *tag);
 int store_tag(struct Entry *entry, const char *arg);
+void drop_tags(struct Entry *entry, const size_t keep);
 void free_tags(struct Entry *entry);
 
+/* trace.c */
+extern struct Trace trace;
+void trace_init(const bool enabled);
+void trace_begin(struct timespec *ts);
+void trace_end(const enum tracephase phase, const struct timespec *ts);
+char *trace_json(const struct Logs *logs, const unsigned long count);
+int trace_print(const char *fname, const struct Logs *logs,
+                const unsigned long count);
+
+/* writer.c */
+void writer_start(struct Logs *logs);
+int writer_push(struct Writer *w, char *ap, char *jp);
+int writer_drain(struct Writer *w);
+int writer_stop(struct Writer *w);
+
 #endif /* ifndef _SUUID_H */
 
 /* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -20,17 +20,95 @@
 
 #include "suuid.h"
 
-unsigned int tag_count = 0;
-unsigned int tag_list_ind = 0;
+/*
+ * The tags are stored in insertion order in entry->tag[]. When there are more 
+ * than ENTRY_TAGS of them, tag_exists() uses the hash set in entry->tag_set 
+ * instead of comparing against every tag. It's an open addressing table with 
+ * linear probing where every slot contains the index of the tag in 
+ * entry->tag[] plus one, or 0 if the slot is empty. If the same tag is added 
+ * several times by append_tag(), only the first one is in the set.
+ */
+
+/*
+ * tag_hash() - Return the FNV-1a hash of the string `s`.
+ */
+
+static size_t tag_hash(const char *s)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (*p) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return (size_t)h;
+}
 
 /*
- * rewind_tag() - Reset the index counter so get_next_tag() starts from the 
- * beginning.
+ * tag_slot() - Return pointer to the slot in entry->tag_set where `tag` is 
+ * stored, or to the empty slot where it should be stored.
  */
 
-void rewind_tag(void)
+static size_t *tag_slot(const struct Entry *entry, const char *tag)
 {
-	tag_list_ind = 0;
+	size_t i, mask;
+
+	assert(entry);
+	assert(entry->tag_set);
+	assert(tag);
+
+	mask = entry->tag_set_size - 1;
+	for (i = tag_hash(tag) & mask; entry->tag_set[i];
+	     i = (i + 1) & mask) {
+		if (!strcmp(entry->tag[entry->tag_set[i] - 1], tag))
+			break;
+	}
+
+	return &entry->tag_set[i];
+}
+
+/*
+ * tag_set_add() - Add entry->tag[ind] to the hash set. The set is created or 
+ * doubled in size and filled with all the tags from entry->tag[] if it's 
+ * more than half full. Returns 0 if ok, or 1 if calloc() fails.
+ */
+
+static int tag_set_add(struct Entry *entry, const size_t ind)
+{
+	size_t *slot, i;
+
+	assert(entry);
+	assert(ind < entry->tag_count);
+
+	if ((ind + 1) * 2 > entry->tag_set_size) {
+		size_t *old = entry->tag_set, oldsize = entry->tag_set_size;
+
+		entry->tag_set_size = oldsize ? oldsize * 2 : TAG_SET_MIN;
+		while ((ind + 1) * 2 > entry->tag_set_size)
+			entry->tag_set_size *= 2;
+		entry->tag_set = calloc(entry->tag_set_size, sizeof(size_t));
+		if (!entry->tag_set) {
+			failed("calloc()"); /* gncov */
+			entry->tag_set = old; /* gncov */
+			entry->tag_set_size = oldsize; /* gncov */
+			return 1; /* gncov */
+		}
+		trace_count(allocs, 1);
+		trace_count(alloc_bytes, entry->tag_set_size * sizeof(size_t));
+		free(old);
+		for (i = 0; i < ind; i++) {
+			slot = tag_slot(entry, entry->tag[i]);
+			if (!*slot)
+				*slot = i + 1;
+		}
+	}
+	slot = tag_slot(entry, entry->tag[ind]);
+	if (!*slot)
+		*slot = ind + 1;
+
+	return 0;
 }
 
 /*
@@ -40,13 +118,16 @@ void rewind_tag(void)
 
 bool tag_exists(const struct Entry *entry, const char *tag)
 {
-	unsigned int i;
+	size_t i;
 
 	assert(entry);
 	assert(entry->tag);
 	assert(tag);
 
-	for (i = 0; i < tag_count; i++) {
+	if (entry->tag_set)
+		return !!*tag_slot(entry, tag);
+
+	for (i = 0; i < entry->tag_count; i++) {
 		if (!strcmp(tag, entry->tag[i]))
 			return true;
 	}
@@ -55,96 +136,154 @@ bool tag_exists(const struct Entry *entry, const char *tag)
 }
 
 /*
- * get_next_tag() - Return a pointer to a string with the next stored tag name. 
- * Returns NULL when the last tag has been found.
+ * append_tag() - Add the string `tag`, allocated from entry->arena, to the 
+ * end of entry->tag[]. The tags are stored in entry->tag_buf until it's full, 
+ * then the array is moved to the heap and doubled in size when needed. `tag` 
+ * is discarded if the array can't be extended. Returns 0 if ok, or 1 if 
+ * error.
  */
 
-char *get_next_tag(const struct Entry *entry)
+int append_tag(struct Entry *entry, char *tag)
 {
+	char **p;
+	size_t size;
+
 	assert(entry);
-	assert(entry->tag);
+	assert(tag);
 
-	if (tag_list_ind < MAX_TAGS)
-		return entry->tag[tag_list_ind++];
-	else
-		return NULL; /* gncov */
+	if (entry->tag_count + 1 >= entry->tag_size) {
+		size = entry->tag_size * 2;
+		if (entry->tag == entry->tag_buf) {
+			p = malloc(size * sizeof(char *));
+			if (p)
+				memcpy(p, entry->tag_buf,
+				       entry->tag_size * sizeof(char *));
+		} else {
+			p = realloc(entry->tag, size * sizeof(char *));
+		}
+		if (!p) {
+			failed("realloc()"); /* gncov */
+			arena_discard(entry->arena, tag); /* gncov */
+			return 1; /* gncov */
+		}
+		trace_count(allocs, 1);
+		trace_count(alloc_bytes, size * sizeof(char *));
+		entry->tag = p;
+		entry->tag_size = size;
+	}
+	entry->tag[entry->tag_count++] = tag;
+	entry->tag[entry->tag_count] = NULL;
+
+	if ((entry->tag_set || entry->tag_count > ENTRY_TAGS)
+	    && tag_set_add(entry, entry->tag_count - 1)) {
+		entry->tag[--entry->tag_count] = NULL; /* gncov */
+		arena_discard(entry->arena, tag); /* gncov */
+		return 1; /* gncov */
+	}
+
+	return 0;
 }
 
 /*
- * store_tag() - Store a new tag in the array. Return 0 if the tag was 
- * successfully added or it existed from before, or 1 if something failed.
+ * store_tag() - Split `arg` at every comma and store the pieces in the tag 
+ * array with surrounding whitespace removed. Empty tags and tags that already 
+ * exist are ignored. Return 0 if all tags were successfully added or existed 
+ * from before, or 1 if something failed.
  */
 
 int store_tag(struct Entry *entry, const char *arg)
 {
-	char *tag, *p;
+	char *buf, *p, *next, *end, *tag;
 	int retval = 0;
 
 	assert(entry);
 	assert(arg);
 
-	tag = mystrdup(arg); /* Don't modify the source */
-	if (!tag) {
-		failed("mystrdup()"); /* gncov */
+	/*
+	 * The tags are split and trimmed in a copy of `arg`. If the entry has 
+	 * an arena, the tags are stored as pointers into the copy, otherwise 
+	 * every tag gets its own allocation so it can be freed separately.
+	 */
+
+	buf = arena_strdup(entry->arena, arg);
+	if (!buf) {
+		failed("arena_strdup()"); /* gncov */
 		return 1; /* gncov */
 	}
 
-	while ((p = strchr(tag, ','))) {
-		*p++ = '\0';
-		if (store_tag(entry, tag)) {
+	for (p = buf; p; p = next) {
+		next = strchr(p, ',');
+		if (next) {
+			end = next;
+			*next++ = '\0';
+		} else {
+			end = p + strlen(p);
+		}
+		while (isspace((unsigned char)*p))
+			p++;
+		while (end > p && isspace((unsigned char)end[-1]))
+			end--;
+		*end = '\0';
+
+		if (!*p || tag_exists(entry, p))
+			continue;
+		if (utf8_check(p)) {
+			myerror("Tags have to be in UTF-8");
 			retval = 1;
-			goto cleanup;
+			break;
 		}
-		if (p && *p) {
-			/*
-			 * This whole thing could be replaced by a single 
-			 * strcpy(tag, p), but Valgrind complains about source 
-			 * and destination overlap. It's better to uglify the 
-			 * source a bit than having Valgrind errors, so live 
-			 * with it for now.
-			 */
-			char *tag2;
-
-			tag2 = malloc(strlen(p) + 1);
-			if (!tag2) {
-				failed("malloc()"); /* gncov */
-				retval = 1; /* gncov */
-				goto cleanup; /* gncov */
-			}
-			strcpy(tag2, p);
-			free(tag);
-			tag = tag2;
+		tag = entry->arena ? p : mystrdup(p);
+		if (!tag) {
+			failed("mystrdup()"); /* gncov */
+			retval = 1; /* gncov */
+			break; /* gncov */
+		}
+		if (append_tag(entry, tag)) {
+			retval = 1; /* gncov */
+			break; /* gncov */
 		}
 	}
-	trim_str_front(tag);
-	trim_str_end(tag);
-	if (tag_exists(entry, tag) || !*tag)
-		goto cleanup;
-	if (utf8_check(tag)) {
-		myerror("Tags have to be in UTF-8");
-		retval = 1;
-		goto cleanup;
-	}
+	arena_discard(entry->arena, buf);
 
-	if (tag_count >= MAX_TAGS) {
-		myerror("Maximum number of tags (%d) exceeded", MAX_TAGS);
-		retval = 1;
-		goto cleanup;
-	}
+	return retval;
+}
 
-	if (!(entry->tag[tag_count++] = mystrdup(tag))) {
-		failed("mystrdup()"); /* gncov */
-		retval = 1; /* gncov */
-	}
+/*
+ * drop_tags() - Remove the tags in entry->tag[] from index `keep` and up, 
+ * so only the first `keep` tags are left and new tags can be added after 
+ * them. The strings are freed unless they belong to entry->arena, and the 
+ * tags are removed from the hash set. Returns nothing.
+ */
 
-cleanup:
-	free(tag);
+void drop_tags(struct Entry *entry, const size_t keep)
+{
+	size_t i, *slot;
 
-	return retval;
+	assert(entry);
+	assert(keep <= entry->tag_count);
+
+	/*
+	 * Removing the tags in the opposite order of insertion leaves the hash 
+	 * set in the same state as before they were added, so no tombstones 
+	 * are needed.
+	 */
+
+	for (i = entry->tag_count; i-- > keep; ) {
+		if (entry->tag_set) {
+			slot = tag_slot(entry, entry->tag[i]);
+			if (*slot == i + 1)
+				*slot = 0;
+		}
+		arena_discard(entry->arena, entry->tag[i]);
+		entry->tag[i] = NULL;
+	}
+	entry->tag_count = keep;
 }
 
 /*
- * free_tags() - Free all allocated strings in the tag array.
+ * free_tags() - Free all strings in the tag array unless they belong to 
+ * entry->arena, the array itself if it was moved to the heap, and the hash 
+ * set. The entry can be used for new tags afterwards.
  */
 
 void free_tags(struct Entry *entry)
@@ -154,7 +293,16 @@ void free_tags(struct Entry *entry)
 	assert(entry);
 
 	for (i = 0; entry->tag[i]; i++)
-		free(entry->tag[i]);
+		arena_discard(entry->arena, entry->tag[i]);
+	if (entry->tag != entry->tag_buf)
+		free(entry->tag);
+	free(entry->tag_set);
+	entry->tag_set = NULL;
+	entry->tag_set_size = 0;
+	entry->tag = entry->tag_buf;
+	entry->tag_buf[0] = NULL;
+	entry->tag_count = 0;
+	entry->tag_size = ENTRY_TAGS + 1;
 }
 
 /* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
@@ -0,0 +1,228 @@
+/*
+ * trace.c
+ * File ID: 5d0e8a34-cb36-11f1-9f2b-02fc00000001
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * With --trace-timing, the time spent in every phase of the UUID generation 
+ * is measured with the monotonic clock and printed as a JSON object when the 
+ * program is done. The phases are timed with trace_begin() and trace_end(), 
+ * which do nothing unless the tracing is enabled. The counters for 
+ * allocations, XML escaping, log writes and clock reads are increased with 
+ * the trace_count() macro. The writer thread also updates them, so it's done 
+ * atomically.
+ */
+
+#include "suuid.h"
+
+struct Trace trace;
+
+static const char *phase_names[TRACE_PHASES] = {
+	"init_randomness",
+	"read_rcfile",
+	"fill_entry_struct",
+	"hostname",
+	"cwd",
+	"user",
+	"tty",
+	"sess",
+	"open_logfile",
+	"generate",
+	"serialize",
+	"write",
+	"close_logfile",
+};
+
+/*
+ * ts_ns() - Return the number of nanoseconds from `start` to `end`.
+ */
+
+static long long ts_ns(const struct timespec *start,
+                       const struct timespec *end)
+{
+	assert(start);
+	assert(end);
+
+	return (long long)(end->tv_sec - start->tv_sec) * 1000000000LL
+	       + (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * trace_init() - Reset the counters and enable the tracing if `enabled` is 
+ * true. The total time is measured from here. Returns nothing.
+ */
+
+void trace_init(const bool enabled)
+{
+	memset(&trace, 0, sizeof(trace));
+	trace.enabled = enabled;
+	if (enabled)
+		clock_gettime(CLOCK_MONOTONIC, &trace.start);
+}
+
+/*
+ * trace_begin() - Store the start time of a phase in `ts` if the tracing is 
+ * enabled. Returns nothing.
+ */
+
+void trace_begin(struct timespec *ts)
+{
+	assert(ts);
+
+	if (trace.enabled)
+		clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/*
+ * trace_end() - Add the time since `ts`, set by trace_begin(), to the phase 
+ * `phase`. Returns nothing.
+ */
+
+void trace_end(const enum tracephase phase, const struct timespec *ts)
+{
+	struct timespec now;
+
+	assert(phase < TRACE_PHASES);
+	assert(ts);
+
+	if (!trace.enabled)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	__atomic_add_fetch(&trace.ns[phase], ts_ns(ts, &now),
+	                   __ATOMIC_RELAXED);
+	__atomic_add_fetch(&trace.calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * bb_addf() - Add the printf()-like arguments to the end of `b`. Returns 0 if 
+ * ok, or 1 if allocation failed.
+ */
+
+static int bb_addf(struct binbuf *b, const char *format, ...)
+{
+	va_list ap;
+	char *p;
+	int retval = 0;
+
+	assert(b);
+	assert(format);
+
+	va_start(ap, format);
+	p = allocstr_va(format, ap);
+	va_end(ap);
+	if (!p)
+		return 1; /* gncov */
+	if (!bb_append(b, p, strlen(p)))
+		retval = 1; /* gncov */
+	free(p);
+
+	return retval;
+}
+
+/*
+ * trace_json() - Return a pointer to an allocated string with the JSON object 
+ * containing the total time, the time and number of calls for every phase, 
+ * the lock statistics from `logs` (can be NULL), the counters and the number 
+ * of UUIDs in `count`. All times are in nanoseconds. Returns NULL if error.
+ */
+
+char *trace_json(const struct Logs *logs, const unsigned long count)
+{
+	const struct Trace t = trace; /* Not counting the allocations here */
+	struct binbuf b;
+	struct timespec now;
+	const struct Lockstat *ls = logs ? &logs->lock : NULL;
+	long long open_ns = t.ns[TRACE_OPEN];
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	binbuf_init(&b);
+	if (bb_addf(&b, "{\"total_ns\":%lld,\"count\":%lu,\"phases\":{",
+	            ts_ns(&t.start, &now), count))
+		goto error; /* gncov */
+	for (i = 0; i < TRACE_PHASES; i++) {
+		if (bb_addf(&b, "%s\"%s\":{\"ns\":%lld,\"calls\":%lu}",
+		            i ? "," : "", phase_names[i], t.ns[i], t.calls[i]))
+			goto error; /* gncov */
+	}
+	if (bb_addf(&b, "},\"open_logfile\":{\"lock_wait_ns\":%lld,"
+	                "\"seek_ns\":%lld},\"locks\":{\"count\":%lu,"
+	                "\"waits\":%lu,\"wait_ns\":%lld,\"max_ns\":%lld},",
+	            t.open_lock_ns, open_ns - t.open_lock_ns,
+	            ls ? ls->locks : 0UL, ls ? ls->waits : 0UL,
+	            ls ? ls->wait_ns : 0LL, ls ? ls->max_ns : 0LL))
+		goto error; /* gncov */
+	if (bb_addf(&b, "\"counters\":{\"allocs\":%llu,\"alloc_bytes\":%llu,"
+	                "\"xml_escapes\":%llu,\"xml_escape_bytes\":%llu,"
+	                "\"log_writes\":%llu,\"log_bytes\":%llu,"
+	                "\"clock_reads\":%llu,\"clock_spins\":%llu}}",
+	            t.allocs, t.alloc_bytes, t.xml_escapes,
+	            t.xml_escape_bytes, t.log_writes, t.log_bytes,
+	            t.clock_reads, t.clock_spins))
+		goto error; /* gncov */
+
+	return b.buf;
+
+error:
+	failed("bb_addf()"); /* gncov */
+	binbuf_free(&b); /* gncov */
+	return NULL; /* gncov */
+}
+
+/*
+ * trace_print() - Write the JSON object from trace_json() and a newline to 
+ * the file `fname`, or to stderr if `fname` is "-". Returns 0 if ok, or 1 if 
+ * error.
+ */
+
+int trace_print(const char *fname, const struct Logs *logs,
+                const unsigned long count)
+{
+	char *s;
+	FILE *fp;
+	int retval = 0;
+
+	assert(fname);
+
+	s = trace_json(logs, count);
+	if (!s)
+		return 1; /* gncov */
+	if (!strcmp(fname, "-")) {
+		fp = stderr;
+	} else {
+		fp = fopen(fname, "w");
+		if (!fp) {
+			myerror("%s: Could not open file", fname);
+			free(s);
+			return 1;
+		}
+	}
+	if (fprintf(fp, "%s\n", s) < 0) {
+		myerror("%s: Cannot write timing data", fname); /* gncov */
+		retval = 1; /* gncov */
+	}
+	if (fp != stderr && fclose(fp) == EOF) {
+		myerror("%s: Cannot close file", fname); /* gncov */
+		retval = 1; /* gncov */
+	}
+	free(s);
+
+	return retval;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
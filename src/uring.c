@@ -0,0 +1,493 @@
+/*
+ * uring.c
+ * File ID: 2e8d1be6-cb1f-11f1-950c-02fc00000001
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Asynchronous log writes with io_uring, used in uring log mode. The entries 
+ * are copied into one of URING_BUFFERS buffers of URING_BUFSIZE bytes, and 
+ * every full buffer is submitted as a write at an explicit file offset while 
+ * the next one is filled. Only URING_BUFFERS writes can be in flight, when 
+ * all buffers are busy, the program waits for the oldest write to complete. 
+ * The kernel interface is used directly with syscall(2), so liburing isn't 
+ * needed. If io_uring isn't available, uring_setup() fails and the caller 
+ * uses the plain write path instead.
+ */
+
+#include "suuid.h"
+
+#define URING_FSYNC  URING_BUFFERS /* user_data of fsync requests */
+
+/*
+ * uring_init() - Initialise the Uring struct `u`, it's not set up yet. Returns 
+ * nothing.
+ */
+
+void uring_init(struct Uring *u)
+{
+	assert(u);
+
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+	u->logfd = -1;
+}
+
+#ifdef HAVE_IO_URING
+
+/*
+ * uring_enter() - Call io_uring_enter(2) on the ring in `u`, try again if the 
+ * call is interrupted by a signal. Returns the return value from the system 
+ * call.
+ */
+
+static long uring_enter(const struct Uring *u, const unsigned submit,
+                        const unsigned wait)
+{
+	long res;
+
+	assert(u);
+	assert(u->fd != -1);
+
+	do {
+		res = syscall(__NR_io_uring_enter, u->fd, submit, wait,
+		              wait ? IORING_ENTER_GETEVENTS : 0U, NULL, 0);
+	} while (res == -1 && errno == EINTR);
+
+	return res;
+}
+
+/*
+ * write_rest() - Write the part of buffer `b` in `u` that wasn't written by a 
+ * short write of `done` bytes, using pwrite(). Returns 0 if ok, or 1 if error.
+ */
+
+static int write_rest(const struct Uring *u, const unsigned b, size_t done)
+{
+	assert(u);
+	assert(b < URING_BUFFERS);
+
+	while (done < u->len[b]) { /* gncov */
+		ssize_t res = pwrite(u->logfd, /* gncov */
+		                     u->buf[b] + done,
+		                     u->len[b] - done,
+		                     u->off[b] + (off_t)done);
+
+		if (res < 1)
+			return 1; /* gncov */
+		done += (size_t)res; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * reap() - Take one completion from the completion queue in `u`. If the 
+ * queue is empty and `wait` is true, wait for the next completion, otherwise 
+ * return. The buffer of a completed write is marked as free. Returns 0 if ok, 
+ * or 1 if the request failed or the system call failed.
+ */
+
+static int reap(struct Uring *u, const bool wait)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head, tail;
+	int retval = 0;
+
+	assert(u);
+
+	head = *u->cqhead;
+	tail = __atomic_load_n(u->cqtail, __ATOMIC_ACQUIRE);
+	while (head == tail) {
+		if (!wait)
+			return 0;
+		if (uring_enter(u, 0, 1) == -1) {
+			myerror("io_uring_enter() failed"); /* gncov */
+			return 1; /* gncov */
+		}
+		tail = __atomic_load_n(u->cqtail, __ATOMIC_ACQUIRE);
+	}
+
+	cqe = (struct io_uring_cqe *)u->cqes + (head & *u->cqmask);
+	if (cqe->user_data == URING_FSYNC) {
+		if (cqe->res < 0) {
+			errno = -cqe->res; /* gncov */
+			myerror("Cannot sync the log file"); /* gncov */
+			retval = 1; /* gncov */
+		}
+	} else {
+		const unsigned b = (unsigned)cqe->user_data;
+
+		assert(b < URING_BUFFERS);
+		assert(u->busy[b]);
+		if (cqe->res < 0) {
+			errno = -cqe->res; /* gncov */
+			myerror("Cannot write to the log file"); /* gncov */
+			retval = 1; /* gncov */
+		} else if ((size_t)cqe->res < u->len[b]
+		           && write_rest(u, b, (size_t)cqe->res)) {
+			myerror("Cannot write to the log file"); /* gncov */
+			retval = 1; /* gncov */
+		}
+		u->busy[b] = false;
+	}
+	__atomic_store_n(u->cqhead, head + 1, __ATOMIC_RELEASE);
+	u->inflight--;
+
+	return retval;
+}
+
+/*
+ * get_sqe() - Return a cleared submission queue entry from the ring in `u`. 
+ * If the ring is full, wait for a completion first. Returns NULL if error.
+ */
+
+static struct io_uring_sqe *get_sqe(struct Uring *u)
+{
+	struct io_uring_sqe *sqe;
+
+	assert(u);
+
+	while (u->inflight >= u->entries) {
+		if (reap(u, true))
+			return NULL; /* gncov */
+	}
+	sqe = (struct io_uring_sqe *)u->sqes + (*u->sqtail & *u->sqmask);
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+/*
+ * submit_sqe() - Add the submission queue entry `sqe` from get_sqe() to the 
+ * ring in `u` by storing its index in the submission array, and submit it to 
+ * the kernel. Returns 0 if ok, or 1 if error.
+ */
+
+static int submit_sqe(struct Uring *u, const struct io_uring_sqe *sqe)
+{
+	unsigned tail, ind;
+
+	assert(u);
+	assert(sqe);
+
+	tail = *u->sqtail;
+	ind = (unsigned)(sqe - (const struct io_uring_sqe *)u->sqes);
+	u->sqarray[tail & *u->sqmask] = ind;
+	__atomic_store_n(u->sqtail, tail + 1, __ATOMIC_RELEASE);
+	if (uring_enter(u, 1, 0) != 1) {
+		myerror("io_uring_enter() failed"); /* gncov */
+		return 1; /* gncov */
+	}
+	u->inflight++;
+
+	return 0;
+}
+
+/*
+ * submit_buf() - Submit the buffer that's being filled in `u` as a write at 
+ * the current file offset, and make the next buffer the current one. If the 
+ * next buffer is still in flight, wait for it. Returns 0 if ok, or 1 if error.
+ */
+
+static int submit_buf(struct Uring *u)
+{
+	struct io_uring_sqe *sqe;
+	const unsigned b = u->cur;
+
+	assert(u);
+
+	if (!u->len[b])
+		return 0;
+	sqe = get_sqe(u);
+	if (!sqe)
+		return 1; /* gncov */
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = u->logfd;
+	sqe->addr = (uint64_t)(uintptr_t)u->buf[b];
+	sqe->len = (uint32_t)u->len[b];
+	sqe->off = (uint64_t)u->pos;
+	sqe->user_data = b;
+	u->off[b] = u->pos;
+	u->busy[b] = true;
+	if (submit_sqe(u, sqe))
+		return 1; /* gncov */
+	u->pos += (off_t)u->len[b];
+	u->writes++;
+	trace_count(log_writes, 1);
+	trace_count(log_bytes, u->len[b]);
+
+	u->cur = (b + 1) % URING_BUFFERS;
+	while (u->busy[u->cur]) {
+		if (reap(u, true))
+			return 1; /* gncov */
+	}
+	u->len[u->cur] = 0;
+
+	return 0;
+}
+
+/*
+ * map_rings() - Map the submission queue, completion queue and submission 
+ * queue entries of the ring in `u` that was set up with the values in `p`. 
+ * Returns 0 if ok, or 1 if error.
+ */
+
+static int map_rings(struct Uring *u, const struct io_uring_params *p)
+{
+	unsigned char *sq, *cq;
+
+	assert(u);
+	assert(p);
+
+	u->sqsize = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	u->cqsize = p->cq_off.cqes
+	            + p->cq_entries * sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cqsize > u->sqsize)
+			u->sqsize = u->cqsize;
+		u->cqsize = 0;
+	}
+	u->sqring = mmap(NULL, u->sqsize, PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if (u->sqring == MAP_FAILED) {
+		u->sqring = NULL; /* gncov */
+		return 1; /* gncov */
+	}
+	if (u->cqsize) {
+		u->cqring = mmap(NULL, u->cqsize, /* gncov */
+		                 PROT_READ | PROT_WRITE,
+		                 MAP_SHARED | MAP_POPULATE, u->fd,
+		                 IORING_OFF_CQ_RING);
+		if (u->cqring == MAP_FAILED) {
+			u->cqring = NULL; /* gncov */
+			return 1; /* gncov */
+		}
+	}
+	u->sqessize = p->sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqessize, PROT_READ | PROT_WRITE,
+	               MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		u->sqes = NULL; /* gncov */
+		return 1; /* gncov */
+	}
+
+	sq = u->sqring;
+	cq = u->cqsize ? u->cqring : u->sqring;
+	u->sqhead = (unsigned *)(sq + p->sq_off.head);
+	u->sqtail = (unsigned *)(sq + p->sq_off.tail);
+	u->sqmask = (unsigned *)(sq + p->sq_off.ring_mask);
+	u->sqarray = (unsigned *)(sq + p->sq_off.array);
+	u->cqhead = (unsigned *)(cq + p->cq_off.head);
+	u->cqtail = (unsigned *)(cq + p->cq_off.tail);
+	u->cqmask = (unsigned *)(cq + p->cq_off.ring_mask);
+	u->cqes = cq + p->cq_off.cqes;
+	u->entries = p->sq_entries;
+
+	return 0;
+}
+
+/*
+ * uring_setup() - Set up an io_uring instance in `u` for writing to the file 
+ * descriptor `logfd`, starting at file offset `pos`. Fails if the 
+ * SUUID_NO_URING environment variable is defined, if the kernel doesn't 
+ * support io_uring or if it's not allowed. Returns 0 if ok, or 1 if io_uring 
+ * can't be used.
+ */
+
+int uring_setup(struct Uring *u, const int logfd, const off_t pos)
+{
+	struct io_uring_params p;
+	unsigned i;
+	long fd;
+
+	assert(u);
+	assert(logfd != -1);
+	assert(pos >= 0);
+
+	uring_init(u);
+	if (getenv(ENV_NO_URING))
+		return 1;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(__NR_io_uring_setup, 2 * URING_BUFFERS, &p);
+	if (fd == -1)
+		return 1; /* gncov */
+	u->fd = (int)fd;
+	if (map_rings(u, &p)) {
+		uring_free(u); /* gncov */
+		return 1; /* gncov */
+	}
+	u->buf[0] = malloc(URING_BUFFERS * URING_BUFSIZE);
+	if (!u->buf[0]) {
+		uring_free(u); /* gncov */
+		return 1; /* gncov */
+	}
+	for (i = 1; i < URING_BUFFERS; i++)
+		u->buf[i] = u->buf[0] + i * URING_BUFSIZE;
+	u->logfd = logfd;
+	u->pos = pos;
+
+	return 0;
+}
+
+/*
+ * uring_write() - Copy `len` bytes from `s` into the write buffers in `u`, 
+ * submitting every buffer that gets full. Returns 0 if ok, or 1 if error.
+ */
+
+int uring_write(struct Uring *u, const char *s, size_t len)
+{
+	assert(u);
+	assert(u->fd != -1);
+	assert(s);
+
+	while (len) {
+		const unsigned b = u->cur;
+		size_t n = URING_BUFSIZE - u->len[b];
+
+		if (n > len)
+			n = len;
+		memcpy(u->buf[b] + u->len[b], s, n);
+		u->len[b] += n;
+		s += n;
+		len -= n;
+		if (u->len[b] == URING_BUFSIZE && submit_buf(u))
+			return 1; /* gncov */
+	}
+
+	return 0;
+}
+
+/*
+ * uring_fsync() - Submit the current buffer in `u` and an fdatasync() of the 
+ * log file that starts when all earlier writes are done. Doesn't wait for it 
+ * to complete. Returns 0 if ok, or 1 if error.
+ */
+
+int uring_fsync(struct Uring *u)
+{
+	struct io_uring_sqe *sqe;
+
+	assert(u);
+	assert(u->fd != -1);
+
+	if (submit_buf(u))
+		return 1; /* gncov */
+	sqe = get_sqe(u);
+	if (!sqe)
+		return 1; /* gncov */
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = u->logfd;
+	sqe->flags = IOSQE_IO_DRAIN;
+	sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	sqe->user_data = URING_FSYNC;
+
+	return submit_sqe(u, sqe);
+}
+
+/*
+ * uring_finish() - Submit the last buffer in `u` and wait until all requests 
+ * are completed. Afterwards, `u->pos` is the file offset after the last byte 
+ * written. Returns 0 if ok, or 1 if any request failed.
+ */
+
+int uring_finish(struct Uring *u)
+{
+	int retval = 0;
+
+	assert(u);
+	assert(u->fd != -1);
+
+	if (submit_buf(u))
+		retval = 1; /* gncov */
+	while (u->inflight) {
+		if (reap(u, true))
+			retval = 1; /* gncov */
+	}
+
+	return retval;
+}
+
+/*
+ * uring_free() - Unmap the rings in `u`, close the io_uring file descriptor 
+ * and free the buffers. The log file descriptor isn't closed. Returns 
+ * nothing.
+ */
+
+void uring_free(struct Uring *u)
+{
+	assert(u);
+
+	if (u->sqes)
+		munmap(u->sqes, u->sqessize);
+	if (u->cqring)
+		munmap(u->cqring, u->cqsize); /* gncov */
+	if (u->sqring)
+		munmap(u->sqring, u->sqsize);
+	if (u->fd != -1)
+		close(u->fd);
+	free(u->buf[0]);
+	u->sqes = u->cqring = u->sqring = NULL;
+	u->buf[0] = NULL;
+	u->fd = -1;
+}
+
+#else /* ifdef HAVE_IO_URING */
+
+int uring_setup(struct Uring *u, const int logfd, const off_t pos)
+{
+	assert(u);
+	assert(logfd != -1);
+	assert(pos >= 0);
+
+	uring_init(u);
+
+	return 1;
+}
+
+int uring_write(struct Uring *u, const char *s, size_t len)
+{
+	(void)u;
+	(void)s;
+	(void)len;
+
+	return 1;
+}
+
+int uring_fsync(struct Uring *u)
+{
+	(void)u;
+
+	return 1;
+}
+
+int uring_finish(struct Uring *u)
+{
+	(void)u;
+
+	return 1;
+}
+
+void uring_free(struct Uring *u)
+{
+	(void)u;
+}
+
+#endif /* ifdef HAVE_IO_URING else */
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */
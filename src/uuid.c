@@ -68,11 +68,14 @@ char *write_hex(char *dest, const unsigned char *src, size_t len)
 
 bool valid_uuid(const char *u, const bool check_len)
 {
+	size_t len;
+
 	assert(check_len == false || check_len == true);
 
-	if (!u || strlen(u) < UUID_LENGTH)
+	if (!u)
 		return false;
-	if (check_len && strlen(u) != UUID_LENGTH)
+	len = strnlen(u, UUID_LENGTH + 1); /* Don't scan long strings */
+	if (len < UUID_LENGTH || (check_len && len != UUID_LENGTH))
 		return false;
 
 	/*
@@ -174,9 +177,11 @@ struct timeval *get_current_time(struct timeval *tv)
 			        __func__);
 			return NULL; /* gncov */
 		}
+		trace_count(clock_reads, 1);
 		create_uuid_time(&utime, &tvbuf);
 		if (utime != prevtime)
 			break;
+		trace_count(clock_spins, 1);
 	}
 	prevtime = utime;
 	memcpy(tv, &tvbuf, sizeof(tvbuf));
@@ -357,41 +362,96 @@ bool is_valid_date(const char *src, const bool check_len)
 }
 
 /*
- * uuid_date() - Receive an UUID v1 and write the UUID date to dest, 29 bytes 
- * (ISO 8601 date plus terminating null byte). Return pointer to dest if ok, or 
- * NULL if it's not a valid v1 UUID.
+ * uuid_ticks() - Return the timestamp in the v1 UUID `uuid` as the number of 
+ * 100-nanosecond intervals since 1582-10-15 00:00:00 UTC. The UUID must be 
+ * valid. Returns 0 if it's not a v1 UUID.
  */
 
-char *uuid_date(char *dest, const char *uuid)
+utime_t uuid_ticks(const char *uuid)
 {
 	char hexbuf[16];
-	utime_t val;
-	utime_t nano; /* Same type as `val` due to modulus */
-	time_t timeval;
-	struct tm *tm;
-	char *p;
-#ifdef VERIFY_UUID
-	char chkbuf[DATE_LENGTH + 1];
-	char *chkres;
-#endif
 
-	assert(dest);
 	assert(uuid);
 
-	if (!valid_uuid(uuid, false))
-		return NULL;
 	if (uuid[14] != '1')
-		return NULL; /* Not a v1 UUID, has no timestamp */ /* gncov */
+		return 0;
 
 	memset(hexbuf, 0, 16);
 	strncat(hexbuf, uuid + 15, 3);
 	strncat(hexbuf, uuid + 9, 4);
 	strncat(hexbuf, uuid, 8);
 
-	val = strtoull(hexbuf, NULL, 16);
+	return strtoull(hexbuf, NULL, 16);
+}
+
+/*
+ * uuid_to_bin() - Convert the UUID string `uuid` to 16 bytes of binary data 
+ * and store it in `dest`. Returns 0 if ok, or 1 if the UUID isn't valid.
+ */
+
+int uuid_to_bin(unsigned char *dest, const char *uuid)
+{
+	const char *p;
+	unsigned int i = 0;
+
+	assert(dest);
+	assert(uuid);
+
+	if (!valid_uuid(uuid, true))
+		return 1;
+	for (p = uuid; *p; p += 2) {
+		if (*p == '-')
+			p++;
+		dest[i++] = (unsigned char)(HEXVAL(p[0]) << 4 | HEXVAL(p[1]));
+	}
+
+	return 0;
+}
+
+/*
+ * bin_to_uuid() - Write the 16 bytes of binary data in `src` as a UUID string 
+ * to `dest`, which must have room for UUID_LENGTH + 1 bytes. Returns `dest`.
+ */
+
+char *bin_to_uuid(char *dest, const unsigned char *src)
+{
+	assert(dest);
+	assert(src);
+
+	write_hex(dest, src, 4);
+	dest[8] = '-';
+	write_hex(dest + 9, src + 4, 2);
+	dest[13] = '-';
+	write_hex(dest + 14, src + 6, 2);
+	dest[18] = '-';
+	write_hex(dest + 19, src + 8, 2);
+	dest[23] = '-';
+	write_hex(dest + 24, src + 10, 6);
+
+	return dest;
+}
+
+/*
+ * ticks_date() - Write the date of the UUID timestamp `val`, the number of 
+ * 100-nanosecond intervals since 1582-10-15 00:00:00 UTC, to `dest`, 29 bytes 
+ * (ISO 8601 date plus terminating null byte). Returns pointer to dest if ok, 
+ * or NULL if error.
+ */
+
+char *ticks_date(char *dest, const utime_t val)
+{
+	utime_t nano; /* Same type as `val` due to modulus */
+	time_t timeval;
+	struct tm *tm;
+	char *p;
+
+	assert(dest);
+
 	nano = val % 10000000ULL;
 	timeval = (time_t)((val / 10000000ULL) - EPOCH_DIFF);
 	tm = gmtime(&timeval);
+	if (!tm)
+		return NULL; /* gncov */
 
 	memset(dest, 0, DATE_LENGTH + 1);
 	strftime(dest, DATE_LENGTH, "%Y-%m-%dT%H:%M:%S", tm);
@@ -408,6 +468,33 @@ char *uuid_date(char *dest, const char *uuid)
 		return NULL; /* gncov */
 	}
 
+	return dest;
+}
+
+/*
+ * uuid_date() - Receive an UUID v1 and write the UUID date to dest, 29 bytes 
+ * (ISO 8601 date plus terminating null byte). Return pointer to dest if ok, or 
+ * NULL if it's not a valid v1 UUID.
+ */
+
+char *uuid_date(char *dest, const char *uuid)
+{
+#ifdef VERIFY_UUID
+	char chkbuf[DATE_LENGTH + 1];
+	char *chkres;
+#endif
+
+	assert(dest);
+	assert(uuid);
+
+	if (!valid_uuid(uuid, false))
+		return NULL;
+	if (uuid[14] != '1')
+		return NULL; /* Not a v1 UUID, has no timestamp */ /* gncov */
+
+	if (!ticks_date(dest, uuid_ticks(uuid)))
+		return NULL; /* gncov */
+
 #ifdef VERIFY_UUID
 	chkres = uuid_date_from_uuid(chkbuf, uuid);
 	if (chkres) {
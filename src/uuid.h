@@ -25,6 +25,8 @@
 #define EPOCH_DIFF 12219292800ULL
 #define MACADDR_LENGTH  6 /* Length of MAC address */
 #define UUID_LENGTH  36 /* Length of a standard UUID */
+#define UUID_BIN_LENGTH  16 /* Length of a binary UUID */
+#define HEXVAL(c)  ((c) <= '9' ? (c) - '0' : (c) - 'a' + 10)
 
 typedef unsigned long long utime_t;
 
@@ -46,6 +48,10 @@ const char *scan_for_uuid(const char *s);
 bool valid_macaddr(const char *macaddr);
 void scramble_mac_address(char *dest);
 char *generate_uuid(char *uuid);
+utime_t uuid_ticks(const char *uuid);
+char *ticks_date(char *dest, const utime_t val);
+int uuid_to_bin(unsigned char *dest, const char *uuid);
+char *bin_to_uuid(char *dest, const unsigned char *src);
 bool is_valid_date(const char *src, const bool check_len);
 char *uuid_date(char *dest, const char *uuid);
 #ifdef VERIFY_UUID
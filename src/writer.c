@@ -0,0 +1,262 @@
+/*
+ * writer.c
+ * File ID: 8e41d2a6-cb2a-11f1-950c-02fc00000001
+ *
+ * (C)opyleft 2025- Øyvind A. Holm <sunny@sunbase.org>
+ *
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License as published by the Free 
+ * Software Foundation; either version 2 of the License, or (at your option) 
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * When more than one UUID is generated, the entries are written to the log 
+ * files by a separate writer thread, so the generation doesn't wait for the 
+ * disk. The main thread renders the XML and JSON entries and pushes them into 
+ * a single-producer, single-consumer ring of WRITER_RING_SLOTS slots, and the 
+ * writer thread takes them out and writes them with write_log_entry().
+ *
+ * The ring itself is lock-free, `head` is only written by the producer and 
+ * `tail` only by the consumer. The mutex and the condition variables are only 
+ * used when one side has to sleep because the ring is empty or full. A side 
+ * announces that it's going to sleep by setting its `waiting` flag before it 
+ * checks the ring again under the mutex, and the other side checks the flag 
+ * after it has moved its index. Both use sequentially consistent atomics, so 
+ * at least one of them sees the other's store and a wakeup can't get lost.
+ */
+
+#include "suuid.h"
+
+/*
+ * ring_used() - Return the number of entries in the ring in `w`.
+ */
+
+static unsigned ring_used(struct Writer *w)
+{
+	return __atomic_load_n(&w->head, __ATOMIC_SEQ_CST)
+	       - __atomic_load_n(&w->tail, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * wake() - Wake up the other thread if it's sleeping on `cond`, as announced 
+ * by `*waiting`. Returns nothing.
+ */
+
+static void wake(struct Writer *w, pthread_cond_t *cond, int *waiting)
+{
+	if (!__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+		return;
+	pthread_mutex_lock(&w->mutex);
+	pthread_cond_signal(cond);
+	pthread_mutex_unlock(&w->mutex);
+}
+
+/*
+ * writer_thread() - The consumer. Write the entries from the ring to the log 
+ * files until the producer is done and the ring is empty. After an error, 
+ * the entries are only removed from the ring. Returns NULL.
+ */
+
+static void *writer_thread(void *arg)
+{
+	struct Logs *logs = arg;
+	struct Writer *w = &logs->writer;
+
+	for (;;) {
+		struct Writerslot *slot;
+		struct timespec ts;
+		unsigned tail;
+
+		if (!ring_used(w)) {
+			pthread_mutex_lock(&w->mutex);
+			__atomic_store_n(&w->cwaiting, 1, __ATOMIC_SEQ_CST);
+			while (!ring_used(w)
+			       && !__atomic_load_n(&w->done, __ATOMIC_SEQ_CST))
+				pthread_cond_wait(&w->notempty, &w->mutex);
+			__atomic_store_n(&w->cwaiting, 0, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&w->mutex);
+			if (!ring_used(w))
+				break;
+		}
+
+		tail = __atomic_load_n(&w->tail, __ATOMIC_RELAXED);
+		slot = &w->slots[tail % WRITER_RING_SLOTS];
+		trace_begin(&ts);
+		if (!__atomic_load_n(&w->error, __ATOMIC_SEQ_CST)
+		    && write_log_entry(logs, slot->ap, slot->jp))
+			__atomic_store_n(&w->error, 1, __ATOMIC_SEQ_CST);
+		trace_end(TRACE_WRITE, &ts);
+		free(slot->ap);
+		free(slot->jp);
+		slot->ap = slot->jp = NULL;
+		w->written++;
+		__atomic_store_n(&w->tail, tail + 1, __ATOMIC_SEQ_CST);
+		wake(w, &w->notfull, &w->pwaiting);
+	}
+
+	/*
+	 * io_uring requests are cancelled when the thread that submitted them 
+	 * exits, so wait for them to complete before that.
+	 */
+	if (logs->ring.fd != -1 && uring_finish(&logs->ring))
+		__atomic_store_n(&w->error, 1, __ATOMIC_SEQ_CST); /* gncov */
+
+	return NULL;
+}
+
+/*
+ * writer_start() - Start the writer thread for the log files in `logs`. If 
+ * the thread can't be created, the entries are written directly by 
+ * add_to_logfile() as before. All signals are blocked in the writer thread, 
+ * so they're delivered to the main thread which checks should_terminate. 
+ * Returns nothing.
+ */
+
+void writer_start(struct Logs *logs)
+{
+	struct Writer *w;
+	sigset_t all, orig;
+
+	assert(logs);
+
+	w = &logs->writer;
+	w->running = false;
+	w->head = w->tail = 0;
+	w->pwaiting = w->cwaiting = 0;
+	w->done = w->error = 0;
+	w->written = w->waits = 0;
+	w->slots = calloc(WRITER_RING_SLOTS, sizeof(*w->slots));
+	if (!w->slots) {
+		failed("calloc()"); /* gncov */
+		return; /* gncov */
+	}
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->notempty, NULL);
+	pthread_cond_init(&w->notfull, NULL);
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &orig);
+	if (!pthread_create(&w->thread, NULL, writer_thread, logs))
+		w->running = true;
+	pthread_sigmask(SIG_SETMASK, &orig, NULL);
+	if (w->running)
+		return;
+
+	msg(1, "Cannot start the writer thread, writing" /* gncov */
+	       " directly");
+	pthread_cond_destroy(&w->notfull); /* gncov */
+	pthread_cond_destroy(&w->notempty); /* gncov */
+	pthread_mutex_destroy(&w->mutex); /* gncov */
+	free(w->slots); /* gncov */
+	w->slots = NULL; /* gncov */
+}
+
+/*
+ * writer_push() - The producer. Add the rendered XML entry `ap` and JSON 
+ * entry `jp` (can be NULL) to the ring in `w`, and wait for a free slot if 
+ * it's full. The strings are taken over by the writer and freed after they 
+ * are written. Returns 0 if ok, or 1 if the writer thread has failed.
+ */
+
+int writer_push(struct Writer *w, char *ap, char *jp)
+{
+	struct Writerslot *slot;
+	unsigned head;
+
+	assert(w);
+	assert(w->running);
+	assert(ap);
+
+	if (__atomic_load_n(&w->error, __ATOMIC_SEQ_CST)) {
+		free(ap);
+		free(jp);
+		return 1;
+	}
+	if (ring_used(w) == WRITER_RING_SLOTS) {
+		w->waits++;
+		pthread_mutex_lock(&w->mutex);
+		__atomic_store_n(&w->pwaiting, 1, __ATOMIC_SEQ_CST);
+		while (ring_used(w) == WRITER_RING_SLOTS)
+			pthread_cond_wait(&w->notfull, &w->mutex);
+		__atomic_store_n(&w->pwaiting, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	head = __atomic_load_n(&w->head, __ATOMIC_RELAXED);
+	slot = &w->slots[head % WRITER_RING_SLOTS];
+	slot->ap = ap;
+	slot->jp = jp;
+	__atomic_store_n(&w->head, head + 1, __ATOMIC_SEQ_CST);
+	wake(w, &w->notempty, &w->cwaiting);
+
+	return 0;
+}
+
+/*
+ * writer_drain() - Used by the producer. Wait until the writer thread has 
+ * written all entries in the ring in `w`. The thread keeps running, but it 
+ * doesn't touch the log files until the next writer_push(), so the caller 
+ * can write the XML batch. Returns 0 if all entries were written, or 1 if the 
+ * writer thread has failed.
+ */
+
+int writer_drain(struct Writer *w)
+{
+	assert(w);
+
+	if (!w->running)
+		return 0;
+	if (ring_used(w)) {
+		pthread_mutex_lock(&w->mutex);
+		__atomic_store_n(&w->pwaiting, 1, __ATOMIC_SEQ_CST);
+		while (ring_used(w))
+			pthread_cond_wait(&w->notfull, &w->mutex);
+		__atomic_store_n(&w->pwaiting, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&w->mutex);
+	}
+
+	return __atomic_load_n(&w->error, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * writer_stop() - Let the writer thread write the rest of the entries in the 
+ * ring, wait for it to finish and deallocate the ring. Returns 0 if all 
+ * entries were written, or 1 if the writer thread failed.
+ */
+
+int writer_stop(struct Writer *w)
+{
+	assert(w);
+
+	if (!w->running)
+		return 0;
+
+	pthread_mutex_lock(&w->mutex);
+	__atomic_store_n(&w->done, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_signal(&w->notempty);
+	pthread_mutex_unlock(&w->mutex);
+	pthread_join(w->thread, NULL);
+	w->running = false;
+
+	msg(3, "The writer thread wrote %lu entr%s, the ring was full %lu"
+	       " time%s", w->written, w->written == 1 ? "y" : "ies",
+	       w->waits, w->waits == 1 ? "" : "s");
+	pthread_cond_destroy(&w->notfull);
+	pthread_cond_destroy(&w->notempty);
+	pthread_mutex_destroy(&w->mutex);
+	free(w->slots);
+	w->slots = NULL;
+
+	return w->error;
+}
+
+/* vim: set ts=8 sw=8 sts=8 noet fo+=w tw=79 fenc=UTF-8 : */